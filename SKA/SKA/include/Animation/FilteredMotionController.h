@@ -0,0 +1,88 @@
+//-----------------------------------------------------------------------------
+// FilteredMotionController.h
+//	 Controller that smooths the output of another controller with a
+//   causal StreamFilterBank (see Signals/StreamFilters.h). Usable with
+//   live or procedural controllers, where FFTfilter cannot be used.
+//   The listed channels are read from the upstream controller once per new
+//   time and filtered together; other channels pass through unchanged.
+//   Rotation channels are unwrapped before filtering so that a jump
+//   between +pi and -pi is not smoothed into a spin.
+//   The controller reports the filter latency and the CPU time spent per
+//   frame (including the upstream reads).
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef FILTEREDMOTIONCONTROLLER_DOT_H
+#define FILTEREDMOTIONCONTROLLER_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <map>
+#include <vector>
+using namespace std;
+#include <Animation/MotionController.h>
+#include <Signals/StreamFilters.h>
+
+class SKA_LIB_DECLSPEC FilteredMotionController : public MotionController
+{
+public:
+	// If _owns_upstream is true, the upstream controller is deleted with
+	// this controller. The filter starts as SF_NONE; configure it through
+	// filter().
+	FilteredMotionController(MotionController* _upstream, 
+		const vector<CHANNEL_ID>& _channels, bool _owns_upstream=false);
+	virtual ~FilteredMotionController();
+
+	virtual bool isValidChannel(CHANNEL_ID _channel, float _time)
+	{
+		return upstream->isValidChannel(_channel, _time);
+	}
+
+	virtual float getValue(CHANNEL_ID _channel, float _time);
+
+	StreamFilterBank& filter() { return bank; }
+
+	// restart the filter at the next call to getValue()
+	void reset();
+
+	// Filter latency for slow changes. Seconds are based on the most
+	// recent time step.
+	float latencyFrames() const { return bank.latencyFrames(); }
+	float latencySeconds() const { return bank.latencyFrames()*last_dt; }
+
+	// CPU cost of producing filtered frames
+	long framesProcessed() const { return frames_processed; }
+	double averageMicrosecondsPerFrame() const 
+	{ 
+		return (frames_processed > 0) ? 1.0e6*total_seconds/frames_processed : 0.0; 
+	}
+	void resetStatistics() { frames_processed = 0; total_seconds = 0.0; }
+
+private:
+	MotionController* upstream;
+	bool owns_upstream;
+	vector<CHANNEL_ID> channels;
+	map<CHANNEL_ID, int> channel_index;
+	vector<bool> is_rotation;
+	StreamFilterBank bank;
+
+	bool have_frame;
+	float last_time;
+	float last_dt;
+	vector<float> raw;			// latest upstream values
+	vector<float> unwrapped;	// raw with rotation jumps removed
+	vector<float> filtered;		// filter output, wrapped back next to raw
+
+	long frames_processed;
+	double total_seconds;
+
+	void update(float _time);
+};
+
+#endif
@@ -0,0 +1,121 @@
+//-----------------------------------------------------------------------------
+// MotionMatchingController.h
+//	 Motion controller that plays clips from a MotionMatchingDatabase and,
+//   every search interval, searches the database for the frame that best
+//   continues the current pose towards a desired trajectory. If that frame
+//   is cheaper than carrying on, playback jumps to it.
+//   Only root translation and joint rotation channels are driven.
+//   Jumps are hidden by inertialization: the difference between the pose
+//   being shown and the new pose (and between their velocities) is kept as
+//   an offset per joint that decays to zero with a critically damped
+//   spring, so the new clip is played at once and never blended with the
+//   old one.
+//   The character moves in world space: root translation and facing are
+//   accumulated from the clips, and each new clip is turned and moved to
+//   continue from where the character is.
+//   Searches bound the cost by that of the current frame, so they usually
+//   visit a small part of the database. A controller only reads the
+//   database, so many controllers (characters) can share one.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef MOTIONMATCHINGCONTROLLER_DOT_H
+#define MOTIONMATCHINGCONTROLLER_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+#include <Math/Vector3D.h>
+#include <Math/Quaternion.h>
+#include <Animation/MotionController.h>
+#include <Animation/MotionMatchingDatabase.h>
+
+class SKA_LIB_DECLSPEC MotionMatchingController : public MotionController
+{
+public:
+	// search_interval is in seconds. blend_halflife is the time (seconds)
+	// for the inertialization offsets to halve.
+	MotionMatchingController(const MotionMatchingDatabase* _database,
+		float _search_interval=0.1f, float _blend_halflife=0.1f);
+	virtual ~MotionMatchingController() { }
+
+	// required by inheritance from MotionController
+	virtual bool isValidChannel(CHANNEL_ID _channel, float _time);
+	virtual float getValue(CHANNEL_ID _channel, float _time);
+
+	// Desired root positions and facing directions (only x and z are used)
+	// in world space, at the database's trajectory sample times after the
+	// next search. Usually set every frame from user input or a path.
+	// Until this is called the clips follow their own trajectories.
+	void setDesiredTrajectory(const Vector3D positions[MotionMatchingDatabase::TRAJECTORY_SAMPLES],
+		const Vector3D directions[MotionMatchingDatabase::TRAJECTORY_SAMPLES]);
+	void clearDesiredTrajectory() { has_trajectory = false; }
+
+	// place the character on the floor at position, facing heading (radians about y)
+	void setRootPlacement(const Vector3D& position, float heading);
+
+//---------- Internal state, public for display and logging ---------------
+	struct State {
+		int clip;				// clip being played
+		long frame;				// frame being played
+		float current_time;		// time of last internal state update
+		float next_search_time;	// time of the next database search
+		float last_cost;		// cost of the last jump (or of staying, if there was no jump)
+		long searches;			// searches so far
+		long jumps;				// jumps so far
+	};
+	State getState() const { return status; }
+	// position of the root on the floor and facing angle, in world space
+	Vector3D getRootPosition() const { return Vector3D(world_x, 0.0f, world_z); }
+	float getRootHeading() const;
+
+private:
+	const MotionMatchingDatabase* database;
+	float search_interval;
+	float blend_halflife;
+	long same_clip_window;		// jumps within the clip closer than this many frames are skipped
+	State status;
+	float frame_fraction;		// time since the current frame started, in frames
+
+	// placement of the clip in the world: clip positions and directions are
+	// turned by alignment (radians about y), and the root of the current
+	// frame is over (world_x, world_z)
+	float alignment;
+	float world_x, world_z;
+
+	// desired trajectory, in world space
+	bool has_trajectory;
+	Vector3D desired_positions[MotionMatchingDatabase::TRAJECTORY_SAMPLES];
+	Vector3D desired_directions[MotionMatchingDatabase::TRAJECTORY_SAMPLES];
+
+	// inertialization offsets: per joint a rotation (scaled angle axis)
+	// and angular velocity, and the root height and its velocity
+	vector<Vector3D> offset_rotation;
+	vector<Vector3D> offset_velocity;
+	float offset_height, offset_height_velocity;
+
+	// output channel values: three angles per joint (x, y, z) and the root
+	// translation, recomputed when time changes
+	vector<int> bone_joint;		// joint of each bone id, -1 if none
+	vector<float> joint_angles;
+	float root_translation[3];
+	bool values_valid;
+
+	void update(float _time);
+	void advance(long frames);
+	void search();
+	void jump(int clip, long frame);
+	void decayOffsets(float dt);
+	// joint rotations of a clip frame, with the root turned into world space
+	void clipRotations(int clip, long frame, vector<Quaternion>& rotations) const;
+	void computeChannelValues();
+};
+
+#endif
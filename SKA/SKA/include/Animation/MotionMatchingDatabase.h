@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+// MotionMatchingDatabase.h
+//	 Searchable feature database over a set of motion clips, for motion
+//   matching (see MotionMatchingController). Every frame that has enough
+//   future frames is an entry, described by a feature vector of:
+//     - the root position and facing direction at TRAJECTORY_SAMPLES
+//       future times (horizontal only),
+//     - the positions and velocities of the two feet,
+//     - the velocity of the root,
+//   all relative to the character's position and facing at that frame.
+//   Each feature group is scaled by its spread over the database and by a
+//   weight, so the Euclidean distance between feature vectors is the
+//   matching cost. Entries are stored in a full dimension PoseIndex, so
+//   searches are exact and can stop early given a bound on the cost.
+//   The database is read-only once built and can be shared by any number
+//   of controllers (and threads).
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef MOTIONMATCHINGDATABASE_DOT_H
+#define MOTIONMATCHINGDATABASE_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+#include <Math/Vector3D.h>
+#include <Math/PoseIndex.h>
+#include <Animation/Skeleton.h>
+#include <Animation/MotionSequence.h>
+#include <Animation/PoseFeatures.h>
+
+class SKA_LIB_DECLSPEC MotionMatchingDatabase
+{
+public:
+	// future trajectory samples in each feature vector
+	static const int TRAJECTORY_SAMPLES = 3;
+	// floats per feature vector
+	static const int FEATURE_SIZE = 4*TRAJECTORY_SAMPLES + 12 + 3;
+
+	// relative importance of the feature groups
+	struct Weights
+	{
+		float trajectory_position;
+		float trajectory_direction;
+		float foot_position;
+		float foot_velocity;
+		float root_velocity;
+		Weights() : trajectory_position(1.0f), trajectory_direction(1.5f),
+			foot_position(0.75f), foot_velocity(1.0f), root_velocity(1.0f) { }
+	};
+
+	MotionMatchingDatabase();
+	virtual ~MotionMatchingDatabase() { }
+
+	// Build from clips of the given skeleton, which must all have the same
+	// channels and frame rate. The skeleton is only used during the call
+	// (its motion controller is restored afterwards). The clips are not
+	// kept; the database holds everything needed for playback.
+	// sample_times are the TRAJECTORY_SAMPLES future times in seconds.
+	// Throws AnimationException if the clips or foot bones are unusable.
+	void build(Skeleton* skeleton, const vector<MotionSequence*>& clips,
+		const char* left_foot, const char* right_foot,
+		const float sample_times[TRAJECTORY_SAMPLES], const Weights& weights=Weights(),
+		int max_threads=0);
+	void clear();
+
+	int numClips() const { return int(clips.size()); }
+	float getFrameRate() const { return frame_rate; }
+	// frames after the sample frame of trajectory sample k
+	int sampleOffset(int k) const { return sample_offsets[k]; }
+	// poses of clip c, for playback
+	const PoseFeatures& clipPoses(int c) const { return clips[c].poses; }
+	// facing angle (radians about y, 0 along z) of clip c at frame f
+	float clipHeading(int c, long f) const { return clips[c].headings[f]; }
+	// channels driven by the clips
+	bool isValidChannel(CHANNEL_ID channel) const;
+
+	long numEntries() const { return long(entry_clip.size()); }
+	int entryClip(long e) const { return entry_clip[e]; }
+	long entryFrame(long e) const { return entry_frame[e]; }
+	// first entry of clip c and its number of entries (frames 0 to
+	// clipEntries(c)-1 are entries)
+	long clipFirstEntry(int c) const { return clips[c].first_entry; }
+	long clipEntries(int c) const { return clips[c].num_entries; }
+	// scaled feature vector of entry e
+	const float* entryFeature(long e) const { return &features[e*FEATURE_SIZE]; }
+
+	// Scale the trajectory part of a query: positions and directions are
+	// (x, z) pairs relative to the character, TRAJECTORY_SAMPLES of each.
+	// query must hold FEATURE_SIZE floats; the rest is left unchanged.
+	void setQueryTrajectory(float* query, const float* positions, const float* directions) const;
+	// The entry with the lowest cost for query if it is below max_cost,
+	// otherwise -1.
+	long search(const float* query, float max_cost, float* cost=NULL) const;
+	// cost between query and entry e
+	float cost(const float* query, long e) const;
+
+private:
+	struct Clip
+	{
+		PoseFeatures poses;
+		vector<float> headings;
+		long first_entry;
+		long num_entries;
+	};
+	vector<Clip> clips;
+	vector<CHANNEL_ID> channels;
+	float frame_rate;
+	int sample_offsets[TRAJECTORY_SAMPLES];
+
+	// entries, and their scaled features row by row
+	vector<int> entry_clip;
+	vector<long> entry_frame;
+	vector<float> features;
+	// scaled feature = (feature - offset)*scale
+	float offset[FEATURE_SIZE];
+	float scale[FEATURE_SIZE];
+	PoseIndex index;
+};
+
+#endif
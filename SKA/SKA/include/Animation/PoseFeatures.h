@@ -0,0 +1,77 @@
+//-----------------------------------------------------------------------------
+// PoseFeatures.h
+//	 Packed per-frame pose features of a motion sequence, for comparing
+//   poses (motion graphs, motion matching) without going through text
+//   files. Each frame is stored as one row of floats: the root position
+//   (x, y, z) followed by the local rotation of each joint as a quaternion
+//   (w, x, y, z). Joints are the skeleton bones with rotation channels, in
+//   bone id order, so any skeleton size works.
+//   Rotations are built from the bone's channels in the bone's channel
+//   order (as Bone::computeRotationTransform does) and are kept in the
+//   hemisphere w >= 0, so that nearby rotations have nearby features.
+//   Frames are converted four at a time and in parallel across frames.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef POSEFEATURES_DOT_H
+#define POSEFEATURES_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+#include <Math/Math.h>
+#include <Animation/Skeleton.h>
+#include <Animation/MotionSequence.h>
+
+class SKA_LIB_DECLSPEC PoseFeatures
+{
+public:
+	PoseFeatures();
+	virtual ~PoseFeatures() { }
+
+	// Convert every frame of motion. The root position comes from the
+	// translation channels of bone 0. Channels missing from motion are
+	// taken as zero.
+	void extract(Skeleton* skeleton, MotionSequence* motion, int max_threads=0);
+	void clear();
+
+	long numFrames() const { return num_frames; }
+	int numJoints() const { return int(joint_bones.size()); }
+	// floats per frame: 3 + 4*numJoints()
+	int frameSize() const { return frame_size; }
+	float getFrameRate() const { return frame_rate; }
+	// bone id of joint j
+	short jointBone(int j) const { return joint_bones[j]; }
+	// order the bone's rotation channels are applied in, for converting
+	// rotations back to channel values
+	EULER_ORDER jointOrder(int j) const { return joint_orders[j]; }
+
+	const float* frame(long f) const { return &data[f*frame_size]; }
+	const float* rootPosition(long f) const { return frame(f); }
+	// w, x, y, z of joint j in frame f
+	const float* jointRotation(long f, int j) const { return frame(f) + 3 + 4*j; }
+	// all frames, row by row
+	const vector<float>& getData() const { return data; }
+
+	// Returns false if the file cannot be written, or cannot be read as
+	// pose features (in which case the features are unchanged).
+	bool save(const char* filename) const;
+	bool load(const char* filename);
+
+private:
+	long num_frames;
+	int frame_size;
+	float frame_rate;
+	vector<short> joint_bones;
+	vector<EULER_ORDER> joint_orders;
+	vector<float> data;
+};
+
+#endif
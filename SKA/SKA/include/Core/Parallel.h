@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------
+// Parallel.h
+//	 Minimal helpers for splitting loops across worker threads.
+//   When ENABLE_THREADS is 0 all work runs on the calling thread.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef PARALLEL_DOT_H
+#define PARALLEL_DOT_H
+#include <Core/SystemConfiguration.h>
+#if ENABLE_THREADS==1
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+using namespace std;
+
+// Number of worker threads that parallel helpers will use.
+// max_threads <= 0 means "use all hardware threads".
+inline int parallelThreadCount(int max_threads=0)
+{
+#if ENABLE_THREADS==1
+	int n = int(thread::hardware_concurrency());
+	if (n < 1) n = 1;
+	if ((max_threads > 0) && (n > max_threads)) n = max_threads;
+	return n;
+#else
+	return 1;
+#endif
+}
+
+// Split [begin,end) into contiguous blocks and call func(block_begin, block_end)
+// for each block. Blocks are never smaller than min_block items, so small loops
+// stay on the calling thread. func must be safe to call concurrently.
+// If func throws, the first exception is rethrown on the calling thread
+// once every block has finished.
+template <class FUNC>
+void parallelForBlocks(long begin, long end, FUNC func, long min_block=1, int max_threads=0)
+{
+	long count = end - begin;
+	if (count <= 0) return;
+	if (min_block < 1) min_block = 1;
+	long num_blocks = parallelThreadCount(max_threads);
+	if (num_blocks > count/min_block) num_blocks = count/min_block;
+	if (num_blocks <= 1)
+	{
+		func(begin, end);
+		return;
+	}
+#if ENABLE_THREADS==1
+	// an exception escaping a worker thread would terminate the program
+	exception_ptr error;
+	mutex error_lock;
+	auto run = [&func, &error, &error_lock](long b, long e)
+	{
+		try { func(b, e); }
+		catch (...)
+		{
+			lock_guard<mutex> lock(error_lock);
+			if (!error) error = current_exception();
+		}
+	};
+	vector<thread> workers;
+	long block = count / num_blocks;
+	long extra = count % num_blocks;
+	long b = begin;
+	for (long i=0; i<num_blocks; i++)
+	{
+		long e = b + block + (i < extra ? 1 : 0);
+		if (i == num_blocks-1) run(b, e);	// last block on the calling thread
+		else workers.push_back(thread(run, b, e));
+		b = e;
+	}
+	for (unsigned int i=0; i<workers.size(); i++) workers[i].join();
+	if (error) rethrow_exception(error);
+#else
+	func(begin, end);
+#endif
+}
+
+// Call func(i) for every i in [begin,end).
+template <class FUNC>
+void parallelFor(long begin, long end, FUNC func, long min_block=1, int max_threads=0)
+{
+	parallelForBlocks(begin, end,
+		[&func](long b, long e) { for (long i=b; i<e; i++) func(i); },
+		min_block, max_threads);
+}
+
+#endif
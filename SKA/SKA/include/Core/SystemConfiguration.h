@@ -60,5 +60,36 @@
 #define ENABLE_FFTW 0
 #endif
 
+// ENABLE_THREADS: Enable code that spreads work across multiple threads.
+//   Uses the C++11 standard thread library (see Core/Parallel.h).
+//   Linux builds may need -pthread when linking applications.
+// 0 = run all work on the calling thread
+// 1 = allow worker threads
+//   This flag can be overridden with a compiler flag.
+#ifndef ENABLE_THREADS
+#define ENABLE_THREADS 1
+#endif
+
+// ENABLE_SIMD: Enable SSE versions of the math kernels (see Math/Matrix4x4.h).
+//   SSE is only used when the compiler targets it (all x86-64 builds,
+//   x86 builds with SSE enabled). Other targets use the scalar code.
+// 0 = scalar code only
+// 1 = use SSE when available
+//   This flag can be overridden with a compiler flag.
+#ifndef ENABLE_SIMD
+#define ENABLE_SIMD 1
+#endif
+#if (ENABLE_SIMD==1) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define SKA_SSE 1
+#else
+#define SKA_SSE 0
+#endif
+// SSE2 adds the integer operations used by some kernels (x86-64 always has it)
+#if (SKA_SSE==1) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define SKA_SSE2 1
+#else
+#define SKA_SSE2 0
+#endif
+
 #endif
 
@@ -18,13 +18,15 @@
 
 class Skeleton;
 class MotionSequence;
+class ChannelSelection;
 
 class SKA_LIB_DECLSPEC AMC_Reader
 {
 public:
 	AMC_Reader() : motion(NULL), AMC_angles_are_degrees(true) { }
 
-	MotionSequence* readAMC(const char* motionFilename, Skeleton* skeleton);
+	// If selection is not NULL, only the selected channels are parsed and stored.
+	MotionSequence* readAMC(const char* motionFilename, Skeleton* skeleton, ChannelSelection* selection=NULL);
 	
 private:
 	MotionSequence* motion;
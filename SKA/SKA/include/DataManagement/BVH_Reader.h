@@ -25,12 +25,15 @@
 #include <iostream>
 using namespace std;
 
+class ChannelSelection;
+
 class SKA_LIB_DECLSPEC BVH_Reader
 {
 public:
 	BVH_Reader();
 	virtual ~BVH_Reader();
-	pair<Skeleton*, MotionSequence*> readBVH(const char* inputFilename);
+	// If selection is not NULL, only the selected channels are converted and stored.
+	pair<Skeleton*, MotionSequence*> readBVH(const char* inputFilename, ChannelSelection* selection=NULL);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// BVH_Writer.h
+//	 Writes Biovision Hierarchical data file (BVH)
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef BVH_WRITER_DOT_H
+#define BVH_WRITER_DOT_H
+#include <Core/SystemConfiguration.h>
+
+class Skeleton;
+class MotionSequence;
+
+// Each SKA bone becomes a BVH joint whose OFFSET is the end of its parent bone.
+// Bones that BVH_Reader split from one joint ("name__0", "name__1", ...) are
+// merged back into a single joint. Bones with a local axis (ASF skeletons)
+// are written with ZXY rotation channels computed from C*M*Cinv, so the
+// exported pose matches what SKA displays.
+class SKA_LIB_DECLSPEC BVH_Writer
+{
+public:
+	bool writeBVH(const char* outputFilename, 
+		Skeleton* skeleton, 
+		MotionSequence* motion,
+		bool overwrite=true);
+};
+
+#endif
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+// BinaryStream.h
+//	 Little-endian byte packing helpers for SKA binary file formats.
+//   ByteWriter appends values to a memory buffer.
+//   ByteReader reads them back with bounds checking.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef BINARYSTREAM_DOT_H
+#define BINARYSTREAM_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// SKA binary formats that are meant to be memory mapped store
+// data little-endian (the byte order of all current target machines).
+inline bool hostIsLittleEndian()
+{
+	unsigned int one = 1;
+	return *((unsigned char*)&one) == 1;
+}
+
+// byte swap an array of 4 byte words in place
+inline void swapEndian4Array(void* data, long count)
+{
+	unsigned char* p = (unsigned char*)data;
+	for (long i=0; i<count; i++, p+=4)
+	{
+		unsigned char c;
+		c=p[0]; p[0]=p[3]; p[3]=c;
+		c=p[1]; p[1]=p[2]; p[2]=c;
+	}
+}
+
+class ByteWriter
+{
+public:
+	vector<unsigned char> bytes;
+
+	void putU8(unsigned char v) { bytes.push_back(v); }
+	void putU16(unsigned short v) { putUnsigned(v, 2); }
+	void putU32(unsigned int v) { putUnsigned(v, 4); }
+	void putU64(unsigned long long v) { putUnsigned(v, 8); }
+	void putI16(short v) { putUnsigned((unsigned short)v, 2); }
+	void putI32(int v) { putUnsigned((unsigned int)v, 4); }
+	void putF32(float v) { unsigned int u; memcpy(&u, &v, 4); putU32(u); }
+	void putF64(double v) { unsigned long long u; memcpy(&u, &v, 8); putU64(u); }
+	// strings are stored as a 16 bit length followed by the characters
+	void putString(const string& s)
+	{
+		unsigned short n = (unsigned short)(s.size() < 65535 ? s.size() : 65535);
+		putU16(n);
+		bytes.insert(bytes.end(), s.begin(), s.begin()+n);
+	}
+	void putBytes(const void* p, long n)
+	{
+		const unsigned char* c = (const unsigned char*)p;
+		bytes.insert(bytes.end(), c, c+n);
+	}
+	void padTo(long alignment)
+	{
+		while (bytes.size() % alignment != 0) bytes.push_back(0);
+	}
+	long size() { return long(bytes.size()); }
+	// overwrite a previously written 64 bit value
+	void patchU64(long pos, unsigned long long v)
+	{
+		for (int i=0; i<8; i++) bytes[pos+i] = (unsigned char)(v >> (8*i));
+	}
+private:
+	void putUnsigned(unsigned long long v, int n)
+	{
+		for (int i=0; i<n; i++) bytes.push_back((unsigned char)(v >> (8*i)));
+	}
+};
+
+class ByteReader
+{
+public:
+	ByteReader(const unsigned char* _data, long _size)
+		: data(_data), size(_size), pos(0), failed(false) { }
+
+	// true until a read runs past the end of the buffer
+	bool good() { return !failed; }
+	long position() { return pos; }
+	long remaining() { return size - pos; }
+	void seek(long p) { if ((p < 0) || (p > size)) failed = true; else pos = p; }
+
+	unsigned char getU8() { return (unsigned char)getUnsigned(1); }
+	unsigned short getU16() { return (unsigned short)getUnsigned(2); }
+	unsigned int getU32() { return (unsigned int)getUnsigned(4); }
+	unsigned long long getU64() { return getUnsigned(8); }
+	short getI16() { return (short)getU16(); }
+	int getI32() { return (int)getU32(); }
+	float getF32() { unsigned int u = getU32(); float v; memcpy(&v, &u, 4); return v; }
+	double getF64() { unsigned long long u = getU64(); double v; memcpy(&v, &u, 8); return v; }
+	string getString()
+	{
+		unsigned short n = getU16();
+		if (!check(n)) return string();
+		string s((const char*)data+pos, n);
+		pos += n;
+		return s;
+	}
+	const unsigned char* getBytes(long n)
+	{
+		if (!check(n)) return NULL;
+		const unsigned char* p = data+pos;
+		pos += n;
+		return p;
+	}
+private:
+	const unsigned char* data;
+	long size;
+	long pos;
+	bool failed;
+	bool check(long n)
+	{
+		if (failed || (n < 0) || (pos+n > size)) { failed = true; return false; }
+		return true;
+	}
+	unsigned long long getUnsigned(int n)
+	{
+		if (!check(n)) return 0;
+		unsigned long long v = 0;
+		for (int i=0; i<n; i++) v |= ((unsigned long long)data[pos+i]) << (8*i);
+		pos += n;
+		return v;
+	}
+};
+
+#endif
@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+// BufferedWriter.h
+//	 Buffered text output with fast number formatting.
+//   Used by the text file writers (ASF, AMC, BVH) in place of ofstream.
+//   Text is accumulated in a large memory buffer and written to the file
+//   in big blocks. Nothing is flushed at line ends.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef BUFFEREDWRITER_DOT_H
+#define BUFFEREDWRITER_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <Core/Parallel.h>
+#include <cstdio>
+#include <vector>
+using namespace std;
+
+class SKA_LIB_DECLSPEC BufferedWriter
+{
+public:
+	// A writer that is never opened collects text in memory only.
+	// This is used to format blocks of text in parallel, which are
+	// then appended to a file writer in order.
+	BufferedWriter(long _capacity=1<<20);
+	virtual ~BufferedWriter();
+
+	bool open(const char* filename);
+	// flush and close. Returns false if any write failed.
+	bool close();
+	bool isOpen() { return file != NULL; }
+	bool good() { return !failed; }
+
+	// write buffered text to the file
+	void flush();
+	// discard buffered text (memory-only use)
+	void clear() { length = 0; }
+	long size() { return length; }
+	const char* data() { return buffer; }
+
+	BufferedWriter& put(char c)
+	{
+		if (length >= capacity) makeRoom(1);
+		buffer[length++] = c;
+		return *this;
+	}
+	BufferedWriter& put(const char* s);
+	BufferedWriter& put(const char* s, long n);
+	BufferedWriter& putInt(long v);
+	// Fixed point with at most 'decimals' digits after the point.
+	// Trailing zeros are dropped ("12.5", "0", "-3.25").
+	BufferedWriter& putFloat(float v, int decimals=6);
+	BufferedWriter& newline() { return put('\n'); }
+	BufferedWriter& append(BufferedWriter& other) { return put(other.buffer, other.length); }
+
+	// stream style for mixed text
+	BufferedWriter& operator<<(const char* s) { return put(s); }
+	BufferedWriter& operator<<(char c) { return put(c); }
+	BufferedWriter& operator<<(int v) { return putInt(v); }
+	BufferedWriter& operator<<(short v) { return putInt(v); }
+	BufferedWriter& operator<<(long v) { return putInt(v); }
+	BufferedWriter& operator<<(float v) { return putFloat(v); }
+	BufferedWriter& operator<<(double v) { return putFloat(float(v)); }
+
+private:
+	void makeRoom(long n);
+	char* buffer;
+	long capacity;
+	long length;
+	FILE* file;
+	bool failed;
+
+	// not copyable
+	BufferedWriter(const BufferedWriter&);
+	BufferedWriter& operator=(const BufferedWriter&);
+};
+
+// Format items [0,num_items) into out, in order, by calling
+// format_item(BufferedWriter& part, long item). Blocks of items are
+// formatted into memory on worker threads and appended one round at a
+// time, so memory use stays bounded for long motions.
+template <class FUNC>
+void formatInOrder(BufferedWriter& out, long num_items, FUNC format_item, long block_size=256)
+{
+	int num_parts = parallelThreadCount();
+	if ((num_parts <= 1) || (num_items <= block_size))
+	{
+		for (long i=0; i<num_items; i++) format_item(out, i);
+		return;
+	}
+	vector<BufferedWriter*> parts(num_parts);
+	for (int p=0; p<num_parts; p++) parts[p] = new BufferedWriter(1<<16);
+	long round_size = block_size*num_parts;
+	for (long round_start=0; round_start<num_items; round_start+=round_size)
+	{
+		parallelFor(0, num_parts, [&](long p) {
+			long b = round_start + p*block_size;
+			long e = b + block_size;
+			if (e > num_items) e = num_items;
+			parts[p]->clear();
+			for (long i=b; i<e; i++) format_item(*parts[p], i);
+		});
+		for (int p=0; p<num_parts; p++) out.append(*parts[p]);
+	}
+	for (int p=0; p<num_parts; p++) delete parts[p];
+}
+
+#endif
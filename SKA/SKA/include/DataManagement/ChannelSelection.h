@@ -0,0 +1,58 @@
+//-----------------------------------------------------------------------------
+// ChannelSelection.h
+//	 A subset of bones and channels to load from a motion file.
+//   Readers that accept a selection only decode and store the selected
+//   channels. All other channels are absent from the MotionSequence
+//   (getValue() returns 0 for them). The skeleton is always complete.
+//   Bones are selected by name, so one selection works for any file
+//   whose skeleton uses those names. Split BVH bones ("Hips__0", "Hips__1")
+//   match their joint name ("Hips").
+//   Note that computing world positions of a bone also needs the rotations
+//   of all its ancestors.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef CHANNELSELECTION_DOT_H
+#define CHANNELSELECTION_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <Animation/Channel.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+class Skeleton;
+
+class SKA_LIB_DECLSPEC ChannelSelection
+{
+public:
+	ChannelSelection() { }
+
+	// select all channels of a bone
+	void addBone(const char* bone_name);
+	// select one channel of a bone
+	void addChannel(const char* bone_name, CHANNEL_TYPE channel_type);
+	// select a bone and every bone on the path from it to the root
+	void addBoneAndAncestors(Skeleton* skeleton, const char* bone_name);
+	void clear() { names.clear(); masks.clear(); }
+	bool isEmpty() { return names.size() == 0; }
+
+	bool selectsBone(const char* bone_name);
+	bool selectsChannel(const char* bone_name, CHANNEL_TYPE channel_type);
+	bool selectsChannel(Skeleton* skeleton, CHANNEL_ID channel);
+
+private:
+	vector<string> names;			// joint names, without any "__n" suffix
+	vector<unsigned short> masks;	// bit (1<<channel_type) per selected channel
+	unsigned short boneMask(const char* bone_name);
+	void addMask(const char* bone_name, unsigned short mask);
+};
+
+#endif
@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// CompressedChannels.h
+//	 Lossless compression of motion channel data.
+//   Each channel is cut into fixed-size chunks of frames. Each chunk is
+//   predicted from its own previous values (XOR, delta or linear
+//   prediction on the float bit patterns) and the residuals are Rice coded.
+//   Decoding returns exactly the original bits.
+//   Chunks are independent, so any range of frames of any channel can be
+//   decoded without touching the rest of the data, and encoding and
+//   decoding run across several threads.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef COMPRESSEDCHANNELS_DOT_H
+#define COMPRESSEDCHANNELS_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+
+// Reads a compressed channel block produced by CompressedChannels::encode.
+// attach() does not copy the block, so the caller keeps it alive
+// (for example a memory mapped file) while the object is used.
+class SKA_LIB_DECLSPEC CompressedChannels
+{
+public:
+	// Compress column-major float data (all frames of channel 0, then channel 1, ...).
+	// Returns false if the dimensions are out of range.
+	static bool encode(const float* data, long num_frames, long num_channels,
+		vector<unsigned char>& out, long chunk_frames=256, int max_threads=0);
+
+	// Size of the block header and chunk table, which is enough to
+	// find every chunk. Returns 0 if the bytes do not start a valid block.
+	static long tableSize(const unsigned char* block, long available);
+
+	CompressedChannels();
+	// With table_only, block holds just the first tableSize() bytes. The chunk
+	// layout can then be queried and channels decoded from separately read bytes.
+	bool attach(const unsigned char* block, long size, bool table_only=false);
+	bool isValid() { return block != NULL; }
+
+	long numChannels() { return num_channels; }
+	long numFrames() { return num_frames; }
+	long chunkFrames() { return chunk_frames; }
+	long numChunks() { return num_chunks; }
+	// byte range of one chunk, relative to the start of the block
+	long chunkOffset(long channel, long chunk);
+	long chunkSize(long channel, long chunk);
+	// byte range holding all chunks of one channel (chunks are stored channel by channel)
+	long channelOffset(long channel) { return chunkOffset(channel, 0); }
+	long channelSize(long channel);
+
+	// Decoders return false if the request is out of range or the data is corrupt.
+	// dest receives one float per frame.
+	bool decodeChunk(long channel, long chunk, float* dest);
+	bool decodeFrames(long channel, long first_frame, long count, float* dest);
+	bool decodeChannel(long channel, float* dest);
+	// decode everything into column-major order
+	bool decodeAll(float* dest, int max_threads=0);
+
+	// decode one chunk from its own bytes (as located by chunkOffset/chunkSize)
+	static bool decodeChunkBytes(const unsigned char* bytes, long size, long count, float* dest);
+	// decode one channel from its own bytes (as located by channelOffset/channelSize)
+	bool decodeChannelBytes(long channel, const unsigned char* bytes, float* dest);
+
+private:
+	const unsigned char* block;
+	long block_size;
+	long num_channels;
+	long num_frames;
+	long chunk_frames;
+	long num_chunks;
+	long data_start;
+	unsigned long long tableEntry(long i);
+};
+
+#endif
@@ -16,11 +16,14 @@
 #ifndef DATA_MANAGER_DOT_H
 #define DATA_MANAGER_DOT_H
 #include <Core/SystemConfiguration.h>
+#include <cstddef>
 #include <utility>
 using namespace std;
 
 class Skeleton;
 class MotionSequence;
+class MotionLibrary;
+class ChannelSelection;
 struct DataManagerData;
 
 class SKA_LIB_DECLSPEC DataManager
@@ -44,14 +47,20 @@ public:
 	//   for every bone, even when the ASF specfies limited DOF.
 	//   This obviously wastes space, but it makes the motion compatible 
 	//   for conversions to other formats.
+	//
+	// All motion readers take an optional ChannelSelection. When one is given
+	//   only the selected bones/channels are decoded and stored in the motion.
+	//   Binary formats (SKM, motion libraries) read only the selected columns.
 	pair<Skeleton*, MotionSequence*> readASFAMC(
 		const char* _asf_file, 
-		const char* _amc_file);
+		const char* _amc_file,
+		ChannelSelection* _selection=NULL);
 	Skeleton* readASF(
 		const char* _asf_file);
 	MotionSequence* readAMC(
 		Skeleton* _skel,
-		const char* _amc_file);
+		const char* _amc_file,
+		ChannelSelection* _selection=NULL);
 
 	void writeASFAMC(
 		Skeleton* _skel, 
@@ -69,7 +78,8 @@ public:
 //---------- BVH file management -------------------
 
 	pair<Skeleton*, MotionSequence*> readBVH(
-		const char* _bvh_file);
+		const char* _bvh_file,
+		ChannelSelection* _selection=NULL);
 
 	void writeBVH(
 		Skeleton* _skel, 
@@ -80,25 +90,47 @@ public:
 
 	pair<Skeleton*, MotionSequence*> readSKSSKM(
 		const char* _asf_file, 
-		const char* _amc_file);
+		const char* _amc_file,
+		ChannelSelection* _selection=NULL);
 	Skeleton* readSKS(
 		const char* _asf_file);
 	MotionSequence* readSKM(
 		Skeleton* _skel,
-		const char* _amc_file);
+		const char* _amc_file,
+		ChannelSelection* _selection=NULL);
 
+	// _compress stores the motion with lossless chunked compression
 	void writeSKSSKM(
 		Skeleton* _skel, 
 		MotionSequence* _ms, 
 		const char* _asf_file,
-		const char* _amc_file);
+		const char* _amc_file,
+		bool _compress=false);
 	void writeSKS(
 		Skeleton* _skel,
 		const char* _asf_file);
 	void writeSKM(
 		Skeleton* _skel, 
 		MotionSequence* _ms, 
-		const char* _amc_file);
+		const char* _amc_file,
+		bool _compress=false);
+
+//---------- Motion library (SKL) management -------------------
+
+	// A motion library packs many clips and their skeletons into one file
+	// (see MotionLibrary.h). Only the index is read when the library is opened.
+	// Each clip is read when it is requested.
+	// Build libraries with MotionLibraryBuilder or the MotionLibraryTool application.
+	void openMotionLibrary(
+		const char* _skl_file,
+		bool _use_mmap=false);
+	void closeMotionLibrary();
+	long numLibraryClips();
+	const char* libraryClipName(long _index);
+	pair<Skeleton*, MotionSequence*> readLibraryClip(
+		const char* _clip_name,
+		ChannelSelection* _selection=NULL);
+	MotionLibrary* getMotionLibrary();
 
 //---------- Format Conversion Utilities -------------------
 
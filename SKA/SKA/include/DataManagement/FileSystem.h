@@ -16,6 +16,7 @@
 #ifndef FILESYSTEM_DOT_H
 #define FILESYSTEM_DOT_H
 #include <string>
+#include <list>
 using namespace std;
 #include <Core/SystemConfiguration.h>
 
@@ -40,6 +41,10 @@ public:
 
 	// Returns true if path specifies a valid directory.
 	static bool fileExists(const char* path);
+
+	// Lists the names (without path) of the regular files and subdirectories in path.
+	// "." and ".." are not included. Returns false if the directory could not be read.
+	static bool listDirectory(const char* path, list<string>& files, list<string>& subdirs);
 };
 
 #endif
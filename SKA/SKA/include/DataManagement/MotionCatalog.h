@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// MotionCatalog.h
+//	 Index of the motion files found in a set of directory trees.
+//   Scanning reads only file headers (BVH hierarchy and frame counts,
+//   ASF names, AMC frame rate and last frame number, SKM dimensions and
+//   ids, SKL library indexes), so large collections can be catalogued
+//   quickly. Files are examined in parallel.
+//   The catalog can be saved to a compact index file and queried by
+//   skeleton, duration, format and name pattern.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef MOTIONCATALOG_DOT_H
+#define MOTIONCATALOG_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct MotionCatalogData;
+
+struct SKA_LIB_DECLSPEC MotionCatalogEntry
+{
+	string name;			// path below the scanned directory, '/' separated, no extension
+	string path;			// file path as found by the scan
+	string format;			// "BVH", "AMC", "ASF", "SKM" or "SKL"
+	string clip;			// clip name inside an SKL library, otherwise empty
+	string skeleton_id;		// ASF :name, SKM skeleton id, or a BVH hierarchy signature
+	string skeleton_file;	// ASF file used with an AMC file, otherwise empty
+	long frames;
+	float frame_rate;
+	short bones;			// 0 if not known from the header
+	short channels;			// 0 if not known from the header
+	unsigned long long file_size;
+
+	MotionCatalogEntry() : frames(0), frame_rate(0.0f), bones(0), channels(0), file_size(0) { }
+	float duration() { return (frame_rate > 0.0f) ? frames/frame_rate : 0.0f; }
+};
+
+// Query fields that are empty (or negative for durations) are not tested.
+// Patterns may use '*' (any characters) and '?' (one character).
+struct SKA_LIB_DECLSPEC MotionCatalogQuery
+{
+	string name_pattern;
+	string skeleton_pattern;
+	string format;
+	float min_duration;
+	float max_duration;
+	MotionCatalogQuery() : min_duration(-1.0f), max_duration(-1.0f) { }
+};
+
+class SKA_LIB_DECLSPEC MotionCatalog
+{
+public:
+	MotionCatalog();
+	virtual ~MotionCatalog();
+
+	// Scan a directory tree and add an entry for every motion file in it.
+	// Returns the number of entries added.
+	long scan(const char* directory, int max_threads=0);
+	// Add a single file (name is used as the entry name).
+	bool addFile(const char* path, const char* name);
+	void clear();
+
+	bool save(const char* filename);
+	bool load(const char* filename);
+
+	long numEntries();
+	MotionCatalogEntry& entry(long index);
+
+	// indices of the entries that match, in catalog order
+	long query(MotionCatalogQuery& q, vector<long>& results);
+	static bool matchPattern(const char* pattern, const char* text);
+
+private:
+	MotionCatalogData* data;
+};
+
+#endif
@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+// MotionLibrary.h
+//	 Single-file library of many motion clips (SKL files).
+//   The file starts with a header and an index of every clip
+//   (name, skeleton, frame count, frame rate, channel list and payload
+//   location), followed by the clip payloads aligned on 64 byte boundaries.
+//   Any clip can be loaded by name without reading the others.
+//   Skeletons are stored once and shared by all clips that use them.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef MOTIONLIBRARY_DOT_H
+#define MOTIONLIBRARY_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <Animation/Channel.h>
+#include <utility>
+using namespace std;
+
+class Skeleton;
+class MotionSequence;
+class ChannelSelection;
+struct MotionLibraryData;
+struct MotionLibraryBuilderData;
+
+// Reads an SKL file. The index is read by open(). Clip payloads are read
+// on demand, either with file reads or from a memory mapping of the file.
+// Load methods may be called from several threads at once.
+class SKA_LIB_DECLSPEC MotionLibrary
+{
+public:
+	MotionLibrary();
+	virtual ~MotionLibrary();
+
+	bool open(const char* filename, bool use_mmap=false);
+	void close();
+	bool isOpen();
+	bool isMapped();
+
+	// index queries - clip indices run from 0 to numClips()-1
+	long numClips();
+	long findClip(const char* clip_name);	// returns -1 if not found
+	const char* clipName(long clip);
+	const char* clipSource(long clip);
+	const char* clipSkeletonId(long clip);
+	long clipFrames(long clip);
+	float clipFrameRate(long clip);
+	short clipNumChannels(long clip);
+	CHANNEL_ID clipChannel(long clip, short channel_index);
+	bool clipCompressed(long clip);
+	unsigned long long clipStoredSize(long clip);	// payload bytes in the file
+
+	// Loaders create new objects that the caller must delete.
+	// They return NULL if the clip index is invalid or the payload can not be read.
+	// With a selection only the selected channels are read from the file.
+	Skeleton* loadSkeleton(long clip);
+	MotionSequence* loadMotion(long clip, ChannelSelection* selection=NULL);
+	pair<Skeleton*, MotionSequence*> loadClip(long clip, ChannelSelection* selection=NULL);
+	pair<Skeleton*, MotionSequence*> loadClip(const char* clip_name, ChannelSelection* selection=NULL);
+
+	// Column-major frame data inside the mapping, without copying.
+	// Only available when the library is memory mapped and the clip is
+	// stored uncompressed in the machine's byte order. Otherwise NULL.
+	const float* mappedClipData(long clip);
+
+private:
+	MotionLibraryData* data;
+	bool readPayload(long clip, unsigned long long offset, unsigned long long size, unsigned char* dest);
+};
+
+// Writes an SKL file. Clip payloads are streamed to a temporary file
+// as clips are added, so memory use does not grow with the library size.
+// finish() writes the header and index and then appends the payloads.
+class SKA_LIB_DECLSPEC MotionLibraryBuilder
+{
+public:
+	MotionLibraryBuilder();
+	virtual ~MotionLibraryBuilder();
+
+	bool create(const char* filename);
+	// Store clips added from now on with lossless chunked compression
+	// (see CompressedChannels). Off by default.
+	void setCompression(bool compress, long chunk_frames=256);
+	// clip names must be unique within a library
+	bool addClip(const char* clip_name, Skeleton* skeleton, MotionSequence* motion, const char* source=NULL);
+	long numClips();
+	bool finish();
+
+private:
+	MotionLibraryBuilderData* data;
+};
+
+#endif
@@ -18,17 +18,22 @@
 #include <Animation/Skeleton.h>
 #include <Animation/MotionSequence.h>
 
+class ChannelSelection;
+
 class SKA_LIB_DECLSPEC SKM_ReaderWriter
 {
 public:
+	// If selection is not NULL, only the selected channels are read.
 	static MotionSequence* readSKM(
 		const char* inputFilename,
-		Skeleton* skeleton);
+		Skeleton* skeleton,
+		ChannelSelection* selection=NULL);
 	static bool writeSKM(
 		const char* outputFilename,
 		Skeleton* skeleton,
 		MotionSequence* ms,
-		bool overwrite=true);
+		bool overwrite=true,
+		bool compress=false);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,133 @@
+//-----------------------------------------------------------------------------
+// BatchTrig.h
+//	 Sine and cosine of many angles at once, four lanes at a time.
+//   Both values come from one argument reduction, so asking for sine and
+//   cosine together costs little more than either one.
+//   TRIG_FULL is accurate to a few float ulps (|angle| above 8192 falls
+//   back to the C library). TRIG_FAST keeps errors below 3e-6 for angles
+//   within a few hundred radians, which is ample for joint angles.
+//   batchAtan2 is the four-lane counterpart of atan2, used where rotations
+//   are factored back into angles.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef BATCHTRIG_DOT_H
+#define BATCHTRIG_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+using namespace std;
+#include <Math/Float4.h>
+
+enum TRIG_PRECISION { TRIG_FULL, TRIG_FAST };
+
+// s[i] = sin(angles[i]) and c[i] = cos(angles[i]).
+// Either output may be NULL. Outputs may be the same array as angles.
+SKA_LIB_DECLSPEC void batchSinCos(const float* angles, float* s, float* c, long n,
+	TRIG_PRECISION precision=TRIG_FULL);
+
+// result[i] = atan2(y[i], x[i]), in [-pi, pi], within 2 float ulps.
+// atan2(0, 0) is 0. result may be the same array as y or x.
+SKA_LIB_DECLSPEC void batchAtan2(const float* y, const float* x, float* result, long n);
+
+// Kernel for use inside other four-lane kernels.
+inline void f4sincos(Float4 x, Float4& s, Float4& c, TRIG_PRECISION precision=TRIG_FULL)
+{
+	// quadrant q = round(|x|/(pi/2)), r = |x| - q*pi/2 in [-pi/4, pi/4]
+	Float4 ax = f4abs(x);
+	Float4 q = f4round(f4mul(ax, f4set1(0.636619772f)));
+	Float4 r;
+	if (precision == TRIG_FULL)
+	{
+		// pi/2 split into three parts (Cody and Waite), exact products with q
+		r = f4sub(ax, f4mul(q, f4set1(1.5703125f)));
+		r = f4sub(r, f4mul(q, f4set1(4.837512969970703125e-4f)));
+		r = f4sub(r, f4mul(q, f4set1(7.54978995489188216e-8f)));
+	}
+	else
+	{
+		r = f4sub(ax, f4mul(q, f4set1(1.5703125f)));
+		r = f4sub(r, f4mul(q, f4set1(4.83826794897e-4f)));
+	}
+
+	// minimax polynomials on [-pi/4, pi/4]
+	Float4 z = f4mul(r, r);
+	Float4 ps, pc;
+	if (precision == TRIG_FULL)
+	{
+		ps = f4set1(-1.9515295891e-4f);
+		ps = f4madd(ps, z, f4set1(8.3321608736e-3f));
+		ps = f4madd(ps, z, f4set1(-1.6666654611e-1f));
+		pc = f4set1(2.443315711809948e-5f);
+		pc = f4madd(pc, z, f4set1(-1.388731625493765e-3f));
+		pc = f4madd(pc, z, f4set1(4.166664568298827e-2f));
+		pc = f4madd(pc, z, f4set1(-0.5f));
+	}
+	else
+	{
+		ps = f4set1(8.18170545e-3f);
+		ps = f4madd(ps, z, f4set1(-1.66647989e-1f));
+		pc = f4set1(-1.36423339e-3f);
+		pc = f4madd(pc, z, f4set1(4.16605023e-2f));
+		pc = f4madd(pc, z, f4set1(-0.499999797f));
+	}
+	Float4 sin_r = f4madd(f4mul(ps, z), r, r);
+	Float4 cos_r = f4madd(pc, z, f4set1(1.0f));
+
+	// q mod 4 from the fractional part of q/4: 0, 0.25, +-0.5, -0.25
+	Float4 f = f4mul(q, f4set1(0.25f));
+	f = f4sub(f, f4round(f));
+	Float4 m1 = f4cmpgt(f, f4set1(0.125f));
+	Float4 m3 = f4cmplt(f, f4set1(-0.125f));
+	Float4 m13 = f4and(f4cmpgt(f4abs(f), f4set1(0.125f)), f4cmplt(f4abs(f), f4set1(0.375f)));
+	Float4 m2 = f4cmpgt(f4abs(f), f4set1(0.375f));
+	m1 = f4and(m1, m13);
+	m3 = f4and(m3, m13);
+
+	// quadrant 0: (sin r, cos r), 1: (cos r, -sin r), 2: (-sin r, -cos r), 3: (-cos r, sin r)
+	Float4 odd = f4or(m1, m3);
+	Float4 sv = f4select(odd, cos_r, sin_r);
+	Float4 cv = f4select(odd, sin_r, cos_r);
+	Float4 sign_bit = f4set1(-0.0f);
+	Float4 s_negate = f4and(f4or(m2, m3), sign_bit);
+	Float4 c_negate = f4and(f4or(m1, m2), sign_bit);
+	// sine is odd, so restore the sign of x
+	s = f4xor(f4xor(sv, s_negate), f4signbit(x));
+	c = f4xor(cv, c_negate);
+}
+
+// Kernel for use inside other four-lane kernels.
+inline Float4 f4atan2(Float4 y, Float4 x)
+{
+	Float4 ay = f4abs(y), ax = f4abs(x);
+	Float4 hi = f4max(ay, ax);
+	Float4 lo = f4min(ay, ax);
+	// a = lo/hi in [0,1], with 0/0 taken as 0
+	Float4 zero_hi = f4cmple(hi, f4zero());
+	Float4 a = f4div(lo, f4select(zero_hi, f4set1(1.0f), hi));
+
+	// reduce a > tan(pi/8) to (a-1)/(a+1), offset pi/4 (cephes atanf)
+	Float4 big = f4cmpgt(a, f4set1(0.414213562f));
+	Float4 t = f4select(big, f4div(f4sub(a, f4set1(1.0f)), f4add(a, f4set1(1.0f))), a);
+	Float4 offset = f4and(big, f4set1(0.785398163f));
+	Float4 z = f4mul(t, t);
+	Float4 p = f4set1(8.05374449538e-2f);
+	p = f4madd(p, z, f4set1(-1.38776856032e-1f));
+	p = f4madd(p, z, f4set1(1.99777106478e-1f));
+	p = f4madd(p, z, f4set1(-3.33329491539e-1f));
+	Float4 r = f4add(offset, f4madd(f4mul(p, z), t, t));
+
+	// undo the octant folding
+	r = f4select(f4cmpgt(ay, ax), f4sub(f4set1(1.570796327f), r), r);
+	r = f4select(f4cmplt(x, f4zero()), f4sub(f4set1(3.141592654f), r), r);
+	return f4xor(r, f4signbit(y));
+}
+
+#endif
@@ -0,0 +1,140 @@
+//-----------------------------------------------------------------------------
+// Float4.h
+//	 Four-lane float operations for the batch math kernels.
+//   Float4 is an SSE register when SKA_SSE is 1 (see SystemConfiguration.h)
+//   and a plain array of four floats otherwise, so kernels are written once.
+//   Comparisons return lane masks (all bits set or clear) for f4select().
+//   f4load/f4store require 16 byte aligned addresses, the "u" versions do not.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef FLOAT4_DOT_H
+#define FLOAT4_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <cstring>
+using namespace std;
+#if SKA_SSE==1
+#include <xmmintrin.h>
+#endif
+
+#if SKA_SSE==1
+
+typedef __m128 Float4;
+
+inline Float4 f4load(const float* p) { return _mm_load_ps(p); }
+inline Float4 f4loadu(const float* p) { return _mm_loadu_ps(p); }
+inline void f4store(float* p, Float4 a) { _mm_store_ps(p, a); }
+inline void f4storeu(float* p, Float4 a) { _mm_storeu_ps(p, a); }
+inline Float4 f4set1(float a) { return _mm_set1_ps(a); }
+// lanes in memory order: a is lane 0
+inline Float4 f4set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+inline Float4 f4zero() { return _mm_setzero_ps(); }
+
+inline Float4 f4add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 f4sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+inline Float4 f4mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+inline Float4 f4div(Float4 a, Float4 b) { return _mm_div_ps(a, b); }
+inline Float4 f4sqrt(Float4 a) { return _mm_sqrt_ps(a); }
+inline Float4 f4min(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+inline Float4 f4max(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+
+inline Float4 f4and(Float4 a, Float4 b) { return _mm_and_ps(a, b); }
+inline Float4 f4or(Float4 a, Float4 b) { return _mm_or_ps(a, b); }
+inline Float4 f4xor(Float4 a, Float4 b) { return _mm_xor_ps(a, b); }
+// (not a) and b
+inline Float4 f4andnot(Float4 a, Float4 b) { return _mm_andnot_ps(a, b); }
+
+inline Float4 f4cmplt(Float4 a, Float4 b) { return _mm_cmplt_ps(a, b); }
+inline Float4 f4cmple(Float4 a, Float4 b) { return _mm_cmple_ps(a, b); }
+inline Float4 f4cmpgt(Float4 a, Float4 b) { return _mm_cmpgt_ps(a, b); }
+inline Float4 f4cmpge(Float4 a, Float4 b) { return _mm_cmpge_ps(a, b); }
+// bit i is set if lane i of the mask is set
+inline int f4movemask(Float4 mask) { return _mm_movemask_ps(mask); }
+// lanes (1, 0, 3, 2): swaps the parts of two interleaved complex numbers
+inline Float4 f4swappairs(Float4 a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)); }
+
+// round to nearest integer value (as float), |a| < 2^22
+inline Float4 f4round(Float4 a)
+{
+	const Float4 magic = _mm_set1_ps(12582912.0f);	// 1.5 * 2^23
+	return _mm_sub_ps(_mm_add_ps(a, magic), magic);
+}
+
+#else
+
+struct Float4 { float v[4]; };
+
+inline Float4 f4load(const float* p) { Float4 r; memcpy(r.v, p, 4*sizeof(float)); return r; }
+inline Float4 f4loadu(const float* p) { return f4load(p); }
+inline void f4store(float* p, Float4 a) { memcpy(p, a.v, 4*sizeof(float)); }
+inline void f4storeu(float* p, Float4 a) { f4store(p, a); }
+inline Float4 f4set1(float a) { Float4 r; r.v[0] = r.v[1] = r.v[2] = r.v[3] = a; return r; }
+inline Float4 f4set(float a, float b, float c, float d) { Float4 r; r.v[0] = a; r.v[1] = b; r.v[2] = c; r.v[3] = d; return r; }
+inline Float4 f4zero() { return f4set1(0.0f); }
+
+inline Float4 f4add(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] += b.v[i]; return a; }
+inline Float4 f4sub(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] -= b.v[i]; return a; }
+inline Float4 f4mul(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] *= b.v[i]; return a; }
+inline Float4 f4div(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] /= b.v[i]; return a; }
+inline Float4 f4sqrt(Float4 a) { for (int i=0; i<4; i++) a.v[i] = sqrtf(a.v[i]); return a; }
+inline Float4 f4min(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] = (a.v[i] < b.v[i]) ? a.v[i] : b.v[i]; return a; }
+inline Float4 f4max(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] = (a.v[i] > b.v[i]) ? a.v[i] : b.v[i]; return a; }
+
+inline unsigned int f4bits(float a) { unsigned int u; memcpy(&u, &a, 4); return u; }
+inline float f4float(unsigned int u) { float a; memcpy(&a, &u, 4); return a; }
+inline Float4 f4and(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] = f4float(f4bits(a.v[i]) & f4bits(b.v[i])); return a; }
+inline Float4 f4or(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] = f4float(f4bits(a.v[i]) | f4bits(b.v[i])); return a; }
+inline Float4 f4xor(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] = f4float(f4bits(a.v[i]) ^ f4bits(b.v[i])); return a; }
+inline Float4 f4andnot(Float4 a, Float4 b) { for (int i=0; i<4; i++) a.v[i] = f4float(~f4bits(a.v[i]) & f4bits(b.v[i])); return a; }
+
+inline Float4 f4mask(bool a, bool b, bool c, bool d)
+{
+	Float4 r;
+	r.v[0] = f4float(a ? 0xffffffffu : 0u); r.v[1] = f4float(b ? 0xffffffffu : 0u);
+	r.v[2] = f4float(c ? 0xffffffffu : 0u); r.v[3] = f4float(d ? 0xffffffffu : 0u);
+	return r;
+}
+inline Float4 f4cmplt(Float4 a, Float4 b) { return f4mask(a.v[0]<b.v[0], a.v[1]<b.v[1], a.v[2]<b.v[2], a.v[3]<b.v[3]); }
+inline Float4 f4cmple(Float4 a, Float4 b) { return f4mask(a.v[0]<=b.v[0], a.v[1]<=b.v[1], a.v[2]<=b.v[2], a.v[3]<=b.v[3]); }
+inline Float4 f4cmpgt(Float4 a, Float4 b) { return f4cmplt(b, a); }
+inline Float4 f4cmpge(Float4 a, Float4 b) { return f4cmple(b, a); }
+inline int f4movemask(Float4 mask)
+{
+	int bits = 0;
+	for (int i=0; i<4; i++) if (f4bits(mask.v[i]) & 0x80000000u) bits |= (1 << i);
+	return bits;
+}
+
+inline Float4 f4swappairs(Float4 a) { Float4 r; r.v[0] = a.v[1]; r.v[1] = a.v[0]; r.v[2] = a.v[3]; r.v[3] = a.v[2]; return r; }
+
+inline Float4 f4round(Float4 a)
+{
+	const float magic = 12582912.0f;	// 1.5 * 2^23
+	for (int i=0; i<4; i++) { volatile float t = a.v[i] + magic; a.v[i] = t - magic; }
+	return a;
+}
+
+#endif
+
+// operations built from the ones above
+
+// lanes of a where mask is set, lanes of b elsewhere
+inline Float4 f4select(Float4 mask, Float4 a, Float4 b) { return f4or(f4and(mask, a), f4andnot(mask, b)); }
+inline Float4 f4neg(Float4 a) { return f4xor(a, f4set1(-0.0f)); }
+inline Float4 f4abs(Float4 a) { return f4andnot(f4set1(-0.0f), a); }
+// the sign bit of each lane of a
+inline Float4 f4signbit(Float4 a) { return f4and(a, f4set1(-0.0f)); }
+// a*b + c
+inline Float4 f4madd(Float4 a, Float4 b, Float4 c) { return f4add(f4mul(a, b), c); }
+inline float f4lane(Float4 a, int i) { float t[4]; f4storeu(t, a); return t[i]; }
+
+#endif
@@ -33,6 +33,10 @@ const float HALF_PI = PI/2.0f;
 const float TWO_PI = 2.0f*PI;
 const float EPSILON = 1.0e-6f;
 
+// Orders of Euler angle rotations, named like Matrix4x4::rotation???().
+// The first axis named is applied first, so EULER_ZXY is the transform Ry*Rx*Rz.
+enum EULER_ORDER { EULER_XYZ, EULER_XZY, EULER_YXZ, EULER_YZX, EULER_ZXY, EULER_ZYX };
+
 inline float cotangent(float a) { return 1.0f / tan(a); }
 inline float rad2deg(float r) { return r*180.0f/PI; }
 inline float deg2rad(float r) { return r*PI/180.0f; }
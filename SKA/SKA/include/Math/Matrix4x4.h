@@ -1,6 +1,12 @@
 //-----------------------------------------------------------------------------
 // Matrix4x4.h
 //    4x4 float matrix, primarily intended for homogeneous transformations.
+//    Matrix4x4 is trivially copyable, so arrays of matrices can be copied
+//    as raw memory and processed with SSE. It asks for 16 byte alignment,
+//    but heap objects do not always get it (32-bit MSVC), so the SSE code
+//    uses unaligned loads and stores.
+//    Batch methods transform arrays of points or compose arrays of
+//    matrices in one call.
 //-----------------------------------------------------------------------------
 // This software is part of the Skeleton Animation Toolkit (SKA) developed 
 // at the University of the Pacific, under the guidance of Michael Doherty.
@@ -17,9 +23,14 @@
 #include <Core/SystemConfiguration.h>
 #include <cmath>
 #include <fstream>
+#include <cstring>
 using namespace std;
+#if SKA_SSE==1
+#include <xmmintrin.h>
+#endif
 #include <Math/Math.h>
 #include <Math/Vector3D.h>
+#include <Math/BatchTrig.h>
 
 class SKA_LIB_DECLSPEC Quaternion;
 
@@ -34,26 +45,15 @@ public:
 	//  2  6 10 14    [2,0] [2,1] [2,2] [2,3]
 	//  3  7 11 15    [3,0] [3,1] [3,2] [3,3]
 
-	float m[16];
+	alignas(16) float m[16];
 
 	// default constructor - all zeros
+	// Copying and destruction are left to the compiler, which keeps the
+	// class trivially copyable (no vtable, plain 64 byte copies).
 	Matrix4x4() 
 	{ 
-		memset(m, 0, 16*sizeof(float)); 
-	}
-	// copy constructor
-	Matrix4x4(const Matrix4x4& _m) 
-	{ 
-		memcpy(m, _m.m, 16*sizeof(float)); 
-	}
-	// assignment operator
-	Matrix4x4& operator= (const Matrix4x4& _m) 
-	{ 
-		memcpy(m, _m.m, 16*sizeof(float)); 
-		return *this; 
+		for (int i=0; i<16; i++) m[i] = 0.0f;
 	}
-	// destructor - nothing to do
-	virtual ~Matrix4x4() { }
 
 	// access with row, column indexes
 	float& operator()(unsigned int r, unsigned int c)
@@ -91,6 +91,10 @@ public:
 		return M;
 	}
 
+	// Inverse of a rigid transformation (rotation and translation only).
+	// For M = [R|t] this is [R^T|-R^T*t]. No check is made that M is rigid.
+	Matrix4x4 inverseRigid() const;
+
 	// FIXIT - needs a more appropriate name
 	Matrix4x4 cheapInverse(bool check=false)
 	{
@@ -134,7 +138,7 @@ public:
 	static Matrix4x4 rotationXZY(float rx, float ry, float rz);
 	//	rotationYXZ = Rz*Rx*Ry 
 	static Matrix4x4 rotationYXZ(float rx, float ry, float rz);
-	//	rotationYZX = Rz*Ry*Rx 
+	//	rotationYZX = Rx*Rz*Ry 
 	static Matrix4x4 rotationYZX(float rx, float ry, float rz);
 	//	rotationZXY = Ry*Rx*Rz 
 	static Matrix4x4 rotationZXY(float rx, float ry, float rz);
@@ -148,6 +152,14 @@ public:
 	static Matrix4x4 rotationZXY(const Vector3D& v) { return Matrix4x4::rotationZXY(v.x, v.y, v.z); }
 	static Matrix4x4 rotationZYX(const Vector3D& v) { return Matrix4x4::rotationZYX(v.x, v.y, v.z); }
 
+	// rotation???() selected by an EULER_ORDER value
+	static Matrix4x4 rotationEuler(float rx, float ry, float rz, EULER_ORDER order);
+	// Batch version: out[i] = rotationEuler(rx[i], ry[i], rz[i], order).
+	// The angle arrays can be channel columns of a motion sequence.
+	// Sines and cosines are computed four angles at a time (see BatchTrig.h).
+	static void rotationBatch(const float* rx, const float* ry, const float* rz, long n,
+		EULER_ORDER order, Matrix4x4* out, TRIG_PRECISION precision=TRIG_FULL);
+
 	//   1   0   0
 	//   0  cc -sx
 	//   0  sx  cx
@@ -206,6 +218,17 @@ public:
 	bool factorEulerYZX(Vector3D& r) { return factorEulerYZX(r.x, r.y, r.z); }
 	bool factorEulerZXY(Vector3D& r) { return factorEulerZXY(r.x, r.y, r.z); }
 	bool factorEulerZYX(Vector3D& r) { return factorEulerZYX(r.x, r.y, r.z); }
+
+	// Factor in the given order (see rotationEuler()).
+	bool factorEuler(float& rx, float& ry, float& rz, EULER_ORDER order);
+	// Batch version: factors in[0..n-1] into the angle arrays, four matrices
+	// at a time with no branches. Singular (gimbal locked) matrices get the
+	// same treatment as the per-matrix methods: the first applied angle is
+	// zero and the last absorbs the combined rotation.
+	// unique[i] (if not NULL) is false for singular matrices.
+	// Returns the number of singular matrices.
+	static long factorEulerBatch(const Matrix4x4* in, long n, EULER_ORDER order,
+		float* rx, float* ry, float* rz, bool* unique=NULL);
 	
 	static Matrix4x4 rotationFromAxisAngle(Vector3D& axis, float angle)
 	{
@@ -270,31 +293,60 @@ public:
 		return vout; 
 	}
 
-	Matrix4x4 operator*(const Matrix4x4& rhs)
+	// out = a*b. out may be the same matrix as a or b.
+	static void product(const Matrix4x4& a, const Matrix4x4& b, Matrix4x4& out)
+	{
+#if SKA_SSE==1
+		// column j of the product is a's columns weighted by column j of b
+		__m128 a0 = _mm_loadu_ps(a.m);
+		__m128 a1 = _mm_loadu_ps(a.m+4);
+		__m128 a2 = _mm_loadu_ps(a.m+8);
+		__m128 a3 = _mm_loadu_ps(a.m+12);
+		for (int j=0; j<16; j+=4)
+		{
+			__m128 r = _mm_mul_ps(a0, _mm_set1_ps(b.m[j]));
+			r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b.m[j+1])));
+			r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b.m[j+2])));
+			r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b.m[j+3])));
+			_mm_storeu_ps(out.m+j, r);
+		}
+#else
+		float M[16];
+		for (int j=0; j<16; j+=4)
+		{
+			for (int i=0; i<4; i++)
+				M[i+j] = a.m[i]*b.m[j] + a.m[i+4]*b.m[j+1] + a.m[i+8]*b.m[j+2] + a.m[i+12]*b.m[j+3];
+		}
+		memcpy(out.m, M, 16*sizeof(float));
+#endif
+	}
+
+	Matrix4x4 operator*(const Matrix4x4& rhs) const
 	{
 		Matrix4x4 M;
-		M.m[0]  = m[0]*rhs.m[0]  + m[4]*rhs.m[1]  + m[8]*rhs.m[2]   + m[12]*rhs.m[3];
-		M.m[1]  = m[1]*rhs.m[0]  + m[5]*rhs.m[1]  + m[9]*rhs.m[2]   + m[13]*rhs.m[3];
-		M.m[2]  = m[2]*rhs.m[0]  + m[6]*rhs.m[1]  + m[10]*rhs.m[2]  + m[14]*rhs.m[3];
-		M.m[3]  = m[3]*rhs.m[0]  + m[7]*rhs.m[1]  + m[11]*rhs.m[2]  + m[15]*rhs.m[3];
-
-		M.m[4]  = m[0]*rhs.m[4]  + m[4]*rhs.m[5]  + m[8]*rhs.m[6]   + m[12]*rhs.m[7];
-		M.m[5]  = m[1]*rhs.m[4]  + m[5]*rhs.m[5]  + m[9]*rhs.m[6]   + m[13]*rhs.m[7];
-		M.m[6]  = m[2]*rhs.m[4]  + m[6]*rhs.m[5]  + m[10]*rhs.m[6]  + m[14]*rhs.m[7];
-		M.m[7]  = m[3]*rhs.m[4]  + m[7]*rhs.m[5]  + m[11]*rhs.m[6]  + m[15]*rhs.m[7];
-		
-		M.m[8]  = m[0]*rhs.m[8]  + m[4]*rhs.m[9]  + m[8]*rhs.m[10]  + m[12]*rhs.m[11];
-		M.m[9]  = m[1]*rhs.m[8]  + m[5]*rhs.m[9]  + m[9]*rhs.m[10]  + m[13]*rhs.m[11];
-		M.m[10] = m[2]*rhs.m[8]  + m[6]*rhs.m[9]  + m[10]*rhs.m[10] + m[14]*rhs.m[11];
-		M.m[11] = m[3]*rhs.m[8]  + m[7]*rhs.m[9]  + m[11]*rhs.m[10] + m[15]*rhs.m[11];
-		
-		M.m[12] = m[0]*rhs.m[12] + m[4]*rhs.m[13] + m[8]*rhs.m[14]  + m[12]*rhs.m[15];
-		M.m[13] = m[1]*rhs.m[12] + m[5]*rhs.m[13] + m[9]*rhs.m[14]  + m[13]*rhs.m[15];
-		M.m[14] = m[2]*rhs.m[12] + m[6]*rhs.m[13] + m[10]*rhs.m[14] + m[14]*rhs.m[15];
-		M.m[15] = m[3]*rhs.m[12] + m[7]*rhs.m[13] + m[11]*rhs.m[14] + m[15]*rhs.m[15];
+		product(*this, rhs, M);
 		return M;
 	}
 
+	// Batch operations. The matrix is assumed to be affine (bottom row 0,0,0,1),
+	// so unlike operator*(Vector3D) no perspective division is done.
+	// out may be the same array as in.
+	static void transformPoints(const Matrix4x4& M, const Vector3D* in, Vector3D* out, long n);
+	static void transformVectors(const Matrix4x4& M, const Vector3D* in, Vector3D* out, long n);
+	// points and vectors packed as x,y,z float triples
+	static void transformPoints(const Matrix4x4& M, const float* in, float* out, long n);
+	static void transformVectors(const Matrix4x4& M, const float* in, float* out, long n);
+
+	// out[i] = A[i]*B[i]
+	static void multiplyArrays(const Matrix4x4* A, const Matrix4x4* B, Matrix4x4* out, long n);
+	// out[i] = A*B[i]
+	static void premultiplyArray(const Matrix4x4& A, const Matrix4x4* B, Matrix4x4* out, long n);
+	// Compose a transform hierarchy: world[i] = world[parent[i]]*local[i].
+	// Parents must come before their children (parent[i] < i).
+	// Roots have parent -1 and get world[i] = base*local[i].
+	static void composeHierarchy(const Matrix4x4& base, const Matrix4x4* local,
+		const short* parent, Matrix4x4* world, long n);
+
 	Matrix4x4 operator+(const Matrix4x4& rhs)
 	{
 		Matrix4x4 M;
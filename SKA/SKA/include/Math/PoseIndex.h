@@ -0,0 +1,110 @@
+//-----------------------------------------------------------------------------
+// PoseIndex.h
+//	 Nearest neighbour index over pose feature vectors (for example the
+//   joint quaternions of every frame in a motion library), so that similar
+//   poses can be found without comparing every frame with every other.
+//   Features are reduced with principal component analysis and the reduced
+//   points are stored in a KD-tree.
+//   The reduction is a projection onto orthonormal axes, so distances in
+//   the reduced space are never larger than the Euclidean distances between
+//   the full features. A radius search therefore returns every item within
+//   the radius (plus some that are farther away, which the caller can
+//   remove by computing exact distances).
+//   Building and batch searches run on several threads. An index can be
+//   saved to and loaded from a binary file.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef POSEINDEX_DOT_H
+#define POSEINDEX_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+class SKA_LIB_DECLSPEC PoseIndex
+{
+public:
+	PoseIndex();
+	virtual ~PoseIndex() { }
+
+	// Index n items whose features are stored row by row (dim floats per
+	// item). Items are numbered 0 to n-1 in that order.
+	// reduced_dim is the number of principal components kept (clamped to
+	// dim). If it is 0, enough components are kept to explain
+	// variance_fraction of the total variance.
+	void build(const float* features, long n, int dim, int reduced_dim=0,
+		float variance_fraction=0.95f, int max_threads=0);
+	void clear();
+
+	long size() const { return num_items; }
+	int dimension() const { return dim; }
+	int reducedDimension() const { return reduced_dim; }
+	// fraction of the feature variance kept by the reduction
+	float explainedVariance() const { return explained_variance; }
+
+	// reduced coordinates of a feature vector (reducedDimension() floats)
+	void project(const float* feature, float* reduced) const;
+
+	// Items within radius of feature in the reduced space, in no
+	// particular order. Appends to result.
+	void radiusSearch(const float* feature, float radius, vector<long>& result) const;
+	// The k items nearest to feature in the reduced space, nearest first.
+	// Items numbered in [exclude_begin,exclude_end) are skipped (for
+	// example the frames of the clip the query comes from).
+	void nearest(const float* feature, int k, vector<long>& result, vector<float>* distances=NULL,
+		long exclude_begin=0, long exclude_end=0) const;
+	// The item nearest to feature in the reduced space if it is closer than
+	// max_distance, otherwise -1. max_distance bounds the search from the
+	// start, so a good guess (such as the distance to a known item) skips
+	// most of the tree. Does not allocate when reducedDimension() <= 64.
+	long nearestWithin(const float* feature, float max_distance, float* distance=NULL) const;
+
+	// radiusSearch() for m queries stored row by row. results[q] holds the
+	// items for query q.
+	void radiusSearchBatch(const float* features, long m, float radius,
+		vector<vector<long> >& results, int max_threads=0) const;
+
+	// Returns false if the file cannot be written, or cannot be read as an
+	// index (in which case the index is unchanged).
+	bool save(const char* filename) const;
+	bool load(const char* filename);
+
+private:
+	int dim;
+	int reduced_dim;
+	long num_items;
+	float explained_variance;
+
+	// PCA: mean feature, and reduced_dim rows of dim floats holding the
+	// principal axes, largest variance first
+	vector<float> mean;
+	vector<float> axes;
+
+	// KD-tree with median splits, stored implicitly: node k has children
+	// 2k+1 and 2k+2 and the nodes at depth tree_depth are leaves. A node
+	// covering points [b,e) splits them at b+(e-b)/2. Points are stored in
+	// tree order, with the item number of each in ids.
+	int tree_depth;
+	vector<int> split_dim;
+	vector<float> split_value;
+	vector<float> points;
+	vector<long> ids;
+
+	// Build the subtree at node, down to depth stop_depth. Nodes reached at
+	// stop_depth that are not leaves are appended to frontier as
+	// (node, begin, end) so they can be built in parallel.
+	void buildNode(long node, int depth, long begin, long end, vector<long>& order,
+		const vector<float>& reduced, int stop_depth, vector<long>* frontier);
+	void searchRadius(const float* q, float radius2, vector<long>& result) const;
+};
+
+#endif
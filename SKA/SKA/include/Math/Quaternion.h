@@ -45,12 +45,7 @@ public:
     explicit Quaternion(const Vector3D& vector);
     explicit Quaternion(const Matrix4x4& rotation);
     
-	// destructor
-	inline ~Quaternion() {}
-
-    // copy operations
-    Quaternion(const Quaternion& other);
-    Quaternion& operator=(const Quaternion& other);
+	// copying and destruction are left to the compiler (trivially copyable)
 
     // text output
     SKA_LIB_DECLSPEC friend ostream& operator<<(ostream& out, const Quaternion& source);
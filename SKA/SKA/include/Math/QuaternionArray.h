@@ -0,0 +1,107 @@
+//-----------------------------------------------------------------------------
+// QuaternionArray.h
+//	 Array of quaternions stored as four separate component arrays
+//   (structure of arrays), so operations run four quaternions at a time
+//   with SSE. Intended for whole joint sets (one pose) or whole clip
+//   columns (one joint over all frames).
+//   Element-wise operations require arrays of the same size and allow the
+//   result to be one of the operands.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef QUATERNIONARRAY_DOT_H
+#define QUATERNIONARRAY_DOT_H
+#include <Core/SystemConfiguration.h>
+using namespace std;
+#include <Math/Math.h>
+#include <Math/Quaternion.h>
+#include <Math/Matrix4x4.h>
+#include <Math/Vector3D.h>
+
+class SKA_LIB_DECLSPEC QuaternionArray
+{
+public:
+	QuaternionArray();
+	// n identity quaternions
+	QuaternionArray(long n);
+	QuaternionArray(const QuaternionArray& other);
+	QuaternionArray& operator=(const QuaternionArray& other);
+	virtual ~QuaternionArray();
+
+	// Existing elements are kept, new elements are identity quaternions.
+	void resize(long n);
+	long size() const { return count; }
+
+	// Component arrays, 16 byte aligned. Padding after the last element
+	// holds identity quaternions.
+	float* w() { return cw; }
+	float* x() { return cx; }
+	float* y() { return cy; }
+	float* z() { return cz; }
+	const float* w() const { return cw; }
+	const float* x() const { return cx; }
+	const float* y() const { return cy; }
+	const float* z() const { return cz; }
+
+	Quaternion get(long i) const { return Quaternion(cw[i], cx[i], cy[i], cz[i]); }
+	void set(long i, const Quaternion& q) { cw[i] = q.w; cx[i] = q.x; cy[i] = q.y; cz[i] = q.z; }
+	void setIdentity();
+	void fromQuaternions(const Quaternion* q, long n);
+	void toQuaternions(Quaternion* q) const;
+
+	// result[i] = a[i]*b[i]
+	static void multiply(const QuaternionArray& a, const QuaternionArray& b, QuaternionArray& result);
+	void conjugate();
+	// Zero length quaternions become zero, as in Quaternion::normalize().
+	void normalize();
+	// Negate elements as needed so that each has a non-negative dot product
+	// with the matching reference element (same rotation, shorter blends).
+	void alignWith(const QuaternionArray& reference);
+
+	// result[i] = dot(a[i], b[i])
+	static void dot(const QuaternionArray& a, const QuaternionArray& b, float* result);
+	// result[i] = (a[i]-b[i]).magnitude()
+	static void differenceMagnitudes(const QuaternionArray& a, const QuaternionArray& b, float* result);
+	// sum of (a[i]-b[i]).magnitude() over all elements
+	static float sumDifferenceMagnitudes(const QuaternionArray& a, const QuaternionArray& b);
+
+	// Interpolation from a (t=0) to b (t=1), taking the shorter path.
+	// nlerp normalizes a linear blend, slerp follows the great arc.
+	static void nlerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& result);
+	static void slerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& result);
+
+	// out[i] = element i applied to in[i]. Elements must be unit quaternions.
+	// out may be the same array as in.
+	void rotate(const Vector3D* in, Vector3D* out) const;
+	// vectors packed as x,y,z float triples
+	void rotate(const float* in, float* out) const;
+
+	// conversions - matrix arrays hold size() matrices
+	void toMatrices(Matrix4x4* out) const;
+	void fromMatrices(const Matrix4x4* in, long n);
+	// Euler angle arrays (radians) hold one angle per element, for example
+	// three channel columns of a motion sequence.
+	void fromEuler(const float* rx, const float* ry, const float* rz, long n, EULER_ORDER order);
+	void toEuler(float* rx, float* ry, float* rz, EULER_ORDER order) const;
+
+private:
+	long count;
+	long capacity;		// multiple of 4
+	float* buffer;		// allocation holding the four aligned component arrays
+	float* cw;
+	float* cx;
+	float* cy;
+	float* cz;
+	void allocate(long n);
+	void checkSize(const QuaternionArray& other, const char* function) const;
+};
+
+#endif
@@ -2,6 +2,7 @@
 // RandomGenerator.h
 //   The RandomGenerator class encapsulates a seed and 
 //   a variety of functions for generating random numbers.
+//   The RandomStream class is a counter-based generator for parallel use.
 //-----------------------------------------------------------------------------
 // This software is part of the Skeleton Animation Toolkit (SKA) developed 
 // at the University of the Pacific, under the guidance of Michael Doherty.
@@ -34,6 +35,10 @@
 // simpack distribution, retrieved on 02/06/05 from
 // http://www.cise.ufl.edu/~fishwick/simpack/howtoget.html
 //-----------------------------------------------------------------------------
+// RandomStream uses the Philox4x32-10 generator from J. Salmon, M. Moraes,
+// R. Dror and D. Shaw, "Parallel Random Numbers: As Easy as 1, 2, 3",
+// Proceedings of SC11, 2011.
+//-----------------------------------------------------------------------------
 
 #include <cstdlib>
 #include <cmath>
@@ -41,6 +46,63 @@
 using namespace std;
 #include <Math/Math.h>
 
+//-----------------------------------------------------------------------------
+// RandomStream
+//   Value number p of a stream is a hash of (seed, stream id, p), so any
+//   value can be computed directly, without the ones before it.
+//   - Different stream ids give independent sequences. Give each thread,
+//     character or motion-graph walk its own stream.
+//   - seek() and skip() jump to any position at no cost.
+//   - The fill methods compute their values on several threads, and the
+//     result is the same for any number of threads.
+//   - Uniform and normal values share the position counter, one position
+//     per value. fillUniform(out, n) gives the same values as n calls to
+//     uniform(), and likewise for fillNormal() and normal().
+//   Generation is const apart from the position, so streams can be copied
+//   freely and different streams never share state.
+//-----------------------------------------------------------------------------
+class SKA_LIB_DECLSPEC RandomStream
+{
+public:
+	RandomStream(unsigned long long _seed=0, unsigned long long _stream_id=0)
+		: seed(_seed), stream_id(_stream_id), position(0) { }
+
+	unsigned long long getSeed() const { return seed; }
+	unsigned long long getStreamId() const { return stream_id; }
+	unsigned long long getPosition() const { return position; }
+	void seek(unsigned long long _position) { position = _position; }
+	void skip(unsigned long long count) { position += count; }
+	// a different stream with the same seed, at position 0
+	RandomStream stream(unsigned long long _stream_id) const { return RandomStream(seed, _stream_id); }
+
+	// 32 random bits
+	unsigned int next();
+	// uniform in [0.0, 1.0), 24 random bits
+	float uniform();
+	// uniform in [a, b)
+	float uniform(float a, float b);
+	// integer equiprobably selected from i, i+1, ..., n
+	int random(int i, int n);
+	// normal distribution with mean x and standard deviation s
+	float normal(float x=0.0f, float s=1.0f);
+
+	// bulk versions, each advances the position by n
+	void fillBits(unsigned int* out, long n);
+	void fillUniform(float* out, long n, float a=0.0f, float b=1.0f);
+	void fillNormal(float* out, long n, float x=0.0f, float s=1.0f);
+
+	// Values at any position, without changing the stream.
+	// These are safe to call from several threads at once.
+	void bitsAt(unsigned long long start, unsigned int* out, long n) const;
+	void uniformAt(unsigned long long start, float* out, long n, float a=0.0f, float b=1.0f) const;
+	void normalAt(unsigned long long start, float* out, long n, float x=0.0f, float s=1.0f) const;
+
+private:
+	unsigned long long seed;
+	unsigned long long stream_id;
+	unsigned long long position;
+};
+
 class SKA_LIB_DECLSPEC RandomGenerator
 {
 public:
@@ -49,6 +111,14 @@ public:
 	{
 		if (_seed == 0) seed = (long)time(0);
 		else seed = _seed;
+		initial_seed = seed;
+	}
+
+	// Counter-based stream keyed by this generator's seed.
+	// Independent of randf() and the other sequential functions.
+	RandomStream stream(unsigned long long stream_id) const
+	{
+		return RandomStream((unsigned long long)initial_seed, stream_id);
 	}
 
 	// UNIFORM (0.0, 1.0) RANDOM REAL NUMBER GENERATOR
@@ -178,6 +248,7 @@ public:
 
 private:
 	long seed;
+	long initial_seed;
 };
 
 SKA_LIB_DECLSPEC extern RandomGenerator random_generator;
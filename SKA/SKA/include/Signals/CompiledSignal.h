@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// CompiledSignal.h
+//	 A sum of sinusoids evaluated as one kernel. compileSignalGenerator()
+//   flattens a tree of SignalAdder, SineGenerator, CosineGenerator and
+//   ConstantGenerator objects into a CompiledSignal, merging terms that
+//   share a frequency and folding all constants into one.
+//   signalBlock() advances each sinusoid by rotating its phasor, four
+//   samples per step, and recomputes the phasors exactly every
+//   1024 samples so rounding errors do not build up.
+//   bakeSignalGenerators() fills whole MotionSequence channels from
+//   generators, compiling them first when possible.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef COMPILEDSIGNAL_DOT_H
+#define COMPILEDSIGNAL_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+#include <Signals/Signals.h>
+#include <Animation/MotionSequence.h>
+
+class SKA_LIB_DECLSPEC CompiledSignal : public SignalGenerator
+{
+public:
+	CompiledSignal(const vector<SignalSpec>& specs);
+	virtual ~CompiledSignal() { }
+
+	virtual float signal(float time);
+	virtual void signalBlock(float t0, float dt, long n, float* out);
+	virtual bool appendSpecs(vector<SignalSpec>& specs) const;
+
+	// number of sinusoids after merging, not counting the constant
+	int numTerms() const { return int(amplitudes.size()); }
+	float constantTerm() const { return float(constant); }
+
+private:
+	double constant;
+	// term k is amplitudes[k]*sin(omegas[k]*t + phases[k]), omegas[k] > 0
+	vector<double> amplitudes;
+	vector<double> omegas;
+	vector<double> phases;
+};
+
+// Returns a new CompiledSignal equivalent to g, or NULL if g is not a sum
+// of sinusoids. g is not modified and still belongs to the caller.
+SKA_LIB_DECLSPEC CompiledSignal* compileSignalGenerator(SignalGenerator* g);
+
+// Fill channels[i] of motion with generators[i] sampled at the motion's
+// frame rate: frame f gets the value at time t0 + f/frame_rate.
+// Channels missing from motion are skipped, as are NULL generators.
+// Channels are filled in parallel, so generators that cannot be compiled
+// must be safe to call from several threads.
+SKA_LIB_DECLSPEC void bakeSignalGenerators(MotionSequence* motion, 
+	const vector<CHANNEL_ID>& channels, const vector<SignalGenerator*>& generators, 
+	float t0=0.0f, int max_threads=0);
+
+// Create a new MotionSequence with the given channels and fill it as above.
+SKA_LIB_DECLSPEC MotionSequence* bakeSignalGenerators(const vector<CHANNEL_ID>& channels, 
+	const vector<SignalGenerator*>& generators, long num_frames, float frame_rate, 
+	float t0=0.0f, int max_threads=0);
+
+#endif
@@ -1,8 +1,8 @@
 //-----------------------------------------------------------------------------
 // FFT.h
 //   Interface to Fast Fourier Transform processing.
-//   This code is non-functional if not linked to FFTW library,
-//   available from www.fftw.org.
+//   Uses the FFTW library (www.fftw.org) if enabled, otherwise the
+//   built-in transforms in Signals/FFTPlan.h.
 //   See ENABLE_FFTW flag in Core/SystemConfiguration.h.
 //-----------------------------------------------------------------------------
 // This software is part of the Skeleton Animation Toolkit (SKA) developed 
@@ -35,34 +35,62 @@ bool computeFFT(complex<float>* signal, complex<float>* spectrum, int n);
 bool computeInverseFFT(complex<float>* spectrum, float* signal, int n);
 bool computeInverseFFT(complex<float>* spectrum, complex<float>* signal, int n);
 
+// Real signals: the spectrum holds only the n/2+1 non-negative frequency
+// bins. computeInverseRealFFT is normalized, like computeInverseFFT.
+// Plans and working memory are cached, so repeated sizes are cheap and
+// these can run on several threads at once.
+bool computeRealFFT(const float* signal, complex<float>* spectrum, int n);
+bool computeInverseRealFFT(const complex<float>* spectrum, float* signal, int n);
+
+// Low-pass filter of column-major data, in place. Column c holds num_frames
+// values starting at data + c*num_frames, and keeps its frequency bins
+// 0 to cutoffs[c]-1 (and their negative frequency mirrors). Columns with
+// cutoffs[c] <= 0 are not changed. Runs of filtered columns are
+// transformed in batches, spread over up to max_threads threads
+// (0 = all available).
+void lowPassChannels(float* data, int num_frames, int num_columns, const int* cutoffs, int max_threads=0);
+
 // FFT directly integrated with a MotionSequence
+// Filtering starts from a copy of the data taken by initialize(), so it can
+// be repeated with other cutoffs. A cutoff is the number of frequency bins
+// kept (see lowPassChannels()). Cutoffs <= 0 restore the original data.
 class FFTfilter
 {
 public:
 	FFTfilter()
 	{
 		num_frames = 0;
+		num_channels = 0;
 		motion = NULL;
 	}
 	~FFTfilter()
 	{
 	}
 	void initialize(MotionSequence* _motion);
+	// Channels filtered by runFilters(int). By default all channels except
+	// the first six (root position and orientation).
+	void setFilterChannel(int channel, bool filter);
 	void runFilter(int channel, int cutoff);
 	bool runFilter(CHANNEL_ID& channel, int cutoff);
 	void runFilters(int cutoff);
+	// one cutoff per channel, all channels filtered in one batched pass;
+	// channels past the end of cutoffs are restored but not filtered
+	void runFilters(const vector<int>& cutoffs);
 	int computeFFT(CHANNEL_ID& channel, float result[], int len);
 	int computeFFT(int channel, float result[], int len);
 	int computeFFT(CHANNEL_ID& channel, complex<float> result[], int len);
 	int computeFFT(int channel, complex<float> result[], int len);
+
+	// Filters a motion in place, with no copy of the original data.
+	// cutoffs[c] applies to channel c, missing entries are not filtered.
+	static void lowPass(MotionSequence* motion, const vector<int>& cutoffs, int max_threads=0);
 private:
 	Array2D<float> original;
-	Array2D<float> filtered;
 	int num_frames;
 	int num_channels;
 	MotionSequence* motion;
 
-	bool filter_channels[500];
+	vector<bool> filter_channels;
 	void setFilterChannels();
 };
 
@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------
+// FFTPlan.h
+//	 Built-in Fast Fourier Transform, used by the functions in FFT.h when
+//   the FFTW library is not enabled (see ENABLE_FFTW flag in
+//   Core/SystemConfiguration.h). It can also be used directly.
+//   Sizes with prime factors up to 31 use a mixed radix Stockham FFT with
+//   four-lane butterflies. Other sizes use Bluestein's algorithm, so every
+//   length runs in O(n log n).
+//   Scaling follows FFTW: neither direction is normalized, so a forward
+//   transform followed by a backward transform multiplies by n.
+//   Forward transforms use exp(-2*pi*i*j*k/n), backward use exp(+...).
+//   Plans are read-only once built, so one plan can run on many threads.
+//   Working memory comes from per-thread buffers that are reused between
+//   calls.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef FFTPLAN_DOT_H
+#define FFTPLAN_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <complex>
+#include <vector>
+using namespace std;
+
+enum FFT_DIRECTION { FFT_FORWARD, FFT_BACKWARD };
+
+// FFT_COMPLEX: n complex values to n complex values.
+// FFT_REAL: forward plans take n real values to the n/2+1 non-negative
+//   frequency bins (the rest follow from conj(X[n-k]) = X[k]), backward
+//   plans take those n/2+1 bins back to n real values.
+enum FFT_TYPE { FFT_COMPLEX, FFT_REAL };
+
+class SKA_LIB_DECLSPEC FFTPlan
+{
+public:
+	FFTPlan(int _n, FFT_DIRECTION _direction, FFT_TYPE _type=FFT_COMPLEX);
+	virtual ~FFTPlan();
+
+	int size() const { return n; }
+	FFT_DIRECTION getDirection() const { return direction; }
+	FFT_TYPE getType() const { return type; }
+
+	// Shared plan for (n, direction, type), built on first use.
+	// Safe to call from several threads. The plan stays valid until
+	// clearCache() is called, which must not overlap any use of the plans.
+	static const FFTPlan& cached(int n, FFT_DIRECTION direction, FFT_TYPE type=FFT_COMPLEX);
+	static void clearCache();
+
+	// FFT_COMPLEX plans. out may be the same array as in.
+	void execute(const complex<float>* in, complex<float>* out) const;
+	// FFT_REAL forward plans: out holds n/2+1 values.
+	void executeReal(const float* in, complex<float>* out) const;
+	// FFT_REAL backward plans: in holds n/2+1 values. The imaginary parts
+	//   of in[0] (and of in[n/2] for even n) are ignored.
+	void executeReal(const complex<float>* in, float* out) const;
+	// Many transforms at once: transform t reads in + t*in_distance and
+	//   writes out + t*out_distance.
+	void executeReal(const float* in, long in_distance, complex<float>* out, long out_distance, int howmany) const;
+	void executeReal(const complex<float>* in, long in_distance, float* out, long out_distance, int howmany) const;
+
+private:
+	int n;
+	FFT_DIRECTION direction;
+	FFT_TYPE type;
+
+	// mixed radix stages: radix, and offset of the stage twiddle factors
+	vector<int> radices;
+	vector<long> twiddle_offsets;
+	vector<complex<float> > twiddles;
+
+	// Bluestein: chirp[k] = exp(+-i*pi*k^2/n), and the transform of the
+	//   convolution kernel (scaled by 1/m), with power of two size m
+	bool bluestein;
+	long m;
+	vector<complex<float> > chirp;
+	vector<complex<float> > kernel_spectrum;
+	FFTPlan* forward_m;
+	FFTPlan* backward_m;
+
+	// FFT_REAL: complex plan of n/2 values (even n) or n values (odd n),
+	//   and exp(-+2*pi*i*k/n) for k < n/2
+	FFTPlan* complex_plan;
+	vector<complex<float> > real_twiddles;
+
+	void executeStages(const complex<float>* in, complex<float>* out, complex<float>* work) const;
+	void runStage(int stage, long len, const float* x, float* y) const;
+	void executeBluestein(const complex<float>* in, complex<float>* out) const;
+
+	// plans hold sub-plans, so they are not copied
+	FFTPlan(const FFTPlan&);
+	FFTPlan& operator=(const FFTPlan&);
+};
+
+#endif
@@ -1,6 +1,11 @@
 //-----------------------------------------------------------------------------
 // Signals.h
 //   Signal generation classes.
+//   signal() gives one sample. signalBlock() fills n samples at times
+//   t0, t0+dt, ... in one call, which avoids a virtual call per sample.
+//   appendSpecs() describes generators that are sums of sinusoids as
+//   SignalSpecs, so that CompiledSignal (Signals/CompiledSignal.h) can
+//   flatten a tree of them into one kernel.
 //-----------------------------------------------------------------------------
 // This software is part of the Skeleton Animation Toolkit (SKA) developed 
 // at the University of the Pacific, under the guidance of Michael Doherty.
@@ -20,8 +25,12 @@
 #include <iostream>
 using namespace std;
 #include <Math/Math.h>
+#include <Math/BatchTrig.h>
 #include <Signals/SignalSpec.h>
 
+// samples per batch in the signalBlock() implementations
+static const long SIGNAL_BLOCK = 256;
+
 class SignalGenerator
 {
 public:
@@ -34,6 +43,20 @@ public:
 	{
 		return 0.0f;
 	}
+
+	// out[i] = signal(t0 + i*dt) for 0 <= i < n
+	virtual void signalBlock(float t0, float dt, long n, float* out)
+	{
+		for (long i=0; i<n; i++) out[i] = signal(t0 + i*dt);
+	}
+
+	// Append the sinusoids whose sum is this signal (frequency 0 means a
+	// constant equal to the amplitude, as in buildSignalGenerator).
+	// Returns false if the signal is not a sum of sinusoids.
+	virtual bool appendSpecs(vector<SignalSpec>& specs) const
+	{
+		return false;
+	}
 };
 
 class ConstantGenerator : public SignalGenerator
@@ -61,6 +84,18 @@ public:
 	{
 		return value;
 	}
+
+	virtual void signalBlock(float t0, float dt, long n, float* out)
+	{
+		for (long i=0; i<n; i++) out[i] = value;
+	}
+
+	virtual bool appendSpecs(vector<SignalSpec>& specs) const
+	{
+		SignalSpec spec = { value, 0.0f, 0.0f };
+		specs.push_back(spec);
+		return true;
+	}
 };
 
 class SineGenerator : public SignalGenerator
@@ -96,6 +131,25 @@ public:
 	{
 		return amplitude*sin(phase+TWO_PI*time*frequency);
 	}
+
+	virtual void signalBlock(float t0, float dt, long n, float* out)
+	{
+		float angles[SIGNAL_BLOCK];
+		for (long i=0; i<n; i+=SIGNAL_BLOCK)
+		{
+			long m = (n-i < SIGNAL_BLOCK) ? n-i : SIGNAL_BLOCK;
+			for (long k=0; k<m; k++) angles[k] = phase + TWO_PI*(t0 + (i+k)*dt)*frequency;
+			batchSinCos(angles, out+i, NULL, m);
+			for (long k=0; k<m; k++) out[i+k] *= amplitude;
+		}
+	}
+
+	virtual bool appendSpecs(vector<SignalSpec>& specs) const
+	{
+		SignalSpec spec = { amplitude, frequency, phase };
+		specs.push_back(spec);
+		return true;
+	}
 };
 
 class CosineGenerator : public SignalGenerator
@@ -131,6 +185,25 @@ public:
 	{
 		return amplitude*cos(phase + TWO_PI*time*frequency);
 	}
+
+	virtual void signalBlock(float t0, float dt, long n, float* out)
+	{
+		float angles[SIGNAL_BLOCK];
+		for (long i=0; i<n; i+=SIGNAL_BLOCK)
+		{
+			long m = (n-i < SIGNAL_BLOCK) ? n-i : SIGNAL_BLOCK;
+			for (long k=0; k<m; k++) angles[k] = phase + TWO_PI*(t0 + (i+k)*dt)*frequency;
+			batchSinCos(angles, NULL, out+i, m);
+			for (long k=0; k<m; k++) out[i+k] *= amplitude;
+		}
+	}
+
+	virtual bool appendSpecs(vector<SignalSpec>& specs) const
+	{
+		SignalSpec spec = { amplitude, frequency, phase + HALF_PI };
+		specs.push_back(spec);
+		return true;
+	}
 };
 
 class SignalAdder : public SignalGenerator
@@ -177,6 +250,28 @@ public:
 			s += inputs[i]->signal(time);
 		return s;
 	}
+
+	virtual void signalBlock(float t0, float dt, long n, float* out)
+	{
+		for (long i=0; i<n; i++) out[i] = 0.0f;
+		float partial[SIGNAL_BLOCK];
+		for (long i=0; i<n; i+=SIGNAL_BLOCK)
+		{
+			long m = (n-i < SIGNAL_BLOCK) ? n-i : SIGNAL_BLOCK;
+			for (unsigned short j=0; j<inputs.size(); j++)
+			{
+				inputs[j]->signalBlock(t0 + i*dt, dt, m, partial);
+				for (long k=0; k<m; k++) out[i+k] += partial[k];
+			}
+		}
+	}
+
+	virtual bool appendSpecs(vector<SignalSpec>& specs) const
+	{
+		for (unsigned short i=0; i<inputs.size(); i++)
+			if (!inputs[i]->appendSpecs(specs)) return false;
+		return true;
+	}
 };
 
 void testSignalGenerator();
@@ -0,0 +1,95 @@
+//-----------------------------------------------------------------------------
+// StreamFilters.h
+//	 Causal filters for smoothing channels one frame at a time, for live
+//   data where the whole clip is not available (FFT.h needs the whole clip).
+//   A StreamFilterBank runs the same filter on many channels, four
+//   channels at a time. Cost per frame does not depend on stream length.
+//   Filters:
+//     Butterworth low-pass, as a cascade of biquads (order 2, 4, 6 or 8)
+//     Savitzky-Golay, fitting a polynomial to the last few frames and
+//       taking its value at the newest frame
+//     One-Euro (Casiez, Roussel and Vogel, CHI 2012), a low-pass whose
+//       cutoff rises with speed: smooth when still, little lag when moving
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#ifndef STREAMFILTERS_DOT_H
+#define STREAMFILTERS_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+
+enum STREAM_FILTER_TYPE { SF_NONE, SF_BUTTERWORTH, SF_SAVITZKY_GOLAY, SF_ONE_EURO };
+
+class SKA_LIB_DECLSPEC StreamFilterBank
+{
+public:
+	StreamFilterBank(int _num_channels=0);
+	virtual ~StreamFilterBank() { }
+
+	// Changing the channel count or the filter restarts the filter.
+	void setNumChannels(int _num_channels);
+	int numChannels() const { return num_channels; }
+	STREAM_FILTER_TYPE getType() const { return type; }
+
+	// cutoff and sample rate in Hz
+	void setButterworth(float cutoff, float sample_rate, int order=2);
+	// window in frames (> degree), polynomial degree 0 to 4
+	void setSavitzkyGolay(int window, int degree);
+	// min_cutoff and derivative_cutoff in Hz, beta in 1/(channel units)
+	void setOneEuro(float min_cutoff, float beta, float derivative_cutoff=1.0f);
+	// pass values through unchanged
+	void setNone();
+
+	// Filter one frame: in and out hold one value per channel and may be
+	// the same array. dt is the time since the previous frame in seconds
+	// (used by One-Euro, the others assume a fixed rate).
+	// The first frame after a reset passes through and fills the history.
+	void process(const float* in, float* out, float dt);
+	void reset() { primed = false; }
+
+	// Delay of slow changes through the filter, in frames (group delay at
+	// zero frequency, and at rest for One-Euro).
+	float latencyFrames() const;
+
+private:
+	STREAM_FILTER_TYPE type;
+	int num_channels;
+	int padded;			// num_channels rounded up to a multiple of 4
+	bool primed;
+
+	// Butterworth: five coefficients (b0 b1 b2 a1 a2) and two state values
+	// per channel for each section
+	int num_sections;
+	vector<float> coefficients;
+	vector<float> state;
+
+	// Savitzky-Golay: weights[i] applies to the frame i frames old, history
+	// is a ring of window frames
+	int window;
+	int newest;
+	vector<float> weights;
+	vector<float> history;
+
+	// One-Euro
+	float min_cutoff, beta, derivative_cutoff;
+	vector<float> previous;		// filtered value
+	vector<float> derivative;	// filtered derivative
+	float last_dt;				// most recent time step, for latencyFrames
+
+	// channels in, padded with zeros
+	vector<float> input;
+
+	void allocate();
+	void prime(const float* in);
+};
+
+#endif
@@ -73,7 +73,7 @@ void Bone::update()
 		end_position.x = W.m[12];
 		end_position.y = W.m[13];
 		end_position.z = W.m[14];
-		bone_object->setEndpoints(position, end_position);
+		if (bone_object != NULL) bone_object->setEndpoints(position, end_position);
 	}
 	if (base_box != NULL) base_box->moveTo(position);
 	if (tip_box != NULL) tip_box->moveTo(end_position);
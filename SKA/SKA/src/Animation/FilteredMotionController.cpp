@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+// FilteredMotionController.cpp
+//	 Controller that smooths the output of another controller.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <chrono>
+#include <cmath>
+using namespace std;
+#include <Animation/FilteredMotionController.h>
+#include <Animation/AnimationException.h>
+#include <Math/Math.h>
+
+FilteredMotionController::FilteredMotionController(MotionController* _upstream, 
+	const vector<CHANNEL_ID>& _channels, bool _owns_upstream)
+	: MotionController(), upstream(_upstream), owns_upstream(_owns_upstream),
+	channels(_channels), bank(int(_channels.size())),
+	have_frame(false), last_time(0.0f), last_dt(0.0f),
+	frames_processed(0), total_seconds(0.0)
+{
+	if (upstream == NULL) throw AnimationException("FilteredMotionController: NULL upstream controller");
+	int n = int(channels.size());
+	is_rotation.resize(n);
+	for (int i=0; i<n; i++)
+	{
+		channel_index[channels[i]] = i;
+		CHANNEL_TYPE ct = channels[i].channel_type;
+		is_rotation[i] = (ct == CT_RX) || (ct == CT_RY) || (ct == CT_RZ);
+	}
+	raw.assign(n, 0.0f);
+	unwrapped.assign(n, 0.0f);
+	filtered.assign(n, 0.0f);
+}
+
+FilteredMotionController::~FilteredMotionController()
+{
+	if (owns_upstream) delete upstream;
+}
+
+void FilteredMotionController::reset()
+{
+	have_frame = false;
+	bank.reset();
+}
+
+float FilteredMotionController::getValue(CHANNEL_ID _channel, float _time)
+{
+	map<CHANNEL_ID, int>::iterator it = channel_index.find(_channel);
+	if (it == channel_index.end()) return upstream->getValue(_channel, _time);
+	if (!have_frame || (_time != last_time)) update(_time);
+	return filtered[it->second];
+}
+
+void FilteredMotionController::update(float _time)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// going back in time restarts the filter
+	if (have_frame && (_time < last_time)) bank.reset();
+	float dt = have_frame ? _time - last_time : 0.0f;
+	if (dt > 0.0f) last_dt = dt;
+	bool first = !have_frame || (dt < 0.0f);
+
+	int n = int(channels.size());
+	for (int i=0; i<n; i++)
+	{
+		// channels that are not currently controlled keep their last value
+		float value = raw[i];
+		if (upstream->isValidChannel(channels[i], _time)) 
+			value = upstream->getValue(channels[i], _time);
+		if (is_rotation[i] && !first)
+		{
+			float delta = value - raw[i];
+			delta -= float(TWO_PI)*floor(delta/float(TWO_PI) + 0.5f);
+			unwrapped[i] += delta;
+		}
+		else unwrapped[i] = value;
+		raw[i] = value;
+	}
+
+	if (first) bank.reset();
+	bank.process(&unwrapped[0], &filtered[0], dt);
+
+	for (int i=0; i<n; i++)
+	{
+		if (!is_rotation[i]) continue;
+		float offset = filtered[i] - raw[i];
+		filtered[i] -= float(TWO_PI)*floor(offset/float(TWO_PI) + 0.5f);
+	}
+
+	have_frame = true;
+	last_time = _time;
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	total_seconds += elapsed.count();
+	frames_processed++;
+}
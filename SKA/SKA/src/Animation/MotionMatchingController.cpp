@@ -0,0 +1,333 @@
+//-----------------------------------------------------------------------------
+// MotionMatchingController.cpp
+//	 Motion controller that plays clips from a MotionMatchingDatabase,
+//   jumping to the best matching frame at regular intervals.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+using namespace std;
+#include <Animation/MotionMatchingController.h>
+#include <Animation/AnimationException.h>
+#include <Math/Matrix4x4.h>
+
+// jumps to the same clip closer than this (seconds) are not worth taking
+static const float SAME_CLIP_WINDOW = 0.2f;
+
+static const int SAMPLES = MotionMatchingDatabase::TRAJECTORY_SAMPLES;
+
+// rotation as a scaled angle axis vector (angle times unit axis), taking
+// the shorter way round
+static Vector3D rotationVector(const Quaternion& q)
+{
+	float sign = (q.w < 0.0f) ? -1.0f : 1.0f;
+	float s = sqrt(q.x*q.x + q.y*q.y + q.z*q.z);
+	if (s < 1e-8f) return Vector3D(2.0f*sign*q.x, 2.0f*sign*q.y, 2.0f*sign*q.z);
+	float angle = 2.0f*atan2(s, sign*q.w);
+	float k = sign*angle/s;
+	return Vector3D(k*q.x, k*q.y, k*q.z);
+}
+
+static Quaternion rotationFromVector(const Vector3D& v)
+{
+	float angle = v.magnitude();
+	if (angle < 1e-8f)
+	{
+		Quaternion q(1.0f, 0.5f*v.x, 0.5f*v.y, 0.5f*v.z);
+		q.normalize();
+		return q;
+	}
+	float k = sin(0.5f*angle)/angle;
+	return Quaternion(cos(0.5f*angle), k*v.x, k*v.y, k*v.z);
+}
+
+static Quaternion yawRotation(float angle)
+{
+	return Quaternion(cos(0.5f*angle), 0.0f, sin(0.5f*angle), 0.0f);
+}
+
+// Critically damped spring towards zero (x is the offset, v its velocity)
+// after dt seconds, for a spring whose offset halves in halflife seconds
+// when at rest.
+static void decaySpring(float& x, float& v, float halflife, float dt)
+{
+	float y = 0.5f*(4.0f*0.69314718f)/(halflife + 1e-5f);
+	float j = v + x*y;
+	float e = exp(-y*dt);
+	x = e*(x + j*dt);
+	v = e*(v - j*y*dt);
+}
+
+MotionMatchingController::MotionMatchingController(const MotionMatchingDatabase* _database,
+	float _search_interval, float _blend_halflife)
+	: database(_database), search_interval(_search_interval), blend_halflife(_blend_halflife),
+	  frame_fraction(0.0f), alignment(0.0f), world_x(0.0f), world_z(0.0f), has_trajectory(false),
+	  offset_height(0.0f), offset_height_velocity(0.0f), values_valid(false)
+{
+	if ((database == NULL) || (database->numEntries() == 0))
+		throw AnimationException("MotionMatchingController: empty motion matching database");
+	same_clip_window = long(SAME_CLIP_WINDOW*database->getFrameRate());
+
+	// start at the first frame that can be matched
+	status.clip = database->entryClip(0);
+	status.frame = 0;
+	status.current_time = -1.0f;
+	status.next_search_time = 0.0f;
+	status.last_cost = 0.0f;
+	status.searches = 0;
+	status.jumps = 0;
+	setRootPlacement(Vector3D(0.0f, 0.0f, 0.0f), 0.0f);
+
+	const PoseFeatures& poses = database->clipPoses(status.clip);
+	int num_joints = poses.numJoints();
+	offset_rotation.assign(num_joints, Vector3D(0.0f, 0.0f, 0.0f));
+	offset_velocity.assign(num_joints, Vector3D(0.0f, 0.0f, 0.0f));
+	joint_angles.assign(3*num_joints, 0.0f);
+	for (int j=0; j<num_joints; j++)
+	{
+		short bone = poses.jointBone(j);
+		if (bone >= short(bone_joint.size())) bone_joint.resize(bone+1, -1);
+		bone_joint[bone] = j;
+	}
+	for (int a=0; a<3; a++) root_translation[a] = 0.0f;
+}
+
+//---------- Runtime Access Methods ---------------
+
+bool MotionMatchingController::isValidChannel(CHANNEL_ID _channel, float _time)
+{
+	if (!database->isValidChannel(_channel)) return false;
+	if (_channel.channel_type <= CT_TZ) return _channel.bone_id == 0;
+	if (_channel.channel_type <= CT_RZ)
+		return (_channel.bone_id < bone_joint.size()) && (bone_joint[_channel.bone_id] >= 0);
+	return false;
+}
+
+float MotionMatchingController::getValue(CHANNEL_ID _channel, float _time)
+{
+	update(_time);
+	if (!values_valid) computeChannelValues();
+	if (isValidChannel(_channel, _time))
+	{
+		if (_channel.channel_type <= CT_TZ)
+			return root_translation[_channel.channel_type - CT_TX];
+		return joint_angles[3*bone_joint[_channel.bone_id] + _channel.channel_type - CT_RX];
+	}
+	char s[200];
+	sprintf(s, "MotionMatchingController received request for invalid channel bone: %d dof: %d",
+		int(_channel.bone_id), int(_channel.channel_type));
+	throw AnimationException(s);
+}
+
+void MotionMatchingController::setDesiredTrajectory(const Vector3D positions[MotionMatchingDatabase::TRAJECTORY_SAMPLES],
+	const Vector3D directions[MotionMatchingDatabase::TRAJECTORY_SAMPLES])
+{
+	for (int k=0; k<SAMPLES; k++)
+	{
+		desired_positions[k] = positions[k];
+		desired_directions[k] = directions[k];
+	}
+	has_trajectory = true;
+}
+
+void MotionMatchingController::setRootPlacement(const Vector3D& position, float heading)
+{
+	world_x = position.x;
+	world_z = position.z;
+	alignment = heading - database->clipHeading(status.clip, status.frame);
+	values_valid = false;
+}
+
+float MotionMatchingController::getRootHeading() const
+{
+	return database->clipHeading(status.clip, status.frame) + alignment;
+}
+
+//---------- Internal Control Logic Methods ---------------
+
+void MotionMatchingController::update(float _time)
+{
+	if (status.current_time < 0.0f)
+	{
+		status.current_time = _time;
+		status.next_search_time = _time;
+	}
+	// if time has not advanced, there's nothing to do
+	float dt = max(0.0f, _time - status.current_time);
+	if ((dt < 0.0001f) && (_time < status.next_search_time)) return;
+	status.current_time = _time;
+	values_valid = false;
+
+	frame_fraction += dt*database->getFrameRate();
+	long frames = long(frame_fraction);
+	frame_fraction -= frames;
+	advance(frames);
+	decayOffsets(dt);
+
+	if (_time >= status.next_search_time)
+	{
+		search();
+		status.next_search_time = _time + search_interval;
+	}
+}
+
+void MotionMatchingController::advance(long frames)
+{
+	for (; frames > 0; frames--)
+	{
+		// at the end of a clip the best match anywhere has to be taken
+		if (status.frame + 1 >= database->clipPoses(status.clip).numFrames())
+		{
+			search();
+			if (status.frame + 1 >= database->clipPoses(status.clip).numFrames())
+				jump(database->entryClip(0), database->entryFrame(0));
+		}
+		const PoseFeatures& poses = database->clipPoses(status.clip);
+		const float* p0 = poses.rootPosition(status.frame);
+		const float* p1 = poses.rootPosition(status.frame + 1);
+		float dx = p1[0] - p0[0], dz = p1[2] - p0[2];
+		float c = cos(alignment), s = sin(alignment);
+		world_x += c*dx + s*dz;
+		world_z += -s*dx + c*dz;
+		status.frame++;
+	}
+}
+
+void MotionMatchingController::search()
+{
+	// The query is the current pose with the desired trajectory. Past the
+	// last entry of a clip (the end of the clip, where the trajectory is
+	// not known) the last entry stands in for the pose, and any match is
+	// better than staying.
+	long clip_entries = database->clipEntries(status.clip);
+	bool can_stay = status.frame < clip_entries;
+	long current = database->clipFirstEntry(status.clip) + (can_stay ? status.frame : clip_entries - 1);
+	float query[MotionMatchingDatabase::FEATURE_SIZE];
+	const float* feature = database->entryFeature(current);
+	for (int d=0; d<MotionMatchingDatabase::FEATURE_SIZE; d++) query[d] = feature[d];
+	if (has_trajectory)
+	{
+		// desired trajectory relative to the character
+		float heading = getRootHeading();
+		float c = cos(heading), s = sin(heading);
+		float positions[2*SAMPLES], directions[2*SAMPLES];
+		for (int k=0; k<SAMPLES; k++)
+		{
+			float dx = desired_positions[k].x - world_x, dz = desired_positions[k].z - world_z;
+			positions[2*k] = c*dx - s*dz;
+			positions[2*k+1] = s*dx + c*dz;
+			directions[2*k] = c*desired_directions[k].x - s*desired_directions[k].z;
+			directions[2*k+1] = s*desired_directions[k].x + c*desired_directions[k].z;
+		}
+		database->setQueryTrajectory(query, positions, directions);
+	}
+
+	float stay_cost = can_stay ? database->cost(query, current) : FLT_MAX;
+	float cost = stay_cost;
+	long best = database->search(query, stay_cost, &cost);
+	status.searches++;
+	status.last_cost = cost;
+	if (best < 0) return;
+	int clip = database->entryClip(best);
+	long frame = database->entryFrame(best);
+	if (can_stay && (clip == status.clip) && (labs(frame - status.frame) < same_clip_window)) return;
+	jump(clip, frame);
+}
+
+void MotionMatchingController::jump(int clip, long frame)
+{
+	const PoseFeatures& from = database->clipPoses(status.clip);
+	const PoseFeatures& to = database->clipPoses(clip);
+	float frame_rate = database->getFrameRate();
+	int num_joints = int(offset_rotation.size());
+	long from_next = (status.frame + 1 < from.numFrames()) ? status.frame + 1 : status.frame;
+
+	// pose and velocities being shown
+	vector<Quaternion> src, src_next, dst, dst_next;
+	clipRotations(status.clip, status.frame, src);
+	clipRotations(status.clip, from_next, src_next);
+	float src_height = from.rootPosition(status.frame)[1];
+	float src_height_velocity = (from.rootPosition(from_next)[1] - src_height)*frame_rate;
+
+	// continue from the character's floor position and facing
+	alignment = getRootHeading() - database->clipHeading(clip, frame);
+	status.clip = clip;
+	status.frame = frame;
+	status.jumps++;
+	clipRotations(clip, frame, dst);
+	clipRotations(clip, frame + 1, dst_next);
+	float dst_height = to.rootPosition(frame)[1];
+	float dst_height_velocity = (to.rootPosition(frame + 1)[1] - dst_height)*frame_rate;
+
+	// offsets that take the new pose to the one being shown
+	for (int j=0; j<num_joints; j++)
+	{
+		Quaternion shown = rotationFromVector(offset_rotation[j])*src[j];
+		offset_rotation[j] = rotationVector(shown*conjugate(dst[j]));
+		Vector3D src_velocity = rotationVector(src_next[j]*conjugate(src[j]))*frame_rate;
+		Vector3D dst_velocity = rotationVector(dst_next[j]*conjugate(dst[j]))*frame_rate;
+		offset_velocity[j] += src_velocity - dst_velocity;
+	}
+	offset_height += src_height - dst_height;
+	offset_height_velocity += src_height_velocity - dst_height_velocity;
+	values_valid = false;
+}
+
+void MotionMatchingController::decayOffsets(float dt)
+{
+	for (unsigned int j=0; j<offset_rotation.size(); j++)
+	{
+		Vector3D& x = offset_rotation[j];
+		Vector3D& v = offset_velocity[j];
+		decaySpring(x.x, v.x, blend_halflife, dt);
+		decaySpring(x.y, v.y, blend_halflife, dt);
+		decaySpring(x.z, v.z, blend_halflife, dt);
+	}
+	decaySpring(offset_height, offset_height_velocity, blend_halflife, dt);
+}
+
+void MotionMatchingController::clipRotations(int clip, long frame, vector<Quaternion>& rotations) const
+{
+	const PoseFeatures& poses = database->clipPoses(clip);
+	rotations.resize(poses.numJoints());
+	for (int j=0; j<poses.numJoints(); j++)
+	{
+		const float* q = poses.jointRotation(frame, j);
+		rotations[j] = Quaternion(q[0], q[1], q[2], q[3]);
+	}
+	if ((poses.numJoints() > 0) && (poses.jointBone(0) == 0))
+		rotations[0] = yawRotation(alignment)*rotations[0];
+}
+
+void MotionMatchingController::computeChannelValues()
+{
+	const PoseFeatures& poses = database->clipPoses(status.clip);
+	vector<Quaternion> rotations;
+	clipRotations(status.clip, status.frame, rotations);
+	for (int j=0; j<poses.numJoints(); j++)
+	{
+		Quaternion q = rotationFromVector(offset_rotation[j])*rotations[j];
+		q.normalize();
+		Matrix4x4 m;
+		q.toRotationMatrix(m);
+		float* angles = &joint_angles[3*j];
+		m.factorEuler(angles[0], angles[1], angles[2], poses.jointOrder(j));
+	}
+	root_translation[0] = world_x;
+	root_translation[1] = poses.rootPosition(status.frame)[1] + offset_height;
+	root_translation[2] = world_z;
+	values_valid = true;
+}
@@ -0,0 +1,270 @@
+//-----------------------------------------------------------------------------
+// MotionMatchingDatabase.cpp
+//	 Searchable feature database over a set of motion clips.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+#include <Animation/MotionMatchingDatabase.h>
+#include <Animation/AnimationException.h>
+#include <Animation/RawMotionController.h>
+#include <Core/Array2D.h>
+#include <Core/Parallel.h>
+
+// feature layout: offsets of the groups within a feature vector
+static const int TRAJECTORY_POSITION = 0;
+static const int TRAJECTORY_DIRECTION = 2*MotionMatchingDatabase::TRAJECTORY_SAMPLES;
+static const int FOOT_POSITION = 4*MotionMatchingDatabase::TRAJECTORY_SAMPLES;
+static const int FOOT_VELOCITY = FOOT_POSITION + 6;
+static const int ROOT_VELOCITY = FOOT_VELOCITY + 6;
+
+// entries per parallel work item when computing features
+static const long PARALLEL_MIN_BLOCK = 64;
+
+// facing angle of a root rotation: its local z axis projected on the floor
+static float heading(const float* q)
+{
+	float w = q[0], x = q[1], y = q[2], z = q[3];
+	float fx = 2.0f*(x*z + w*y);
+	float fz = 1.0f - 2.0f*(x*x + y*y);
+	return atan2(fx, fz);
+}
+
+MotionMatchingDatabase::MotionMatchingDatabase()
+	: frame_rate(0.0f)
+{
+	for (int k=0; k<TRAJECTORY_SAMPLES; k++) sample_offsets[k] = 1;
+	for (int d=0; d<FEATURE_SIZE; d++) { offset[d] = 0.0f; scale[d] = 1.0f; }
+}
+
+void MotionMatchingDatabase::clear()
+{
+	clips.clear();
+	channels.clear();
+	frame_rate = 0.0f;
+	entry_clip.clear();
+	entry_frame.clear();
+	features.clear();
+	index.clear();
+}
+
+void MotionMatchingDatabase::build(Skeleton* skeleton, const vector<MotionSequence*>& _clips,
+	const char* left_foot, const char* right_foot,
+	const float sample_times[TRAJECTORY_SAMPLES], const Weights& weights, int max_threads)
+{
+	if ((skeleton == NULL) || _clips.empty())
+		throw AnimationException("MotionMatchingDatabase::build: missing skeleton or clips");
+	short feet[2] = { skeleton->boneIdFromName(left_foot), skeleton->boneIdFromName(right_foot) };
+	if ((feet[0] < 0) || (feet[1] < 0))
+		throw AnimationException("MotionMatchingDatabase::build: foot bone not found in skeleton");
+	clear();
+
+	MotionSequence* first = _clips[0];
+	frame_rate = first->getFrameRate();
+	for (short i=0; i<first->numChannels(); i++) channels.push_back(first->getChannelID(i));
+	sort(channels.begin(), channels.end());
+	for (unsigned int c=1; c<_clips.size(); c++)
+	{
+		MotionSequence* clip = _clips[c];
+		if (fabs(clip->getFrameRate() - frame_rate) > 0.001f*frame_rate)
+			throw AnimationException("MotionMatchingDatabase::build: clips have different frame rates");
+		if (clip->numChannels() != first->numChannels())
+			throw AnimationException("MotionMatchingDatabase::build: clips have different channels");
+		for (unsigned int i=0; i<channels.size(); i++)
+			if (!clip->isValidChannel(channels[i]))
+				throw AnimationException("MotionMatchingDatabase::build: clips have different channels");
+	}
+	int max_offset = 1;
+	for (int k=0; k<TRAJECTORY_SAMPLES; k++)
+	{
+		sample_offsets[k] = max(1, int(sample_times[k]*frame_rate + 0.5f));
+		max_offset = max(max_offset, sample_offsets[k]);
+	}
+
+	// poses, headings and foot positions of every clip
+	MotionController* previous_controller = skeleton->getMotionController();
+	clips.resize(_clips.size());
+	vector<vector<float> > foot_positions(_clips.size());
+	long num_entries = 0;
+	for (unsigned int c=0; c<_clips.size(); c++)
+	{
+		Clip& clip = clips[c];
+		clip.poses.extract(skeleton, _clips[c], max_threads);
+		long n = clip.poses.numFrames();
+		bool root_rotates = (clip.poses.numJoints() > 0) && (clip.poses.jointBone(0) == 0);
+		clip.headings.resize(n);
+		for (long f=0; f<n; f++)
+			clip.headings[f] = root_rotates ? heading(clip.poses.jointRotation(f, 0)) : 0.0f;
+
+		RawMotionController controller(_clips[c]);
+		skeleton->attachMotionController(&controller);
+		Array2D<float> positions;
+		skeleton->buildPositionMatrix(positions);
+		skeleton->attachMotionController(previous_controller);
+		vector<float>& feet_c = foot_positions[c];
+		feet_c.resize(6*n);
+		for (long f=0; f<n; f++)
+			for (int s=0; s<2; s++)
+				for (int a=0; a<3; a++)
+					feet_c[6*f + 3*s + a] = positions.get(f, 3*feet[s] + a);
+
+		clip.first_entry = num_entries;
+		clip.num_entries = max(0L, n - max_offset);
+		num_entries += clip.num_entries;
+	}
+	if (num_entries == 0)
+		throw AnimationException("MotionMatchingDatabase::build: clips are shorter than the trajectory");
+
+	// raw features, in the frame of the character at each entry
+	entry_clip.resize(num_entries);
+	entry_frame.resize(num_entries);
+	for (unsigned int c=0; c<clips.size(); c++)
+		for (long f=0; f<clips[c].num_entries; f++)
+		{
+			entry_clip[clips[c].first_entry + f] = c;
+			entry_frame[clips[c].first_entry + f] = f;
+		}
+	features.resize(num_entries*FEATURE_SIZE);
+	parallelForBlocks(0, num_entries, [&](long begin, long end)
+	{
+		for (long e=begin; e<end; e++)
+		{
+			const Clip& clip = clips[entry_clip[e]];
+			const vector<float>& feet_c = foot_positions[entry_clip[e]];
+			long f = entry_frame[e];
+			long n = clip.poses.numFrames();
+			long prev = max(0L, f-1), next = min(n-1, f+1);
+			float rate = (next > prev) ? frame_rate/float(next - prev) : 0.0f;
+			float h = clip.headings[f];
+			float ch = cos(h), sh = sin(h);
+			const float* root = clip.poses.rootPosition(f);
+			float* out = &features[e*FEATURE_SIZE];
+			for (int k=0; k<TRAJECTORY_SAMPLES; k++)
+			{
+				const float* p = clip.poses.rootPosition(f + sample_offsets[k]);
+				float dx = p[0] - root[0], dz = p[2] - root[2];
+				out[TRAJECTORY_POSITION + 2*k] = ch*dx - sh*dz;
+				out[TRAJECTORY_POSITION + 2*k + 1] = sh*dx + ch*dz;
+				float dh = clip.headings[f + sample_offsets[k]] - h;
+				out[TRAJECTORY_DIRECTION + 2*k] = sin(dh);
+				out[TRAJECTORY_DIRECTION + 2*k + 1] = cos(dh);
+			}
+			for (int s=0; s<2; s++)
+			{
+				const float* p = &feet_c[6*f + 3*s];
+				float dx = p[0] - root[0], dz = p[2] - root[2];
+				out[FOOT_POSITION + 3*s] = ch*dx - sh*dz;
+				out[FOOT_POSITION + 3*s + 1] = p[1];
+				out[FOOT_POSITION + 3*s + 2] = sh*dx + ch*dz;
+				const float* p0 = &feet_c[6*prev + 3*s];
+				const float* p1 = &feet_c[6*next + 3*s];
+				float vx = (p1[0] - p0[0])*rate, vz = (p1[2] - p0[2])*rate;
+				out[FOOT_VELOCITY + 3*s] = ch*vx - sh*vz;
+				out[FOOT_VELOCITY + 3*s + 1] = (p1[1] - p0[1])*rate;
+				out[FOOT_VELOCITY + 3*s + 2] = sh*vx + ch*vz;
+			}
+			const float* r0 = clip.poses.rootPosition(prev);
+			const float* r1 = clip.poses.rootPosition(next);
+			float vx = (r1[0] - r0[0])*rate, vz = (r1[2] - r0[2])*rate;
+			out[ROOT_VELOCITY] = ch*vx - sh*vz;
+			out[ROOT_VELOCITY + 1] = (r1[1] - r0[1])*rate;
+			out[ROOT_VELOCITY + 2] = sh*vx + ch*vz;
+		}
+	}, PARALLEL_MIN_BLOCK, max_threads);
+
+	// Each dimension is centred on its mean; each group is divided by its
+	// average standard deviation, so that groups with large values (such
+	// as positions in cm) do not outweigh the others.
+	struct Group { int begin, end; float weight; };
+	Group groups[5] = {
+		{ TRAJECTORY_POSITION, TRAJECTORY_DIRECTION, weights.trajectory_position },
+		{ TRAJECTORY_DIRECTION, FOOT_POSITION, weights.trajectory_direction },
+		{ FOOT_POSITION, FOOT_VELOCITY, weights.foot_position },
+		{ FOOT_VELOCITY, ROOT_VELOCITY, weights.foot_velocity },
+		{ ROOT_VELOCITY, FEATURE_SIZE, weights.root_velocity } };
+	double mean[FEATURE_SIZE], variance[FEATURE_SIZE];
+	for (int d=0; d<FEATURE_SIZE; d++)
+	{
+		double sum = 0.0, sum2 = 0.0;
+		for (long e=0; e<num_entries; e++)
+		{
+			double v = features[e*FEATURE_SIZE + d];
+			sum += v;
+			sum2 += v*v;
+		}
+		mean[d] = sum/num_entries;
+		variance[d] = max(0.0, sum2/num_entries - mean[d]*mean[d]);
+	}
+	for (int g=0; g<5; g++)
+	{
+		double v = 0.0;
+		for (int d=groups[g].begin; d<groups[g].end; d++) v += variance[d];
+		double deviation = sqrt(v/(groups[g].end - groups[g].begin));
+		for (int d=groups[g].begin; d<groups[g].end; d++)
+		{
+			offset[d] = float(mean[d]);
+			scale[d] = (deviation > 0.0) ? float(groups[g].weight/deviation) : groups[g].weight;
+		}
+	}
+	for (long e=0; e<num_entries; e++)
+		for (int d=0; d<FEATURE_SIZE; d++)
+		{
+			float& v = features[e*FEATURE_SIZE + d];
+			v = (v - offset[d])*scale[d];
+		}
+
+	// keeping every dimension makes the index exact
+	index.build(&features[0], num_entries, FEATURE_SIZE, FEATURE_SIZE, 1.0f, max_threads);
+}
+
+bool MotionMatchingDatabase::isValidChannel(CHANNEL_ID channel) const
+{
+	return binary_search(channels.begin(), channels.end(), channel);
+}
+
+void MotionMatchingDatabase::setQueryTrajectory(float* query, const float* positions, const float* directions) const
+{
+	for (int k=0; k<TRAJECTORY_SAMPLES; k++)
+	{
+		for (int a=0; a<2; a++)
+		{
+			int d = TRAJECTORY_POSITION + 2*k + a;
+			query[d] = (positions[2*k + a] - offset[d])*scale[d];
+		}
+		float length = sqrt(directions[2*k]*directions[2*k] + directions[2*k+1]*directions[2*k+1]);
+		float inverse = (length > 0.0f) ? 1.0f/length : 0.0f;
+		for (int a=0; a<2; a++)
+		{
+			int d = TRAJECTORY_DIRECTION + 2*k + a;
+			query[d] = (directions[2*k + a]*inverse - offset[d])*scale[d];
+		}
+	}
+}
+
+long MotionMatchingDatabase::search(const float* query, float max_cost, float* cost) const
+{
+	return index.nearestWithin(query, max_cost, cost);
+}
+
+float MotionMatchingDatabase::cost(const float* query, long e) const
+{
+	const float* x = entryFeature(e);
+	float sum = 0.0f;
+	for (int d=0; d<FEATURE_SIZE; d++)
+	{
+		float t = x[d] - query[d];
+		sum += t*t;
+	}
+	return sqrt(sum);
+}
@@ -0,0 +1,198 @@
+//-----------------------------------------------------------------------------
+// PoseFeatures.cpp
+//	 Packed per-frame pose features of a motion sequence.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cstdio>
+#include <cstring>
+using namespace std;
+#include <Animation/PoseFeatures.h>
+#include <Animation/AnimationException.h>
+#include <Core/Parallel.h>
+#include <DataManagement/BinaryStream.h>
+#include <Math/Matrix4x4.h>
+#include <Math/Quaternion.h>
+
+static const char POSE_FEATURES_MAGIC[8] = { 'S','K','A','P','F','T','R','\0' };
+static const unsigned int POSE_FEATURES_VERSION = 2;
+
+// frames converted together by one thread
+static const long FRAME_BLOCK = 256;
+
+// EULER_ORDER for axes applied first, second and third (0=x, 1=y, 2=z)
+static EULER_ORDER eulerOrder(const int axes[3])
+{
+	static const EULER_ORDER orders[3][3] = {
+		{ EULER_XYZ, EULER_XYZ, EULER_XZY },
+		{ EULER_YXZ, EULER_YXZ, EULER_YZX },
+		{ EULER_ZXY, EULER_ZYX, EULER_ZYX } };
+	// the second axis picks between the two orders starting with the first
+	return orders[axes[0]][axes[1]];
+}
+
+PoseFeatures::PoseFeatures()
+	: num_frames(0), frame_size(3), frame_rate(0.0f)
+{
+}
+
+void PoseFeatures::clear()
+{
+	num_frames = 0;
+	frame_size = 3;
+	frame_rate = 0.0f;
+	joint_bones.clear();
+	joint_orders.clear();
+	data.clear();
+}
+
+void PoseFeatures::extract(Skeleton* skeleton, MotionSequence* motion, int max_threads)
+{
+	if ((skeleton == NULL) || (motion == NULL))
+		throw AnimationException("PoseFeatures::extract: missing skeleton or motion");
+	clear();
+	num_frames = motion->numFrames();
+	frame_rate = motion->getFrameRate();
+
+	// channel columns of each joint (NULL for missing channels) and the
+	// order its rotations are applied in
+	struct Joint
+	{
+		const float* angles[3];
+		EULER_ORDER order;
+	};
+	vector<Joint> joints;
+	for (short id=0; id<skeleton->numBones(); id++)
+	{
+		Bone* bone = skeleton->getBone(id);
+		if (bone == NULL) continue;
+		int axes[3];
+		int num_axes = 0;
+		bool used[3] = { false, false, false };
+		for (int d=0; d<NUMBER_OF_CHANNEL_TYPES; d++)
+		{
+			CHANNEL_TYPE ct = bone->getChannelOrder(d);
+			if ((ct < CT_RX) || (ct > CT_RZ) || !bone->isValidChannel(ct)) continue;
+			int a = ct - CT_RX;
+			if (used[a]) continue;
+			used[a] = true;
+			axes[num_axes++] = a;
+		}
+		if (num_axes == 0) continue;
+		// axes without a channel have zero angle, so their place is arbitrary
+		for (int a=0; a<3; a++) if (!used[a]) axes[num_axes++] = a;
+
+		Joint joint;
+		joint.order = eulerOrder(axes);
+		for (int a=0; a<3; a++)
+		{
+			CHANNEL_ID c(BONE_ID(id), CHANNEL_TYPE(CT_RX + a));
+			joint.angles[a] = motion->isValidChannel(c) ? motion->getChannelPtr(c) : NULL;
+		}
+		joints.push_back(joint);
+		joint_bones.push_back(id);
+		joint_orders.push_back(joint.order);
+	}
+	const float* root[3];
+	for (int a=0; a<3; a++)
+	{
+		CHANNEL_ID c(BONE_ID(0), CHANNEL_TYPE(CT_TX + a));
+		root[a] = motion->isValidChannel(c) ? motion->getChannelPtr(c) : NULL;
+	}
+
+	frame_size = 3 + 4*int(joints.size());
+	data.assign(num_frames*frame_size, 0.0f);
+	parallelForBlocks(0, num_frames, [&](long begin, long end)
+	{
+		long n = end - begin;
+		vector<float> zeros(n, 0.0f);
+		vector<Matrix4x4> rotations(n);
+		for (long f=begin; f<end; f++)
+			for (int a=0; a<3; a++)
+				data[f*frame_size + a] = (root[a] != NULL) ? root[a][f] : 0.0f;
+		for (unsigned int j=0; j<joints.size(); j++)
+		{
+			const float* angles[3];
+			for (int a=0; a<3; a++)
+				angles[a] = (joints[j].angles[a] != NULL) ? joints[j].angles[a] + begin : &zeros[0];
+			Matrix4x4::rotationBatch(angles[0], angles[1], angles[2], n, joints[j].order, &rotations[0]);
+			for (long k=0; k<n; k++)
+			{
+				Quaternion q;
+				q.fromRotationMatrix(rotations[k]);
+				float sign = (q.w < 0.0f) ? -1.0f : 1.0f;
+				float* out = &data[(begin+k)*frame_size + 3 + 4*j];
+				out[0] = sign*q.w;
+				out[1] = sign*q.x;
+				out[2] = sign*q.y;
+				out[3] = sign*q.z;
+			}
+		}
+	}, FRAME_BLOCK, max_threads);
+}
+
+bool PoseFeatures::save(const char* filename) const
+{
+	ByteWriter w;
+	w.putBytes(POSE_FEATURES_MAGIC, 8);
+	w.putU32(POSE_FEATURES_VERSION);
+	w.putU64((unsigned long long)num_frames);
+	w.putF32(frame_rate);
+	w.putU32((unsigned int)joint_bones.size());
+	for (unsigned int j=0; j<joint_bones.size(); j++) w.putI16(joint_bones[j]);
+	for (unsigned int j=0; j<joint_orders.size(); j++) w.putU8((unsigned char)joint_orders[j]);
+	for (unsigned long i=0; i<data.size(); i++) w.putF32(data[i]);
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL) return false;
+	bool ok = (fwrite(&w.bytes[0], 1, w.bytes.size(), fp) == w.bytes.size());
+	if (fclose(fp) != 0) ok = false;
+	return ok;
+}
+
+bool PoseFeatures::load(const char* filename)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) return false;
+	vector<unsigned char> bytes;
+	unsigned char buffer[1<<16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer+n);
+	fclose(fp);
+	if (bytes.size() < 28) return false;
+
+	ByteReader r(&bytes[0], long(bytes.size()));
+	if ((memcmp(r.getBytes(8), POSE_FEATURES_MAGIC, 8) != 0) || (r.getU32() != POSE_FEATURES_VERSION)) return false;
+	PoseFeatures features;
+	features.num_frames = long(r.getU64());
+	features.frame_rate = r.getF32();
+	unsigned int num_joints = r.getU32();
+	features.frame_size = 3 + 4*int(num_joints);
+	// check the size before allocating anything
+	if ((features.num_frames < 0) || (num_joints > 65535) ||
+		(r.remaining() != 3L*num_joints + 4L*features.num_frames*features.frame_size))
+		return false;
+	features.joint_bones.resize(num_joints);
+	for (unsigned int j=0; j<num_joints; j++) features.joint_bones[j] = r.getI16();
+	features.joint_orders.resize(num_joints);
+	for (unsigned int j=0; j<num_joints; j++)
+	{
+		unsigned char order = r.getU8();
+		if (order > EULER_ZYX) return false;
+		features.joint_orders[j] = EULER_ORDER(order);
+	}
+	features.data.resize(features.num_frames*features.frame_size);
+	for (unsigned long i=0; i<features.data.size(); i++) features.data[i] = r.getF32();
+	if (!r.good()) return false;
+	*this = features;
+	return true;
+}
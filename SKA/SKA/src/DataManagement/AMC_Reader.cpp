@@ -16,11 +16,12 @@
 #include <cstdlib>
 #include <DataManagement/AMC_Reader.h>
 #include <DataManagement/ParsingUtilities.h>
+#include <DataManagement/ChannelSelection.h>
 #include <Core/Array2D.h>
 #include <Animation/Skeleton.h>
 #include <Animation/MotionSequence.h>
 	
-MotionSequence* AMC_Reader::readAMC(const char* motionFilename, Skeleton* skeleton)
+MotionSequence* AMC_Reader::readAMC(const char* motionFilename, Skeleton* skeleton, ChannelSelection* selection)
 {
 	string line;
 
@@ -38,10 +39,29 @@ MotionSequence* AMC_Reader::readAMC(const char* motionFilename, Skeleton* skelet
 	}
 	line_scanner1.close();
 
+	// Decide which channels are stored before parsing, 
+	// so unused bones can be skipped and no space is allocated for them.
+	// column[bone*6+channel_type] is the storage column, or -1.
+	vector<CHANNEL_ID> channel_ids;
+	vector<int> column(6*skeleton->numBones(), -1);
+	vector<bool> bone_needed(skeleton->numBones(), false);
+	for (short b=0; b<skeleton->numBones(); b++)
+	{
+		for (short channel_type=0; channel_type<6; channel_type++)
+		{
+			CHANNEL_ID c(b, CHANNEL_TYPE(channel_type));
+			if (!skeleton->isActiveChannel(b,channel_type)) continue; //|| (force_angle_channels_active && (channel_type>=4)))
+			if ((selection != NULL) && !selection->selectsChannel(skeleton, c)) continue;
+			column[b*6+channel_type] = int(channel_ids.size());
+			channel_ids.push_back(c);
+			bone_needed[b] = true;
+		}
+	}
+
 	Array2D<float> data;
 	motion = new MotionSequence;
 
-	data.resize(frame_count, 6*skeleton->numBones());
+	data.resize(frame_count, int(channel_ids.size()));
 
 	// now read for storage
 	AMC_angles_are_degrees = false;
@@ -84,16 +104,18 @@ MotionSequence* AMC_Reader::readAMC(const char* motionFilename, Skeleton* skelet
 		{
 			string name, rest;
 			ParsingUtilities::splitLine(line, name, rest);
+			short bone_id = skeleton->boneIdFromName(name.c_str());
+			if ((bone_id < 0) || !bone_needed[bone_id]) continue;
+			if ((frame < 1) || (frame > frame_count)) continue;
 			list<float> values;
 			ParsingUtilities::parseFloats(rest, values);
 
 			Vector3D p;
 			Vector3D a;
-			short bone_id = skeleton->boneIdFromName(name.c_str());
 			float linedata[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
 			list<float>::iterator iter = values.begin();
 			int i=0;
-			while (iter != values.end())
+			while ((iter != values.end()) && (i < 6))
 			{
 				linedata[i] = (*iter); i++; iter++;
 			}
@@ -107,46 +129,28 @@ MotionSequence* AMC_Reader::readAMC(const char* motionFilename, Skeleton* skelet
 				a.roll = deg2rad(a.roll);
 			}
 
-			data.element(frame-1, bone_id*6)   = p.x;
-			data.element(frame-1, bone_id*6+1) = p.y;
-			data.element(frame-1, bone_id*6+2) = p.z;
-			data.element(frame-1, bone_id*6+3) = a.pitch;
-			data.element(frame-1, bone_id*6+4) = a.yaw;
-			data.element(frame-1, bone_id*6+5) = a.roll;
+			float values6[6] = { p.x, p.y, p.z, a.pitch, a.yaw, a.roll };
+			for (short channel_type=0; channel_type<6; channel_type++)
+			{
+				int col = column[bone_id*6+channel_type];
+				if (col >= 0) data.element(frame-1, col) = values6[channel_type];
+			}
 		}
 	}
 	line_scanner2.close();
 	
 	// parsing is done
 	// Convert the data into a MotionSequence
-
-	vector<CHANNEL_ID> channel_ids;
-	for (short b=0; b<skeleton->numBones(); b++)
-	{
-		for (short channel_type=0; channel_type<6; channel_type++)
-		{
-			CHANNEL_ID c(b, CHANNEL_TYPE(channel_type));
-			if (skeleton->isActiveChannel(b,channel_type)) //|| (force_angle_channels_active && (channel_type>=4)))
-				channel_ids.push_back(c);
-		}
-	}
 	
 	int frames = data.getRows();
 	motion->setNumFrames(frames);
 	motion->setFrameRate(120);
 
 	int chans = channel_ids.size();
-	Array2D<float> data2; // data with "false" channels removed.
-	data2.resize(frames, chans);
-
-	CHANNEL_ID* cid = new CHANNEL_ID[chans];
-	for (unsigned short c=0; c<chans; c++)	
-	{
-		cid[c] = channel_ids[c];
-		memcpy(data2.getColumnPtr(c), data.getColumnPtr(cid[c].bone_id*6+cid[c].channel_type), frames*sizeof(float));
-	}
-	motion->bulkBuild(cid, chans, data2);
-	delete cid;
+	CHANNEL_ID* cid = new CHANNEL_ID[chans > 0 ? chans : 1];
+	for (unsigned short c=0; c<chans; c++) cid[c] = channel_ids[c];
+	motion->bulkBuild(cid, chans, data);
+	delete [] cid;
 
 	return motion;
 }
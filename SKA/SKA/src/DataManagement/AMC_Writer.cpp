@@ -14,15 +14,24 @@
 
 #include <Core/SystemConfiguration.h>
 #include <DataManagement/AMC_Writer.h>
+#include <DataManagement/BufferedWriter.h>
 #include <DataManagement/FileSystem.h>
 #include <Animation/Skeleton.h>
 #include <Animation/MotionSequence.h>
 #include <Core/Array2D.h>
 #include <Core/Utilities.h>
 #include <Math/Math.h>
-#include <fstream>
+#include <vector>
 using namespace std;
 
+// per-bone output layout, resolved once before frames are written
+struct AMC_BoneLine
+{
+	string name;
+	vector<float*> columns;		// motion data column for each channel (NULL if missing)
+	vector<bool> is_angle;
+};
+
 bool AMC_Writer::writeAMC(const char* outputFilename, 
 		Skeleton* skeleton, 
 		MotionSequence* motion,
@@ -31,47 +40,55 @@ bool AMC_Writer::writeAMC(const char* outputFilename,
 	if (!overwrite && FileSystem::fileExists(outputFilename))
 		return false;
 
-	ofstream ofs(outputFilename);
-	if (!ofs) return false;
+	BufferedWriter out;
+	if (!out.open(outputFilename)) return false;
 
 	// comments
-	//ofs << "# ASF:" << skeleton->getId() << " AMC:" << motion->getId() << endl;
-	//ofs << "# Documentation: " << motion->getDocumentation() << endl;
-	//ofs << "# Source: " << motion->getSource() << endl;
-	//ofs << "# Framerate: " << motion->getFrameRate() << endl;
+	//out << "# ASF:" << skeleton->getId() << " AMC:" << motion->getId() << '\n';
 
 	// standard qualifiers
-	ofs << ":FULLY-SPECIFIED" << endl;
-	ofs << ":DEGREES" << endl;
+	out << ":FULLY-SPECIFIED\n";
+	out << ":DEGREES\n";
 
-	for (int frame=0; frame<motion->numFrames(); frame++)
+	vector<AMC_BoneLine> lines;
+	for (int bone_id=0; bone_id<skeleton->numBones(); bone_id++)
 	{
-		// write frame number (start at 1)
-		ofs << frame+1 << endl;
-		for (int bone_id=0; bone_id<skeleton->numBones(); bone_id++)
+		Bone* bone = skeleton->getBone(bone_id);
+		// skip bones with no valid DOF
+		if (bone->getChannelOrder(0) == CT_INVALID) continue;
+		AMC_BoneLine line;
+		line.name = string(skeleton->boneNameFromId(bone_id)) + " ";
+		for (int d=0; d<6; d++)
 		{
-			string bone_name = skeleton->boneNameFromId(bone_id);
-			Bone* bone = skeleton->getBone(bone_id);
-			// skip bones with no valid DOF
-			if (bone->getChannelOrder(0) == CT_INVALID) continue;
-			ofs << bone_name << " ";
-			for (int d=0; d<6; d++)
+			CHANNEL_TYPE dof_id = bone->getChannelOrder(d);
+			if (dof_id != CT_INVALID)
 			{
-				// FIXIT! do not write bones that have 0 DOF
-				CHANNEL_TYPE dof_id = bone->getChannelOrder(d);
-				if (dof_id != CT_INVALID)
-				{
-					CHANNEL_ID channel_id(bone_id, dof_id);
-					float value = motion->getValue(channel_id, frame);
-					if ((dof_id==CT_RX) || (dof_id==CT_RY) || (dof_id==CT_RZ))
-						value = rad2deg(value);
-					ofs << value << " ";
-				}
+				CHANNEL_ID channel_id(bone_id, dof_id);
+				line.columns.push_back(motion->getChannelPtr(channel_id));
+				line.is_angle.push_back((dof_id==CT_RX) || (dof_id==CT_RY) || (dof_id==CT_RZ));
 			}
-			ofs << endl;
 		}
+		lines.push_back(line);
 	}
-	ofs.close();
-	return true;
-}
 
+	// frames are independent, so blocks of frames are formatted in parallel
+	formatInOrder(out, motion->numFrames(), [&lines](BufferedWriter& part, long frame)
+	{
+		// write frame number (start at 1)
+		part.putInt(frame+1).newline();
+		for (unsigned int b=0; b<lines.size(); b++)
+		{
+			part.put(lines[b].name.c_str(), long(lines[b].name.size()));
+			for (unsigned int c=0; c<lines[b].columns.size(); c++)
+			{
+				float value = 0.0f;
+				if (lines[b].columns[c] != NULL) value = lines[b].columns[c][frame];
+				if (lines[b].is_angle[c]) value = rad2deg(value);
+				part.putFloat(value).put(' ');
+			}
+			part.newline();
+		}
+	});
+
+	return out.close();
+}
@@ -14,10 +14,10 @@
 
 #include <Core/SystemConfiguration.h>
 #include <DataManagement/ASF_Writer.h>
+#include <DataManagement/BufferedWriter.h>
 #include <DataManagement/FileSystem.h>
 #include <Animation/Skeleton.h>
 #include <Core/Utilities.h>
-#include <fstream>
 using namespace std;
 
 bool ASF_Writer::writeASF(const char* outputFilename,
@@ -27,143 +27,143 @@ bool ASF_Writer::writeASF(const char* outputFilename,
 	if (!overwrite && FileSystem::fileExists(outputFilename))
 		return false;
 
-	ofstream ofs (outputFilename);
-	if (!ofs) return false;
+	BufferedWriter out;
+	if (!out.open(outputFilename)) return false;
 
 	// comments
-	ofs << "# ASF:" << skeleton->getId() << endl;
-	ofs << "# Documentation: " << skeleton->getDocumentation() << endl;
-	ofs << "# Source: " << skeleton->getSource() << endl;
+	out << "# ASF:" << skeleton->getId() << '\n';
+	out << "# Documentation: " << skeleton->getDocumentation() << '\n';
+	out << "# Source: " << skeleton->getSource() << '\n';
 
 	// standard qualifiers
-	ofs << ":version 1.10" << endl;
-	ofs << ":name VICON" << endl;
+	out << ":version 1.10" << '\n';
+	out << ":name VICON" << '\n';
 
-	ofs << ":units" << endl;
-	ofs << "  mass " << 1.0f << endl;		// FIXIT! 
-	ofs << "  length " << 0.45f << endl;    // FIXIT!
-	ofs << "  angle deg" << endl;
+	out << ":units" << '\n';
+	out << "  mass " << 1.0f << '\n';		// FIXIT! 
+	out << "  length " << 0.45f << '\n';    // FIXIT!
+	out << "  angle deg" << '\n';
 
-	ofs << ":documentation" << endl;
-	ofs << "   Created at University of the Pacific" << endl;
+	out << ":documentation" << '\n';
+	out << "   Created at University of the Pacific" << '\n';
 
 	//:root
 	//   order TX TY TZ RX RY RZ
 	//   axis XYZ
 	//   position 0 0 0  
 	//   orientation 0 0 0 
-	ofs << ":root" << endl;
+	out << ":root" << '\n';
 
 	short root_id = skeleton->boneIdFromName("root");
 	Bone* root_bone = skeleton->getBone(root_id);
-	ofs << "   order ";
+	out << "   order ";
 	for (int d=0; d<6; d++)
 	{
 		switch (root_bone->getChannelOrder(d))
 		{
-		case CT_TX: ofs << "TX "; break;
-		case CT_TY: ofs << "TY "; break;
-		case CT_TZ: ofs << "TZ "; break;
-		case CT_RX: ofs << "RX "; break;
-		case CT_RY: ofs << "RY "; break;
-		case CT_RZ: ofs << "RZ "; break;
-		default: ofs << "INVALID "; break;
+		case CT_TX: out << "TX "; break;
+		case CT_TY: out << "TY "; break;
+		case CT_TZ: out << "TZ "; break;
+		case CT_RX: out << "RX "; break;
+		case CT_RY: out << "RY "; break;
+		case CT_RZ: out << "RZ "; break;
+		default: out << "INVALID "; break;
 		}
 	}
-	ofs << endl << "   axis ";
+	out << '\n' << "   axis ";
 	for (int d=0; d<3; d++)
 	{
 		switch (root_bone->getAxisOrder(d))
 		{
-		case CT_RX: ofs << "X "; break;
-		case CT_RY: ofs << "Y "; break;
-		case CT_RZ: ofs << "Z "; break;
+		case CT_RX: out << "X "; break;
+		case CT_RY: out << "Y "; break;
+		case CT_RZ: out << "Z "; break;
 		default: break;
 		}
 	}	
-	ofs << endl;
+	out << '\n';
 	Vector3D initposition = skeleton->getRootPosition();
 	Vector3D initorientation = skeleton->getRootOrientation();
-	ofs << "   position " << 
+	out << "   position " << 
 		initposition.x << " " << 
 		initposition.y << " " << 
-		initposition.z << endl;
-	ofs << "   orientation " << 
+		initposition.z << '\n';
+	out << "   orientation " << 
 		initorientation.pitch << " " << 
 		initorientation.yaw << " " << 
-		initorientation.roll << endl;
+		initorientation.roll << '\n';
 
-	ofs << ":bonedata" << endl;
+	out << ":bonedata" << '\n';
 	for (int bone_id=0; bone_id<skeleton->numBones(); bone_id++)
 	{
 		string bone_name = skeleton->boneNameFromId(bone_id);
 		if (bone_name == string("root")) continue;
 		Bone* bone = skeleton->getBone(bone_id);
-		ofs << "  begin" << endl;
+		out << "  begin" << '\n';
 		
-		ofs << "     id " << bone_id << endl;
-		ofs << "     name " << bone_name << endl;
+		out << "     id " << bone_id << '\n';
+		out << "     name " << bone_name.c_str() << '\n';
 		Vector3D bone_direction = bone->getDirection();
-		ofs << "     direction " 
+		out << "     direction " 
 			<< bone_direction.x << " " 
 			<< bone_direction.y << " " 
-			<< bone_direction.z << endl;
-		ofs << "     length " << bone->getLength() << endl;
-		ofs << "     axis ";
+			<< bone_direction.z << '\n';
+		out << "     length " << bone->getLength() << '\n';
+		out << "     axis ";
 		for (int d=0; d<3; d++)
 		{
 			switch (bone->getAxisOrder(d))
 			{
-			case CT_RX: ofs << rad2deg(bone->getAxis().pitch) << " "; break;
-			case CT_RY: ofs << rad2deg(bone->getAxis().yaw) << " "; break;
-			case CT_RZ: ofs << rad2deg(bone->getAxis().roll) << " "; break;
+			case CT_RX: out << rad2deg(bone->getAxis().pitch) << " "; break;
+			case CT_RY: out << rad2deg(bone->getAxis().yaw) << " "; break;
+			case CT_RZ: out << rad2deg(bone->getAxis().roll) << " "; break;
 			default: break;
 			}
 		}
-		ofs << " ";
+		out << " ";
 		for (int d=0; d<3; d++)
 		{
 			switch (bone->getAxisOrder(d))
 			{
-			case CT_RX: ofs << "X"; break;
-			case CT_RY: ofs << "Y"; break;
-			case CT_RZ: ofs << "Z"; break;
+			case CT_RX: out << "X"; break;
+			case CT_RY: out << "Y"; break;
+			case CT_RZ: out << "Z"; break;
 			default: break;
 			}
 		}
-		ofs << endl;
+		out << '\n';
 		if (bone->getChannelOrder(0) != CT_INVALID)
 		{
 			// "dof" and "limits" lines only when bone has valid DOF
-			ofs << "     dof ";
+			out << "     dof ";
 			for (int d=0; d<6; d++)
 			{
 				if (bone->getChannelOrder(d) != CT_INVALID) 
 				{
 					switch (bone->getChannelOrder(d))
 					{
-					case CT_TX: ofs << "TX"; break;
-					case CT_TY: ofs << "TY"; break;
-					case CT_TZ: ofs << "TZ"; break;
-					case CT_RX: ofs << "RX"; break;
-					case CT_RY: ofs << "RY"; break;
-					case CT_RZ: ofs << "RZ"; break;
-					case CT_QW: ofs << "QW"; break;
-					case CT_QX: ofs << "QX"; break;
-					case CT_QY: ofs << "QY"; break;
-					case CT_QZ: ofs << "QZ"; break;
-					default: ofs << "--"; break;
+					case CT_TX: out << "TX"; break;
+					case CT_TY: out << "TY"; break;
+					case CT_TZ: out << "TZ"; break;
+					case CT_RX: out << "RX"; break;
+					case CT_RY: out << "RY"; break;
+					case CT_RZ: out << "RZ"; break;
+					case CT_QW: out << "QW"; break;
+					case CT_QX: out << "QX"; break;
+					case CT_QY: out << "QY"; break;
+					case CT_QZ: out << "QZ"; break;
+					default: out << "--"; break;
 					}
-					ofs << " ";
+					out << " ";
 				}
 			}
-			ofs << endl;
-			ofs << "     limits ";
+			out << '\n';
+			out << "     limits ";
 			for (int d=0; d<6; d++)
 			{
 				if (bone->getChannelOrder(d) != CT_INVALID) 
 				{
-					if (d>0) ofs << "            ";
+					if (d>0) out << "            ";
 					int d2 = 0;
 					switch (bone->getChannelOrder(d))
 					{
@@ -172,22 +172,22 @@ bool ASF_Writer::writeASF(const char* outputFilename,
 					case CT_RZ: d2 = 5; break;
 					default: break;
 					}
-					ofs << "(";
-					if (bone->getChannelLowerLimit(d2) == -1.0f*FLT_MAX) ofs << "-inf";
-					else ofs << rad2deg(bone->getChannelLowerLimit(d2));
-					ofs << " ";
-					if (bone->getChannelUpperLimit(d2) == FLT_MAX) ofs << "inf";
-					else ofs << rad2deg(bone->getChannelUpperLimit(d2)); 
-					ofs << ")";
-					ofs <<  endl;
+					out << "(";
+					if (bone->getChannelLowerLimit(d2) == -1.0f*FLT_MAX) out << "-inf";
+					else out << rad2deg(bone->getChannelLowerLimit(d2));
+					out << " ";
+					if (bone->getChannelUpperLimit(d2) == FLT_MAX) out << "inf";
+					else out << rad2deg(bone->getChannelUpperLimit(d2)); 
+					out << ")";
+					out << '\n';
 				}
 					
 			}
 		}
-		ofs << "  end" << endl;
+		out << "  end" << '\n';
 	}
-	ofs << ":hierarchy" << endl;
-	ofs << "  begin" << endl;
+	out << ":hierarchy" << '\n';
+	out << "  begin" << '\n';
 
 	for (int bone_id=0; bone_id<skeleton->numBones(); bone_id++)
 	{
@@ -199,16 +199,15 @@ bool ASF_Writer::writeASF(const char* outputFilename,
 		{
 			if (strcmp((*iter).first, bone_name.c_str()) == 0)
 			{
-				if (count == 0) ofs << "    " << bone_name << " ";
+				if (count == 0) out << "    " << bone_name.c_str() << " ";
 				count++;
-				ofs << (*iter).second << " ";
+				out << (*iter).second << " ";
 			}
 			iter++;
 		}
-		if (count > 0) ofs << endl;
+		if (count > 0) out << '\n';
 	}
-	ofs << "  end" << endl;
+	out << "  end" << '\n';
 
-	ofs.close();
-	return true;
+	return out.close();
 }
@@ -18,6 +18,7 @@
 #include <Core/Array2D.h>
 #include <DataManagement/DataManagementException.h>
 #include <DataManagement/BVH_Reader.h>
+#include <DataManagement/ChannelSelection.h>
 #include <fstream>
 #include <cstdlib>
 #include <vector>
@@ -106,14 +107,14 @@ ostream& operator<<(ostream& os, BVH_MOTION* ptr);
 class BVH_Reader_Local
 {
 public:
-	BVH_Reader_Local() : SKA2BVH_channel_map(NULL), next_bone_id(0), line_scanner(NULL)
+	BVH_Reader_Local() : SKA2BVH_channel_map(NULL), next_bone_id(0), selection(NULL), line_scanner(NULL)
 	{ }
 	virtual ~BVH_Reader_Local() 
 	{ 
 		if (line_scanner != NULL) delete line_scanner; 
 		if (SKA2BVH_channel_map != NULL) delete [] SKA2BVH_channel_map;
 	}
-	pair<Skeleton*, MotionSequence*> readBVH(const char* inputFilename);
+	pair<Skeleton*, MotionSequence*> readBVH(const char* inputFilename, ChannelSelection* _selection);
 
 private:
 
@@ -146,6 +147,11 @@ private:
 	// misc
 	short countChannels(BVH_HIERARCHY* hier);
 	short next_bone_id;
+
+	// channel projection - file channels that are not needed are skipped without conversion
+	ChannelSelection* selection;
+	vector<bool> keep_channel;
+	void markSelectedChannels(BVH_DECL* decl);
 	short* setupReindexing(BVH_HIERARCHY* hier);
 
 	// tokenizer
@@ -250,8 +256,9 @@ BVH_MOTION* postParseProcess(BVH_MOTION* old_mo, short* channel_remap, bool* cha
 
 //==========================================================================
 
-pair<Skeleton*, MotionSequence*> BVH_Reader_Local::readBVH(const char* inputFilename)
+pair<Skeleton*, MotionSequence*> BVH_Reader_Local::readBVH(const char* inputFilename, ChannelSelection* _selection)
 {
+	selection = _selection;
 	pair<Skeleton*, MotionSequence*> result;
 	result.first = NULL;
 	result.second = NULL;
@@ -290,19 +297,27 @@ pair<Skeleton*, MotionSequence*> BVH_Reader_Local::readBVH(const char* inputFile
 	ms->setNumFrames(motion->frames);
 	ms->setFrameRate(1.0f/motion->frame_time);
 
-	CHANNEL_ID* cid = new CHANNEL_ID[channel_ids.size()];
-	for (unsigned short c=0; c<channel_ids.size(); c++)	cid[c] = channel_ids[c];
-	Array2D<float> bulk_data(motion->frames, channel_ids.size());
+	// SKA channels to store (all of them unless there is a selection)
+	vector<short> stored;
+	for (short SKA_channel=0; SKA_channel<num_SKA_channels; SKA_channel++)
+	{
+		if ((selection == NULL) || selection->selectsChannel(skel, channel_ids[SKA_channel]))
+			stored.push_back(SKA_channel);
+	}
+	short num_stored = short(stored.size());
+	CHANNEL_ID* cid = new CHANNEL_ID[num_stored > 0 ? num_stored : 1];
+	for (short c=0; c<num_stored; c++) cid[c] = channel_ids[stored[c]];
+	Array2D<float> bulk_data(motion->frames, num_stored);
 	for (long f=0; f<motion->frames; f++)
 	{
-		for (short SKA_channel=0; SKA_channel<num_SKA_channels; SKA_channel++)
+		for (short c=0; c<num_stored; c++)
 		{
-			short BVH_channel = SKA2BVH_channel_map[SKA_channel];
+			short BVH_channel = SKA2BVH_channel_map[stored[c]];
 			float v = motion->frame_data.get(f, BVH_channel);
-			bulk_data.set(f, SKA_channel, v);
+			bulk_data.set(f, c, v);
 		}
 	}
-	ms->bulkBuild(cid, short(channel_ids.size()), bulk_data);
+	ms->bulkBuild(cid, num_stored, bulk_data);
 	delete [] cid;
 
 	delete bvh_parse_tree;
@@ -503,6 +518,9 @@ BVH_FILE* BVH_Reader_Local::parse_BVH_FILE()
 	BVH_FILE* file = new BVH_FILE;
 	file->hierarchy = parse_BVH_HIERARCHY();
 	file->num_channels = countChannels(file->hierarchy);
+	keep_channel.clear();
+	for (unsigned short i=0; i<file->hierarchy->roots.size(); i++)
+		markSelectedChannels(file->hierarchy->roots[i]);
 	file->motion = parse_BVH_MOTION(file->num_channels);
 	return file;
 }
@@ -602,6 +620,7 @@ BVH_MOTION* BVH_Reader_Local::parse_BVH_MOTION(short _channels)
 	for (f=0; f<frames; f++)
 		for (c=0; c<_channels; c++)
 		{
+			if (!keep_channel[c]) { consumeToken(); continue; }
 			float v = (float)parse_REAL();
 			// Load channels in file order.
 			// Do not reorder based on DOF order.
@@ -613,6 +632,33 @@ BVH_MOTION* BVH_Reader_Local::parse_BVH_MOTION(short _channels)
 //==================================================
 // misc
 
+static CHANNEL_TYPE channelTypeFromLabel(const string& label)
+{
+	if (label == "Xposition") return CT_TX;
+	if (label == "Yposition") return CT_TY;
+	if (label == "Zposition") return CT_TZ;
+	if (label == "Xrotation") return CT_RX;
+	if (label == "Yrotation") return CT_RY;
+	if (label == "Zrotation") return CT_RZ;
+	return CT_INVALID;
+}
+
+// Append one flag per file channel, in file order.
+// The root's channels belong to the SKA bone "root". 
+// A joint's channels belong to the bones named after the joint.
+void BVH_Reader_Local::markSelectedChannels(BVH_DECL* decl)
+{
+	if ((decl->decl_type != BVH_ROOT) && (decl->decl_type != BVH_JOINT)) return;
+	string bone_name = (decl->decl_type == BVH_ROOT) ? string("root") : decl->name;
+	for (unsigned short i=0; i<decl->channels->channel_labels.size(); i++)
+	{
+		CHANNEL_TYPE ct = channelTypeFromLabel(decl->channels->channel_labels[i]);
+		keep_channel.push_back((selection == NULL) || selection->selectsChannel(bone_name.c_str(), ct));
+	}
+	for (unsigned short i=0; i<decl->children.size(); i++)
+		markSelectedChannels(decl->children[i]);
+}
+
 short countChannelsRecursive(BVH_DECL* decl)
 {
 	short c=0;
@@ -804,10 +850,10 @@ BVH_Reader::BVH_Reader() { }
 
 BVH_Reader::~BVH_Reader() { } 
 
-pair<Skeleton*, MotionSequence*> BVH_Reader::readBVH(const char* inputFilename)
+pair<Skeleton*, MotionSequence*> BVH_Reader::readBVH(const char* inputFilename, ChannelSelection* selection)
 {
 	BVH_Reader_Local reader;
-	pair<Skeleton*, MotionSequence*> answer = reader.readBVH(inputFilename);
+	pair<Skeleton*, MotionSequence*> answer = reader.readBVH(inputFilename, selection);
 	return answer;
 }
 
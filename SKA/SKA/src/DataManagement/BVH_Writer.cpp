@@ -0,0 +1,398 @@
+//-----------------------------------------------------------------------------
+// BVH_Writer.cpp
+//	 Writes Biovision Hierarchical data file (BVH)
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <DataManagement/BVH_Writer.h>
+#include <DataManagement/BufferedWriter.h>
+#include <DataManagement/FileSystem.h>
+#include <Animation/Skeleton.h>
+#include <Animation/MotionSequence.h>
+#include <Math/Math.h>
+#include <Math/Matrix4x4.h>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// One BVH joint, built from one SKA bone or from a group of bones
+// that BVH_Reader split out of a single joint.
+struct BVH_JointOut
+{
+	string name;
+	bool is_root;
+	Vector3D offset;
+	short channel_bone;					// SKA bone that supplies the rotations
+	vector<BVH_JointOut*> children;
+	vector<Vector3D> end_sites;
+
+	// channels as written, in BVH (left-to-right) order
+	vector<CHANNEL_TYPE> file_channels;
+	vector<float*> file_columns;		// NULL columns are written as zero
+
+	// bones with a local axis are converted through C*M*Cinv
+	bool convert;
+	Matrix4x4 C, Cinv;
+	vector<CHANNEL_TYPE> ska_channels;	// SKA (application) order
+	vector<float*> ska_columns;
+
+	BVH_JointOut() : is_root(false), channel_bone(-1), convert(false) { }
+	~BVH_JointOut() { for (unsigned int i=0; i<children.size(); i++) delete children[i]; }
+};
+
+class BVH_Writer_Local
+{
+public:
+	BVH_Writer_Local(Skeleton* _skeleton, MotionSequence* _motion)
+		: skeleton(_skeleton), motion(_motion), root(NULL) { }
+	~BVH_Writer_Local() { if (root != NULL) delete root; }
+	bool buildHierarchy();
+	void writeHierarchy(BufferedWriter& out) { writeJoint(out, root, 0); }
+	void writeFrame(BufferedWriter& out, long frame);
+private:
+	Skeleton* skeleton;
+	MotionSequence* motion;
+	BVH_JointOut* root;
+	vector<BVH_JointOut*> joint_order;		// depth first, matches channel order in MOTION
+	vector<vector<short> > bone_children;
+
+	BVH_JointOut* buildJoint(const string& name, short channel_bone, bool is_root,
+		Vector3D offset, vector<short>& outgoing);
+	void configureChannels(BVH_JointOut* joint);
+	void writeJoint(BufferedWriter& out, BVH_JointOut* joint, int depth);
+};
+
+// "name__3" -> "name"
+static string baseBoneName(const char* name)
+{
+	string s(name);
+	size_t p = s.rfind("__");
+	if (p == string::npos || p == 0 || p+2 >= s.size()) return s;
+	for (size_t i=p+2; i<s.size(); i++)
+		if ((s[i] < '0') || (s[i] > '9')) return s;
+	return s.substr(0, p);
+}
+
+static bool hasDOF(Bone* bone)
+{
+	return bone->getChannelOrder(0) != CT_INVALID;
+}
+
+// group child bones that came from the same BVH joint
+static vector<vector<short> > groupChildren(Skeleton* skeleton, vector<short>& children)
+{
+	vector<vector<short> > groups;
+	vector<string> names;
+	for (unsigned int i=0; i<children.size(); i++)
+	{
+		string base = baseBoneName(skeleton->boneNameFromId(children[i]));
+		unsigned int g = 0;
+		while ((g < names.size()) && (names[g] != base)) g++;
+		if (g == names.size()) { names.push_back(base); groups.push_back(vector<short>()); }
+		groups[g].push_back(children[i]);
+	}
+	return groups;
+}
+
+bool BVH_Writer_Local::buildHierarchy()
+{
+	short num_bones = short(skeleton->numBones());
+	bone_children.assign(num_bones, vector<short>());
+	short root_id = -1;
+	for (short b=0; b<num_bones; b++)
+	{
+		if (skeleton->getBone(b) == NULL) return false;
+		short p = skeleton->getParentBoneId(b);
+		if (p < 0) { if (root_id < 0) root_id = b; }
+		else bone_children[p].push_back(b);
+	}
+	if (root_id < 0) return false;
+
+	// The SKA root bone has no length; its children start at the root position.
+	// A BVH_Reader skeleton has the BVH root joint split into DOF-less children
+	// of "root". Collapse those back into the BVH root joint.
+	vector<short>& root_children = bone_children[root_id];
+	vector<vector<short> > groups = groupChildren(skeleton, root_children);
+	bool collapse = (groups.size() == 1);
+	for (unsigned int i=0; collapse && i<root_children.size(); i++)
+		if (hasDOF(skeleton->getBone(root_children[i]))) collapse = false;
+
+	Vector3D offset = skeleton->getRootPosition();
+	if (collapse)
+	{
+		string name = baseBoneName(skeleton->boneNameFromId(groups[0][0]));
+		root = buildJoint(name, root_id, true, offset, groups[0]);
+	}
+	else
+	{
+		vector<short> outgoing(1, root_id);
+		root = buildJoint(skeleton->boneNameFromId(root_id), root_id, true, offset, outgoing);
+	}
+	// root translation channels already place the root
+	for (unsigned int c=0; c<root->file_channels.size(); c++)
+		if (root->file_channels[c] <= CT_TZ) root->offset = Vector3D(0.0f, 0.0f, 0.0f);
+	return true;
+}
+
+// outgoing: SKA bones that start at this joint
+BVH_JointOut* BVH_Writer_Local::buildJoint(const string& name, short channel_bone, bool is_root,
+	Vector3D offset, vector<short>& outgoing)
+{
+	BVH_JointOut* joint = new BVH_JointOut;
+	joint->name = name;
+	joint->is_root = is_root;
+	joint->offset = offset;
+	joint->channel_bone = channel_bone;
+	configureChannels(joint);
+	joint_order.push_back(joint);
+
+	for (unsigned int i=0; i<outgoing.size(); i++)
+	{
+		short bone_id = outgoing[i];
+		Bone* bone = skeleton->getBone(bone_id);
+		Vector3D end(0.0f, 0.0f, 0.0f);
+		// the root bone is translated by its channels, not by its length
+		if (!(is_root && bone_id == channel_bone)) end = bone->getDirection() * bone->getLength();
+		if (bone_children[bone_id].size() == 0)
+		{
+			joint->end_sites.push_back(end);
+			continue;
+		}
+		vector<vector<short> > groups = groupChildren(skeleton, bone_children[bone_id]);
+		for (unsigned int g=0; g<groups.size(); g++)
+		{
+			string child_name = skeleton->boneNameFromId(groups[g][0]);
+			if (groups[g].size() > 1) child_name = baseBoneName(child_name.c_str());
+			joint->children.push_back(buildJoint(child_name, groups[g][0], false, end, groups[g]));
+		}
+	}
+	return joint;
+}
+
+void BVH_Writer_Local::configureChannels(BVH_JointOut* joint)
+{
+	Bone* bone = skeleton->getBone(joint->channel_bone);
+
+	// a joint without DOF is written with constant zero rotations,
+	// since not all BVH readers accept "CHANNELS 0"
+	if (!hasDOF(bone))
+	{
+		joint->file_channels.push_back(CT_RZ);
+		joint->file_channels.push_back(CT_RX);
+		joint->file_channels.push_back(CT_RY);
+		joint->file_columns.assign(3, (float*)NULL);
+		return;
+	}
+
+	vector<CHANNEL_TYPE> translations, rotations;
+	for (short d=0; d<6; d++)
+	{
+		CHANNEL_TYPE ct = bone->getChannelOrder(d);
+		if ((ct == CT_TX) || (ct == CT_TY) || (ct == CT_TZ))
+		{
+			// BVH only supports translation on the root
+			if (joint->is_root) translations.push_back(ct);
+		}
+		else if ((ct == CT_RX) || (ct == CT_RY) || (ct == CT_RZ))
+		{
+			rotations.push_back(ct);
+			CHANNEL_ID cid(joint->channel_bone, ct);
+			joint->ska_channels.push_back(ct);
+			joint->ska_columns.push_back(motion->getChannelPtr(cid));
+		}
+	}
+
+	// local axis transform, computed as in Bone::computeLocalAxisTransform()
+	Vector3D axis = bone->getAxis();
+	Matrix4x4 C = Matrix4x4::identity();
+	for (short d=0; d<3; d++)
+	{
+		switch(bone->getAxisOrder(d))
+		{
+		case CT_RX: C = Matrix4x4::rotationPitch(axis.pitch) * C; break;
+		case CT_RY: C = Matrix4x4::rotationYaw(axis.yaw) * C; break;
+		case CT_RZ: C = Matrix4x4::rotationRoll(axis.roll) * C; break;
+		default: break;
+		}
+	}
+	bool identity_axis = true;
+	Matrix4x4 I = Matrix4x4::identity();
+	for (short i=0; i<16; i++)
+		if (fabs(C.m[i]-I.m[i]) > 1.0e-6f) identity_axis = false;
+
+	for (unsigned int t=0; t<translations.size(); t++)
+	{
+		CHANNEL_ID cid(joint->channel_bone, translations[t]);
+		joint->file_channels.push_back(translations[t]);
+		joint->file_columns.push_back(motion->getChannelPtr(cid));
+	}
+
+	// Bone::update() ignores the axis of the root bone
+	if (joint->is_root || identity_axis)
+	{
+		// SKA lists rotations in application order (right-to-left),
+		// BVH lists them left-to-right.
+		for (int r=int(rotations.size())-1; r>=0; r--)
+		{
+			CHANNEL_ID cid(joint->channel_bone, rotations[r]);
+			joint->file_channels.push_back(rotations[r]);
+			joint->file_columns.push_back(motion->getChannelPtr(cid));
+		}
+		// Most BVH readers (including BVH_Reader) expect three rotations per joint.
+		// Missing axes are written as zero, which leaves the rotation unchanged.
+		CHANNEL_TYPE all_rotations[3] = { CT_RZ, CT_RX, CT_RY };
+		for (short r=0; r<3; r++)
+		{
+			bool present = false;
+			for (unsigned int i=0; i<rotations.size(); i++)
+				if (rotations[i] == all_rotations[r]) present = true;
+			if (present) continue;
+			joint->file_channels.push_back(all_rotations[r]);
+			joint->file_columns.push_back((float*)NULL);
+		}
+		return;
+	}
+
+	// rotation is C*M*Cinv, written as Rz*Rx*Ry
+	joint->convert = true;
+	joint->C = C;
+	joint->Cinv = C.cheapInverse(true);
+	joint->file_channels.push_back(CT_RZ);
+	joint->file_channels.push_back(CT_RX);
+	joint->file_channels.push_back(CT_RY);
+}
+
+static void indent(BufferedWriter& out, int depth)
+{
+	for (int i=0; i<depth; i++) out.put('\t');
+}
+
+static const char* channelLabel(CHANNEL_TYPE ct)
+{
+	switch (ct)
+	{
+	case CT_TX: return "Xposition";
+	case CT_TY: return "Yposition";
+	case CT_TZ: return "Zposition";
+	case CT_RX: return "Xrotation";
+	case CT_RY: return "Yrotation";
+	case CT_RZ: return "Zrotation";
+	default: return "INVALID";
+	}
+}
+
+static void writeOffset(BufferedWriter& out, const Vector3D& v, int depth)
+{
+	indent(out, depth);
+	out << "OFFSET " << v.x << ' ' << v.y << ' ' << v.z << '\n';
+}
+
+void BVH_Writer_Local::writeJoint(BufferedWriter& out, BVH_JointOut* joint, int depth)
+{
+	indent(out, depth);
+	out << (joint->is_root ? "ROOT " : "JOINT ") << joint->name.c_str() << '\n';
+	indent(out, depth);
+	out << "{\n";
+	writeOffset(out, joint->offset, depth+1);
+	indent(out, depth+1);
+	out << "CHANNELS " << int(joint->file_channels.size());
+	for (unsigned int c=0; c<joint->file_channels.size(); c++)
+		out << ' ' << channelLabel(joint->file_channels[c]);
+	out << '\n';
+	for (unsigned int i=0; i<joint->children.size(); i++)
+		writeJoint(out, joint->children[i], depth+1);
+	for (unsigned int i=0; i<joint->end_sites.size(); i++)
+	{
+		indent(out, depth+1);
+		out << "End Site\n";
+		indent(out, depth+1);
+		out << "{\n";
+		writeOffset(out, joint->end_sites[i], depth+2);
+		indent(out, depth+1);
+		out << "}\n";
+	}
+	indent(out, depth);
+	out << "}\n";
+}
+
+void BVH_Writer_Local::writeFrame(BufferedWriter& out, long frame)
+{
+	for (unsigned int j=0; j<joint_order.size(); j++)
+	{
+		BVH_JointOut* joint = joint_order[j];
+		if (!joint->convert)
+		{
+			for (unsigned int c=0; c<joint->file_channels.size(); c++)
+			{
+				float value = 0.0f;
+				if (joint->file_columns[c] != NULL) value = joint->file_columns[c][frame];
+				if (joint->file_channels[c] >= CT_RX) value = rad2deg(value);
+				if (j+c > 0) out.put(' ');
+				out.putFloat(value);
+			}
+			continue;
+		}
+		// same composition as Bone::computeRotationTransform()
+		Matrix4x4 M = Matrix4x4::identity();
+		for (unsigned int c=0; c<joint->ska_channels.size(); c++)
+		{
+			float a = 0.0f;
+			if (joint->ska_columns[c] != NULL) a = joint->ska_columns[c][frame];
+			switch (joint->ska_channels[c])
+			{
+			case CT_RX: M = Matrix4x4::rotationPitch(a) * M; break;
+			case CT_RY: M = Matrix4x4::rotationYaw(a) * M; break;
+			case CT_RZ: M = Matrix4x4::rotationRoll(a) * M; break;
+			default: break;
+			}
+		}
+		Matrix4x4 R = joint->C * M * joint->Cinv;
+		float rx, ry, rz;
+		R.factorEulerYXZ(rx, ry, rz);
+		if (j > 0) out.put(' ');
+		out.putFloat(rad2deg(rz)).put(' ').putFloat(rad2deg(rx)).put(' ').putFloat(rad2deg(ry));
+	}
+	out.newline();
+}
+
+bool BVH_Writer::writeBVH(const char* outputFilename,
+		Skeleton* skeleton,
+		MotionSequence* motion,
+		bool overwrite)
+{
+	if (!overwrite && FileSystem::fileExists(outputFilename))
+		return false;
+	if ((skeleton == NULL) || (motion == NULL)) return false;
+
+	BVH_Writer_Local writer(skeleton, motion);
+	if (!writer.buildHierarchy()) return false;
+
+	BufferedWriter out;
+	if (!out.open(outputFilename)) return false;
+
+	out << "HIERARCHY\n";
+	writer.writeHierarchy(out);
+
+	float frame_time = 0.0f;
+	if (motion->getFrameRate() > 0.0f) frame_time = 1.0f/motion->getFrameRate();
+	out << "MOTION\n";
+	out << "Frames: " << motion->numFrames() << '\n';
+	out << "Frame Time: ";
+	out.putFloat(frame_time, 9).newline();
+
+	formatInOrder(out, motion->numFrames(), [&writer](BufferedWriter& part, long frame)
+	{
+		writer.writeFrame(part, frame);
+	});
+
+	return out.close();
+}
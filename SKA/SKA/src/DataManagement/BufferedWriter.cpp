@@ -0,0 +1,152 @@
+//-----------------------------------------------------------------------------
+// BufferedWriter.cpp
+//	 Buffered text output with fast number formatting.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <DataManagement/BufferedWriter.h>
+#include <cstring>
+#include <cmath>
+using namespace std;
+
+static const unsigned long long POW10[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL };
+static const int MAX_DECIMALS = 9;
+
+BufferedWriter::BufferedWriter(long _capacity)
+	: buffer(NULL), capacity(_capacity), length(0), file(NULL), failed(false)
+{
+	if (capacity < 256) capacity = 256;
+	buffer = new char[capacity];
+}
+
+BufferedWriter::~BufferedWriter()
+{
+	if (file != NULL) close();
+	delete [] buffer;
+}
+
+bool BufferedWriter::open(const char* filename)
+{
+	if (file != NULL) close();
+	length = 0;
+	failed = false;
+	file = fopen(filename, "wb");
+	return (file != NULL);
+}
+
+bool BufferedWriter::close()
+{
+	if (file == NULL) return !failed;
+	flush();
+	if (fclose(file) != 0) failed = true;
+	file = NULL;
+	return !failed;
+}
+
+void BufferedWriter::flush()
+{
+	if ((file == NULL) || (length == 0)) return;
+	if (fwrite(buffer, 1, size_t(length), file) != size_t(length)) failed = true;
+	length = 0;
+}
+
+void BufferedWriter::makeRoom(long n)
+{
+	if (length + n <= capacity) return;
+	flush();
+	if (length + n <= capacity) return;
+	// memory-only writer, or a single put larger than the buffer
+	long new_capacity = capacity;
+	while (length + n > new_capacity) new_capacity *= 2;
+	char* tmp = new char[new_capacity];
+	memcpy(tmp, buffer, size_t(length));
+	delete [] buffer;
+	buffer = tmp;
+	capacity = new_capacity;
+}
+
+BufferedWriter& BufferedWriter::put(const char* s)
+{
+	return put(s, long(strlen(s)));
+}
+
+BufferedWriter& BufferedWriter::put(const char* s, long n)
+{
+	if ((file != NULL) && (n > capacity))
+	{	// large block: bypass the buffer
+		flush();
+		if (fwrite(s, 1, size_t(n), file) != size_t(n)) failed = true;
+		return *this;
+	}
+	makeRoom(n);
+	memcpy(buffer+length, s, size_t(n));
+	length += n;
+	return *this;
+}
+
+// write the decimal digits of v, at least min_digits (zero padded)
+static int formatDigits(char* out, unsigned long long v, int min_digits)
+{
+	char tmp[24];
+	int n = 0;
+	do { tmp[n++] = char('0' + (v % 10)); v /= 10; } while (v > 0);
+	while (n < min_digits) tmp[n++] = '0';
+	for (int i=0; i<n; i++) out[i] = tmp[n-1-i];
+	return n;
+}
+
+BufferedWriter& BufferedWriter::putInt(long v)
+{
+	makeRoom(24);
+	char* out = buffer + length;
+	unsigned long long u = (unsigned long long)v;
+	if (v < 0) { *out++ = '-'; u = 0ULL - u; }
+	out += formatDigits(out, u, 1);
+	length = long(out - buffer);
+	return *this;
+}
+
+BufferedWriter& BufferedWriter::putFloat(float v, int decimals)
+{
+	if (decimals < 0) decimals = 0;
+	if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+	makeRoom(48);
+	char* out = buffer + length;
+	double a = fabs(double(v));
+	// NaN, infinity and very large values go through the C library
+	if (!(a < 1.0e9))
+	{
+		length += snprintf(out, 48, "%.9g", double(v));
+		return *this;
+	}
+	unsigned long long scale = POW10[decimals];
+	unsigned long long q = (unsigned long long)(a*double(scale) + 0.5);
+	if (q == 0ULL)
+	{	// also avoids printing "-0"
+		buffer[length++] = '0';
+		return *this;
+	}
+	if (v < 0.0f) *out++ = '-';
+	out += formatDigits(out, q / scale, 1);
+	unsigned long long frac = q % scale;
+	if (frac > 0ULL)
+	{
+		int d = decimals;
+		while ((frac % 10ULL) == 0ULL) { frac /= 10ULL; d--; }
+		*out++ = '.';
+		out += formatDigits(out, frac, d);
+	}
+	length = long(out - buffer);
+	return *this;
+}
@@ -0,0 +1,90 @@
+//-----------------------------------------------------------------------------
+// ChannelSelection.cpp
+//	 A subset of bones and channels to load from a motion file.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <string>
+using namespace std;
+#include <DataManagement/ChannelSelection.h>
+#include <Animation/Skeleton.h>
+#include <Animation/Bone.h>
+
+// "Hips__1" -> "Hips" (bones created by splitting a BVH joint)
+static string jointName(const char* bone_name)
+{
+	string name(bone_name);
+	size_t split = name.rfind("__");
+	if ((split == string::npos) || (split+2 == name.size())) return name;
+	for (size_t i=split+2; i<name.size(); i++)
+		if ((name[i] < '0') || (name[i] > '9')) return name;
+	return name.substr(0, split);
+}
+
+void ChannelSelection::addMask(const char* bone_name, unsigned short mask)
+{
+	string name = jointName(bone_name);
+	for (unsigned int i=0; i<names.size(); i++)
+	{
+		if (names[i] == name) { masks[i] |= mask; return; }
+	}
+	names.push_back(name);
+	masks.push_back(mask);
+}
+
+void ChannelSelection::addBone(const char* bone_name)
+{
+	addMask(bone_name, (unsigned short)((1 << NUMBER_OF_CHANNEL_TYPES) - 1));
+}
+
+void ChannelSelection::addChannel(const char* bone_name, CHANNEL_TYPE channel_type)
+{
+	if ((channel_type < 0) || (channel_type >= CT_INVALID)) return;
+	addMask(bone_name, (unsigned short)(1 << channel_type));
+}
+
+void ChannelSelection::addBoneAndAncestors(Skeleton* skeleton, const char* bone_name)
+{
+	Bone* bone = skeleton->getBone(bone_name);
+	if (bone == NULL) { addBone(bone_name); return; }
+	while (bone != NULL)
+	{
+		addBone(bone->getName());
+		bone = bone->getParent();
+	}
+}
+
+unsigned short ChannelSelection::boneMask(const char* bone_name)
+{
+	string name = jointName(bone_name);
+	for (unsigned int i=0; i<names.size(); i++)
+		if (names[i] == name) return masks[i];
+	return 0;
+}
+
+bool ChannelSelection::selectsBone(const char* bone_name)
+{
+	return boneMask(bone_name) != 0;
+}
+
+bool ChannelSelection::selectsChannel(const char* bone_name, CHANNEL_TYPE channel_type)
+{
+	if ((channel_type < 0) || (channel_type >= CT_INVALID)) return false;
+	return (boneMask(bone_name) & (1 << channel_type)) != 0;
+}
+
+bool ChannelSelection::selectsChannel(Skeleton* skeleton, CHANNEL_ID channel)
+{
+	char* name = skeleton->boneNameFromId(short(channel.bone_id));
+	if (name == NULL) return false;
+	return selectsChannel(name, channel.channel_type);
+}
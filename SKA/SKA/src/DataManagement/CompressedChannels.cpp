@@ -0,0 +1,479 @@
+//-----------------------------------------------------------------------------
+// CompressedChannels.cpp
+//	 Lossless compression of motion channel data.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cstring>
+#include <vector>
+using namespace std;
+#include <Core/Parallel.h>
+#include <DataManagement/CompressedChannels.h>
+#include <DataManagement/BinaryStream.h>
+
+/*==========================================================================
+Compressed block layout (all values little-endian)
+
+   0  char[4]  magic "SKCC"
+   4  u32      version
+   8  u32      number of channels
+  12  u32      number of frames
+  16  u32      frames per chunk
+  20  u32      reserved
+  24  u64      chunk offsets, channels*chunks+1 entries, relative to the
+               block start. Chunk k of channel c is entry c*chunks+k.
+      chunk data
+
+Chunk:
+   u8  predictor (PRED_XOR, PRED_DELTA or PRED_LINEAR)
+   bit stream (least significant bit first):
+      first value, 32 bits
+      remaining values in groups of GROUP_SIZE:
+         5 bit Rice parameter k (ZERO_GROUP means every residual is 0)
+         per value: unary quotient (z>>k), a 0 bit, then the low k bits.
+         A quotient of ESCAPE_QUOTIENT or more is sent as ESCAPE_QUOTIENT
+         1 bits followed by the raw 32 bit residual.
+
+Prediction works on the float bit patterns, so it is exact.
+PRED_XOR stores value^previous. The delta and linear predictors first
+map the bits to unsigned integers that sort in the same order as the floats,
+so nearby floats map to nearby integers, and store the zigzag coded
+difference from previous or from 2*previous-before (mod 2^32).
+==========================================================================*/
+
+static const char SKCC_MAGIC[4] = { 'S','K','C','C' };
+static const unsigned int SKCC_VERSION = 1;
+static const long SKCC_HEADER_SIZE = 24;
+
+enum { PRED_XOR=0, PRED_DELTA=1, PRED_LINEAR=2, NUM_PREDICTORS=3 };
+static const int GROUP_SIZE = 16;
+static const unsigned int ZERO_GROUP = 31;
+static const unsigned int MAX_RICE_K = 30;
+static const unsigned int ESCAPE_QUOTIENT = 24;
+
+// ---------------- value mapping ----------------
+
+static inline unsigned int floatBits(float f) { unsigned int u; memcpy(&u, &f, 4); return u; }
+static inline float bitsFloat(unsigned int u) { float f; memcpy(&f, &u, 4); return f; }
+
+// order preserving map from float bits to unsigned integers (and back)
+static inline unsigned int toOrdered(unsigned int u) { return (u & 0x80000000u) ? ~u : (u | 0x80000000u); }
+static inline unsigned int fromOrdered(unsigned int o) { return (o & 0x80000000u) ? (o & 0x7fffffffu) : ~o; }
+
+static inline unsigned int zigzag(unsigned int d) { return (d << 1) ^ (unsigned int)(-(int)(d >> 31)); }
+static inline unsigned int unzigzag(unsigned int z) { return (z >> 1) ^ (unsigned int)(-(int)(z & 1)); }
+
+// residuals of values 1..n-1 of a chunk (bits holds the raw float bits)
+static void computeResiduals(int predictor, const unsigned int* bits, long n, unsigned int* residuals)
+{
+	for (long i=1; i<n; i++)
+	{
+		if (predictor == PRED_XOR) { residuals[i-1] = bits[i] ^ bits[i-1]; continue; }
+		unsigned int pred = toOrdered(bits[i-1]);
+		if ((predictor == PRED_LINEAR) && (i > 1))
+			pred = 2*pred - toOrdered(bits[i-2]);
+		residuals[i-1] = zigzag(toOrdered(bits[i]) - pred);
+	}
+}
+
+static void applyResidual(int predictor, unsigned int* bits, long i, unsigned int residual)
+{
+	if (predictor == PRED_XOR) { bits[i] = residual ^ bits[i-1]; return; }
+	unsigned int pred = toOrdered(bits[i-1]);
+	if ((predictor == PRED_LINEAR) && (i > 1))
+		pred = 2*pred - toOrdered(bits[i-2]);
+	bits[i] = fromOrdered(unzigzag(residual) + pred);
+}
+
+// ---------------- Rice parameter selection ----------------
+
+static unsigned long long riceCost(const unsigned int* z, long n, unsigned int k)
+{
+	unsigned long long cost = 5;
+	for (long i=0; i<n; i++)
+	{
+		unsigned int q = z[i] >> k;
+		cost += (q >= ESCAPE_QUOTIENT) ? (ESCAPE_QUOTIENT + 32) : (q + 1 + k);
+	}
+	return cost;
+}
+
+// best k for one group, and its cost in bits
+static unsigned int chooseRiceK(const unsigned int* z, long n, unsigned long long& cost)
+{
+	unsigned long long sum = 0;
+	for (long i=0; i<n; i++) sum += z[i];
+	if (sum == 0) { cost = 5; return ZERO_GROUP; }
+	// start from the bit length of the mean and search nearby
+	unsigned long long mean = sum / n;
+	unsigned int k0 = 0;
+	while ((k0 < MAX_RICE_K) && ((1ull << k0) <= mean)) k0++;
+	unsigned int best_k = k0;
+	cost = riceCost(z, n, k0);
+	for (unsigned int k = (k0 > 2 ? k0-2 : 0); (k <= k0+2) && (k <= MAX_RICE_K); k++)
+	{
+		unsigned long long c = riceCost(z, n, k);
+		if (c < cost) { cost = c; best_k = k; }
+	}
+	return best_k;
+}
+
+static unsigned long long residualCost(const unsigned int* z, long n)
+{
+	unsigned long long total = 0;
+	for (long g=0; g<n; g+=GROUP_SIZE)
+	{
+		unsigned long long cost;
+		chooseRiceK(z+g, (n-g < GROUP_SIZE) ? n-g : GROUP_SIZE, cost);
+		total += cost;
+	}
+	return total;
+}
+
+// ---------------- bit streams ----------------
+
+class BitWriter
+{
+public:
+	BitWriter(vector<unsigned char>& _out) : out(_out), acc(0), nbits(0) { }
+	// n <= 32
+	void put(unsigned int v, int n)
+	{
+		if (n == 0) return;
+		acc |= ((unsigned long long)(v & (0xffffffffu >> (32-n)))) << nbits;
+		nbits += n;
+		while (nbits >= 8) { out.push_back((unsigned char)acc); acc >>= 8; nbits -= 8; }
+	}
+	void flush() { if (nbits > 0) out.push_back((unsigned char)acc); acc = 0; nbits = 0; }
+private:
+	vector<unsigned char>& out;
+	unsigned long long acc;
+	int nbits;
+};
+
+static inline unsigned int countTrailingOnes(unsigned long long v)
+{
+	v = ~v;
+	if (v == 0) return 64;
+#if defined(__GNUC__)
+	return (unsigned int)__builtin_ctzll(v);
+#else
+	unsigned int n = 0;
+	while ((v & 0xff) == 0) { v >>= 8; n += 8; }
+	while ((v & 1) == 0) { v >>= 1; n++; }
+	return n;
+#endif
+}
+
+class BitReader
+{
+public:
+	BitReader(const unsigned char* _data, long _size) : data(_data), size(_size), pos(0), acc(0), nbits(0), failed(false) { }
+	bool good() { return !failed; }
+	// n <= 32
+	unsigned int get(int n)
+	{
+		if (n == 0) return 0;
+		refill();
+		if (nbits < n) { failed = true; return 0; }
+		unsigned int v = (unsigned int)(acc & (0xffffffffull >> (32-n)));
+		acc >>= n;
+		nbits -= n;
+		return v;
+	}
+	// count 1 bits up to a 0 bit, stopping at limit (limit < 32)
+	unsigned int unary(unsigned int limit)
+	{
+		if (nbits <= int(limit)) refill();
+		unsigned int q = countTrailingOnes(acc);
+		if (q >= limit) q = limit;
+		else if (int(q) >= nbits) { failed = true; return 0; }
+		int used = (q == limit) ? int(q) : int(q)+1;	// the 0 bit is consumed too
+		if (used > nbits) { failed = true; return 0; }
+		acc >>= used;
+		nbits -= used;
+		return q;
+	}
+private:
+	const unsigned char* data;
+	long size;
+	long pos;
+	unsigned long long acc;
+	int nbits;
+	bool failed;
+	void refill()
+	{
+		while ((nbits <= 56) && (pos < size))
+		{
+			acc |= ((unsigned long long)data[pos++]) << nbits;
+			nbits += 8;
+		}
+	}
+};
+
+// ---------------- chunk coding ----------------
+
+static void encodeChunk(const float* values, long n, vector<unsigned char>& out)
+{
+	vector<unsigned int> bits(n);
+	for (long i=0; i<n; i++) bits[i] = floatBits(values[i]);
+
+	// pick the predictor that codes this chunk smallest
+	vector<unsigned int> residuals(n > 1 ? n-1 : 1);
+	vector<unsigned int> best_residuals;
+	int best_predictor = PRED_XOR;
+	unsigned long long best_cost = 0;
+	for (int p=0; p<NUM_PREDICTORS; p++)
+	{
+		computeResiduals(p, &bits[0], n, &residuals[0]);
+		unsigned long long cost = residualCost(&residuals[0], n-1);
+		if ((p == 0) || (cost < best_cost))
+		{
+			best_cost = cost;
+			best_predictor = p;
+			best_residuals = residuals;
+		}
+	}
+
+	out.push_back((unsigned char)best_predictor);
+	BitWriter w(out);
+	w.put(bits[0], 32);
+	for (long g=0; g<n-1; g+=GROUP_SIZE)
+	{
+		long gn = (n-1-g < GROUP_SIZE) ? n-1-g : GROUP_SIZE;
+		const unsigned int* z = &best_residuals[g];
+		unsigned long long cost;
+		unsigned int k = chooseRiceK(z, gn, cost);
+		w.put(k, 5);
+		if (k == ZERO_GROUP) continue;
+		for (long i=0; i<gn; i++)
+		{
+			unsigned int q = z[i] >> k;
+			if (q >= ESCAPE_QUOTIENT)
+			{
+				w.put((1u << ESCAPE_QUOTIENT)-1, ESCAPE_QUOTIENT);
+				w.put(z[i], 32);
+			}
+			else
+			{
+				w.put((1u << q)-1, q+1);	// q ones, then a zero
+				w.put(z[i], k);
+			}
+		}
+	}
+	w.flush();
+}
+
+bool CompressedChannels::decodeChunkBytes(const unsigned char* bytes, long size, long count, float* dest)
+{
+	if ((size < 1) || (count < 1)) return false;
+	int predictor = bytes[0];
+	if (predictor >= NUM_PREDICTORS) return false;
+	BitReader r(bytes+1, size-1);
+	vector<unsigned int> bits(count);
+	bits[0] = r.get(32);
+	for (long g=1; g<count; g+=GROUP_SIZE)
+	{
+		long gn = (count-g < GROUP_SIZE) ? count-g : GROUP_SIZE;
+		unsigned int k = r.get(5);
+		for (long i=g; i<g+gn; i++)
+		{
+			unsigned int z = 0;
+			if (k != ZERO_GROUP)
+			{
+				unsigned int q = r.unary(ESCAPE_QUOTIENT);
+				if (q >= ESCAPE_QUOTIENT) z = r.get(32);
+				else z = (q << k) | r.get(int(k));
+			}
+			applyResidual(predictor, &bits[0], i, z);
+		}
+		if (!r.good()) return false;
+	}
+	if (!r.good()) return false;
+	for (long i=0; i<count; i++) dest[i] = bitsFloat(bits[i]);
+	return true;
+}
+
+//==========================================================================
+// encoder
+
+bool CompressedChannels::encode(const float* data, long num_frames, long num_channels,
+	vector<unsigned char>& out, long chunk_frames, int max_threads)
+{
+	if ((num_frames < 0) || (num_channels < 0) || (chunk_frames < 1)) return false;
+	if ((num_frames > 0xffffffffL) || (num_channels > 0xffffffffL) || (chunk_frames > 0xffffffffL)) return false;
+	long num_chunks = (num_frames + chunk_frames - 1) / chunk_frames;
+	long total = num_channels * num_chunks;
+
+	vector< vector<unsigned char> > chunks(total);
+	parallelFor(0, total, [&](long i) {
+		long c = i / num_chunks;
+		long k = i % num_chunks;
+		long first = k*chunk_frames;
+		long n = (num_frames-first < chunk_frames) ? num_frames-first : chunk_frames;
+		encodeChunk(data + c*num_frames + first, n, chunks[i]);
+	}, 8, max_threads);
+
+	ByteWriter w;
+	w.putBytes(SKCC_MAGIC, 4);
+	w.putU32(SKCC_VERSION);
+	w.putU32((unsigned int)num_channels);
+	w.putU32((unsigned int)num_frames);
+	w.putU32((unsigned int)chunk_frames);
+	w.putU32(0);
+	unsigned long long offset = SKCC_HEADER_SIZE + 8*(unsigned long long)(total+1);
+	for (long i=0; i<total; i++)
+	{
+		w.putU64(offset);
+		offset += chunks[i].size();
+	}
+	w.putU64(offset);
+
+	out.swap(w.bytes);
+	out.reserve(size_t(offset));
+	for (long i=0; i<total; i++) out.insert(out.end(), chunks[i].begin(), chunks[i].end());
+	return true;
+}
+
+//==========================================================================
+// reader
+
+CompressedChannels::CompressedChannels()
+	: block(NULL), block_size(0), num_channels(0), num_frames(0),
+	chunk_frames(0), num_chunks(0), data_start(0)
+{ }
+
+long CompressedChannels::tableSize(const unsigned char* block, long available)
+{
+	if (available < SKCC_HEADER_SIZE) return 0;
+	ByteReader r(block, available);
+	const unsigned char* magic = r.getBytes(4);
+	unsigned int version = r.getU32();
+	unsigned long long channels = r.getU32();
+	unsigned long long frames = r.getU32();
+	unsigned long long chunk = r.getU32();
+	if ((memcmp(magic, SKCC_MAGIC, 4) != 0) || (version != SKCC_VERSION) || (chunk == 0)) return 0;
+	unsigned long long chunks = (frames + chunk - 1) / chunk;
+	return long(SKCC_HEADER_SIZE + 8*(channels*chunks+1));
+}
+
+bool CompressedChannels::attach(const unsigned char* _block, long _size, bool table_only)
+{
+	block = NULL;
+	long table = tableSize(_block, _size);
+	if ((table == 0) || (table > _size)) return false;
+	ByteReader r(_block+8, _size-8);
+	num_channels = long(r.getU32());
+	num_frames = long(r.getU32());
+	chunk_frames = long(r.getU32());
+	num_chunks = (num_frames + chunk_frames - 1) / chunk_frames;
+	data_start = table;
+	block = _block;
+	block_size = _size;
+	// the last offset marks the end of the data
+	if (table_only) block_size = table;
+	else if (tableEntry(num_channels*num_chunks) > (unsigned long long)_size) { block = NULL; return false; }
+	return true;
+}
+
+unsigned long long CompressedChannels::tableEntry(long i)
+{
+	const unsigned char* p = block + SKCC_HEADER_SIZE + 8*i;
+	unsigned long long v = 0;
+	for (int b=0; b<8; b++) v |= ((unsigned long long)p[b]) << (8*b);
+	return v;
+}
+
+long CompressedChannels::chunkOffset(long channel, long chunk)
+{
+	if ((block == NULL) || (channel < 0) || (channel >= num_channels) || (chunk < 0) || (chunk >= num_chunks)) return 0;
+	return long(tableEntry(channel*num_chunks + chunk));
+}
+
+long CompressedChannels::chunkSize(long channel, long chunk)
+{
+	if ((block == NULL) || (channel < 0) || (channel >= num_channels) || (chunk < 0) || (chunk >= num_chunks)) return 0;
+	long i = channel*num_chunks + chunk;
+	return long(tableEntry(i+1) - tableEntry(i));
+}
+
+long CompressedChannels::channelSize(long channel)
+{
+	if ((block == NULL) || (channel < 0) || (channel >= num_channels) || (num_chunks == 0)) return 0;
+	return long(tableEntry((channel+1)*num_chunks) - tableEntry(channel*num_chunks));
+}
+
+bool CompressedChannels::decodeChannelBytes(long channel, const unsigned char* bytes, float* dest)
+{
+	if ((block == NULL) || (channel < 0) || (channel >= num_channels)) return false;
+	long base = channelOffset(channel);
+	for (long k=0; k<num_chunks; k++)
+	{
+		long first = k*chunk_frames;
+		long count = (num_frames-first < chunk_frames) ? num_frames-first : chunk_frames;
+		long offset = chunkOffset(channel, k) - base;
+		long size = chunkSize(channel, k);
+		if ((offset < 0) || (size <= 0) || (offset + size > channelSize(channel))) return false;
+		if (!decodeChunkBytes(bytes+offset, size, count, dest+first)) return false;
+	}
+	return true;
+}
+
+bool CompressedChannels::decodeChunk(long channel, long chunk, float* dest)
+{
+	long offset = chunkOffset(channel, chunk);
+	long size = chunkSize(channel, chunk);
+	if ((offset < data_start) || (size <= 0) || (offset + size > block_size)) return false;
+	long first = chunk*chunk_frames;
+	long count = (num_frames-first < chunk_frames) ? num_frames-first : chunk_frames;
+	return decodeChunkBytes(block+offset, size, count, dest);
+}
+
+bool CompressedChannels::decodeFrames(long channel, long first_frame, long count, float* dest)
+{
+	if ((block == NULL) || (first_frame < 0) || (count < 0) || (first_frame+count > num_frames)) return false;
+	if (count == 0) return true;
+	long first_chunk = first_frame / chunk_frames;
+	long last_chunk = (first_frame + count - 1) / chunk_frames;
+	vector<float> buffer(chunk_frames);
+	for (long k=first_chunk; k<=last_chunk; k++)
+	{
+		if (!decodeChunk(channel, k, &buffer[0])) return false;
+		long chunk_start = k*chunk_frames;
+		long from = (first_frame > chunk_start) ? first_frame : chunk_start;
+		long to = (first_frame+count < chunk_start+chunk_frames) ? first_frame+count : chunk_start+chunk_frames;
+		memcpy(dest + (from-first_frame), &buffer[from-chunk_start], (to-from)*sizeof(float));
+	}
+	return true;
+}
+
+bool CompressedChannels::decodeChannel(long channel, float* dest)
+{
+	if ((block == NULL) || (channel < 0) || (channel >= num_channels)) return false;
+	for (long k=0; k<num_chunks; k++)
+		if (!decodeChunk(channel, k, dest + k*chunk_frames)) return false;
+	return true;
+}
+
+bool CompressedChannels::decodeAll(float* dest, int max_threads)
+{
+	if (block == NULL) return false;
+	long total = num_channels*num_chunks;
+	vector<char> ok(total, 0);
+	parallelFor(0, total, [&](long i) {
+		long c = i / num_chunks;
+		long k = i % num_chunks;
+		ok[i] = decodeChunk(c, k, dest + c*num_frames + k*chunk_frames) ? 1 : 0;
+	}, 8, max_threads);
+	for (long i=0; i<total; i++) if (!ok[i]) return false;
+	return true;
+}
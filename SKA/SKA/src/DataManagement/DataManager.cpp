@@ -25,8 +25,10 @@ using namespace std;
 #include <DataManagement/ASF_Writer.h>
 #include <DataManagement/AMC_Writer.h>
 #include <DataManagement/BVH_Reader.h>
+#include <DataManagement/BVH_Writer.h>
 #include <DataManagement/SKS_ReaderWriter.h>
 #include <DataManagement/SKM_ReaderWriter.h>
+#include <DataManagement/MotionLibrary.h>
 #include <DataManagement/FileSystem.h>
 #include <Core/Utilities.h>
 #include <Core/SystemTimer.h>
@@ -35,6 +37,7 @@ using namespace std;
 
 struct DataManagerData {
 	vector<string> paths;
+	MotionLibrary library;
 };
 
 DataManager data_manager;
@@ -73,7 +76,7 @@ char* DataManager::findFile(const char* _file)
 //---------- ASF/AMC file management -------------------
 
 pair<Skeleton*, MotionSequence*> DataManager::readASFAMC(
-	const char* _asf_file, const char* _amc_file)
+	const char* _asf_file, const char* _amc_file, ChannelSelection* _selection)
 {
 	Skeleton* skel = NULL;
 	MotionSequence* ms = NULL;
@@ -81,7 +84,7 @@ pair<Skeleton*, MotionSequence*> DataManager::readASFAMC(
 	if (skel != NULL)
 	{
 		try {
-			ms = readAMC(skel, _amc_file);
+			ms = readAMC(skel, _amc_file, _selection);
 		}
 		catch (const DataManagementException& dme)
 		{
@@ -114,7 +117,7 @@ Skeleton* DataManager::readASF(const char* _asf_file)
 }
 
 MotionSequence* DataManager::readAMC(
-	Skeleton* _skel, const char* _amc_file)
+	Skeleton* _skel, const char* _amc_file, ChannelSelection* _selection)
 {
 	if (_skel == NULL) 
 	{
@@ -130,7 +133,7 @@ MotionSequence* DataManager::readAMC(
 	}
 
 	AMC_Reader amc_reader;
-	MotionSequence* ms  = amc_reader.readAMC(_amc_file, _skel);
+	MotionSequence* ms  = amc_reader.readAMC(_amc_file, _skel, _selection);
 
 	if (ms == NULL) 
 	{
@@ -177,7 +180,7 @@ void DataManager::writeAMC(
 //---------- BVH file management -------------------
 
 pair<Skeleton*, MotionSequence*> DataManager::readBVH(
-		const char* _bvh_file)
+		const char* _bvh_file, ChannelSelection* _selection)
 {
 	pair<Skeleton*, MotionSequence*> result;
 	result.first = NULL;
@@ -189,7 +192,7 @@ pair<Skeleton*, MotionSequence*> DataManager::readBVH(
 		throw DataManagementException(err.c_str());
 	}
 	BVH_Reader bvh_reader;
-	result = bvh_reader.readBVH(_bvh_file);
+	result = bvh_reader.readBVH(_bvh_file, _selection);
 	if ((result.first == NULL) || (result.second == NULL))
 	{
 		if (result.first != NULL) delete result.first;
@@ -206,15 +209,19 @@ pair<Skeleton*, MotionSequence*> DataManager::readBVH(
 void DataManager::writeBVH(
 	Skeleton* _skel, MotionSequence* _ms, const char* _bvh_file)
 {
-	string err = string("DataManager::writeBVH: Could not write BVH file ") + _bvh_file + " (function not yet available).";
-	logout << err << endl;
-	throw DataManagementException(err.c_str());
+	BVH_Writer bvh_writer;
+	if (!bvh_writer.writeBVH(_bvh_file, _skel, _ms))
+	{
+		string err = string("DataManager::writeBVH: Could not write BVH file ") + _bvh_file + " (write failure).";
+		logout << err << endl;
+		throw DataManagementException(err.c_str());
+	}
 }
 
 //---------- SKS/SKM file management -------------------
 
 pair<Skeleton*, MotionSequence*> DataManager::readSKSSKM(
-	const char* _sks_file, const char* _skm_file)
+	const char* _sks_file, const char* _skm_file, ChannelSelection* _selection)
 {
 	Skeleton* skel = NULL;
 	MotionSequence* ms = NULL;
@@ -222,7 +229,7 @@ pair<Skeleton*, MotionSequence*> DataManager::readSKSSKM(
 	if (skel != NULL)
 	{
 		try {
-			ms = readSKM(skel, _skm_file);
+			ms = readSKM(skel, _skm_file, _selection);
 		}
 		catch (const DataManagementException& dme)
 		{
@@ -254,7 +261,7 @@ Skeleton* DataManager::readSKS(const char* _sks_file)
 }
 
 MotionSequence* DataManager::readSKM(
-	Skeleton* _skel, const char* _skm_file)
+	Skeleton* _skel, const char* _skm_file, ChannelSelection* _selection)
 {
 	if (_skel == NULL) 
 	{
@@ -269,7 +276,7 @@ MotionSequence* DataManager::readSKM(
 		throw DataManagementException(err.c_str());
 	}
 
-	MotionSequence* ms  = SKM_ReaderWriter::readSKM(_skm_file, _skel);
+	MotionSequence* ms  = SKM_ReaderWriter::readSKM(_skm_file, _skel, _selection);
 
 	if (ms == NULL) 
 	{
@@ -282,10 +289,10 @@ MotionSequence* DataManager::readSKM(
 }
 
 void DataManager::writeSKSSKM(
-	Skeleton* _skel, MotionSequence* _ms, const char* _sks_file, const char* _skm_file)
+	Skeleton* _skel, MotionSequence* _ms, const char* _sks_file, const char* _skm_file, bool _compress)
 {
 	writeSKS(_skel, _sks_file);
-	writeSKM(_skel, _ms, _skm_file);
+	writeSKM(_skel, _ms, _skm_file, _compress);
 }
 
 void DataManager::writeSKS(
@@ -300,9 +307,9 @@ void DataManager::writeSKS(
 }
 
 void DataManager::writeSKM(
-	Skeleton* _skel, MotionSequence* _ms, const char* _skm_file)
+	Skeleton* _skel, MotionSequence* _ms, const char* _skm_file, bool _compress)
 {
-	if (!SKM_ReaderWriter::writeSKM(_skm_file, _skel, _ms))
+	if (!SKM_ReaderWriter::writeSKM(_skm_file, _skel, _ms, true, _compress))
 	{
 		string err = string("DataManager::writeAMC: Could not write AMC file ") + _skm_file + " (write failure).";
 		logout << err << endl;
@@ -310,6 +317,71 @@ void DataManager::writeSKM(
 	}
 }
 
+//---------- Motion library (SKL) management -------------------
+
+void DataManager::openMotionLibrary(
+	const char* _skl_file, bool _use_mmap)
+{
+	if (!FileSystem::fileExists(_skl_file)) 
+	{
+		string err = string("DataManager::openMotionLibrary: Could not open motion library ") + _skl_file + " (file not found).";
+		logout << err << endl;
+		throw DataManagementException(err.c_str());
+	}
+	if (!data->library.open(_skl_file, _use_mmap))
+	{
+		string err = string("DataManager::openMotionLibrary: Could not open motion library ") + _skl_file + " (read failure).";
+		logout << err << endl;
+		throw DataManagementException(err.c_str());
+	}
+}
+
+void DataManager::closeMotionLibrary()
+{
+	data->library.close();
+}
+
+long DataManager::numLibraryClips()
+{
+	return data->library.numClips();
+}
+
+const char* DataManager::libraryClipName(long _index)
+{
+	return data->library.clipName(_index);
+}
+
+pair<Skeleton*, MotionSequence*> DataManager::readLibraryClip(
+	const char* _clip_name, ChannelSelection* _selection)
+{
+	if (!data->library.isOpen()) 
+	{
+		string err = string("DataManager::readLibraryClip: Could not read clip ") + _clip_name + " (no motion library open).";
+		logout << err << endl;
+		throw DataManagementException(err.c_str());
+	}
+	long clip = data->library.findClip(_clip_name);
+	if (clip < 0) 
+	{
+		string err = string("DataManager::readLibraryClip: Could not read clip ") + _clip_name + " (clip not found).";
+		logout << err << endl;
+		throw DataManagementException(err.c_str());
+	}
+	pair<Skeleton*, MotionSequence*> result = data->library.loadClip(clip, _selection);
+	if ((result.first == NULL) || (result.second == NULL))
+	{
+		string err = string("DataManager::readLibraryClip: Could not read clip ") + _clip_name + " (read failure).";
+		logout << err << endl;
+		throw DataManagementException(err.c_str());
+	}
+	return result;
+}
+
+MotionLibrary* DataManager::getMotionLibrary()
+{
+	return &data->library;
+}
+
 //---------- Format Conversion Utilities -------------------
 
 void DataManager::openAllEulerChannels(
@@ -22,6 +22,7 @@ using namespace std;
 #include <DataManagement/FileSystem.h>
 
 #ifdef _WIN32
+#include <windows.h>
 
 char* FileSystem::backslashFilepath(char* path)
 {
@@ -99,7 +100,26 @@ bool FileSystem::fileExists(const char* path)
 	return false;
 }
 
+bool FileSystem::listDirectory(const char* path, list<string>& files, list<string>& subdirs)
+{
+	string pattern = string(path) + "\\*";
+	backslashFilepath(pattern);
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA(pattern.c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE) return false;
+	do
+	{
+		string name = fd.cFileName;
+		if ((name == ".") || (name == "..")) continue;
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) subdirs.push_back(name);
+		else files.push_back(name);
+	} while (FindNextFileA(h, &fd));
+	FindClose(h);
+	return true;
+}
+
 #else
+#include <dirent.h>
 
 bool FileSystem::makeDir(const char* path)
 {
@@ -127,4 +147,24 @@ bool FileSystem::fileExists(const char* path)
 	return false;
 }
 
+bool FileSystem::listDirectory(const char* path, list<string>& files, list<string>& subdirs)
+{
+	DIR* dir = opendir(path);
+	if (dir == NULL) return false;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		string name = entry->d_name;
+		if ((name == ".") || (name == "..")) continue;
+		// d_type is not filled in by all file systems
+		string full = string(path) + "/" + name;
+		struct stat st;
+		if (stat(full.c_str(), &st) != 0) continue;
+		if (S_ISDIR(st.st_mode)) subdirs.push_back(name);
+		else if (S_ISREG(st.st_mode)) files.push_back(name);
+	}
+	closedir(dir);
+	return true;
+}
+
 #endif
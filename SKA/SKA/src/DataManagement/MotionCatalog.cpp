@@ -0,0 +1,498 @@
+//-----------------------------------------------------------------------------
+// MotionCatalog.cpp
+//	 Index of the motion files found in a set of directory trees.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <list>
+using namespace std;
+#include <Core/Parallel.h>
+#include <DataManagement/MotionCatalog.h>
+#include <DataManagement/MotionLibrary.h>
+#include <DataManagement/FileSystem.h>
+#include <DataManagement/BinaryStream.h>
+
+/*==========================================================================
+Catalog file layout (all values little-endian)
+   char[8]  magic "SKACATL"
+   u32      version
+   u32      number of entries
+   entries: name, path, format, clip, skeleton id, skeleton file (strings),
+            u32 frames, f32 frame rate, u16 bones, u16 channels, u64 file size
+==========================================================================*/
+
+static const char CATALOG_MAGIC[8] = { 'S','K','A','C','A','T','L','\0' };
+static const unsigned int CATALOG_VERSION = 1;
+
+struct MotionCatalogData
+{
+	vector<MotionCatalogEntry> entries;
+};
+
+// ---------------- small helpers ----------------
+
+static string lowerExtension(const string& name)
+{
+	size_t dot = name.rfind('.');
+	size_t slash = name.find_last_of("/\\");
+	if ((dot == string::npos) || ((slash != string::npos) && (dot < slash))) return string("");
+	string ext = name.substr(dot+1);
+	for (unsigned int i=0; i<ext.size(); i++) ext[i] = char(tolower(ext[i]));
+	return ext;
+}
+
+static string stripExtension(const string& name)
+{
+	size_t dot = name.rfind('.');
+	size_t slash = name.find_last_of("/\\");
+	if ((dot == string::npos) || ((slash != string::npos) && (dot < slash))) return name;
+	return name.substr(0, dot);
+}
+
+static string directoryOf(const string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	if (slash == string::npos) return string(".");
+	return path.substr(0, slash);
+}
+
+static string fileOf(const string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	if (slash == string::npos) return path;
+	return path.substr(slash+1);
+}
+
+static string trim(const string& s)
+{
+	size_t b = s.find_first_not_of(" \t\r\n");
+	if (b == string::npos) return string("");
+	size_t e = s.find_last_not_of(" \t\r\n");
+	return s.substr(b, e-b+1);
+}
+
+static bool isSingleInteger(const string& s)
+{
+	string t = trim(s);
+	if (t.size() == 0) return false;
+	for (unsigned int i=0; i<t.size(); i++) if (!isdigit((unsigned char)t[i])) return false;
+	return true;
+}
+
+static unsigned long long fileSize(const string& path)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (fp == NULL) return 0;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fclose(fp);
+	return (size > 0) ? (unsigned long long)size : 0;
+}
+
+static bool isMotionExtension(const string& ext)
+{
+	return (ext == "bvh") || (ext == "amc") || (ext == "asf") || (ext == "skm") || (ext == "skl");
+}
+
+// The skeleton for an AMC file: "02_01.amc" -> "02.asf", else the only ASF in the directory.
+static string pairedASF(const string& amc_path)
+{
+	string dir = directoryOf(amc_path);
+	list<string> files, subdirs;
+	if (!FileSystem::listDirectory(dir.c_str(), files, subdirs)) return string("");
+	string amc_name = fileOf(amc_path);
+	string prefix = amc_name.substr(0, amc_name.find('_'));
+	string only;
+	int count = 0;
+	list<string>::iterator iter;
+	for (iter=files.begin(); iter!=files.end(); iter++)
+	{
+		if (lowerExtension(*iter) != "asf") continue;
+		if (stripExtension(*iter) == prefix) return dir + "/" + *iter;
+		only = *iter;
+		count++;
+	}
+	if (count == 1) return dir + "/" + only;
+	return string("");
+}
+
+// ---------------- header readers ----------------
+
+// HIERARCHY section and the two MOTION header lines. The frame data is not read.
+static bool readBVHHeader(const string& path, MotionCatalogEntry& e)
+{
+	ifstream in(path.c_str());
+	if (!in) return false;
+	string line, root_name;
+	string signature;
+	bool have_frames = false;
+	while (getline(in, line))
+	{
+		istringstream tokens(line);
+		string word;
+		if (!(tokens >> word)) continue;
+		if ((word == "ROOT") || (word == "JOINT"))
+		{
+			string name;
+			tokens >> name;
+			if (word == "ROOT") root_name = name;
+			signature += name + "/";
+			e.bones++;
+		}
+		else if (word == "CHANNELS")
+		{
+			int n = 0;
+			tokens >> n;
+			e.channels += short(n);
+			string label;
+			while (tokens >> label) signature += label.substr(0, 2);
+		}
+		else if (word == "Frames:")
+		{
+			tokens >> e.frames;
+			have_frames = true;
+		}
+		else if (word == "Frame")
+		{
+			string time_word;
+			float frame_time = 0.0f;
+			tokens >> time_word >> frame_time;
+			if (frame_time > 0.0f) e.frame_rate = 1.0f/frame_time;
+			break;
+		}
+	}
+	if (!have_frames) return false;
+	// Skeletons with the same joint names, hierarchy order and channels share an id.
+	unsigned int hash = 2166136261u;
+	for (unsigned int i=0; i<signature.size(); i++) { hash ^= (unsigned char)signature[i]; hash *= 16777619u; }
+	char id[128];
+	sprintf(id, "BVH:%.64s:%d:%08x", root_name.c_str(), int(e.bones), hash);
+	e.skeleton_id = id;
+	return true;
+}
+
+static bool readASFHeader(const string& path, MotionCatalogEntry& e)
+{
+	ifstream in(path.c_str());
+	if (!in) return false;
+	string line;
+	bool in_bonedata = false;
+	e.bones = 1;	// root
+	while (getline(in, line))
+	{
+		string t = trim(line);
+		if (t.compare(0, 5, ":name") == 0) e.skeleton_id = trim(t.substr(5));
+		else if (t.compare(0, 9, ":bonedata") == 0) in_bonedata = true;
+		else if ((t.size() > 0) && (t[0] == ':')) in_bonedata = false;
+		else if (in_bonedata && (t == "begin")) e.bones++;
+	}
+	return true;
+}
+
+// The frame count is the last frame number, found by reading the end of the file.
+static bool readAMCHeader(const string& path, MotionCatalogEntry& e)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (fp == NULL) return false;
+	e.frame_rate = 120.0f;
+
+	// header comments, up to the first frame number
+	char buffer[1024];
+	while (fgets(buffer, sizeof(buffer), fp) != NULL)
+	{
+		string line(buffer);
+		if (line.compare(0, 12, "# Framerate:") == 0)
+		{
+			float rate = float(atof(line.c_str()+12));
+			if (rate > 0.0f) e.frame_rate = rate;
+		}
+		else if (isSingleInteger(line)) break;
+	}
+
+	// search backwards from the end of the file, in growing windows
+	// (an empty file, or one ftell cannot measure, has no frames)
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	for (long window=4096; (e.frames==0) && (size>0); window*=4)
+	{
+		long start = (window < size) ? size-window : 0;
+		vector<char> tail(size-start);
+		fseek(fp, start, SEEK_SET);
+		size_t n = fread(&tail[0], 1, tail.size(), fp);
+		string text(&tail[0], n);
+		size_t end = text.size();
+		while (end > 0)
+		{
+			size_t begin = text.rfind('\n', end-1);
+			size_t line_start = (begin == string::npos) ? 0 : begin+1;
+			// a partial first line can only be trusted at the start of the file
+			if ((begin == string::npos) && (start > 0)) break;
+			string line = text.substr(line_start, end-line_start);
+			if (isSingleInteger(line)) { e.frames = atol(line.c_str()); break; }
+			if (begin == string::npos) break;
+			end = begin;
+		}
+		if (start == 0) break;
+	}
+	fclose(fp);
+
+	e.skeleton_file = pairedASF(path);
+	if (e.skeleton_file.size() > 0)
+	{
+		MotionCatalogEntry asf;
+		if (readASFHeader(e.skeleton_file, asf))
+		{
+			e.skeleton_id = asf.skeleton_id;
+			e.bones = asf.bones;
+		}
+	}
+	return true;
+}
+
+// SKM header: three big endian 32 bit integers, data mode, motion id, skeleton id
+static bool readSKMHeader(const string& path, MotionCatalogEntry& e)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (fp == NULL) return false;
+	unsigned char header[144];
+	size_t n = fread(header, 1, 144, fp);
+	fclose(fp);
+	if (n != 144) return false;
+	unsigned int v[3];
+	for (int i=0; i<3; i++)
+		v[i] = (unsigned int)(header[4*i] << 24) | (header[4*i+1] << 16) | (header[4*i+2] << 8) | header[4*i+3];
+	if (v[0] != 1) return false;
+	e.frames = long(v[1]);
+	e.channels = short(v[2]);
+	e.frame_rate = 120.0f;
+	char sid[65];
+	memcpy(sid, header+80, 64);
+	sid[64] = '\0';
+	e.skeleton_id = sid;
+	return true;
+}
+
+static void readLibraryIndex(const string& path, const string& name, vector<MotionCatalogEntry>& out)
+{
+	MotionLibrary library;
+	if (!library.open(path.c_str())) return;
+	for (long c=0; c<library.numClips(); c++)
+	{
+		MotionCatalogEntry e;
+		e.name = name + "/" + library.clipName(c);
+		e.path = path;
+		e.format = "SKL";
+		e.clip = library.clipName(c);
+		e.skeleton_id = library.clipSkeletonId(c);
+		e.frames = library.clipFrames(c);
+		e.frame_rate = library.clipFrameRate(c);
+		e.channels = library.clipNumChannels(c);
+		e.file_size = library.clipStoredSize(c);
+		out.push_back(e);
+	}
+}
+
+// entries for one file (several for a motion library, none if the file can not be read)
+static void catalogFile(const string& path, const string& name, vector<MotionCatalogEntry>& out)
+{
+	string ext = lowerExtension(path);
+	if (ext == "skl") { readLibraryIndex(path, name, out); return; }
+
+	MotionCatalogEntry e;
+	e.name = name;
+	e.path = path;
+	bool ok = false;
+	if (ext == "bvh") { e.format = "BVH"; ok = readBVHHeader(path, e); }
+	else if (ext == "amc") { e.format = "AMC"; ok = readAMCHeader(path, e); }
+	else if (ext == "asf") { e.format = "ASF"; ok = readASFHeader(path, e); }
+	else if (ext == "skm") { e.format = "SKM"; ok = readSKMHeader(path, e); }
+	if (!ok) return;
+	e.file_size = fileSize(path);
+	out.push_back(e);
+}
+
+struct CatalogJob
+{
+	string path;
+	string name;
+};
+
+static void collectFiles(const string& dir, const string& prefix, vector<CatalogJob>& jobs)
+{
+	list<string> files, subdirs;
+	if (!FileSystem::listDirectory(dir.c_str(), files, subdirs)) return;
+	files.sort();
+	subdirs.sort();
+	list<string>::iterator iter;
+	for (iter=files.begin(); iter!=files.end(); iter++)
+	{
+		if (!isMotionExtension(lowerExtension(*iter))) continue;
+		CatalogJob job;
+		job.path = dir + "/" + *iter;
+		job.name = prefix + stripExtension(*iter);
+		jobs.push_back(job);
+	}
+	for (iter=subdirs.begin(); iter!=subdirs.end(); iter++)
+		collectFiles(dir + "/" + *iter, prefix + *iter + "/", jobs);
+}
+
+//==========================================================================
+
+MotionCatalog::MotionCatalog()
+{
+	data = new MotionCatalogData;
+}
+
+MotionCatalog::~MotionCatalog()
+{
+	delete data;
+}
+
+void MotionCatalog::clear() { data->entries.clear(); }
+long MotionCatalog::numEntries() { return long(data->entries.size()); }
+MotionCatalogEntry& MotionCatalog::entry(long index) { return data->entries[index]; }
+
+long MotionCatalog::scan(const char* directory, int max_threads)
+{
+	string dir(directory);
+	while ((dir.size() > 1) && ((dir[dir.size()-1] == '/') || (dir[dir.size()-1] == '\\')))
+		dir.erase(dir.size()-1);
+	vector<CatalogJob> jobs;
+	collectFiles(dir, fileOf(dir) + "/", jobs);
+
+	// headers are read in parallel, results are kept in scan order
+	vector< vector<MotionCatalogEntry> > results(jobs.size());
+	parallelFor(0, long(jobs.size()), [&](long i) {
+		catalogFile(jobs[i].path, jobs[i].name, results[i]);
+	}, 4, max_threads);
+
+	long added = 0;
+	for (unsigned int i=0; i<results.size(); i++)
+	{
+		data->entries.insert(data->entries.end(), results[i].begin(), results[i].end());
+		added += long(results[i].size());
+	}
+	return added;
+}
+
+bool MotionCatalog::addFile(const char* path, const char* name)
+{
+	vector<MotionCatalogEntry> result;
+	catalogFile(string(path), string(name), result);
+	data->entries.insert(data->entries.end(), result.begin(), result.end());
+	return result.size() > 0;
+}
+
+bool MotionCatalog::save(const char* filename)
+{
+	ByteWriter w;
+	w.putBytes(CATALOG_MAGIC, 8);
+	w.putU32(CATALOG_VERSION);
+	w.putU32((unsigned int)data->entries.size());
+	for (unsigned int i=0; i<data->entries.size(); i++)
+	{
+		MotionCatalogEntry& e = data->entries[i];
+		w.putString(e.name);
+		w.putString(e.path);
+		w.putString(e.format);
+		w.putString(e.clip);
+		w.putString(e.skeleton_id);
+		w.putString(e.skeleton_file);
+		w.putU32((unsigned int)e.frames);
+		w.putF32(e.frame_rate);
+		w.putU16((unsigned short)e.bones);
+		w.putU16((unsigned short)e.channels);
+		w.putU64(e.file_size);
+	}
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL) return false;
+	bool ok = (fwrite(&w.bytes[0], 1, w.bytes.size(), fp) == w.bytes.size());
+	if (fclose(fp) != 0) ok = false;
+	return ok;
+}
+
+bool MotionCatalog::load(const char* filename)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) return false;
+	vector<unsigned char> bytes;
+	unsigned char buffer[1<<16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer+n);
+	fclose(fp);
+	if (bytes.size() < 16) return false;
+
+	ByteReader r(&bytes[0], long(bytes.size()));
+	if ((memcmp(r.getBytes(8), CATALOG_MAGIC, 8) != 0) || (r.getU32() != CATALOG_VERSION)) return false;
+	unsigned int count = r.getU32();
+	vector<MotionCatalogEntry> entries;
+	for (unsigned int i=0; (i<count) && r.good(); i++)
+	{
+		MotionCatalogEntry e;
+		e.name = r.getString();
+		e.path = r.getString();
+		e.format = r.getString();
+		e.clip = r.getString();
+		e.skeleton_id = r.getString();
+		e.skeleton_file = r.getString();
+		e.frames = long(r.getU32());
+		e.frame_rate = r.getF32();
+		e.bones = short(r.getU16());
+		e.channels = short(r.getU16());
+		e.file_size = r.getU64();
+		entries.push_back(e);
+	}
+	if (!r.good()) return false;
+	data->entries.swap(entries);
+	return true;
+}
+
+bool MotionCatalog::matchPattern(const char* pattern, const char* text)
+{
+	// iterative wildcard match, backtracking to the most recent '*'
+	const char* star = NULL;
+	const char* resume = NULL;
+	while (*text != '\0')
+	{
+		if ((*pattern == '?') || (*pattern == *text)) { pattern++; text++; }
+		else if (*pattern == '*') { star = pattern++; resume = text; }
+		else if (star != NULL) { pattern = star+1; text = ++resume; }
+		else return false;
+	}
+	while (*pattern == '*') pattern++;
+	return *pattern == '\0';
+}
+
+long MotionCatalog::query(MotionCatalogQuery& q, vector<long>& results)
+{
+	results.clear();
+	for (unsigned int i=0; i<data->entries.size(); i++)
+	{
+		MotionCatalogEntry& e = data->entries[i];
+		if ((q.format.size() > 0) && (q.format != e.format)) continue;
+		if ((q.name_pattern.size() > 0) && !matchPattern(q.name_pattern.c_str(), e.name.c_str())) continue;
+		if ((q.skeleton_pattern.size() > 0) && !matchPattern(q.skeleton_pattern.c_str(), e.skeleton_id.c_str())) continue;
+		if ((q.min_duration >= 0.0f) && (e.duration() < q.min_duration)) continue;
+		if ((q.max_duration >= 0.0f) && (e.duration() > q.max_duration)) continue;
+		results.push_back(long(i));
+	}
+	return long(results.size());
+}
@@ -0,0 +1,813 @@
+//-----------------------------------------------------------------------------
+// MotionLibrary.cpp
+//	 Single-file library of many motion clips (SKL files).
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#if ENABLE_THREADS==1
+#include <mutex>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+#include <Core/SystemLog.h>
+#include <Core/Array2D.h>
+#include <DataManagement/MotionLibrary.h>
+#include <DataManagement/BinaryStream.h>
+#include <DataManagement/CompressedChannels.h>
+#include <DataManagement/ChannelSelection.h>
+#include <Animation/Skeleton.h>
+#include <Animation/MotionSequence.h>
+
+/*==========================================================================
+SKL file layout (all values little-endian)
+
+  header (64 bytes)
+     0  char[8]  magic "SKAMLIB"
+     8  u32      version
+    12  u32      header size (64)
+    16  u32      number of skeletons
+    20  u32      number of clips
+    24  u64      index offset
+    32  u64      index size
+    40  u64      payload offset
+    48  u32      payload alignment
+    52  12 bytes reserved
+  index
+     skeleton records (see writeSkeletonRecord)
+     clip records (see writeClipRecord)
+  payloads
+     one per clip, each starting on a payload alignment boundary.
+     encoding 0: float32, column-major (all frames of channel 0, then channel 1, ...)
+     encoding 1: a CompressedChannels block holding the same values
+==========================================================================*/
+
+static const char SKL_MAGIC[8] = { 'S','K','A','M','L','I','B','\0' };
+static const unsigned int SKL_VERSION = 1;
+static const unsigned int SKL_HEADER_SIZE = 64;
+static const unsigned int SKL_ALIGNMENT = 64;
+static const unsigned int SKL_ENCODING_RAW = 0;
+static const unsigned int SKL_ENCODING_CHUNKED = 1;
+
+// 64 bit file positioning
+static int seek64(FILE* fp, unsigned long long offset)
+{
+#ifdef _MSC_VER
+	return _fseeki64(fp, (__int64)offset, SEEK_SET);
+#else
+	return fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+}
+
+// size of an open file, or -1 on failure; leaves the position at the end
+static long long fileSize64(FILE* fp)
+{
+#ifdef _MSC_VER
+	if (_fseeki64(fp, 0, SEEK_END) != 0) return -1;
+	return (long long)_ftelli64(fp);
+#else
+	if (fseeko(fp, 0, SEEK_END) != 0) return -1;
+	return (long long)ftello(fp);
+#endif
+}
+
+struct SKL_ClipEntry
+{
+	string name;
+	string source;
+	unsigned int skeleton_index;
+	unsigned int frames;
+	float frame_rate;
+	vector<CHANNEL_ID> channels;
+	unsigned int encoding;
+	unsigned long long payload_offset;
+	unsigned long long payload_size;
+};
+
+struct SKL_SkeletonEntry
+{
+	string id;
+	vector<unsigned char> record;
+};
+
+// ---------------- skeleton records ----------------
+
+static void writeSkeletonRecord(ByteWriter& w, Skeleton* skel)
+{
+	w.putString(skel->getId());
+	w.putString(skel->getSource());
+	Vector3D p = skel->getRootPosition();
+	Vector3D o = skel->getRootOrientation();
+	w.putF32(p.x); w.putF32(p.y); w.putF32(p.z);
+	w.putF32(o.pitch); w.putF32(o.yaw); w.putF32(o.roll);
+	w.putU16((unsigned short)skel->numBones());
+	for (short b=0; b<skel->numBones(); b++)
+	{
+		Bone* bone = skel->getBone(b);
+		w.putString(bone->getName());
+		w.putI16(skel->getParentBoneId(b));
+		w.putF32(bone->getLength());
+		Vector3D dir = bone->getDirection();
+		w.putF32(dir.x); w.putF32(dir.y); w.putF32(dir.z);
+		Vector3D axis = bone->getAxis();
+		w.putF32(axis.x); w.putF32(axis.y); w.putF32(axis.z);
+		for (short d=0; d<3; d++) w.putU8((unsigned char)bone->getAxisOrder(d));
+		for (short d=0; d<6; d++) w.putU8((unsigned char)bone->getChannelOrder(d));
+		for (short c=0; c<6; c++)
+		{
+			w.putU8(bone->isValidChannel(c) ? 1 : 0);
+			w.putF32(bone->getChannelLowerLimit(c));
+			w.putF32(bone->getChannelUpperLimit(c));
+		}
+	}
+}
+
+static Skeleton* readSkeletonRecord(ByteReader& r)
+{
+	string id = r.getString();
+	string source = r.getString();
+	float px = r.getF32(), py = r.getF32(), pz = r.getF32();
+	float ox = r.getF32(), oy = r.getF32(), oz = r.getF32();
+	unsigned short num_bones = r.getU16();
+	if (!r.good()) return NULL;
+
+	Skeleton* skel = new Skeleton(id.c_str());
+	skel->setSource(source.c_str());
+	skel->setRootPosition(px, py, pz);
+	skel->setRootOrientation(ox, oy, oz);
+	vector<string> names(num_bones);
+	vector<short> parents(num_bones);
+	for (short b=0; b<short(num_bones); b++)
+	{
+		names[b] = r.getString();
+		parents[b] = r.getI16();
+		float length = r.getF32();
+		float dx = r.getF32(), dy = r.getF32(), dz = r.getF32();
+		Vector3D axis;
+		axis.x = r.getF32(); axis.y = r.getF32(); axis.z = r.getF32();
+		CHANNEL_TYPE axis_order[3];
+		for (short d=0; d<3; d++) axis_order[d] = CHANNEL_TYPE(r.getU8());
+		CHANNEL_TYPE channel_order[6];
+		short num_channels = 0;
+		for (short d=0; d<6; d++)
+		{
+			channel_order[d] = CHANNEL_TYPE(r.getU8());
+			if (channel_order[d] != CT_INVALID) num_channels = d+1;
+		}
+		if (!r.good()) { delete skel; return NULL; }
+
+		skel->createBone(b, names[b].c_str());
+		skel->setBoneLength(b, length);
+		skel->setBoneDirection(b, dx, dy, dz);
+		Bone* bone = skel->getBone(b);
+		for (short d=0; d<3; d++) bone->setAxisOrder(axis_order[d], d);
+		bone->setAxis(axis);
+		skel->setBoneChannels(b, channel_order, num_channels);
+		for (short c=0; c<6; c++)
+		{
+			bone->setValidChannel(c, r.getU8() != 0);
+			bone->setChannelLowerLimit(c, r.getF32());
+			bone->setChannelUpperLimit(c, r.getF32());
+		}
+	}
+	if (!r.good()) { delete skel; return NULL; }
+	for (short b=0; b<short(num_bones); b++)
+		if ((parents[b] >= 0) && (parents[b] < short(num_bones)))
+			skel->addConnection(names[parents[b]].c_str(), names[b].c_str());
+	skel->finalizeInitialization();
+	return skel;
+}
+
+// ---------------- clip records ----------------
+
+static void writeClipRecord(ByteWriter& w, SKL_ClipEntry& clip)
+{
+	w.putString(clip.name);
+	w.putString(clip.source);
+	w.putU32(clip.skeleton_index);
+	w.putU32(clip.frames);
+	w.putF32(clip.frame_rate);
+	w.putU16((unsigned short)clip.channels.size());
+	for (unsigned int c=0; c<clip.channels.size(); c++)
+	{
+		w.putU16(clip.channels[c].bone_id);
+		w.putU8((unsigned char)clip.channels[c].channel_type);
+	}
+	w.putU32(clip.encoding);
+	w.putU64(clip.payload_offset);
+	w.putU64(clip.payload_size);
+}
+
+static bool readClipRecord(ByteReader& r, SKL_ClipEntry& clip)
+{
+	clip.name = r.getString();
+	clip.source = r.getString();
+	clip.skeleton_index = r.getU32();
+	clip.frames = r.getU32();
+	clip.frame_rate = r.getF32();
+	unsigned short num_channels = r.getU16();
+	if (!r.good()) return false;
+	clip.channels.resize(num_channels);
+	for (unsigned short c=0; c<num_channels; c++)
+	{
+		clip.channels[c].bone_id = r.getU16();
+		clip.channels[c].channel_type = CHANNEL_TYPE(r.getU8());
+	}
+	clip.encoding = r.getU32();
+	clip.payload_offset = r.getU64();
+	clip.payload_size = r.getU64();
+	return r.good();
+}
+
+static void writeHeader(ByteWriter& w, unsigned int num_skeletons, unsigned int num_clips,
+	unsigned long long index_size, unsigned long long payload_offset)
+{
+	w.putBytes(SKL_MAGIC, 8);
+	w.putU32(SKL_VERSION);
+	w.putU32(SKL_HEADER_SIZE);
+	w.putU32(num_skeletons);
+	w.putU32(num_clips);
+	w.putU64(SKL_HEADER_SIZE);
+	w.putU64(index_size);
+	w.putU64(payload_offset);
+	w.putU32(SKL_ALIGNMENT);
+	w.padTo(SKL_HEADER_SIZE);
+}
+
+//==========================================================================
+// MotionLibrary (reader)
+
+struct MotionLibraryData
+{
+	string filename;
+	FILE* fp;
+	vector<SKL_SkeletonEntry> skeletons;
+	vector<SKL_ClipEntry> clips;
+	map<string, long> clip_lookup;
+#if ENABLE_THREADS==1
+	mutex file_lock;
+#endif
+	// memory mapping
+	const unsigned char* map_base;
+	unsigned long long map_size;
+#ifdef _WIN32
+	HANDLE map_file;
+	HANDLE map_handle;
+#endif
+	MotionLibraryData() : fp(NULL), map_base(NULL), map_size(0)
+	{
+#ifdef _WIN32
+		map_file = INVALID_HANDLE_VALUE;
+		map_handle = NULL;
+#endif
+	}
+};
+
+MotionLibrary::MotionLibrary()
+{
+	data = new MotionLibraryData;
+}
+
+MotionLibrary::~MotionLibrary()
+{
+	close();
+	delete data;
+}
+
+static bool mapFile(MotionLibraryData* d)
+{
+#ifdef _WIN32
+	d->map_file = CreateFileA(d->filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (d->map_file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(d->map_file, &size)) return false;
+	d->map_size = (unsigned long long)size.QuadPart;
+	d->map_handle = CreateFileMappingA(d->map_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (d->map_handle == NULL) return false;
+	d->map_base = (const unsigned char*)MapViewOfFile(d->map_handle, FILE_MAP_READ, 0, 0, 0);
+	return d->map_base != NULL;
+#else
+	int fd = ::open(d->filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+	d->map_size = (unsigned long long)st.st_size;
+	void* p = mmap(NULL, size_t(d->map_size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED) return false;
+	d->map_base = (const unsigned char*)p;
+	return true;
+#endif
+}
+
+static void unmapFile(MotionLibraryData* d)
+{
+#ifdef _WIN32
+	if (d->map_base != NULL) UnmapViewOfFile(d->map_base);
+	if (d->map_handle != NULL) CloseHandle(d->map_handle);
+	if (d->map_file != INVALID_HANDLE_VALUE) CloseHandle(d->map_file);
+	d->map_handle = NULL;
+	d->map_file = INVALID_HANDLE_VALUE;
+#else
+	if (d->map_base != NULL) munmap((void*)d->map_base, size_t(d->map_size));
+#endif
+	d->map_base = NULL;
+	d->map_size = 0;
+}
+
+bool MotionLibrary::open(const char* filename, bool use_mmap)
+{
+	close();
+	data->filename = filename;
+
+	// header and index are read the same way in both modes
+	vector<unsigned char> header(SKL_HEADER_SIZE);
+	vector<unsigned char> index;
+	const unsigned char* index_ptr = NULL;
+	unsigned long long file_size = 0;
+	if (use_mmap)
+	{
+		if (!mapFile(data)) { close(); return false; }
+		file_size = data->map_size;
+		if (file_size < SKL_HEADER_SIZE) { close(); return false; }
+		memcpy(&header[0], data->map_base, SKL_HEADER_SIZE);
+	}
+	else
+	{
+		data->fp = fopen(filename, "rb");
+		if (data->fp == NULL) return false;
+		long long size = fileSize64(data->fp);
+		if ((size < SKL_HEADER_SIZE) || (seek64(data->fp, 0) != 0)) { close(); return false; }
+		file_size = (unsigned long long)size;
+		if (fread(&header[0], 1, SKL_HEADER_SIZE, data->fp) != SKL_HEADER_SIZE) { close(); return false; }
+	}
+
+	ByteReader hr(&header[0], SKL_HEADER_SIZE);
+	const unsigned char* magic = hr.getBytes(8);
+	unsigned int version = hr.getU32();
+	hr.getU32();	// header size
+	unsigned int num_skeletons = hr.getU32();
+	unsigned int num_clips = hr.getU32();
+	unsigned long long index_offset = hr.getU64();
+	unsigned long long index_size = hr.getU64();
+	if ((memcmp(magic, SKL_MAGIC, 8) != 0) || (version != SKL_VERSION))
+	{
+		logout << "MotionLibrary::open: " << filename << " is not a motion library file." << endl;
+		close();
+		return false;
+	}
+
+	// The index must lie inside the file, checked so that a corrupt offset or
+	// size cannot overflow. Only a library with no skeletons or clips (which
+	// the builder can write) has an empty index.
+	bool empty = (num_skeletons == 0) && (num_clips == 0);
+	if ((index_offset > file_size) || (index_size > file_size - index_offset) ||
+		((index_size == 0) != empty))
+	{
+		logout << "MotionLibrary::open: corrupt index in " << filename << endl;
+		close();
+		return false;
+	}
+	if (empty) return true;
+	if (use_mmap)
+	{
+		index_ptr = data->map_base + index_offset;
+	}
+	else
+	{
+		index.resize(size_t(index_size));
+		if ((seek64(data->fp, index_offset) != 0) ||
+			(fread(&index[0], 1, size_t(index_size), data->fp) != size_t(index_size)))
+		{
+			close();
+			return false;
+		}
+		index_ptr = &index[0];
+	}
+
+	ByteReader r(index_ptr, long(index_size));
+	data->skeletons.resize(num_skeletons);
+	for (unsigned int s=0; s<num_skeletons; s++)
+	{
+		unsigned int record_size = r.getU32();
+		long start = r.position();
+		data->skeletons[s].id = r.getString();
+		r.seek(start);
+		const unsigned char* rec = r.getBytes(record_size);
+		if (rec == NULL) { close(); return false; }
+		data->skeletons[s].record.assign(rec, rec+record_size);
+	}
+	data->clips.resize(num_clips);
+	for (unsigned int c=0; c<num_clips; c++)
+	{
+		if (!readClipRecord(r, data->clips[c]) || (data->clips[c].skeleton_index >= num_skeletons))
+		{
+			logout << "MotionLibrary::open: corrupt index in " << filename << endl;
+			close();
+			return false;
+		}
+		data->clip_lookup[data->clips[c].name] = long(c);
+	}
+	return true;
+}
+
+void MotionLibrary::close()
+{
+	if (data->fp != NULL) fclose(data->fp);
+	data->fp = NULL;
+	unmapFile(data);
+	data->skeletons.clear();
+	data->clips.clear();
+	data->clip_lookup.clear();
+}
+
+bool MotionLibrary::isOpen() { return (data->fp != NULL) || (data->map_base != NULL); }
+bool MotionLibrary::isMapped() { return data->map_base != NULL; }
+
+long MotionLibrary::numClips() { return long(data->clips.size()); }
+
+long MotionLibrary::findClip(const char* clip_name)
+{
+	map<string, long>::iterator iter = data->clip_lookup.find(string(clip_name));
+	if (iter == data->clip_lookup.end()) return -1;
+	return iter->second;
+}
+
+#define CHECK_CLIP(clip, fail) if ((clip < 0) || (clip >= long(data->clips.size()))) return fail;
+
+const char* MotionLibrary::clipName(long clip) { CHECK_CLIP(clip, NULL); return data->clips[clip].name.c_str(); }
+const char* MotionLibrary::clipSource(long clip) { CHECK_CLIP(clip, NULL); return data->clips[clip].source.c_str(); }
+long MotionLibrary::clipFrames(long clip) { CHECK_CLIP(clip, 0); return long(data->clips[clip].frames); }
+float MotionLibrary::clipFrameRate(long clip) { CHECK_CLIP(clip, 0.0f); return data->clips[clip].frame_rate; }
+short MotionLibrary::clipNumChannels(long clip) { CHECK_CLIP(clip, 0); return short(data->clips[clip].channels.size()); }
+
+bool MotionLibrary::clipCompressed(long clip) { CHECK_CLIP(clip, false); return data->clips[clip].encoding == SKL_ENCODING_CHUNKED; }
+unsigned long long MotionLibrary::clipStoredSize(long clip) { CHECK_CLIP(clip, 0); return data->clips[clip].payload_size; }
+
+const char* MotionLibrary::clipSkeletonId(long clip)
+{
+	CHECK_CLIP(clip, NULL);
+	return data->skeletons[data->clips[clip].skeleton_index].id.c_str();
+}
+
+CHANNEL_ID MotionLibrary::clipChannel(long clip, short channel_index)
+{
+	CHECK_CLIP(clip, CHANNEL_ID(0, CT_INVALID));
+	if ((channel_index < 0) || (channel_index >= short(data->clips[clip].channels.size())))
+		return CHANNEL_ID(0, CT_INVALID);
+	return data->clips[clip].channels[channel_index];
+}
+
+Skeleton* MotionLibrary::loadSkeleton(long clip)
+{
+	CHECK_CLIP(clip, NULL);
+	vector<unsigned char>& rec = data->skeletons[data->clips[clip].skeleton_index].record;
+	if (rec.size() == 0) return NULL;
+	ByteReader r(&rec[0], long(rec.size()));
+	return readSkeletonRecord(r);
+}
+
+// copy size bytes, starting offset bytes into the clip's payload, into dest
+bool MotionLibrary::readPayload(long clip, unsigned long long offset, unsigned long long size, unsigned char* dest)
+{
+	SKL_ClipEntry& entry = data->clips[clip];
+	if (offset + size > entry.payload_size) return false;
+	if (data->map_base != NULL)
+	{
+		if (entry.payload_offset + entry.payload_size > data->map_size) return false;
+		memcpy(dest, data->map_base + entry.payload_offset + offset, size_t(size));
+		return true;
+	}
+	if (data->fp == NULL) return false;
+#if ENABLE_THREADS==1
+	lock_guard<mutex> guard(data->file_lock);
+#endif
+	if (seek64(data->fp, entry.payload_offset + offset) != 0) return false;
+	return fread(dest, 1, size_t(size), data->fp) == size_t(size);
+}
+
+MotionSequence* MotionLibrary::loadMotion(long clip, ChannelSelection* selection)
+{
+	CHECK_CLIP(clip, NULL);
+	SKL_ClipEntry& entry = data->clips[clip];
+	long frames = long(entry.frames);
+	short num_channels = short(entry.channels.size());
+
+	// stored channels to load
+	vector<short> columns;
+	if (selection == NULL)
+	{
+		for (short c=0; c<num_channels; c++) columns.push_back(c);
+	}
+	else
+	{
+		Skeleton* skel = loadSkeleton(clip);
+		if (skel == NULL) return NULL;
+		for (short c=0; c<num_channels; c++)
+			if (selection->selectsChannel(skel, entry.channels[c])) columns.push_back(c);
+		delete skel;
+	}
+	short num_columns = short(columns.size());
+	bool all_columns = (num_columns == num_channels);
+	unsigned long long column_bytes = (unsigned long long)frames*sizeof(float);
+
+	Array2D<float> bulk_data(frames, num_columns);
+	if ((frames > 0) && (num_columns > 0) && (entry.encoding == SKL_ENCODING_RAW))
+	{
+		if (entry.payload_size != column_bytes*num_channels) return NULL;
+		if (all_columns)
+		{
+			if (!readPayload(clip, 0, entry.payload_size, (unsigned char*)bulk_data.getColumnPtr(0))) return NULL;
+		}
+		else
+		{
+			// columns are contiguous, so read only the ones needed
+			for (short i=0; i<num_columns; i++)
+				if (!readPayload(clip, columns[i]*column_bytes, column_bytes, (unsigned char*)bulk_data.getColumnPtr(i))) return NULL;
+		}
+		if (!hostIsLittleEndian()) swapEndian4Array(bulk_data.getColumnPtr(0), long(frames)*num_columns);
+	}
+	else if ((frames > 0) && (num_columns > 0) && (entry.encoding == SKL_ENCODING_CHUNKED))
+	{
+		CompressedChannels reader;
+		vector<unsigned char> payload;
+		if ((data->map_base != NULL) && (entry.payload_offset + entry.payload_size <= data->map_size))
+		{
+			// decode straight from the mapping
+			if (!reader.attach(data->map_base + entry.payload_offset, long(entry.payload_size))) return NULL;
+		}
+		else if (all_columns)
+		{
+			payload.resize(size_t(entry.payload_size));
+			if (!readPayload(clip, 0, entry.payload_size, &payload[0])) return NULL;
+			if (!reader.attach(&payload[0], long(entry.payload_size))) return NULL;
+		}
+		else
+		{
+			// read the chunk table, then only the chunks of the channels needed
+			unsigned char head[24];
+			if (!readPayload(clip, 0, 24, head)) return NULL;
+			long table_size = CompressedChannels::tableSize(head, 24);
+			if (table_size == 0) return NULL;
+			payload.resize(table_size);
+			if (!readPayload(clip, 0, table_size, &payload[0])) return NULL;
+			if (!reader.attach(&payload[0], table_size, true)) return NULL;
+		}
+		if ((reader.numFrames() != frames) || (reader.numChannels() != num_channels)) return NULL;
+		if (all_columns)
+		{
+			if (!reader.decodeAll(bulk_data.getColumnPtr(0))) return NULL;
+		}
+		else if (payload.size() == 0)
+		{
+			for (short i=0; i<num_columns; i++)
+				if (!reader.decodeChannel(columns[i], bulk_data.getColumnPtr(i))) return NULL;
+		}
+		else
+		{
+			vector<unsigned char> bytes;
+			for (short i=0; i<num_columns; i++)
+			{
+				long size = reader.channelSize(columns[i]);
+				bytes.resize(size + 1);
+				if (!readPayload(clip, reader.channelOffset(columns[i]), size, &bytes[0])) return NULL;
+				if (!reader.decodeChannelBytes(columns[i], &bytes[0], bulk_data.getColumnPtr(i))) return NULL;
+			}
+		}
+	}
+	else if ((entry.encoding != SKL_ENCODING_RAW) && (entry.encoding != SKL_ENCODING_CHUNKED)) return NULL;
+
+	vector<CHANNEL_ID> channel_ids(num_columns > 0 ? num_columns : 1);
+	for (short i=0; i<num_columns; i++) channel_ids[i] = entry.channels[columns[i]];
+	MotionSequence* ms = new MotionSequence;
+	ms->setNumFrames(frames);
+	ms->bulkBuild(&channel_ids[0], num_columns, bulk_data);
+	ms->setFrameRate(entry.frame_rate);
+	ms->setId((char*)entry.name.c_str());
+	ms->setSource(entry.source.c_str());
+	return ms;
+}
+
+pair<Skeleton*, MotionSequence*> MotionLibrary::loadClip(long clip, ChannelSelection* selection)
+{
+	pair<Skeleton*, MotionSequence*> result(NULL, NULL);
+	result.first = loadSkeleton(clip);
+	if (result.first == NULL) return result;
+	result.second = loadMotion(clip, selection);
+	if (result.second == NULL) { delete result.first; result.first = NULL; }
+	return result;
+}
+
+pair<Skeleton*, MotionSequence*> MotionLibrary::loadClip(const char* clip_name, ChannelSelection* selection)
+{
+	return loadClip(findClip(clip_name), selection);
+}
+
+const float* MotionLibrary::mappedClipData(long clip)
+{
+	CHECK_CLIP(clip, NULL);
+	if ((data->map_base == NULL) || !hostIsLittleEndian()) return NULL;
+	SKL_ClipEntry& entry = data->clips[clip];
+	if (entry.encoding != SKL_ENCODING_RAW) return NULL;
+	if (entry.payload_offset + entry.payload_size > data->map_size) return NULL;
+	return (const float*)(data->map_base + entry.payload_offset);
+}
+
+//==========================================================================
+// MotionLibraryBuilder
+
+struct MotionLibraryBuilderData
+{
+	string filename;
+	string payload_filename;
+	FILE* payload_fp;
+	unsigned long long payload_size;	// bytes written to the payload file
+	vector<SKL_SkeletonEntry> skeletons;
+	map<vector<unsigned char>, unsigned int> skeleton_lookup;
+	vector<SKL_ClipEntry> clips;
+	map<string, long> clip_lookup;
+	bool compress;
+	long chunk_frames;
+	MotionLibraryBuilderData() : payload_fp(NULL), payload_size(0), compress(false), chunk_frames(256) { }
+};
+
+MotionLibraryBuilder::MotionLibraryBuilder()
+{
+	data = new MotionLibraryBuilderData;
+}
+
+MotionLibraryBuilder::~MotionLibraryBuilder()
+{
+	if (data->payload_fp != NULL)
+	{
+		fclose(data->payload_fp);
+		remove(data->payload_filename.c_str());
+	}
+	delete data;
+}
+
+bool MotionLibraryBuilder::create(const char* filename)
+{
+	if (data->payload_fp != NULL) return false;
+	data->filename = filename;
+	data->payload_filename = string(filename) + ".payload.tmp";
+	data->payload_fp = fopen(data->payload_filename.c_str(), "wb");
+	data->payload_size = 0;
+	data->skeletons.clear();
+	data->skeleton_lookup.clear();
+	data->clips.clear();
+	data->clip_lookup.clear();
+	return data->payload_fp != NULL;
+}
+
+long MotionLibraryBuilder::numClips() { return long(data->clips.size()); }
+
+void MotionLibraryBuilder::setCompression(bool compress, long chunk_frames)
+{
+	data->compress = compress;
+	if (chunk_frames > 0) data->chunk_frames = chunk_frames;
+}
+
+bool MotionLibraryBuilder::addClip(const char* clip_name, Skeleton* skeleton, MotionSequence* motion, const char* source)
+{
+	if ((data->payload_fp == NULL) || (skeleton == NULL) || (motion == NULL)) return false;
+	if (data->clip_lookup.find(string(clip_name)) != data->clip_lookup.end())
+	{
+		logout << "MotionLibraryBuilder::addClip: duplicate clip name " << clip_name << endl;
+		return false;
+	}
+
+	// share identical skeletons
+	ByteWriter skel_writer;
+	writeSkeletonRecord(skel_writer, skeleton);
+	unsigned int skel_index;
+	map<vector<unsigned char>, unsigned int>::iterator iter = data->skeleton_lookup.find(skel_writer.bytes);
+	if (iter != data->skeleton_lookup.end()) skel_index = iter->second;
+	else
+	{
+		skel_index = (unsigned int)data->skeletons.size();
+		SKL_SkeletonEntry entry;
+		entry.id = skeleton->getId();
+		entry.record = skel_writer.bytes;
+		data->skeletons.push_back(entry);
+		data->skeleton_lookup[skel_writer.bytes] = skel_index;
+	}
+
+	SKL_ClipEntry clip;
+	clip.name = clip_name;
+	clip.source = (source != NULL) ? source : motion->getSource();
+	clip.skeleton_index = skel_index;
+	clip.frames = (unsigned int)motion->numFrames();
+	clip.frame_rate = motion->getFrameRate();
+	short num_channels = motion->numChannels();
+	for (short c=0; c<num_channels; c++) clip.channels.push_back(motion->getChannelID(c));
+	clip.encoding = data->compress ? SKL_ENCODING_CHUNKED : SKL_ENCODING_RAW;
+
+	// payload: pad to alignment, then column-major little-endian floats or a compressed block
+	unsigned long long pad = (SKL_ALIGNMENT - data->payload_size % SKL_ALIGNMENT) % SKL_ALIGNMENT;
+	static const unsigned char zeros[SKL_ALIGNMENT] = { 0 };
+	if (fwrite(zeros, 1, size_t(pad), data->payload_fp) != size_t(pad)) return false;
+	data->payload_size += pad;
+
+	long count = long(clip.frames)*num_channels;
+	clip.payload_offset = data->payload_size;		// relative until finish()
+	clip.payload_size = (unsigned long long)count*sizeof(float);
+	if (data->compress)
+	{
+		const float* values = (count > 0) ? motion->getChannelPtr(short(0)) : NULL;
+		vector<unsigned char> block;
+		if (!CompressedChannels::encode(values, long(clip.frames), num_channels, block, data->chunk_frames)) return false;
+		if (fwrite(&block[0], 1, block.size(), data->payload_fp) != block.size()) return false;
+		clip.payload_size = block.size();
+	}
+	else if (count > 0)
+	{
+		const float* values = motion->getChannelPtr(short(0));
+		bool ok;
+		if (hostIsLittleEndian())
+			ok = (fwrite(values, sizeof(float), size_t(count), data->payload_fp) == size_t(count));
+		else
+		{
+			vector<float> swapped(values, values+count);
+			swapEndian4Array(&swapped[0], count);
+			ok = (fwrite(&swapped[0], sizeof(float), size_t(count), data->payload_fp) == size_t(count));
+		}
+		if (!ok) return false;
+	}
+	data->payload_size += clip.payload_size;
+
+	data->clip_lookup[clip.name] = long(data->clips.size());
+	data->clips.push_back(clip);
+	return true;
+}
+
+static void writeIndex(ByteWriter& w, MotionLibraryBuilderData* d, unsigned long long payload_base)
+{
+	for (unsigned int s=0; s<d->skeletons.size(); s++)
+	{
+		w.putU32((unsigned int)d->skeletons[s].record.size());
+		w.putBytes(&d->skeletons[s].record[0], long(d->skeletons[s].record.size()));
+	}
+	for (unsigned int c=0; c<d->clips.size(); c++)
+	{
+		SKL_ClipEntry clip = d->clips[c];
+		clip.payload_offset += payload_base;
+		writeClipRecord(w, clip);
+	}
+}
+
+bool MotionLibraryBuilder::finish()
+{
+	if (data->payload_fp == NULL) return false;
+	fclose(data->payload_fp);
+	data->payload_fp = NULL;
+
+	// index size does not depend on the offsets stored in it
+	ByteWriter sizing;
+	writeIndex(sizing, data, 0);
+	unsigned long long index_size = sizing.size();
+	unsigned long long payload_base = SKL_HEADER_SIZE + index_size;
+	payload_base = ((payload_base + SKL_ALIGNMENT - 1) / SKL_ALIGNMENT) * SKL_ALIGNMENT;
+
+	ByteWriter w;
+	writeHeader(w, (unsigned int)data->skeletons.size(), (unsigned int)data->clips.size(), index_size, payload_base);
+	writeIndex(w, data, payload_base);
+	w.padTo(SKL_ALIGNMENT);
+
+	bool ok = false;
+	FILE* out = fopen(data->filename.c_str(), "wb");
+	FILE* in = fopen(data->payload_filename.c_str(), "rb");
+	if ((out != NULL) && (in != NULL))
+	{
+		ok = (fwrite(&w.bytes[0], 1, w.bytes.size(), out) == w.bytes.size());
+		vector<char> block(1<<20);
+		size_t n;
+		while (ok && ((n = fread(&block[0], 1, block.size(), in)) > 0))
+			ok = (fwrite(&block[0], 1, n, out) == n);
+	}
+	if (in != NULL) fclose(in);
+	if ((out != NULL) && (fclose(out) != 0)) ok = false;
+	remove(data->payload_filename.c_str());
+	return ok;
+}
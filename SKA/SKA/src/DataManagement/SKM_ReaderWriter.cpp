@@ -22,9 +22,16 @@ using namespace std;
 #include <DataManagement/DataManagementException.h>
 #include <DataManagement/SKM_ReaderWriter.h>
 #include <DataManagement/FileSystem.h>
+#include <DataManagement/CompressedChannels.h>
+#include <DataManagement/ChannelSelection.h>
 
 // Motion data files are big endian binary. 
 // If this is a little endian machine, endian conversion is needed.
+// The header holds three 32 bit integers (endian check, rows, columns),
+// the 4 byte data mode, the motion id and the skeleton id.
+// Data mode "ra" is followed by rows*columns floats.
+// Data mode "rc" is followed by a CompressedChannels block, which has
+// its own (little endian) byte order.
 static long endiantest = 1;
 #define LITTLEENDIAN *((char*)(&endiantest)) // 1 for little-endian, 0 for big-endian
 
@@ -63,15 +70,16 @@ public:
 	char* getDataPtr() { return data; }
 
 // methods for reading from a file
-	bool readFromFile(string& filename);
+// If columns is not NULL only those columns are read, in the order given.
+	bool readFromFile(string& filename, vector<long>* columns=NULL);
 // methods for writing to a file:
 	void setup(long _r, long _c, char _mode[4], char* _mid, char* _sid, char* _data);
 	bool writeToFile(string& filename);
 
 private:
-	long endiancheck;
-	long r;
-	long c;
+	int endiancheck;
+	int r;
+	int c;
 	char datamode[4];
 	char motion_id[64];
 	char skeleton_id[64];
@@ -82,8 +90,8 @@ void MotionData::setup(long _r, long _c, char _mode[4], char* _mid, char* _sid,
 {
 	clear();
 	endiancheck = 1;
-	r = _r;
-	c = _c;
+	r = int(_r);
+	c = int(_c);
 	memcpy(datamode, _mode, 4);
 	memcpy(motion_id, _mid, 64); motion_id[63] = '\0';
 	memcpy(skeleton_id, _sid, 64); motion_id[63] = '\0';
@@ -101,17 +109,17 @@ bool MotionData::writeToFile(string& filename)
 	char header[144];
 	char* p = header;
 
-	memcpy(p, &endiancheck, sizeof(long));
+	memcpy(p, &endiancheck, sizeof(int));
 	if (LITTLEENDIAN) swapEndian4(p);
-	p += sizeof(long);
+	p += sizeof(int);
 	
-	memcpy(p, &r, sizeof(long));
+	memcpy(p, &r, sizeof(int));
 	if (LITTLEENDIAN) swapEndian4(p);
-	p += sizeof(long);
+	p += sizeof(int);
 	
-	memcpy(p, &c, sizeof(long));
+	memcpy(p, &c, sizeof(int));
 	if (LITTLEENDIAN) swapEndian4(p);
-	p += sizeof(long);
+	p += sizeof(int);
 	
 	memcpy(p, datamode, 4);
 	p += 4;
@@ -121,47 +129,54 @@ bool MotionData::writeToFile(string& filename)
 	
 	memcpy(p, skeleton_id, 64);
 
-	char* localdata = data;
-	if (LITTLEENDIAN)
-	{
-		localdata = new char[datasize];
-		memcpy(localdata, data, datasize);
-		for (long i=0; i<datasize; i+=4) swapEndian4(&(localdata[i]));
-	}
-
 	fwrite(header, 1, 144, fp);
-	fwrite(localdata, 1, datasize, fp);
 
-	if (LITTLEENDIAN) delete [] localdata;
+	bool ok = true;
+	if (strncmp(datamode, "rc", 4) == 0)
+	{
+		vector<unsigned char> block;
+		CompressedChannels::encode((float*)data, r, c, block);
+		ok = (fwrite(&block[0], 1, block.size(), fp) == block.size());
+	}
+	else
+	{
+		char* localdata = data;
+		if (LITTLEENDIAN)
+		{
+			localdata = new char[datasize];
+			memcpy(localdata, data, datasize);
+			for (long i=0; i<datasize; i+=4) swapEndian4(&(localdata[i]));
+		}
+		fwrite(localdata, 1, datasize, fp);
+		if (LITTLEENDIAN) delete [] localdata;
+	}
 
-	fclose(fp);
-	return true;
+	if (fclose(fp) != 0) ok = false;
+	return ok;
 }
 
-bool MotionData::readFromFile(string& filename)
+bool MotionData::readFromFile(string& filename, vector<long>* columns)
 {
 	clear();
 	FILE *fp = fopen(filename.c_str(), "rb");
 	if (fp == NULL) return false;
-	
-	long datasize = r*c*sizeof(float);
 
 	char header[144];
-	fread(header, 1, 144, fp);
+	if (fread(header, 1, 144, fp) != 144) { fclose(fp); return false; }
 
 	char* p = header;
 	if (LITTLEENDIAN) swapEndian4(p);
-	memcpy(&endiancheck, p, sizeof(long));
-	if (endiancheck != 1) return false;
-	p += sizeof(long);
+	memcpy(&endiancheck, p, sizeof(int));
+	if (endiancheck != 1) { fclose(fp); return false; }
+	p += sizeof(int);
 	
 	if (LITTLEENDIAN) swapEndian4(p);
-	memcpy(&r, p, sizeof(long));
-	p += sizeof(long);
+	memcpy(&r, p, sizeof(int));
+	p += sizeof(int);
 	
 	if (LITTLEENDIAN) swapEndian4(p);
-	memcpy(&c, p, sizeof(long));
-	p += sizeof(long);
+	memcpy(&c, p, sizeof(int));
+	p += sizeof(int);
 	
 	memcpy(datamode, p, 4);
 	p += 4;
@@ -171,29 +186,116 @@ bool MotionData::readFromFile(string& filename)
 	
 	memcpy(skeleton_id, p, 64);
 
-	data = new char[datasize];
-	fread(data, 1, datasize, fp);
-
-	if (LITTLEENDIAN) 
+	vector<long> all_columns;
+	if (columns == NULL)
+	{
+		for (long i=0; i<c; i++) all_columns.push_back(i);
+		columns = &all_columns;
+	}
+	long num_columns = long(columns->size());
+	for (long i=0; i<num_columns; i++)
+		if (((*columns)[i] < 0) || ((*columns)[i] >= c)) { fclose(fp); return false; }
+
+	long datasize = long(r)*c*sizeof(float);
+	long column_size = long(r)*sizeof(float);
+	data = new char[(num_columns > 0) ? num_columns*column_size : 1];
+	bool ok = true;
+	if ((strncmp(datamode, "rc", 4) == 0) && (num_columns < c))
+	{
+		// read the chunk table, then only the chunks of the requested columns
+		vector<unsigned char> table(24);
+		ok = (fread(&table[0], 1, 24, fp) == 24);
+		long table_size = ok ? CompressedChannels::tableSize(&table[0], 24) : 0;
+		if (table_size > 24)
+		{
+			table.resize(table_size);
+			ok = (fread(&table[24], 1, table_size-24, fp) == size_t(table_size-24));
+		}
+		CompressedChannels reader;
+		ok = ok && reader.attach(&table[0], long(table.size()), true)
+			&& (reader.numFrames() == r) && (reader.numChannels() == c);
+		vector<unsigned char> bytes;
+		for (long i=0; ok && (i<num_columns); i++)
+		{
+			long col = (*columns)[i];
+			bytes.resize(reader.channelSize(col) + 1);
+			ok = (fseek(fp, 144 + reader.channelOffset(col), SEEK_SET) == 0)
+				&& (fread(&bytes[0], 1, reader.channelSize(col), fp) == size_t(reader.channelSize(col)))
+				&& reader.decodeChannelBytes(col, &bytes[0], (float*)(data + i*column_size));
+		}
+	}
+	else if (strncmp(datamode, "rc", 4) == 0)
+	{
+		// the compressed block runs to the end of the file
+		vector<unsigned char> block;
+		unsigned char buffer[1<<16];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+			block.insert(block.end(), buffer, buffer+n);
+		CompressedChannels reader;
+		ok = (block.size() > 0) && reader.attach(&block[0], long(block.size()))
+			&& (reader.numFrames() == r) && (reader.numChannels() == c)
+			&& reader.decodeAll((float*)data);
+	}
+	else if (num_columns < c)
+	{
+		// columns are contiguous, so seek straight to each one
+		for (long i=0; ok && (i<num_columns); i++)
+		{
+			ok = (fseek(fp, 144 + (*columns)[i]*column_size, SEEK_SET) == 0)
+				&& (fread(data + i*column_size, 1, column_size, fp) == size_t(column_size));
+		}
+		if (LITTLEENDIAN) 
+		{
+			for (long i=0; i<num_columns*column_size; i+=4) swapEndian4(&(data[i]));
+		}
+	}
+	else
 	{
-		for (long i=0; i<datasize; i+=4) swapEndian4(&(data[i]));
+		ok = (fread(data, 1, datasize, fp) == size_t(datasize));
+		if (LITTLEENDIAN) 
+		{
+			for (long i=0; i<datasize; i+=4) swapEndian4(&(data[i]));
+		}
 	}
 
 	fclose(fp);
-	return true;
+	if (!ok) clear();
+	return ok;
 }
 
 MotionSequence* SKM_ReaderWriter::readSKM(
 	const char* inputFilename,
-	Skeleton* skeleton)
+	Skeleton* skeleton,
+	ChannelSelection* selection)
 {
+	// The file stores the skeleton's active channels, in bone order.
+	vector<CHANNEL_ID> channel_ids;
+	vector<long> columns;
+	long file_channels = 0;
+	for (short b=0; b<skeleton->numBones(); b++)
+	{
+		for (short channel_type=0; channel_type<6; channel_type++)
+		{
+			CHANNEL_ID c(b, CHANNEL_TYPE(channel_type));
+			if (!skeleton->isActiveChannel(b,channel_type)) continue;
+			if ((selection == NULL) || selection->selectsChannel(skeleton, c))
+			{
+				channel_ids.push_back(c);
+				columns.push_back(file_channels);
+			}
+			file_channels++;
+		}
+	}
+
 	MotionData read_buffer;
 	string sfilename(inputFilename);
-	if (!read_buffer.readFromFile(sfilename)) return NULL;
+	if (!read_buffer.readFromFile(sfilename, &columns)) return NULL;
 
-	long r;
-	long c;
+	long r = 0;
+	long c = 0;
 	read_buffer.getDimensions(r,c);
+	if (c != file_channels) return NULL;	// motion does not match the skeleton
 	
 	char mode[4]; memset(mode, 0, 4);
 	read_buffer.getDatamode(mode);
@@ -207,32 +309,20 @@ MotionSequence* SKM_ReaderWriter::readSKM(
 	char* data = read_buffer.getDataPtr();
 
 	MotionSequence* ms = new MotionSequence;
-	short frames = short(r);
+	long frames = r;
 	ms->setNumFrames(frames);
 	ms->setFrameRate(120);
-	
-	//ms->buildChannelsFromSkeleton(skeleton);
-	vector<CHANNEL_ID> channel_ids;
-	for (short b=0; b<skeleton->numBones(); b++)
-	{
-		for (short channel_type=0; channel_type<6; channel_type++)
-		{
-			CHANNEL_ID c(b, CHANNEL_TYPE(channel_type));
-			if (skeleton->isActiveChannel(b,channel_type))
-				channel_ids.push_back(c);
-		}
-	}
 
 	int chans = channel_ids.size();
-	CHANNEL_ID* cid = new CHANNEL_ID[chans];
+	CHANNEL_ID* cid = new CHANNEL_ID[chans > 0 ? chans : 1];
 	for (unsigned short c=0; c<chans; c++) cid[c] = channel_ids[c];
 
 	Array2D<float> data_matrix;
 	data_matrix.resize(frames, chans);
-	memcpy(data_matrix.getColumnPtr(0), data, chans*frames*sizeof(float));
+	if (chans > 0) memcpy(data_matrix.getColumnPtr(0), data, chans*frames*sizeof(float));
 
 	ms->bulkBuild(cid, chans, data_matrix);
-	delete cid;
+	delete [] cid;
 
 	ms->setId(mid);
 
@@ -243,7 +333,8 @@ bool SKM_ReaderWriter::writeSKM(
 	const char* outputFilename,
 	Skeleton* skeleton,
 	MotionSequence* ms,
-	bool overwrite)
+	bool overwrite,
+	bool compress)
 {
 	if (!overwrite && FileSystem::fileExists(outputFilename)) return false;
 
@@ -251,7 +342,7 @@ bool SKM_ReaderWriter::writeSKM(
 	long c = ms->numChannels();
 	
 	char mode[4]; memset(mode, 0, 4);
-	strcpy(mode, "ra"); // rotation angles
+	strcpy(mode, compress ? "rc" : "ra"); // rotation angles, raw or compressed
 	
 	char sid[64]; memset(sid, 0, 64);
 	string skel_id = skeleton->getId();
@@ -269,6 +360,5 @@ bool SKM_ReaderWriter::writeSKM(
 	
 	write_buffer.setup(r, c, mode, mid, sid, data);
 	string sfilename(outputFilename);
-	write_buffer.writeToFile(sfilename);
-	return true;
+	return write_buffer.writeToFile(sfilename);
 }
@@ -0,0 +1,64 @@
+//-----------------------------------------------------------------------------
+// BatchTrig.cpp
+//	 Sine and cosine of many angles at once, four lanes at a time.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+using namespace std;
+#include <Math/BatchTrig.h>
+
+// beyond this the three part reduction loses accuracy
+static const float FULL_PRECISION_LIMIT = 8192.0f;
+
+void batchSinCos(const float* angles, float* s, float* c, long n, TRIG_PRECISION precision)
+{
+	float a[4], ts[4], tc[4];
+	for (long i=0; i<n; i+=4)
+	{
+		long m = (n-i < 4) ? n-i : 4;
+		for (long k=0; k<4; k++) a[k] = (k < m) ? angles[i+k] : 0.0f;
+		Float4 x = f4loadu(a);
+		Float4 vs, vc;
+		f4sincos(x, vs, vc, precision);
+		f4storeu(ts, vs);
+		f4storeu(tc, vc);
+		if ((precision == TRIG_FULL) && f4movemask(f4cmpgt(f4abs(x), f4set1(FULL_PRECISION_LIMIT))))
+		{
+			for (long k=0; k<m; k++)
+			{
+				if (fabs(a[k]) > FULL_PRECISION_LIMIT) { ts[k] = sinf(a[k]); tc[k] = cosf(a[k]); }
+			}
+		}
+		for (long k=0; k<m; k++)
+		{
+			if (s != NULL) s[i+k] = ts[k];
+			if (c != NULL) c[i+k] = tc[k];
+		}
+	}
+}
+
+void batchAtan2(const float* y, const float* x, float* result, long n)
+{
+	float ty[4], tx[4], tr[4];
+	for (long i=0; i<n; i+=4)
+	{
+		long m = (n-i < 4) ? n-i : 4;
+		for (long k=0; k<4; k++)
+		{
+			ty[k] = (k < m) ? y[i+k] : 0.0f;
+			tx[k] = (k < m) ? x[i+k] : 1.0f;
+		}
+		f4storeu(tr, f4atan2(f4loadu(ty), f4loadu(tx)));
+		for (long k=0; k<m; k++) result[i+k] = tr[k];
+	}
+}
@@ -16,9 +16,13 @@
 //-----------------------------------------------------------------------------
 
 #include <Core/SystemConfiguration.h>
+#include <type_traits>
+using namespace std;
 #include <Math/Matrix4x4.h>
 #include <Math/Quaternion.h>
 
+static_assert(is_trivially_copyable<Matrix4x4>::value, "Matrix4x4 must stay trivially copyable");
+
 ostream& operator<<(ostream& out, Matrix4x4& m)
 {
 	out << "Matrix[" 
@@ -145,16 +149,16 @@ Matrix4x4 Matrix4x4::rotationYXZ(float rx, float ry, float rz)
 	M.m[12] = 0.0f;	M.m[13] = 0.0f;	M.m[14] = 0.0f;	M.m[15] = 1.0f;
 	return M;
 }
-//	rotationYZX = Rz*Ry*Rx 
+//	rotationYZX = Rx*Rz*Ry 
 Matrix4x4 Matrix4x4::rotationYZX(float rx, float ry, float rz)
 {
 	Matrix4x4 M;
 	float sx = sin(rx), sy = sin(ry), sz = sin(rz);
 	float cx = cos(rx), cy = cos(ry), cz = cos(rz);
 
-	M.m[0] = cy*cz; M.m[4] = cz*sx*sy - cx*sz; M.m[8] = cx*cz*sy + sx*sz;
-	M.m[1] = cy*sz; M.m[5] = cx*cz + sx*sy*sz; M.m[9] = -cz*sx + cx*sy*sz;
-	M.m[2] = -sy;   M.m[6] = cy*sx;            M.m[10] = cx*cy;
+	M.m[0] = cy*cz;             M.m[4] = -sz;    M.m[8] = cz*sy;
+	M.m[1] = cx*cy*sz + sx*sy;  M.m[5] = cx*cz;  M.m[9] = cx*sy*sz - cy*sx;
+	M.m[2] = cy*sx*sz - cx*sy;  M.m[6] = cz*sx;  M.m[10] = cx*cy + sx*sy*sz;
 
 	M.m[3] = 0.0f; M.m[7] = 0.0f; M.m[11] = 0.0f;
 	M.m[12] = 0.0f;	M.m[13] = 0.0f;	M.m[14] = 0.0f;	M.m[15] = 1.0f;
@@ -230,7 +234,7 @@ bool Matrix4x4::factorEulerXYZ(float& rx, float& ry, float& rz)
 	else { // m[2] == +1
 		// not a unique solution: rx+rz = atan2(-m[9],m[5])
 		ry = -HALF_PI;
-		rz = -atan2(-m[9], m[5]);
+		rz = atan2(-m[9], m[5]);
 		rx = 0.0f;
 		return false;
 	}
@@ -370,3 +374,272 @@ bool Matrix4x4::factorEulerZYX(float& rx, float& ry, float& rz)
 		return false;
 	}
 }
+
+bool Matrix4x4::factorEuler(float& rx, float& ry, float& rz, EULER_ORDER order)
+{
+	switch (order)
+	{
+	case EULER_XYZ: return factorEulerXYZ(rx, ry, rz);
+	case EULER_XZY: return factorEulerXZY(rx, ry, rz);
+	case EULER_YXZ: return factorEulerYXZ(rx, ry, rz);
+	case EULER_YZX: return factorEulerYZX(rx, ry, rz);
+	case EULER_ZXY: return factorEulerZXY(rx, ry, rz);
+	case EULER_ZYX: return factorEulerZYX(rx, ry, rz);
+	}
+	return false;
+}
+
+Matrix4x4 Matrix4x4::rotationEuler(float rx, float ry, float rz, EULER_ORDER order)
+{
+	switch (order)
+	{
+	case EULER_XYZ: return rotationXYZ(rx, ry, rz);
+	case EULER_XZY: return rotationXZY(rx, ry, rz);
+	case EULER_YXZ: return rotationYXZ(rx, ry, rz);
+	case EULER_YZX: return rotationYZX(rx, ry, rz);
+	case EULER_ZXY: return rotationZXY(rx, ry, rz);
+	case EULER_ZYX: return rotationZYX(rx, ry, rz);
+	}
+	return identity();
+}
+
+// 3x3 rotation parts of four matrices, one per lane
+struct Rotation4
+{
+	Float4 r[3][3];
+};
+
+static inline Rotation4 rotation4Multiply(const Rotation4& a, const Rotation4& b)
+{
+	Rotation4 p;
+	for (int i=0; i<3; i++)
+		for (int j=0; j<3; j++)
+			p.r[i][j] = f4add(f4add(f4mul(a.r[i][0], b.r[0][j]), f4mul(a.r[i][1], b.r[1][j])), f4mul(a.r[i][2], b.r[2][j]));
+	return p;
+}
+
+// axes applied first, second and third for each EULER_ORDER (0=x, 1=y, 2=z)
+static const int euler_axes[6][3] = {
+	{ 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+
+void Matrix4x4::rotationBatch(const float* rx, const float* ry, const float* rz, long n,
+	EULER_ORDER order, Matrix4x4* out, TRIG_PRECISION precision)
+{
+	const float* angles[3] = { rx, ry, rz };
+	Float4 zero = f4zero();
+	Float4 one = f4set1(1.0f);
+	float t[4];
+	for (long i=0; i<n; i+=4)
+	{
+		long m = (n-i < 4) ? n-i : 4;
+		Rotation4 axis[3];
+		for (int a=0; a<3; a++)
+		{
+			for (long k=0; k<4; k++) t[k] = (k < m) ? angles[a][i+k] : 0.0f;
+			Float4 s, c;
+			f4sincos(f4loadu(t), s, c, precision);
+			// rotation about axis a: cosines on the other two diagonal entries
+			int u = (a+1)%3, v = (a+2)%3;
+			Rotation4& R = axis[a];
+			R.r[a][a] = one; R.r[a][u] = zero; R.r[a][v] = zero;
+			R.r[u][a] = zero; R.r[u][u] = c; R.r[u][v] = f4neg(s);
+			R.r[v][a] = zero; R.r[v][u] = s; R.r[v][v] = c;
+		}
+		// the first rotation applied is the rightmost factor
+		const int* axes = euler_axes[order];
+		Rotation4 R = rotation4Multiply(axis[axes[2]], rotation4Multiply(axis[axes[1]], axis[axes[0]]));
+
+		float e[3][3][4];
+		for (int row=0; row<3; row++)
+			for (int col=0; col<3; col++)
+				f4storeu(e[row][col], R.r[row][col]);
+		for (long k=0; k<m; k++)
+		{
+			Matrix4x4& M = out[i+k];
+			M = identity();
+			for (int row=0; row<3; row++)
+				for (int col=0; col<3; col++)
+					M(row, col) = e[row][col][k];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Batch factoring works for all orders at once. With axes i, j, k applied
+//   first, second and third (M = Rk*Rj*Ri) and p = +1 when (i,j,k) is a
+//   cyclic order of (x,y,z), -1 otherwise:
+//     M[k][i] = -p*sin(aj)
+//     ai = atan2(p*M[k][j], M[k][k])
+//     ak = atan2(p*M[j][i], M[i][i])
+//   When cos(aj) is zero, ai is set to zero and M = Rk*Rj, whose column j
+//   is Rk applied to axis j, so ak = atan2(-p*M[i][j], M[j][j]).
+//   aj is taken as atan2(sin(aj), cos(aj)) rather than asin(), which keeps
+//   it accurate near the poles.
+//-----------------------------------------------------------------------------
+
+// below this cos(aj) is treated as zero (|sin(aj)| rounds to 1)
+static const float EULER_SINGULAR_LIMIT = 1.0e-6f;
+
+long Matrix4x4::factorEulerBatch(const Matrix4x4* in, long n, EULER_ORDER order,
+	float* rx, float* ry, float* rz, bool* unique)
+{
+	const int* axes = euler_axes[order];
+	int ai = axes[0], aj = axes[1], ak = axes[2];
+	bool cyclic = (aj == (ai+1)%3);
+	Float4 p = f4set1(cyclic ? 1.0f : -1.0f);
+	float* angles[3] = { rx, ry, rz };
+	long singular_count = 0;
+	float e[3][3][4];
+	float t[3][4];
+	for (long i=0; i<n; i+=4)
+	{
+		long m = (n-i < 4) ? n-i : 4;
+		// gather the 3x3 rotation parts, padding lanes with identity
+		for (long k=0; k<4; k++)
+		{
+			for (int row=0; row<3; row++)
+				for (int col=0; col<3; col++)
+					e[row][col][k] = (k < m) ? in[i+k](row, col) : ((row == col) ? 1.0f : 0.0f);
+		}
+		Float4 r[3][3];
+		for (int row=0; row<3; row++)
+			for (int col=0; col<3; col++)
+				r[row][col] = f4loadu(e[row][col]);
+
+		Float4 y_i = f4mul(p, r[ak][aj]);
+		Float4 x_i = r[ak][ak];
+		Float4 sin_j = f4neg(f4mul(p, r[ak][ai]));
+		Float4 cos_j = f4sqrt(f4madd(y_i, y_i, f4mul(x_i, x_i)));
+		Float4 singular = f4cmplt(cos_j, f4set1(EULER_SINGULAR_LIMIT));
+
+		Float4 angle_i = f4atan2(y_i, x_i);
+		Float4 angle_j = f4atan2(sin_j, cos_j);
+		Float4 angle_k = f4atan2(f4mul(p, r[aj][ai]), r[ai][ai]);
+		Float4 locked_k = f4atan2(f4neg(f4mul(p, r[ai][aj])), r[aj][aj]);
+		angle_i = f4andnot(singular, angle_i);
+		angle_k = f4select(singular, locked_k, angle_k);
+
+		f4storeu(t[ai], angle_i);
+		f4storeu(t[aj], angle_j);
+		f4storeu(t[ak], angle_k);
+		int singular_bits = f4movemask(singular);
+		for (long k=0; k<m; k++)
+		{
+			for (int a=0; a<3; a++) angles[a][i+k] = t[a][k];
+			bool is_singular = (singular_bits & (1 << k)) != 0;
+			if (unique != NULL) unique[i+k] = !is_singular;
+			if (is_singular) singular_count++;
+		}
+	}
+	return singular_count;
+}
+
+//-----------------------------------------------------------------------------
+// rigid inverse and batch operations
+//-----------------------------------------------------------------------------
+
+Matrix4x4 Matrix4x4::inverseRigid() const
+{
+	Matrix4x4 M;
+#if SKA_SSE==1
+	__m128 c0 = _mm_loadu_ps(m);
+	__m128 c1 = _mm_loadu_ps(m+4);
+	__m128 c2 = _mm_loadu_ps(m+8);
+	__m128 c3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	// c0..c2 now hold the rows of R (with a zero in the last lane), c3 is zero
+	__m128 t = _mm_mul_ps(c0, _mm_set1_ps(m[12]));
+	t = _mm_add_ps(t, _mm_mul_ps(c1, _mm_set1_ps(m[13])));
+	t = _mm_add_ps(t, _mm_mul_ps(c2, _mm_set1_ps(m[14])));
+	_mm_storeu_ps(M.m,    c0);
+	_mm_storeu_ps(M.m+4,  c1);
+	_mm_storeu_ps(M.m+8,  c2);
+	_mm_storeu_ps(M.m+12, _mm_sub_ps(c3, t));
+#else
+	M.m[0] = m[0]; M.m[4] = m[1]; M.m[8]  = m[2];
+	M.m[1] = m[4]; M.m[5] = m[5]; M.m[9]  = m[6];
+	M.m[2] = m[8]; M.m[6] = m[9]; M.m[10] = m[10];
+	M.m[12] = -(M.m[0]*m[12] + M.m[4]*m[13] + M.m[8]*m[14]);
+	M.m[13] = -(M.m[1]*m[12] + M.m[5]*m[13] + M.m[9]*m[14]);
+	M.m[14] = -(M.m[2]*m[12] + M.m[6]*m[13] + M.m[10]*m[14]);
+#endif
+	M.m[15] = 1.0f;
+	return M;
+}
+
+// r = M * (x,y,z,w) for an affine M, where w is 1 for points and 0 for vectors
+static inline void affineTransform(const Matrix4x4& M, float x, float y, float z, bool point, float* r)
+{
+#if SKA_SSE==1
+	__m128 v = _mm_mul_ps(_mm_loadu_ps(M.m), _mm_set1_ps(x));
+	v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(M.m+4), _mm_set1_ps(y)));
+	v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(M.m+8), _mm_set1_ps(z)));
+	if (point) v = _mm_add_ps(v, _mm_loadu_ps(M.m+12));
+	_mm_storeu_ps(r, v);
+#else
+	r[0] = M.m[0]*x + M.m[4]*y + M.m[8]*z;
+	r[1] = M.m[1]*x + M.m[5]*y + M.m[9]*z;
+	r[2] = M.m[2]*x + M.m[6]*y + M.m[10]*z;
+	if (point) { r[0] += M.m[12]; r[1] += M.m[13]; r[2] += M.m[14]; }
+#endif
+}
+
+static void transformVector3D(const Matrix4x4& M, const Vector3D* in, Vector3D* out, long n, bool point)
+{
+	float r[4];
+	for (long i=0; i<n; i++)
+	{
+		affineTransform(M, in[i].x, in[i].y, in[i].z, point, r);
+		out[i].x = r[0]; out[i].y = r[1]; out[i].z = r[2];
+	}
+}
+
+static void transformPacked(const Matrix4x4& M, const float* in, float* out, long n, bool point)
+{
+	float r[4];
+	for (long i=0; i<3*n; i+=3)
+	{
+		affineTransform(M, in[i], in[i+1], in[i+2], point, r);
+		out[i] = r[0]; out[i+1] = r[1]; out[i+2] = r[2];
+	}
+}
+
+void Matrix4x4::transformPoints(const Matrix4x4& M, const Vector3D* in, Vector3D* out, long n)
+{
+	transformVector3D(M, in, out, n, true);
+}
+
+void Matrix4x4::transformVectors(const Matrix4x4& M, const Vector3D* in, Vector3D* out, long n)
+{
+	transformVector3D(M, in, out, n, false);
+}
+
+void Matrix4x4::transformPoints(const Matrix4x4& M, const float* in, float* out, long n)
+{
+	transformPacked(M, in, out, n, true);
+}
+
+void Matrix4x4::transformVectors(const Matrix4x4& M, const float* in, float* out, long n)
+{
+	transformPacked(M, in, out, n, false);
+}
+
+void Matrix4x4::multiplyArrays(const Matrix4x4* A, const Matrix4x4* B, Matrix4x4* out, long n)
+{
+	for (long i=0; i<n; i++) product(A[i], B[i], out[i]);
+}
+
+void Matrix4x4::premultiplyArray(const Matrix4x4& A, const Matrix4x4* B, Matrix4x4* out, long n)
+{
+	for (long i=0; i<n; i++) product(A, B[i], out[i]);
+}
+
+void Matrix4x4::composeHierarchy(const Matrix4x4& base, const Matrix4x4* local,
+	const short* parent, Matrix4x4* world, long n)
+{
+	for (long i=0; i<n; i++)
+	{
+		if ((parent[i] < 0) || (parent[i] >= i)) product(base, local[i], world[i]);
+		else product(world[parent[i]], local[i], world[i]);
+	}
+}
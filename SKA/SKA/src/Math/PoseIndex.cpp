@@ -0,0 +1,520 @@
+//-----------------------------------------------------------------------------
+// PoseIndex.cpp
+//	 Nearest neighbour index over pose feature vectors.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+#include <Math/PoseIndex.h>
+#include <Math/Math.h>
+#include <Core/Parallel.h>
+#include <DataManagement/BinaryStream.h>
+
+/*==========================================================================
+Pose index file layout (all values little-endian)
+   char[8]  magic "SKAPIDX"
+   u32      version
+   u32      dim, reduced_dim, tree_depth
+   u64      number of items
+   f32      explained variance
+   f32      mean[dim], axes[reduced_dim*dim]
+   u32      split_dim[2^tree_depth - 1]
+   f32      split_value[2^tree_depth - 1], points[items*reduced_dim]
+   u64      ids[items]
+==========================================================================*/
+
+static const char POSE_INDEX_MAGIC[8] = { 'S','K','A','P','I','D','X','\0' };
+static const unsigned int POSE_INDEX_VERSION = 1;
+
+// most points in a leaf of the KD-tree
+static const long LEAF_SIZE = 16;
+// the covariance is estimated from at most this many items
+static const long PCA_MAX_SAMPLES = 65536;
+// items per parallel work item when projecting or searching
+static const long PARALLEL_MIN_BLOCK = 256;
+
+// Eigen decomposition of the symmetric n by n matrix a (row major) by
+// cyclic Jacobi rotations. Eigenvalues go to values and the matching
+// eigenvectors to the columns of vectors. a is destroyed.
+static void symmetricEigen(vector<double>& a, int n, vector<double>& values, vector<double>& vectors)
+{
+	vectors.assign(n*n, 0.0);
+	for (int i=0; i<n; i++) vectors[i*n+i] = 1.0;
+	for (int sweep=0; sweep<100; sweep++)
+	{
+		double off = 0.0, total = 0.0;
+		for (int i=0; i<n; i++)
+			for (int j=0; j<n; j++)
+			{
+				total += a[i*n+j]*a[i*n+j];
+				if (i != j) off += a[i*n+j]*a[i*n+j];
+			}
+		if (off <= 1e-24*total) break;
+		for (int p=0; p<n-1; p++)
+		{
+			for (int q=p+1; q<n; q++)
+			{
+				double apq = a[p*n+q];
+				if (apq == 0.0) continue;
+				double theta = (a[q*n+q] - a[p*n+p])/(2.0*apq);
+				double t = ((theta >= 0.0) ? 1.0 : -1.0)/(fabs(theta) + sqrt(theta*theta + 1.0));
+				double c = 1.0/sqrt(t*t + 1.0), s = t*c;
+				for (int k=0; k<n; k++)
+				{
+					double akp = a[k*n+p], akq = a[k*n+q];
+					a[k*n+p] = c*akp - s*akq;
+					a[k*n+q] = s*akp + c*akq;
+				}
+				for (int k=0; k<n; k++)
+				{
+					double apk = a[p*n+k], aqk = a[q*n+k];
+					a[p*n+k] = c*apk - s*aqk;
+					a[q*n+k] = s*apk + c*aqk;
+				}
+				for (int k=0; k<n; k++)
+				{
+					double vkp = vectors[k*n+p], vkq = vectors[k*n+q];
+					vectors[k*n+p] = c*vkp - s*vkq;
+					vectors[k*n+q] = s*vkp + c*vkq;
+				}
+			}
+		}
+	}
+	values.resize(n);
+	for (int i=0; i<n; i++) values[i] = a[i*n+i];
+}
+
+PoseIndex::PoseIndex()
+	: dim(0), reduced_dim(0), num_items(0), explained_variance(0.0f), tree_depth(0)
+{ }
+
+void PoseIndex::clear()
+{
+	dim = reduced_dim = 0;
+	num_items = 0;
+	explained_variance = 0.0f;
+	tree_depth = 0;
+	mean.clear();
+	axes.clear();
+	split_dim.clear();
+	split_value.clear();
+	points.clear();
+	ids.clear();
+}
+
+void PoseIndex::build(const float* features, long n, int _dim, int _reduced_dim,
+	float variance_fraction, int max_threads)
+{
+	if ((n < 1) || (_dim < 1)) throw MathException("PoseIndex::build: no items to index");
+	clear();
+	dim = _dim;
+	num_items = n;
+
+	// mean and covariance, from evenly spaced samples
+	long step = (n + PCA_MAX_SAMPLES - 1)/PCA_MAX_SAMPLES;
+	long samples = (n + step - 1)/step;
+	vector<double> mean_d(dim, 0.0);
+	for (long s=0; s<samples; s++)
+		for (int d=0; d<dim; d++) mean_d[d] += features[s*step*dim + d];
+	mean.resize(dim);
+	for (int d=0; d<dim; d++) { mean_d[d] /= samples; mean[d] = float(mean_d[d]); }
+
+	int num_chunks = parallelThreadCount(max_threads);
+	vector<vector<double> > partial(num_chunks, vector<double>(dim*dim, 0.0));
+	parallelFor(0, num_chunks, [&](long chunk)
+	{
+		vector<double>& cov = partial[chunk];
+		vector<double> x(dim);
+		for (long s=chunk; s<samples; s+=num_chunks)
+		{
+			const float* f = features + s*step*dim;
+			for (int d=0; d<dim; d++) x[d] = f[d] - mean_d[d];
+			for (int i=0; i<dim; i++)
+				for (int j=i; j<dim; j++) cov[i*dim+j] += x[i]*x[j];
+		}
+	}, 1, max_threads);
+	vector<double> cov(dim*dim, 0.0);
+	for (int c=0; c<num_chunks; c++)
+		for (int i=0; i<dim*dim; i++) cov[i] += partial[c][i];
+	for (int i=0; i<dim; i++)
+		for (int j=i; j<dim; j++) cov[j*dim+i] = cov[i*dim+j] /= samples;
+
+	vector<double> values, vectors;
+	symmetricEigen(cov, dim, values, vectors);
+	vector<int> rank(dim);
+	for (int i=0; i<dim; i++) rank[i] = i;
+	sort(rank.begin(), rank.end(), [&](int a, int b) { return values[a] > values[b]; });
+	double total = 0.0;
+	for (int i=0; i<dim; i++) total += max(values[i], 0.0);
+
+	if (_reduced_dim > 0) reduced_dim = min(_reduced_dim, dim);
+	else
+	{
+		double kept = 0.0;
+		reduced_dim = 0;
+		while ((reduced_dim < dim) && ((reduced_dim == 0) || (kept < variance_fraction*total)))
+			kept += max(values[rank[reduced_dim++]], 0.0);
+	}
+	double kept = 0.0;
+	axes.resize(reduced_dim*dim);
+	for (int r=0; r<reduced_dim; r++)
+	{
+		kept += max(values[rank[r]], 0.0);
+		for (int d=0; d<dim; d++) axes[r*dim+d] = float(vectors[d*dim + rank[r]]);
+	}
+	explained_variance = (total > 0.0) ? float(kept/total) : 1.0f;
+
+	// reduce every item
+	vector<float> reduced(n*reduced_dim);
+	parallelForBlocks(0, n, [&](long b, long e)
+	{
+		for (long i=b; i<e; i++) project(features + i*dim, &reduced[i*reduced_dim]);
+	}, PARALLEL_MIN_BLOCK, max_threads);
+
+	// tree depth that leaves at most LEAF_SIZE points per leaf
+	tree_depth = 0;
+	while (((n + (1L << tree_depth) - 1) >> tree_depth) > LEAF_SIZE) tree_depth++;
+	long num_internal = (1L << tree_depth) - 1;
+	split_dim.assign(num_internal, 0);
+	split_value.assign(num_internal, 0.0f);
+
+	// top levels on this thread, then one subtree per task
+	vector<long> order(n);
+	for (long i=0; i<n; i++) order[i] = i;
+	int parallel_depth = 0;
+	while (((1 << parallel_depth) < 4*parallelThreadCount(max_threads)) && (parallel_depth < tree_depth))
+		parallel_depth++;
+	vector<long> frontier;
+	buildNode(0, 0, 0, n, order, reduced, parallel_depth, &frontier);
+	long num_tasks = long(frontier.size())/3;
+	parallelFor(0, num_tasks, [&](long t)
+	{
+		buildNode(frontier[3*t], parallel_depth, frontier[3*t+1], frontier[3*t+2], order, reduced, tree_depth, NULL);
+	}, 1, max_threads);
+
+	// points in tree order, so each leaf is contiguous
+	points.resize(n*reduced_dim);
+	ids.swap(order);
+	for (long i=0; i<n; i++)
+		memcpy(&points[i*reduced_dim], &reduced[ids[i]*reduced_dim], reduced_dim*sizeof(float));
+}
+
+void PoseIndex::buildNode(long node, int depth, long begin, long end, vector<long>& order,
+	const vector<float>& reduced, int stop_depth, vector<long>* frontier)
+{
+	if (depth == tree_depth) return;
+	if (depth == stop_depth)
+	{
+		frontier->push_back(node);
+		frontier->push_back(begin);
+		frontier->push_back(end);
+		return;
+	}
+	// split the reduced dimension with the largest spread at the median
+	int best = 0;
+	float best_spread = -1.0f;
+	for (int d=0; d<reduced_dim; d++)
+	{
+		float lo = reduced[order[begin]*reduced_dim + d], hi = lo;
+		for (long i=begin+1; i<end; i++)
+		{
+			float v = reduced[order[i]*reduced_dim + d];
+			lo = min(lo, v);
+			hi = max(hi, v);
+		}
+		if (hi - lo > best_spread) { best_spread = hi - lo; best = d; }
+	}
+	long mid = begin + (end - begin)/2;
+	int rd = reduced_dim;
+	nth_element(order.begin()+begin, order.begin()+mid, order.begin()+end,
+		[&](long a, long b) { return reduced[a*rd + best] < reduced[b*rd + best]; });
+	split_dim[node] = best;
+	split_value[node] = reduced[order[mid]*reduced_dim + best];
+	buildNode(2*node+1, depth+1, begin, mid, order, reduced, stop_depth, frontier);
+	buildNode(2*node+2, depth+1, mid, end, order, reduced, stop_depth, frontier);
+}
+
+void PoseIndex::project(const float* feature, float* reduced) const
+{
+	for (int r=0; r<reduced_dim; r++)
+	{
+		const float* axis = &axes[r*dim];
+		float sum = 0.0f;
+		for (int d=0; d<dim; d++) sum += axis[d]*(feature[d] - mean[d]);
+		reduced[r] = sum;
+	}
+}
+
+void PoseIndex::searchRadius(const float* q, float radius2, vector<long>& result) const
+{
+	float radius = sqrt(radius2);
+	// depth first; each step replaces a node by at most two children, so
+	// the stack never holds more than tree_depth+1 entries
+	struct Pending { long node, begin, end; int depth; };
+	Pending stack[64];
+	int top = 0;
+	Pending root = { 0, 0, num_items, 0 };
+	stack[top++] = root;
+	while (top > 0)
+	{
+		Pending p = stack[--top];
+		if (p.depth == tree_depth)
+		{
+			for (long i=p.begin; i<p.end; i++)
+			{
+				const float* x = &points[i*reduced_dim];
+				float d2 = 0.0f;
+				for (int r=0; (r<reduced_dim) && (d2<=radius2); r++)
+				{
+					float t = x[r] - q[r];
+					d2 += t*t;
+				}
+				if (d2 <= radius2) result.push_back(ids[i]);
+			}
+			continue;
+		}
+		long mid = p.begin + (p.end - p.begin)/2;
+		float diff = q[split_dim[p.node]] - split_value[p.node];
+		if (diff <= radius)
+		{
+			Pending left = { 2*p.node+1, p.begin, mid, p.depth+1 };
+			stack[top++] = left;
+		}
+		if (diff >= -radius)
+		{
+			Pending right = { 2*p.node+2, mid, p.end, p.depth+1 };
+			stack[top++] = right;
+		}
+	}
+}
+
+void PoseIndex::radiusSearch(const float* feature, float radius, vector<long>& result) const
+{
+	if (num_items == 0) return;
+	vector<float> q(reduced_dim);
+	project(feature, &q[0]);
+	searchRadius(&q[0], radius*radius, result);
+}
+
+void PoseIndex::radiusSearchBatch(const float* features, long m, float radius,
+	vector<vector<long> >& results, int max_threads) const
+{
+	results.assign(m, vector<long>());
+	if (num_items == 0) return;
+	parallelForBlocks(0, m, [&](long b, long e)
+	{
+		vector<float> q(reduced_dim);
+		for (long i=b; i<e; i++)
+		{
+			project(features + i*dim, &q[0]);
+			searchRadius(&q[0], radius*radius, results[i]);
+		}
+	}, 16, max_threads);
+}
+
+struct IndexedDistance
+{
+	float d2;
+	long id;
+	bool operator<(const IndexedDistance& rhs) const { return d2 < rhs.d2; }
+};
+
+void PoseIndex::nearest(const float* feature, int k, vector<long>& result, vector<float>* distances,
+	long exclude_begin, long exclude_end) const
+{
+	result.clear();
+	if (distances != NULL) distances->clear();
+	if ((num_items == 0) || (k < 1)) return;
+	vector<float> q(reduced_dim);
+	project(feature, &q[0]);
+
+	// max-heap of the best k so far; subtrees are visited near side first
+	// and the far side is skipped once it cannot hold anything closer
+	vector<IndexedDistance> best;
+	struct Pending { long node, begin, end; int depth; float bound; };
+	vector<Pending> stack;
+	Pending root = { 0, 0, num_items, 0, 0.0f };
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		Pending p = stack.back();
+		stack.pop_back();
+		if ((int(best.size()) == k) && (p.bound > best.front().d2)) continue;
+		if (p.depth == tree_depth)
+		{
+			for (long i=p.begin; i<p.end; i++)
+			{
+				if ((ids[i] >= exclude_begin) && (ids[i] < exclude_end)) continue;
+				const float* x = &points[i*reduced_dim];
+				float d2 = 0.0f;
+				for (int r=0; r<reduced_dim; r++) { float t = x[r] - q[r]; d2 += t*t; }
+				if (int(best.size()) < k)
+				{
+					IndexedDistance c = { d2, ids[i] };
+					best.push_back(c);
+					push_heap(best.begin(), best.end());
+				}
+				else if (d2 < best.front().d2)
+				{
+					pop_heap(best.begin(), best.end());
+					best.back().d2 = d2;
+					best.back().id = ids[i];
+					push_heap(best.begin(), best.end());
+				}
+			}
+			continue;
+		}
+		long mid = p.begin + (p.end - p.begin)/2;
+		float diff = q[split_dim[p.node]] - split_value[p.node];
+		Pending left = { 2*p.node+1, p.begin, mid, p.depth+1, p.bound };
+		Pending right = { 2*p.node+2, mid, p.end, p.depth+1, p.bound };
+		if (diff <= 0.0f) right.bound = max(p.bound, diff*diff);
+		else left.bound = max(p.bound, diff*diff);
+		// the near side goes on the stack last so it is searched first
+		if (diff <= 0.0f) { stack.push_back(right); stack.push_back(left); }
+		else { stack.push_back(left); stack.push_back(right); }
+	}
+	sort_heap(best.begin(), best.end());
+	for (unsigned int i=0; i<best.size(); i++)
+	{
+		result.push_back(best[i].id);
+		if (distances != NULL) distances->push_back(sqrt(best[i].d2));
+	}
+}
+
+long PoseIndex::nearestWithin(const float* feature, float max_distance, float* distance) const
+{
+	if (num_items == 0) return -1;
+	float local[64];
+	vector<float> heap_q;
+	float* q = local;
+	if (reduced_dim > 64)
+	{
+		heap_q.resize(reduced_dim);
+		q = &heap_q[0];
+	}
+	project(feature, q);
+
+	// as nearest() with k = 1, starting from the given bound; points stop
+	// accumulating as soon as they pass the best distance
+	long best = -1;
+	float best_d2 = max_distance*max_distance;
+	struct Pending { long node, begin, end; int depth; float bound; };
+	Pending stack[64];
+	int top = 0;
+	Pending root = { 0, 0, num_items, 0, 0.0f };
+	stack[top++] = root;
+	while (top > 0)
+	{
+		Pending p = stack[--top];
+		if (p.bound >= best_d2) continue;
+		if (p.depth == tree_depth)
+		{
+			for (long i=p.begin; i<p.end; i++)
+			{
+				const float* x = &points[i*reduced_dim];
+				float d2 = 0.0f;
+				for (int r=0; (r<reduced_dim) && (d2<best_d2); r++)
+				{
+					float t = x[r] - q[r];
+					d2 += t*t;
+				}
+				if (d2 < best_d2) { best_d2 = d2; best = ids[i]; }
+			}
+			continue;
+		}
+		long mid = p.begin + (p.end - p.begin)/2;
+		float diff = q[split_dim[p.node]] - split_value[p.node];
+		Pending left = { 2*p.node+1, p.begin, mid, p.depth+1, p.bound };
+		Pending right = { 2*p.node+2, mid, p.end, p.depth+1, p.bound };
+		if (diff <= 0.0f) right.bound = max(p.bound, diff*diff);
+		else left.bound = max(p.bound, diff*diff);
+		if (diff <= 0.0f) { stack[top++] = right; stack[top++] = left; }
+		else { stack[top++] = left; stack[top++] = right; }
+	}
+	if ((best >= 0) && (distance != NULL)) *distance = sqrt(best_d2);
+	return best;
+}
+
+bool PoseIndex::save(const char* filename) const
+{
+	ByteWriter w;
+	w.putBytes(POSE_INDEX_MAGIC, 8);
+	w.putU32(POSE_INDEX_VERSION);
+	w.putU32((unsigned int)dim);
+	w.putU32((unsigned int)reduced_dim);
+	w.putU32((unsigned int)tree_depth);
+	w.putU64((unsigned long long)num_items);
+	w.putF32(explained_variance);
+	for (unsigned int i=0; i<mean.size(); i++) w.putF32(mean[i]);
+	for (unsigned int i=0; i<axes.size(); i++) w.putF32(axes[i]);
+	for (unsigned int i=0; i<split_dim.size(); i++) w.putU32((unsigned int)split_dim[i]);
+	for (unsigned int i=0; i<split_value.size(); i++) w.putF32(split_value[i]);
+	for (unsigned long i=0; i<points.size(); i++) w.putF32(points[i]);
+	for (unsigned long i=0; i<ids.size(); i++) w.putU64((unsigned long long)ids[i]);
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL) return false;
+	bool ok = (fwrite(&w.bytes[0], 1, w.bytes.size(), fp) == w.bytes.size());
+	if (fclose(fp) != 0) ok = false;
+	return ok;
+}
+
+bool PoseIndex::load(const char* filename)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) return false;
+	vector<unsigned char> bytes;
+	unsigned char buffer[1<<16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer+n);
+	fclose(fp);
+	if (bytes.size() < 40) return false;
+
+	ByteReader r(&bytes[0], long(bytes.size()));
+	if ((memcmp(r.getBytes(8), POSE_INDEX_MAGIC, 8) != 0) || (r.getU32() != POSE_INDEX_VERSION)) return false;
+	PoseIndex index;
+	index.dim = int(r.getU32());
+	index.reduced_dim = int(r.getU32());
+	index.tree_depth = int(r.getU32());
+	index.num_items = long(r.getU64());
+	index.explained_variance = r.getF32();
+	if ((index.reduced_dim > index.dim) || (index.tree_depth > 40)) return false;
+	long num_internal = (1L << index.tree_depth) - 1;
+	long num_points = index.num_items*index.reduced_dim;
+	// check the size before allocating anything
+	long expected = 4L*(index.dim + long(index.reduced_dim)*index.dim + 2*num_internal + num_points) + 8L*index.num_items;
+	if (r.remaining() != expected) return false;
+	index.mean.resize(index.dim);
+	for (int i=0; i<index.dim; i++) index.mean[i] = r.getF32();
+	index.axes.resize(index.reduced_dim*index.dim);
+	for (unsigned int i=0; i<index.axes.size(); i++) index.axes[i] = r.getF32();
+	index.split_dim.resize(num_internal);
+	for (long i=0; i<num_internal; i++)
+	{
+		index.split_dim[i] = int(r.getU32());
+		if (index.split_dim[i] >= index.reduced_dim) return false;
+	}
+	index.split_value.resize(num_internal);
+	for (long i=0; i<num_internal; i++) index.split_value[i] = r.getF32();
+	index.points.resize(num_points);
+	for (long i=0; i<num_points; i++) index.points[i] = r.getF32();
+	index.ids.resize(index.num_items);
+	for (long i=0; i<index.num_items; i++) index.ids[i] = long(r.getU64());
+	if (!r.good()) return false;
+	*this = index;
+	return true;
+}
@@ -74,22 +74,6 @@ Quaternion::Quaternion(const Matrix4x4& rotation)
     }
 } 
 
-// Copy constructor
-Quaternion::Quaternion(const Quaternion& other) : 
-    w( other.w ), x( other.x ), y( other.y ), z( other.z )
-{}
-
-// Assignment operator
-Quaternion& Quaternion::operator=(const Quaternion& other)
-{
-    if ( this == &other ) return *this;
-    w = other.w;
-    x = other.x;
-    y = other.y;
-    z = other.z;
-    return *this;
-}
-
 // Text representation
 ostream& operator<<(ostream& out, const Quaternion& source)
 {
@@ -0,0 +1,538 @@
+//-----------------------------------------------------------------------------
+// QuaternionArray.cpp
+//	 Array of quaternions stored as four separate component arrays.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+#include <Math/QuaternionArray.h>
+#include <Math/Float4.h>
+#include <Math/BatchTrig.h>
+
+// four quaternions, one per lane
+struct Quat4
+{
+	Float4 w, x, y, z;
+};
+
+static inline Quat4 quat4Multiply(const Quat4& a, const Quat4& b)
+{
+	Quat4 r;
+	r.w = f4sub(f4sub(f4sub(f4mul(a.w, b.w), f4mul(a.x, b.x)), f4mul(a.y, b.y)), f4mul(a.z, b.z));
+	r.x = f4sub(f4add(f4add(f4mul(a.w, b.x), f4mul(a.x, b.w)), f4mul(a.y, b.z)), f4mul(a.z, b.y));
+	r.y = f4sub(f4add(f4add(f4mul(a.w, b.y), f4mul(a.y, b.w)), f4mul(a.z, b.x)), f4mul(a.x, b.z));
+	r.z = f4sub(f4add(f4add(f4mul(a.w, b.z), f4mul(a.z, b.w)), f4mul(a.x, b.y)), f4mul(a.y, b.x));
+	return r;
+}
+
+static inline Float4 quat4Dot(const Quat4& a, const Quat4& b)
+{
+	return f4add(f4add(f4add(f4mul(a.w, b.w), f4mul(a.x, b.x)), f4mul(a.y, b.y)), f4mul(a.z, b.z));
+}
+
+// sa*a + sb*b
+static inline Quat4 quat4Blend(Float4 sa, const Quat4& a, Float4 sb, const Quat4& b)
+{
+	Quat4 r;
+	r.w = f4add(f4mul(sa, a.w), f4mul(sb, b.w));
+	r.x = f4add(f4mul(sa, a.x), f4mul(sb, b.x));
+	r.y = f4add(f4mul(sa, a.y), f4mul(sb, b.y));
+	r.z = f4add(f4mul(sa, a.z), f4mul(sb, b.z));
+	return r;
+}
+
+// Zero length quaternions become zero.
+static inline Quat4 quat4Normalize(const Quat4& q)
+{
+	Float4 len2 = quat4Dot(q, q);
+	Float4 nonzero = f4cmpge(len2, f4set1(EPSILON));
+	Float4 inv = f4and(nonzero, f4div(f4set1(1.0f), f4sqrt(len2)));
+	Quat4 r;
+	r.w = f4mul(q.w, inv);
+	r.x = f4mul(q.x, inv);
+	r.y = f4mul(q.y, inv);
+	r.z = f4mul(q.z, inv);
+	return r;
+}
+
+// acos(x) for x in [0,1], Abramowitz and Stegun 4.4.46 (error below 2e-8)
+static inline Float4 acosKernel(Float4 x)
+{
+	Float4 p = f4set1(-0.0012624911f);
+	p = f4madd(p, x, f4set1(0.0066700901f));
+	p = f4madd(p, x, f4set1(-0.0170881256f));
+	p = f4madd(p, x, f4set1(0.0308918810f));
+	p = f4madd(p, x, f4set1(-0.0501743046f));
+	p = f4madd(p, x, f4set1(0.0889789874f));
+	p = f4madd(p, x, f4set1(-0.2145988016f));
+	p = f4madd(p, x, f4set1(1.5707963050f));
+	return f4mul(p, f4sqrt(f4max(f4sub(f4set1(1.0f), x), f4zero())));
+}
+
+// store the first m (up to 4) lanes
+static inline void storeLanes(float* out, Float4 v, long m)
+{
+	if (m >= 4) { f4storeu(out, v); return; }
+	float t[4];
+	f4storeu(t, v);
+	for (long k=0; k<m; k++) out[k] = t[k];
+}
+
+// load the first m (up to 4) values, other lanes get the fill value
+static inline Float4 loadLanes(const float* in, long m, float fill)
+{
+	if (m >= 4) return f4loadu(in);
+	float t[4] = { fill, fill, fill, fill };
+	for (long k=0; k<m; k++) t[k] = in[k];
+	return f4loadu(t);
+}
+
+//-----------------------------------------------------------------------------
+
+QuaternionArray::QuaternionArray()
+	: count(0), capacity(0), buffer(NULL), cw(NULL), cx(NULL), cy(NULL), cz(NULL)
+{
+	allocate(0);
+}
+
+QuaternionArray::QuaternionArray(long n)
+	: count(0), capacity(0), buffer(NULL), cw(NULL), cx(NULL), cy(NULL), cz(NULL)
+{
+	allocate(n);
+}
+
+QuaternionArray::QuaternionArray(const QuaternionArray& other)
+	: count(0), capacity(0), buffer(NULL), cw(NULL), cx(NULL), cy(NULL), cz(NULL)
+{
+	allocate(other.count);
+	memcpy(cw, other.cw, 4*capacity*sizeof(float));
+}
+
+QuaternionArray& QuaternionArray::operator=(const QuaternionArray& other)
+{
+	if (this == &other) return *this;
+	if (capacity != other.capacity) allocate(other.count);
+	count = other.count;
+	memcpy(cw, other.cw, 4*capacity*sizeof(float));
+	return *this;
+}
+
+QuaternionArray::~QuaternionArray()
+{
+	delete [] buffer;
+}
+
+// new storage for n identity quaternions (the component arrays are consecutive)
+void QuaternionArray::allocate(long n)
+{
+	delete [] buffer;
+	count = n;
+	capacity = (n < 4) ? 4 : ((n+3) & ~3L);
+	buffer = new float[4*capacity + 4];
+	size_t misalign = (size_t(buffer) & 15) / sizeof(float);
+	cw = buffer + ((4 - misalign) & 3);
+	cx = cw + capacity;
+	cy = cx + capacity;
+	cz = cy + capacity;
+	setIdentity();
+}
+
+void QuaternionArray::resize(long n)
+{
+	if (n == count) return;
+	QuaternionArray old(*this);
+	allocate(n);
+	long keep = (old.count < n) ? old.count : n;
+	memcpy(cw, old.cw, keep*sizeof(float));
+	memcpy(cx, old.cx, keep*sizeof(float));
+	memcpy(cy, old.cy, keep*sizeof(float));
+	memcpy(cz, old.cz, keep*sizeof(float));
+}
+
+void QuaternionArray::setIdentity()
+{
+	for (long i=0; i<capacity; i++)
+	{
+		cw[i] = 1.0f; cx[i] = 0.0f; cy[i] = 0.0f; cz[i] = 0.0f;
+	}
+}
+
+void QuaternionArray::checkSize(const QuaternionArray& other, const char* function) const
+{
+	if (other.count != count)
+	{
+		string s = string("QuaternionArray::") + function + ": arrays have different sizes";
+		throw MathException(s.c_str());
+	}
+}
+
+void QuaternionArray::fromQuaternions(const Quaternion* q, long n)
+{
+	if (n != count) allocate(n);
+	for (long i=0; i<n; i++) set(i, q[i]);
+}
+
+void QuaternionArray::toQuaternions(Quaternion* q) const
+{
+	for (long i=0; i<count; i++) q[i] = get(i);
+}
+
+//-----------------------------------------------------------------------------
+// element-wise operations
+// Loops over the whole capacity are safe because the padding holds
+// identity quaternions, which every operation maps to identity.
+//-----------------------------------------------------------------------------
+
+#define LOAD_QUAT4(q, a, i) q.w = f4load(a.cw+i); q.x = f4load(a.cx+i); q.y = f4load(a.cy+i); q.z = f4load(a.cz+i)
+#define STORE_QUAT4(a, i, q) f4store(a.cw+i, q.w); f4store(a.cx+i, q.x); f4store(a.cy+i, q.y); f4store(a.cz+i, q.z)
+
+void QuaternionArray::multiply(const QuaternionArray& a, const QuaternionArray& b, QuaternionArray& result)
+{
+	a.checkSize(b, "multiply");
+	if (result.count != a.count) result.resize(a.count);
+	for (long i=0; i<a.capacity; i+=4)
+	{
+		Quat4 qa, qb;
+		LOAD_QUAT4(qa, a, i);
+		LOAD_QUAT4(qb, b, i);
+		Quat4 r = quat4Multiply(qa, qb);
+		STORE_QUAT4(result, i, r);
+	}
+}
+
+void QuaternionArray::conjugate()
+{
+	for (long i=0; i<capacity; i+=4)
+	{
+		f4store(cx+i, f4neg(f4load(cx+i)));
+		f4store(cy+i, f4neg(f4load(cy+i)));
+		f4store(cz+i, f4neg(f4load(cz+i)));
+	}
+}
+
+void QuaternionArray::normalize()
+{
+	for (long i=0; i<capacity; i+=4)
+	{
+		Quat4 q;
+		LOAD_QUAT4(q, (*this), i);
+		q = quat4Normalize(q);
+		STORE_QUAT4((*this), i, q);
+	}
+}
+
+void QuaternionArray::alignWith(const QuaternionArray& reference)
+{
+	checkSize(reference, "alignWith");
+	for (long i=0; i<capacity; i+=4)
+	{
+		Quat4 q, r;
+		LOAD_QUAT4(q, (*this), i);
+		LOAD_QUAT4(r, reference, i);
+		Float4 sign = f4signbit(quat4Dot(q, r));
+		q.w = f4xor(q.w, sign);
+		q.x = f4xor(q.x, sign);
+		q.y = f4xor(q.y, sign);
+		q.z = f4xor(q.z, sign);
+		STORE_QUAT4((*this), i, q);
+	}
+}
+
+void QuaternionArray::dot(const QuaternionArray& a, const QuaternionArray& b, float* result)
+{
+	a.checkSize(b, "dot");
+	for (long i=0; i<a.count; i+=4)
+	{
+		Quat4 qa, qb;
+		LOAD_QUAT4(qa, a, i);
+		LOAD_QUAT4(qb, b, i);
+		storeLanes(result+i, quat4Dot(qa, qb), a.count-i);
+	}
+}
+
+static inline Float4 differenceMagnitude4(const Quat4& a, const Quat4& b)
+{
+	Quat4 d;
+	d.w = f4sub(a.w, b.w);
+	d.x = f4sub(a.x, b.x);
+	d.y = f4sub(a.y, b.y);
+	d.z = f4sub(a.z, b.z);
+	return f4sqrt(quat4Dot(d, d));
+}
+
+void QuaternionArray::differenceMagnitudes(const QuaternionArray& a, const QuaternionArray& b, float* result)
+{
+	a.checkSize(b, "differenceMagnitudes");
+	for (long i=0; i<a.count; i+=4)
+	{
+		Quat4 qa, qb;
+		LOAD_QUAT4(qa, a, i);
+		LOAD_QUAT4(qb, b, i);
+		storeLanes(result+i, differenceMagnitude4(qa, qb), a.count-i);
+	}
+}
+
+float QuaternionArray::sumDifferenceMagnitudes(const QuaternionArray& a, const QuaternionArray& b)
+{
+	a.checkSize(b, "sumDifferenceMagnitudes");
+	// padding lanes are identity in both arrays, so they add nothing
+	Float4 sum = f4zero();
+	for (long i=0; i<a.capacity; i+=4)
+	{
+		Quat4 qa, qb;
+		LOAD_QUAT4(qa, a, i);
+		LOAD_QUAT4(qb, b, i);
+		sum = f4add(sum, differenceMagnitude4(qa, qb));
+	}
+	float t[4];
+	f4storeu(t, sum);
+	return (t[0] + t[1]) + (t[2] + t[3]);
+}
+
+void QuaternionArray::nlerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& result)
+{
+	a.checkSize(b, "nlerp");
+	if (result.count != a.count) result.resize(a.count);
+	Float4 ft = f4set1(t);
+	Float4 one_minus_t = f4set1(1.0f-t);
+	for (long i=0; i<a.capacity; i+=4)
+	{
+		Quat4 qa, qb;
+		LOAD_QUAT4(qa, a, i);
+		LOAD_QUAT4(qb, b, i);
+		// blend with -a when the quaternions are more than 90 degrees apart
+		Float4 sa = f4xor(one_minus_t, f4signbit(quat4Dot(qa, qb)));
+		Quat4 r = quat4Normalize(quat4Blend(sa, qa, ft, qb));
+		STORE_QUAT4(result, i, r);
+	}
+}
+
+void QuaternionArray::slerp(const QuaternionArray& a, const QuaternionArray& b, float t, QuaternionArray& result)
+{
+	a.checkSize(b, "slerp");
+	if (result.count != a.count) result.resize(a.count);
+	Float4 ft = f4set1(t);
+	Float4 one = f4set1(1.0f);
+	Float4 one_minus_t = f4set1(1.0f-t);
+	for (long i=0; i<a.capacity; i+=4)
+	{
+		Quat4 qa, qb;
+		LOAD_QUAT4(qa, a, i);
+		LOAD_QUAT4(qb, b, i);
+		Float4 cos_theta = quat4Dot(qa, qb);
+		Float4 sign = f4signbit(cos_theta);
+		cos_theta = f4abs(cos_theta);
+
+		Float4 theta = acosKernel(f4min(cos_theta, one));
+		Float4 recip_sin_theta = f4div(one, f4sqrt(f4max(f4sub(one, f4mul(cos_theta, cos_theta)), f4set1(1.0e-30f))));
+		Float4 sin_a, sin_b, unused;
+		f4sincos(f4mul(one_minus_t, theta), sin_a, unused);
+		f4sincos(f4mul(ft, theta), sin_b, unused);
+		Float4 sa = f4mul(sin_a, recip_sin_theta);
+		Float4 sb = f4mul(sin_b, recip_sin_theta);
+
+		// nearly equal quaternions use linear interpolation
+		Float4 linear = f4cmple(f4sub(one, cos_theta), f4set1(EPSILON));
+		sa = f4select(linear, one_minus_t, sa);
+		sb = f4select(linear, ft, sb);
+
+		Quat4 r = quat4Blend(f4xor(sa, sign), qa, sb, qb);
+		STORE_QUAT4(result, i, r);
+	}
+}
+
+// rotate vectors given as lanes of vx,vy,vz
+static inline void rotate4(const Quat4& q, Float4& vx, Float4& vy, Float4& vz)
+{
+	Float4 two = f4set1(2.0f);
+	Float4 p_mult = f4sub(f4sub(f4sub(f4mul(q.w, q.w), f4mul(q.x, q.x)), f4mul(q.y, q.y)), f4mul(q.z, q.z));
+	Float4 v_mult = f4mul(two, f4add(f4add(f4mul(q.x, vx), f4mul(q.y, vy)), f4mul(q.z, vz)));
+	Float4 cross_mult = f4mul(two, q.w);
+	Float4 rx = f4add(f4add(f4mul(p_mult, vx), f4mul(v_mult, q.x)), f4mul(cross_mult, f4sub(f4mul(q.y, vz), f4mul(q.z, vy))));
+	Float4 ry = f4add(f4add(f4mul(p_mult, vy), f4mul(v_mult, q.y)), f4mul(cross_mult, f4sub(f4mul(q.z, vx), f4mul(q.x, vz))));
+	Float4 rz = f4add(f4add(f4mul(p_mult, vz), f4mul(v_mult, q.z)), f4mul(cross_mult, f4sub(f4mul(q.x, vy), f4mul(q.y, vx))));
+	vx = rx; vy = ry; vz = rz;
+}
+
+void QuaternionArray::rotate(const Vector3D* in, Vector3D* out) const
+{
+	float tx[4], ty[4], tz[4];
+	for (long i=0; i<count; i+=4)
+	{
+		long m = (count-i < 4) ? count-i : 4;
+		for (long k=0; k<4; k++)
+		{
+			tx[k] = (k < m) ? in[i+k].x : 0.0f;
+			ty[k] = (k < m) ? in[i+k].y : 0.0f;
+			tz[k] = (k < m) ? in[i+k].z : 0.0f;
+		}
+		Quat4 q;
+		LOAD_QUAT4(q, (*this), i);
+		Float4 vx = f4loadu(tx), vy = f4loadu(ty), vz = f4loadu(tz);
+		rotate4(q, vx, vy, vz);
+		f4storeu(tx, vx); f4storeu(ty, vy); f4storeu(tz, vz);
+		for (long k=0; k<m; k++)
+		{
+			out[i+k].x = tx[k]; out[i+k].y = ty[k]; out[i+k].z = tz[k];
+		}
+	}
+}
+
+void QuaternionArray::rotate(const float* in, float* out) const
+{
+	float tx[4], ty[4], tz[4];
+	for (long i=0; i<count; i+=4)
+	{
+		long m = (count-i < 4) ? count-i : 4;
+		for (long k=0; k<4; k++)
+		{
+			tx[k] = (k < m) ? in[3*(i+k)] : 0.0f;
+			ty[k] = (k < m) ? in[3*(i+k)+1] : 0.0f;
+			tz[k] = (k < m) ? in[3*(i+k)+2] : 0.0f;
+		}
+		Quat4 q;
+		LOAD_QUAT4(q, (*this), i);
+		Float4 vx = f4loadu(tx), vy = f4loadu(ty), vz = f4loadu(tz);
+		rotate4(q, vx, vy, vz);
+		f4storeu(tx, vx); f4storeu(ty, vy); f4storeu(tz, vz);
+		for (long k=0; k<m; k++)
+		{
+			out[3*(i+k)] = tx[k]; out[3*(i+k)+1] = ty[k]; out[3*(i+k)+2] = tz[k];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// conversions
+//-----------------------------------------------------------------------------
+
+// Same formulas as Quaternion::toRotationMatrix()
+void QuaternionArray::toMatrices(Matrix4x4* out) const
+{
+	// r[row*3+col] for the 3x3 rotation part
+	float r[9][4];
+	Float4 two = f4set1(2.0f);
+	Float4 one = f4set1(1.0f);
+	for (long i=0; i<count; i+=4)
+	{
+		Quat4 q;
+		LOAD_QUAT4(q, (*this), i);
+		Float4 two_x = f4mul(two, q.x), two_y = f4mul(two, q.y), two_z = f4mul(two, q.z);
+		Float4 two_wx = f4mul(two_x, q.w), two_wy = f4mul(two_y, q.w), two_wz = f4mul(two_z, q.w);
+		Float4 two_xx = f4mul(two_x, q.x), two_xy = f4mul(two_y, q.x), two_xz = f4mul(two_z, q.x);
+		Float4 two_yy = f4mul(two_y, q.y), two_yz = f4mul(two_z, q.y), two_zz = f4mul(two_z, q.z);
+		f4storeu(r[0], f4sub(one, f4add(two_yy, two_zz)));
+		f4storeu(r[1], f4sub(two_xy, two_wz));
+		f4storeu(r[2], f4add(two_xz, two_wy));
+		f4storeu(r[3], f4add(two_xy, two_wz));
+		f4storeu(r[4], f4sub(one, f4add(two_xx, two_zz)));
+		f4storeu(r[5], f4sub(two_yz, two_wx));
+		f4storeu(r[6], f4sub(two_xz, two_wy));
+		f4storeu(r[7], f4add(two_yz, two_wx));
+		f4storeu(r[8], f4sub(one, f4add(two_xx, two_yy)));
+		long m = (count-i < 4) ? count-i : 4;
+		for (long k=0; k<m; k++)
+		{
+			Matrix4x4& M = out[i+k];
+			M = Matrix4x4::identity();
+			for (int row=0; row<3; row++)
+				for (int col=0; col<3; col++)
+					M(row, col) = r[row*3+col][k];
+		}
+	}
+}
+
+// Shoemake's method as in Quaternion::fromRotationMatrix(), with the
+// four cases computed for every lane and selected by masks.
+void QuaternionArray::fromMatrices(const Matrix4x4* in, long n)
+{
+	if (n != count) allocate(n);
+	static const Matrix4x4 identity = Matrix4x4::identity();
+	Float4 one = f4set1(1.0f);
+	Float4 half = f4set1(0.5f);
+	for (long i=0; i<n; i+=4)
+	{
+		const Matrix4x4* M[4];
+		for (long k=0; k<4; k++) M[k] = (i+k < n) ? &in[i+k] : &identity;
+		Float4 r[3][3];
+		for (int row=0; row<3; row++)
+			for (int col=0; col<3; col++)
+				r[row][col] = f4set((*M[0])(row,col), (*M[1])(row,col), (*M[2])(row,col), (*M[3])(row,col));
+
+		Float4 trace = f4add(f4add(r[0][0], r[1][1]), r[2][2]);
+		Float4 case_w = f4cmpgt(trace, f4zero());
+		Float4 y_over_x = f4cmpgt(r[1][1], r[0][0]);
+		Float4 z_largest = f4cmpgt(r[2][2], f4select(y_over_x, r[1][1], r[0][0]));
+		Float4 t_w = f4add(trace, one);
+		Float4 t_x = f4add(f4sub(f4sub(r[0][0], r[1][1]), r[2][2]), one);
+		Float4 t_y = f4add(f4sub(f4sub(r[1][1], r[2][2]), r[0][0]), one);
+		Float4 t_z = f4add(f4sub(f4sub(r[2][2], r[0][0]), r[1][1]), one);
+		// case_w, else z_largest, else y_over_x, else x is the largest diagonal element
+		Float4 t = f4select(case_w, t_w, f4select(z_largest, t_z, f4select(y_over_x, t_y, t_x)));
+		Float4 root = f4sqrt(t);
+		Float4 diagonal = f4mul(half, root);
+		Float4 s = f4div(half, root);
+
+		Float4 d21 = f4mul(f4sub(r[2][1], r[1][2]), s);
+		Float4 d02 = f4mul(f4sub(r[0][2], r[2][0]), s);
+		Float4 d10 = f4mul(f4sub(r[1][0], r[0][1]), s);
+		Float4 s10 = f4mul(f4add(r[1][0], r[0][1]), s);
+		Float4 s20 = f4mul(f4add(r[2][0], r[0][2]), s);
+		Float4 s21 = f4mul(f4add(r[2][1], r[1][2]), s);
+
+		Quat4 q;
+		q.w = f4select(case_w, diagonal, f4select(z_largest, d10, f4select(y_over_x, d02, d21)));
+		q.x = f4select(case_w, d21, f4select(z_largest, s20, f4select(y_over_x, s10, diagonal)));
+		q.y = f4select(case_w, d02, f4select(z_largest, s21, f4select(y_over_x, diagonal, s10)));
+		q.z = f4select(case_w, d10, f4select(z_largest, diagonal, f4select(y_over_x, s21, s20)));
+		STORE_QUAT4((*this), i, q);
+	}
+}
+
+// axes applied first, second and third for each EULER_ORDER (0=x, 1=y, 2=z)
+static const int euler_axes[6][3] = {
+	{ 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+
+void QuaternionArray::fromEuler(const float* rx, const float* ry, const float* rz, long n, EULER_ORDER order)
+{
+	if (n != count) allocate(n);
+	const float* angles[3] = { rx, ry, rz };
+	Float4 half = f4set1(0.5f);
+	for (long i=0; i<n; i+=4)
+	{
+		Quat4 axis_q[3];
+		for (int a=0; a<3; a++)
+		{
+			Float4 s, c;
+			f4sincos(f4mul(half, loadLanes(angles[a]+i, n-i, 0.0f)), s, c);
+			axis_q[a].w = c;
+			axis_q[a].x = (a == 0) ? s : f4zero();
+			axis_q[a].y = (a == 1) ? s : f4zero();
+			axis_q[a].z = (a == 2) ? s : f4zero();
+		}
+		// the first rotation applied is the rightmost factor
+		const int* axes = euler_axes[order];
+		Quat4 q = quat4Multiply(axis_q[axes[2]], quat4Multiply(axis_q[axes[1]], axis_q[axes[0]]));
+		STORE_QUAT4((*this), i, q);
+	}
+}
+
+void QuaternionArray::toEuler(float* rx, float* ry, float* rz, EULER_ORDER order) const
+{
+	if (count == 0) return;
+	vector<Matrix4x4> matrices(count);
+	toMatrices(&matrices[0]);
+	Matrix4x4::factorEulerBatch(&matrices[0], count, order, rx, ry, rz);
+}
@@ -2,6 +2,7 @@
 // RandomGenerator.cpp
 //   The RandomGenerator class encapsulates a seed and 
 //   a variety of functions for generating random numbers.
+//   The RandomStream class is a counter-based generator for parallel use.
 //-----------------------------------------------------------------------------
 // This software is part of the Skeleton Animation Toolkit (SKA) developed 
 // at the University of the Pacific, under the guidance of Michael Doherty.
@@ -14,6 +15,325 @@
 //-----------------------------------------------------------------------------
 
 #include <Core/SystemConfiguration.h>
+#include <cmath>
+using namespace std;
 #include <Math/RandomGenerator.h>
+#include <Math/Float4.h>
+#include <Math/BatchTrig.h>
+#include <Core/Parallel.h>
+#if SKA_SSE2==1
+#include <emmintrin.h>
+#endif
 
-RandomGenerator random_generator;
\ No newline at end of file
+RandomGenerator random_generator;
+
+//-----------------------------------------------------------------------------
+// Philox4x32-10
+//   A block of four 32 bit words is ten rounds of multiply and xor applied
+//   to a 128 bit counter under a 64 bit key. The counter holds the block
+//   number (words 0,1) and the stream id (words 2,3). The key is the seed.
+//-----------------------------------------------------------------------------
+
+static const unsigned int PHILOX_M0 = 0xD2511F53u;
+static const unsigned int PHILOX_M1 = 0xCD9E8D57u;
+static const unsigned int PHILOX_W0 = 0x9E3779B9u;
+static const unsigned int PHILOX_W1 = 0xBB67AE85u;
+static const int PHILOX_ROUNDS = 10;
+
+// values are generated and converted in chunks of this many words
+static const long CHUNK_WORDS = 256;
+// fills smaller than this stay on the calling thread
+static const long PARALLEL_MIN_BLOCK = 32768;
+
+static void philoxBlock(unsigned long long block, unsigned long long stream_id,
+	unsigned long long seed, unsigned int out[4])
+{
+	unsigned int c0 = (unsigned int)block, c1 = (unsigned int)(block >> 32);
+	unsigned int c2 = (unsigned int)stream_id, c3 = (unsigned int)(stream_id >> 32);
+	unsigned int k0 = (unsigned int)seed, k1 = (unsigned int)(seed >> 32);
+	for (int r=0; r<PHILOX_ROUNDS; r++)
+	{
+		unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0;
+		unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2;
+		c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+		c1 = (unsigned int)p1;
+		c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+		c3 = (unsigned int)p0;
+		k0 += PHILOX_W0; k1 += PHILOX_W1;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+#if SKA_SSE2==1
+// high and low 32 bits of m times each lane of c
+static inline void mulhilo4(__m128i m, __m128i c, __m128i& hi, __m128i& lo)
+{
+	__m128i even = _mm_mul_epu32(c, m);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(c, 32), m);
+	lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+	hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,3,1)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,3,1)));
+}
+
+// blocks first .. first+3, written in order (16 words)
+static void philoxBlocks4(unsigned long long first, unsigned long long stream_id,
+	unsigned long long seed, unsigned int* out)
+{
+	unsigned long long b[4] = { first, first+1, first+2, first+3 };
+	__m128i c0 = _mm_setr_epi32(int(b[0]), int(b[1]), int(b[2]), int(b[3]));
+	__m128i c1 = _mm_setr_epi32(int(b[0] >> 32), int(b[1] >> 32), int(b[2] >> 32), int(b[3] >> 32));
+	__m128i c2 = _mm_set1_epi32(int((unsigned int)stream_id));
+	__m128i c3 = _mm_set1_epi32(int((unsigned int)(stream_id >> 32)));
+	unsigned int k0 = (unsigned int)seed, k1 = (unsigned int)(seed >> 32);
+	const __m128i m0 = _mm_set1_epi32(int(PHILOX_M0));
+	const __m128i m1 = _mm_set1_epi32(int(PHILOX_M1));
+	for (int r=0; r<PHILOX_ROUNDS; r++)
+	{
+		__m128i hi0, lo0, hi1, lo1;
+		mulhilo4(m0, c0, hi0, lo0);
+		mulhilo4(m1, c2, hi1, lo1);
+		c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32(int(k0)));
+		c1 = lo1;
+		c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32(int(k1)));
+		c3 = lo0;
+		k0 += PHILOX_W0; k1 += PHILOX_W1;
+	}
+	// lanes hold blocks, registers hold words: transpose to block order
+	__m128 w0 = _mm_castsi128_ps(c0), w1 = _mm_castsi128_ps(c1);
+	__m128 w2 = _mm_castsi128_ps(c2), w3 = _mm_castsi128_ps(c3);
+	_MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+	_mm_storeu_si128((__m128i*)(out), _mm_castps_si128(w0));
+	_mm_storeu_si128((__m128i*)(out+4), _mm_castps_si128(w1));
+	_mm_storeu_si128((__m128i*)(out+8), _mm_castps_si128(w2));
+	_mm_storeu_si128((__m128i*)(out+12), _mm_castps_si128(w3));
+}
+#endif
+
+// words start .. start+n-1 of a stream
+static void philoxWords(unsigned long long seed, unsigned long long stream_id,
+	unsigned long long start, unsigned int* out, long n)
+{
+	unsigned int block[4];
+	long i = 0;
+	// partial first block
+	while ((i < n) && ((start+i) % 4 != 0))
+	{
+		philoxBlock((start+i)/4, stream_id, seed, block);
+		out[i] = block[(start+i)%4];
+		i++;
+	}
+#if SKA_SSE2==1
+	for (; i+16 <= n; i+=16)
+		philoxBlocks4((start+i)/4, stream_id, seed, out+i);
+#endif
+	for (; i+4 <= n; i+=4)
+		philoxBlock((start+i)/4, stream_id, seed, out+i);
+	if (i < n)
+	{
+		philoxBlock((start+i)/4, stream_id, seed, block);
+		for (long k=0; i+k<n; k++) out[i+k] = block[k];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// conversion of random words to floats
+//-----------------------------------------------------------------------------
+
+// top 24 bits as [0,1), or as (0,1] when offset is 1
+static inline float wordToUnit(unsigned int w, unsigned int offset=0)
+{
+	return float((w >> 8) + offset) * (1.0f/16777216.0f);
+}
+
+static void wordsToUniform(const unsigned int* w, float* out, long n, float a, float b)
+{
+	float scale = (b-a) * (1.0f/16777216.0f);
+	long i = 0;
+#if SKA_SSE2==1
+	__m128 va = _mm_set1_ps(a), vscale = _mm_set1_ps(scale);
+	for (; i+4 <= n; i+=4)
+	{
+		__m128i bits = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(w+i)), 8);
+		_mm_storeu_ps(out+i, _mm_add_ps(va, _mm_mul_ps(_mm_cvtepi32_ps(bits), vscale)));
+	}
+#endif
+	for (; i<n; i++) out[i] = a + float(w[i] >> 8)*scale;
+}
+
+// natural log of positive, finite lanes (cephes logf)
+static inline Float4 f4log(Float4 x)
+{
+#if SKA_SSE2==1
+	__m128i bits = _mm_castps_si128(x);
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+	// mantissa in [0.5, 1)
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F000000)));
+	__m128 small = _mm_cmplt_ps(m, _mm_set1_ps(0.707106781f));
+	e = _mm_sub_ps(e, _mm_and_ps(small, _mm_set1_ps(1.0f)));
+	__m128 t = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(small, m)), _mm_set1_ps(1.0f));
+	__m128 z = _mm_mul_ps(t, t);
+	Float4 y = f4set1(7.0376836292e-2f);
+	y = f4madd(y, t, f4set1(-1.1514610310e-1f));
+	y = f4madd(y, t, f4set1(1.1676998740e-1f));
+	y = f4madd(y, t, f4set1(-1.2420140846e-1f));
+	y = f4madd(y, t, f4set1(1.4249322787e-1f));
+	y = f4madd(y, t, f4set1(-1.6668057665e-1f));
+	y = f4madd(y, t, f4set1(2.0000714765e-1f));
+	y = f4madd(y, t, f4set1(-2.4999993993e-1f));
+	y = f4madd(y, t, f4set1(3.3333331174e-1f));
+	y = f4mul(f4mul(y, t), z);
+	y = f4madd(e, f4set1(-2.12194440e-4f), y);
+	y = f4madd(z, f4set1(-0.5f), y);
+	return f4add(f4add(t, y), f4mul(e, f4set1(0.693359375f)));
+#else
+	float v[4];
+	f4storeu(v, x);
+	for (int i=0; i<4; i++) v[i] = logf(v[i]);
+	return f4loadu(v);
+#endif
+}
+
+// Box-Muller: words 2j and 2j+1 give the normal values 2j (cosine part)
+// and 2j+1 (sine part). n must be even.
+static void wordsToNormal(const unsigned int* w, float* out, long n, float x, float s)
+{
+	float u1[4], u2[4], r0[4], r1[4];
+	for (long i=0; i<n; i+=8)
+	{
+		long pairs = (n-i)/2;
+		if (pairs > 4) pairs = 4;
+		for (long k=0; k<4; k++)
+		{
+			u1[k] = (k < pairs) ? wordToUnit(w[i+2*k], 1) : 1.0f;
+			u2[k] = (k < pairs) ? wordToUnit(w[i+2*k+1]) : 0.0f;
+		}
+		Float4 radius = f4sqrt(f4mul(f4set1(-2.0f), f4log(f4loadu(u1))));
+		Float4 sin_t, cos_t;
+		f4sincos(f4mul(f4loadu(u2), f4set1(6.283185307f)), sin_t, cos_t);
+		Float4 vs = f4set1(s), vx = f4set1(x);
+		f4storeu(r0, f4madd(f4mul(radius, cos_t), vs, vx));
+		f4storeu(r1, f4madd(f4mul(radius, sin_t), vs, vx));
+		for (long k=0; k<pairs; k++)
+		{
+			out[i+2*k] = r0[k];
+			out[i+2*k+1] = r1[k];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// RandomStream
+//-----------------------------------------------------------------------------
+
+void RandomStream::bitsAt(unsigned long long start, unsigned int* out, long n) const
+{
+	unsigned long long key = seed, id = stream_id;
+	parallelForBlocks(0, n, [key, id, start, out](long b, long e)
+	{
+		philoxWords(key, id, start+b, out+b, e-b);
+	}, PARALLEL_MIN_BLOCK);
+}
+
+void RandomStream::uniformAt(unsigned long long start, float* out, long n, float a, float b) const
+{
+	if (a>b) throw MathException("RandomStream::uniformAt Argument Error: a > b");
+	unsigned long long key = seed, id = stream_id;
+	parallelForBlocks(0, n, [key, id, start, out, a, b](long first, long last)
+	{
+		unsigned int words[CHUNK_WORDS];
+		for (long i=first; i<last; i+=CHUNK_WORDS)
+		{
+			long m = (last-i < CHUNK_WORDS) ? last-i : CHUNK_WORDS;
+			philoxWords(key, id, start+i, words, m);
+			wordsToUniform(words, out+i, m, a, b);
+		}
+	}, PARALLEL_MIN_BLOCK);
+}
+
+void RandomStream::normalAt(unsigned long long start, float* out, long n, float x, float s) const
+{
+	unsigned long long key = seed, id = stream_id;
+	parallelForBlocks(0, n, [key, id, start, out, x, s](long first, long last)
+	{
+		unsigned int words[CHUNK_WORDS];
+		float values[CHUNK_WORDS];
+		// positions are converted in whole pairs, so a range starting or
+		// ending on an odd position computes one extra value
+		unsigned long long p = start+first;
+		unsigned long long end = start+last;
+		while (p < end)
+		{
+			unsigned long long pair_start = p & ~1ULL;
+			unsigned long long pair_end = pair_start + CHUNK_WORDS;
+			if (pair_end > end) pair_end = (end+1) & ~1ULL;
+			long m = long(pair_end - pair_start);
+			philoxWords(key, id, pair_start, words, m);
+			wordsToNormal(words, values, m, x, s);
+			long skip = long(p - pair_start);
+			long count = ((pair_end < end) ? long(pair_end - p) : long(end - p));
+			for (long k=0; k<count; k++) out[(p-start)+k] = values[skip+k];
+			p += count;
+		}
+	}, PARALLEL_MIN_BLOCK);
+}
+
+unsigned int RandomStream::next()
+{
+	unsigned int block[4];
+	philoxBlock(position/4, stream_id, seed, block);
+	unsigned int w = block[position%4];
+	position++;
+	return w;
+}
+
+float RandomStream::uniform()
+{
+	return wordToUnit(next());
+}
+
+float RandomStream::uniform(float a, float b)
+{
+	float v;
+	uniformAt(position, &v, 1, a, b);
+	position++;
+	return v;
+}
+
+int RandomStream::random(int i, int n)
+{
+	if (i>n) throw MathException("RandomStream::random Argument Error: i > n");
+	// 64 bit multiply maps the word onto the range without modulo bias
+	// beyond 2^-32
+	unsigned long long range = (unsigned long long)((long long)n - i) + 1;
+	return int(i + (long long)((next() * range) >> 32));
+}
+
+float RandomStream::normal(float x, float s)
+{
+	float v;
+	normalAt(position, &v, 1, x, s);
+	position++;
+	return v;
+}
+
+void RandomStream::fillBits(unsigned int* out, long n)
+{
+	if (n <= 0) return;
+	bitsAt(position, out, n);
+	position += n;
+}
+
+void RandomStream::fillUniform(float* out, long n, float a, float b)
+{
+	if (n <= 0) return;
+	uniformAt(position, out, n, a, b);
+	position += n;
+}
+
+void RandomStream::fillNormal(float* out, long n, float x, float s)
+{
+	if (n <= 0) return;
+	normalAt(position, out, n, x, s);
+	position += n;
+}
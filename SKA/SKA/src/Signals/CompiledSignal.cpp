@@ -0,0 +1,195 @@
+//-----------------------------------------------------------------------------
+// CompiledSignal.cpp
+//	 A sum of sinusoids evaluated as one kernel.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <complex>
+#include <map>
+using namespace std;
+#include <Signals/CompiledSignal.h>
+#include <Math/Math.h>
+#include <Math/Float4.h>
+#include <Core/Parallel.h>
+
+// frames per parallel work item when baking
+static const long BAKE_BLOCK = 4096;
+// samples between exact recomputations of the phasors in signalBlock()
+static const long RESEED_BLOCK = 1024;
+
+CompiledSignal::CompiledSignal(const vector<SignalSpec>& specs)
+	: SignalGenerator(), constant(0.0)
+{
+	// Sum terms with equal frequency as phasors: a*sin(w*t+p) is the
+	// imaginary part of a*exp(i*p)*exp(i*w*t). A negative frequency is
+	// turned around with sin(-x) = -sin(x).
+	map<float, complex<double> > phasors;
+	for (unsigned int s=0; s<specs.size(); s++)
+	{
+		double a = specs[s].amplitude, f = specs[s].frequency, p = specs[s].phase;
+		if (fabs(f) < EPSILON) { constant += a; continue; }
+		if (f < 0.0) { f = -f; a = -a; p = -p; }
+		phasors[float(f)] += polar(a, p);
+	}
+	map<float, complex<double> >::iterator it;
+	for (it=phasors.begin(); it!=phasors.end(); it++)
+	{
+		double a = abs(it->second);
+		if (a == 0.0) continue;
+		amplitudes.push_back(a);
+		omegas.push_back(TWO_PI*double(it->first));
+		phases.push_back(arg(it->second));
+	}
+}
+
+float CompiledSignal::signal(float time)
+{
+	double s = constant;
+	for (unsigned int k=0; k<amplitudes.size(); k++)
+		s += amplitudes[k]*sin(fmod(omegas[k]*time, TWO_PI) + phases[k]);
+	return float(s);
+}
+
+bool CompiledSignal::appendSpecs(vector<SignalSpec>& specs) const
+{
+	if (constant != 0.0)
+	{
+		SignalSpec spec = { float(constant), 0.0f, 0.0f };
+		specs.push_back(spec);
+	}
+	for (unsigned int k=0; k<amplitudes.size(); k++)
+	{
+		SignalSpec spec = { float(amplitudes[k]), float(omegas[k]/TWO_PI), float(phases[k]) };
+		specs.push_back(spec);
+	}
+	return true;
+}
+
+void CompiledSignal::signalBlock(float t0, float dt, long n, float* out)
+{
+	int num_terms = numTerms();
+	// rotations that advance a phasor by one and by four samples
+	vector<double> one_cos(num_terms), one_sin(num_terms);
+	vector<float> step_cos(num_terms), step_sin(num_terms);
+	for (int k=0; k<num_terms; k++)
+	{
+		double step = fmod(omegas[k]*dt, TWO_PI);
+		one_cos[k] = cos(step);
+		one_sin[k] = sin(step);
+		step_cos[k] = float(cos(4.0*step));
+		step_sin[k] = float(sin(4.0*step));
+	}
+
+	// phasor of each term for four consecutive samples. Terms are the
+	// inner loop, so their updates do not wait on each other.
+	vector<float> ps(4*num_terms), pc(4*num_terms);
+	float acc[4];
+	Float4 c0 = f4set1(float(constant));
+	for (long i=0; i<n; i+=RESEED_BLOCK)
+	{
+		long m = (n-i < RESEED_BLOCK) ? n-i : RESEED_BLOCK;
+		// exact phasors for the first four samples of the block
+		for (int k=0; k<num_terms; k++)
+		{
+			double t = double(t0) + double(i)*dt;
+			double angle = fmod(omegas[k]*t, TWO_PI) + phases[k];
+			double sa = amplitudes[k]*sin(angle), ca = amplitudes[k]*cos(angle);
+			for (int j=0; j<4; j++)
+			{
+				ps[4*k+j] = float(sa);
+				pc[4*k+j] = float(ca);
+				double ns = sa*one_cos[k] + ca*one_sin[k];
+				ca = ca*one_cos[k] - sa*one_sin[k];
+				sa = ns;
+			}
+		}
+		for (long q=0; q<m; q+=4)
+		{
+			Float4 sum = c0;
+			for (int k=0; k<num_terms; k++)
+			{
+				Float4 s = f4loadu(&ps[4*k]), c = f4loadu(&pc[4*k]);
+				Float4 rc = f4set1(step_cos[k]), rs = f4set1(step_sin[k]);
+				sum = f4add(sum, s);
+				f4storeu(&ps[4*k], f4madd(s, rc, f4mul(c, rs)));
+				f4storeu(&pc[4*k], f4sub(f4mul(c, rc), f4mul(s, rs)));
+			}
+			if (m-q >= 4) f4storeu(out+i+q, sum);
+			else
+			{
+				f4storeu(acc, sum);
+				for (long j=0; j<m-q; j++) out[i+q+j] = acc[j];
+			}
+		}
+	}
+}
+
+CompiledSignal* compileSignalGenerator(SignalGenerator* g)
+{
+	if (g == NULL) return NULL;
+	vector<SignalSpec> specs;
+	if (!g->appendSpecs(specs)) return NULL;
+	return new CompiledSignal(specs);
+}
+
+void bakeSignalGenerators(MotionSequence* motion, 
+	const vector<CHANNEL_ID>& channels, const vector<SignalGenerator*>& generators, 
+	float t0, int max_threads)
+{
+	if (channels.size() != generators.size())
+		throw MathException("bakeSignalGenerators: channel and generator counts differ");
+	long num_frames = motion->numFrames();
+	float dt = 1.0f/motion->getFrameRate();
+
+	// compile what can be compiled, and find each channel's column
+	vector<SignalGenerator*> kernels;
+	vector<CompiledSignal*> compiled;
+	vector<float*> columns;
+	for (unsigned int c=0; c<channels.size(); c++)
+	{
+		CHANNEL_ID cid = channels[c];
+		if ((generators[c] == NULL) || !motion->isValidChannel(cid)) continue;
+		CompiledSignal* cs = compileSignalGenerator(generators[c]);
+		if (cs != NULL) compiled.push_back(cs);
+		kernels.push_back((cs != NULL) ? cs : generators[c]);
+		columns.push_back(motion->getChannelPtr(cid));
+	}
+
+	long blocks_per_channel = (num_frames + BAKE_BLOCK - 1)/BAKE_BLOCK;
+	long items = long(kernels.size())*blocks_per_channel;
+	parallelFor(0, items, [&](long item)
+	{
+		long c = item/blocks_per_channel;
+		long first = (item%blocks_per_channel)*BAKE_BLOCK;
+		long count = (num_frames-first < BAKE_BLOCK) ? num_frames-first : BAKE_BLOCK;
+		kernels[c]->signalBlock(t0 + first*dt, dt, count, columns[c] + first);
+	}, 1, max_threads);
+
+	for (unsigned int i=0; i<compiled.size(); i++) delete compiled[i];
+}
+
+MotionSequence* bakeSignalGenerators(const vector<CHANNEL_ID>& channels, 
+	const vector<SignalGenerator*>& generators, long num_frames, float frame_rate, 
+	float t0, int max_threads)
+{
+	MotionSequence* motion = new MotionSequence();
+	for (unsigned int c=0; c<channels.size(); c++)
+	{
+		CHANNEL_ID cid = channels[c];
+		motion->addChannel(cid);
+	}
+	motion->setNumFrames(num_frames);
+	motion->setFrameRate(frame_rate);
+	bakeSignalGenerators(motion, channels, generators, t0, max_threads);
+	return motion;
+}
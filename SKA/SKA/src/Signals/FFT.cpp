@@ -1,8 +1,8 @@
 //-----------------------------------------------------------------------------
 // FFT.cpp
 //   Interface to Fast Fourier Transform processing.
-//   This code is non-functional if not linked to FFTW library,
-//   available from www.fftw.org.
+//   Uses the FFTW library (www.fftw.org) if enabled, otherwise the
+//   built-in transforms in Signals/FFTPlan.h.
 //   See ENABLE_FFTW flag in Core/SystemConfiguration.h.
 //-----------------------------------------------------------------------------
 // This software is part of the Skeleton Animation Toolkit (SKA) developed 
@@ -19,11 +19,16 @@
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <map>
+#include <mutex>
 using namespace std;
 #include <Signals/FFT.h>
 #include <Animation/Skeleton.h>
+#include <Core/Parallel.h>
 #if ENABLE_FFTW==1
 #include <fftw3.h>
+#else
+#include <Signals/FFTPlan.h>
 #endif
 
 // Locates strongest signals from a Fourier Transform spectrum
@@ -76,242 +81,289 @@ int extractSignalsFromSpectrum(complex<float>* spectrum, int n,
 }
 
 
-// Structure for converting data to format required by FFTW algorithms
 #if ENABLE_FFTW==1
-struct FFTW_Array
+//-----------------------------------------------------------------------------
+// FFTW plans are made once per size and kind, then executed on per-thread
+// buffers with FFTW's new-array execute functions. FFTW planning is not
+// thread safe, so it is done under a lock. Execution is thread safe.
+//-----------------------------------------------------------------------------
+
+enum FFTW_PLAN_KIND { PLAN_C2C_FORWARD, PLAN_C2C_BACKWARD, PLAN_R2C, PLAN_C2R };
+
+// fftw_malloc'd (SIMD aligned) array of doubles that only grows
+struct FFTW_Buffer
 {
-	long n;
-	fftw_complex* data;
-	FFTW_Array()
-	{
-		n = 0;
-		data = NULL;
-	}
-	FFTW_Array(long _n)
-	{
-		data = NULL;
-		resize(_n);
-	}
-	~FFTW_Array()
+	long capacity;
+	double* data;
+	FFTW_Buffer() : capacity(0), data(NULL) { }
+	~FFTW_Buffer() { if (data != NULL) fftw_free(data); }
+	double* get(long size)
 	{
-		if (data != NULL) fftw_free(data);
-	}
-	void resize(long _n)
-	{
-		if (data != NULL) fftw_free(data);
-		n = _n;
-		data = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * n);
-	}
-	void load(float* f)
-	{
-		for (long i=0; i<n; i++) { data[i][0] = f[i]; data[i][1] = 0.0; }
-	}
-	void extract(float* f)
-	{
-		for (long i=0; i<n; i++) f[i] = (float)data[i][0];
+		if (size > capacity)
+		{
+			if (data != NULL) fftw_free(data);
+			capacity = size;
+			data = (double*) fftw_malloc(sizeof(double) * capacity);
+		}
+		return data;
 	}
-	void load(complex<float>* f)
+};
+
+static thread_local FFTW_Buffer fftw_in_buffer, fftw_out_buffer;
+
+static mutex fftw_plan_lock;
+static map<pair<pair<int,int>,int>, fftw_plan> fftw_plans;
+
+// howmany > 1 (real kinds only): transforms of contiguous signals,
+//   n values apart, with spectra n/2+1 values apart
+static fftw_plan cachedFFTWPlan(int n, FFTW_PLAN_KIND kind, int howmany=1)
+{
+	lock_guard<mutex> guard(fftw_plan_lock);
+	pair<pair<int,int>,int> key(pair<int,int>(n, int(kind)), howmany);
+	map<pair<pair<int,int>,int>, fftw_plan>::iterator iter = fftw_plans.find(key);
+	if (iter != fftw_plans.end()) return iter->second;
+
+	// FFTW_ESTIMATE does not touch the arrays, and planning on fftw_malloc'd
+	// arrays lets the plan run on any other fftw_malloc'd arrays
+	long size = 2 * long(n+1) * howmany;
+	double* in = (double*) fftw_malloc(sizeof(double) * size);
+	double* out = (double*) fftw_malloc(sizeof(double) * size);
+	fftw_plan plan = NULL;
+	if (howmany > 1)
 	{
-		for (long i=0; i<n; i++) { data[i][0] = f[i].real(); data[i][1] = f[i].imag(); }
+		int h = n/2+1;
+		if (kind == PLAN_R2C)
+			plan = fftw_plan_many_dft_r2c(1, &n, howmany, in, NULL, 1, n, (fftw_complex*)out, NULL, 1, h, FFTW_ESTIMATE);
+		else
+			plan = fftw_plan_many_dft_c2r(1, &n, howmany, (fftw_complex*)in, NULL, 1, h, out, NULL, 1, n, FFTW_ESTIMATE);
 	}
-	void extract(complex<float>* f)
+	else
 	{
-		for (long i=0; i<n; i++)  
-			f[i] = complex<float>((float)data[i][0],(float)data[i][1]); 
+		switch (kind)
+		{
+		case PLAN_C2C_FORWARD:
+			plan = fftw_plan_dft_1d(n, (fftw_complex*)in, (fftw_complex*)out, FFTW_FORWARD, FFTW_ESTIMATE);
+			break;
+		case PLAN_C2C_BACKWARD:
+			plan = fftw_plan_dft_1d(n, (fftw_complex*)in, (fftw_complex*)out, FFTW_BACKWARD, FFTW_ESTIMATE);
+			break;
+		case PLAN_R2C:
+			plan = fftw_plan_dft_r2c_1d(n, in, (fftw_complex*)out, FFTW_ESTIMATE);
+			break;
+		case PLAN_C2R:
+			plan = fftw_plan_dft_c2r_1d(n, (fftw_complex*)in, out, FFTW_ESTIMATE);
+			break;
+		}
 	}
-};
-#endif // ENABLE_FFTW==1
+	fftw_free(in);
+	fftw_free(out);
+	fftw_plans[key] = plan;
+	return plan;
+}
 
-bool computeFFT(float* signal, complex<float>* spectrum, int n)
+// forward real transform, n/2+1 bins
+static void runRealFFT(const float* signal, complex<float>* spectrum, int n)
 {
-#if ENABLE_FFTW==1
-	FFTW_Array in, out;
-	in.resize(n);
-	out.resize(n);
-	in.load(signal);
-	
-	fftw_plan fwd_plan;
-	fwd_plan = fftw_plan_dft_1d(n, in.data, out.data, FFTW_FORWARD, FFTW_ESTIMATE);
-	fftw_execute(fwd_plan); 
-	fftw_destroy_plan(fwd_plan);
-
-	out.extract(spectrum);
-	return true;
-#else // ENABLE_FFTW==0
-	return false;
-#endif // ENABLE_FFTW
+	double* in = fftw_in_buffer.get(n);
+	double* out = fftw_out_buffer.get(2*(n/2+1));
+	for (int i=0; i<n; i++) in[i] = signal[i];
+	fftw_execute_dft_r2c(cachedFFTWPlan(n, PLAN_R2C), in, (fftw_complex*)out);
+	for (int k=0; k<=n/2; k++) spectrum[k] = complex<float>((float)out[2*k], (float)out[2*k+1]);
 }
 
-bool computeFFT(complex<float>* signal, complex<float>* spectrum, int n)
+// backward real transform of n/2+1 bins, unnormalized
+static void runInverseRealFFT(const complex<float>* spectrum, float* signal, int n)
 {
-#if ENABLE_FFTW==1
-	FFTW_Array in, out;
-	in.resize(n);
-	out.resize(n);
-	in.load(signal);
-	
-	fftw_plan fwd_plan;
-	fwd_plan = fftw_plan_dft_1d(n, in.data, out.data, FFTW_FORWARD, FFTW_ESTIMATE);
-	fftw_execute(fwd_plan); 
-	fftw_destroy_plan(fwd_plan);
-
-	out.extract(spectrum);
-	return true;
-#else // ENABLE_FFTW==0
-	return false;
-#endif // ENABLE_FFTW
+	double* in = fftw_in_buffer.get(2*(n/2+1));
+	double* out = fftw_out_buffer.get(n);
+	for (int k=0; k<=n/2; k++) { in[2*k] = spectrum[k].real(); in[2*k+1] = spectrum[k].imag(); }
+	// c2r overwrites its input, which is the scratch buffer here
+	fftw_execute_dft_c2r(cachedFFTWPlan(n, PLAN_C2R), (fftw_complex*)in, out);
+	for (int i=0; i<n; i++) signal[i] = (float)out[i];
 }
 
-bool computeInverseFFT(complex<float>* spectrum, float* signal,int n)
+// howmany real signals, n values apart, to spectra n/2+1 values apart
+static void runRealFFTMany(const float* signals, complex<float>* spectra, int n, int howmany)
 {
-#if ENABLE_FFTW==1
-	FFTW_Array in, out;
-	in.resize(n);
-	out.resize(n);
-	in.load(spectrum);
+	long h = n/2+1;
+	double* in = fftw_in_buffer.get(long(n)*howmany);
+	double* out = fftw_out_buffer.get(2*h*howmany);
+	for (long i=0; i<long(n)*howmany; i++) in[i] = signals[i];
+	fftw_execute_dft_r2c(cachedFFTWPlan(n, PLAN_R2C, howmany), in, (fftw_complex*)out);
+	for (long k=0; k<h*howmany; k++) spectra[k] = complex<float>((float)out[2*k], (float)out[2*k+1]);
+}
+
+static void runInverseRealFFTMany(const complex<float>* spectra, float* signals, int n, int howmany)
+{
+	long h = n/2+1;
+	double* in = fftw_in_buffer.get(2*h*howmany);
+	double* out = fftw_out_buffer.get(long(n)*howmany);
+	for (long k=0; k<h*howmany; k++) { in[2*k] = spectra[k].real(); in[2*k+1] = spectra[k].imag(); }
+	fftw_execute_dft_c2r(cachedFFTWPlan(n, PLAN_C2R, howmany), (fftw_complex*)in, out);
+	for (long i=0; i<long(n)*howmany; i++) signals[i] = (float)out[i];
+}
 
-	fftw_plan bwd_plan;
-	bwd_plan = fftw_plan_dft_1d(n, in.data, out.data, FFTW_BACKWARD, FFTW_ESTIMATE);
-	fftw_execute(bwd_plan); 
-	fftw_destroy_plan(bwd_plan);
+// complex transform, unnormalized
+static void runComplexFFT(const complex<float>* input, complex<float>* output, int n, bool forward)
+{
+	double* in = fftw_in_buffer.get(2*n);
+	double* out = fftw_out_buffer.get(2*n);
+	for (int i=0; i<n; i++) { in[2*i] = input[i].real(); in[2*i+1] = input[i].imag(); }
+	fftw_plan plan = cachedFFTWPlan(n, forward ? PLAN_C2C_FORWARD : PLAN_C2C_BACKWARD);
+	fftw_execute_dft(plan, (fftw_complex*)in, (fftw_complex*)out);
+	for (int i=0; i<n; i++) output[i] = complex<float>((float)out[2*i], (float)out[2*i+1]);
+}
 
-	out.extract(signal);
-	for (int i=0; i<n; i++) { signal[i] /= n; }
-	return true;
 #else // ENABLE_FFTW==0
-	return false;
-#endif // ENABLE_FFTW
+
+static void runRealFFT(const float* signal, complex<float>* spectrum, int n)
+{
+	FFTPlan::cached(n, FFT_FORWARD, FFT_REAL).executeReal(signal, spectrum);
 }
 
-bool computeInverseFFT(complex<float>* spectrum, complex<float>* signal,int n)
+static void runInverseRealFFT(const complex<float>* spectrum, float* signal, int n)
 {
-#if ENABLE_FFTW==1
-	FFTW_Array in, out;
-	in.resize(n);
-	out.resize(n);
-	in.load(spectrum);
+	FFTPlan::cached(n, FFT_BACKWARD, FFT_REAL).executeReal(spectrum, signal);
+}
 
-	fftw_plan bwd_plan;
-	bwd_plan = fftw_plan_dft_1d(n, in.data, out.data, FFTW_BACKWARD, FFTW_ESTIMATE);
-	fftw_execute(bwd_plan); 
-	fftw_destroy_plan(bwd_plan);
+static void runRealFFTMany(const float* signals, complex<float>* spectra, int n, int howmany)
+{
+	FFTPlan::cached(n, FFT_FORWARD, FFT_REAL).executeReal(signals, n, spectra, n/2+1, howmany);
+}
 
-	out.extract(signal);
-	for (int i=0; i<n; i++) { signal[i] /= complex<float>(float(n),0.0f); }
-	return true;
-#else // ENABLE_FFTW==0
-	return false;
-#endif // ENABLE_FFTW
+static void runInverseRealFFTMany(const complex<float>* spectra, float* signals, int n, int howmany)
+{
+	FFTPlan::cached(n, FFT_BACKWARD, FFT_REAL).executeReal(spectra, n/2+1, signals, n, howmany);
 }
 
-bool computeInverseFFT(float* input, float* output, int n)
+static void runComplexFFT(const complex<float>* input, complex<float>* output, int n, bool forward)
 {
-#if ENABLE_FFTW==1
-	FFTW_Array fft, signal;
-	fft.resize(n);
-	signal.resize(n);
-	fft.load(input);
-
-	fftw_plan bwd_plan;
-	bwd_plan = fftw_plan_dft_1d(n, fft.data, signal.data, FFTW_BACKWARD, FFTW_ESTIMATE);
-	fftw_execute(bwd_plan); 
-	fftw_destroy_plan(bwd_plan);
-	for (int i=0; i<n; i++) { signal.data[i][0] /= n; signal.data[i][1] /= n;}
-
-	signal.extract(output);
-	return true;
-#else // ENABLE_FFTW==0
-	return false;
-#endif // ENABLE_FFTW
+	FFTPlan::cached(n, forward ? FFT_FORWARD : FFT_BACKWARD).execute(input, output);
 }
 
-bool computeFFT2(float* input, float* output1, float* output2, int n)
+#endif // ENABLE_FFTW
+
+bool computeFFT(float* signal, complex<float>* spectrum, int n)
 {
-#if ENABLE_FFTW==1
-	FFTW_Array signal, fft, recon;
-	signal.resize(n);
-	fft.resize(n);
-	recon.resize(n);
-	signal.load(input);
-	
-	fftw_plan fwd_plan;
-	fwd_plan = fftw_plan_dft_1d(n, signal.data, fft.data, FFTW_FORWARD, FFTW_ESTIMATE);
-	fftw_execute(fwd_plan); 
-	fftw_destroy_plan(fwd_plan);
-
-	fft.extract(output1);
-
-	fftw_plan bwd_plan;
-	bwd_plan = fftw_plan_dft_1d(n, fft.data, recon.data, FFTW_BACKWARD, FFTW_ESTIMATE);
-	fftw_execute(bwd_plan); 
-	fftw_destroy_plan(bwd_plan);
-	for (int i=0; i<n; i++) { recon.data[i][0] /= n; recon.data[i][1] /= n;}
-
-	recon.extract(output2);
+	if (n < 1) return false;
+	runRealFFT(signal, spectrum, n);
+	// negative frequencies are conjugates of the positive ones
+	for (int k=n/2+1; k<n; k++) spectrum[k] = conj(spectrum[n-k]);
 	return true;
-#else // ENABLE_FFTW==0
-	return false;
-#endif // ENABLE_FFTW
 }
 
-#if ENABLE_FFTW==1
-static void runFFTwithFilter(FFTW_Array& signal, FFTW_Array& fft, FFTW_Array& recon_signal, int cutoff=-1)
+bool computeFFT(complex<float>* signal, complex<float>* spectrum, int n)
 {
-	int n = signal.n;
-	
-	fft.resize(n);
-	recon_signal.resize(n);
-	
-	fftw_plan fwd_plan, bwd_plan;
+	if (n < 1) return false;
+	runComplexFFT(signal, spectrum, n, true);
+	return true;
+}
 
-	fwd_plan = fftw_plan_dft_1d(n, signal.data, fft.data, FFTW_FORWARD, FFTW_ESTIMATE);
-	fftw_execute(fwd_plan); 
-	fftw_destroy_plan(fwd_plan);
+bool computeInverseFFT(complex<float>* spectrum, float* signal, int n)
+{
+	if (n < 1) return false;
+	// The result is the real part of the complex inverse, which is the
+	// inverse of the symmetric part of the spectrum. That part has real
+	// input, so a real transform gives it.
+	static thread_local vector<complex<float> > symmetric;
+	symmetric.resize(n/2+1);
+	for (int k=0; k<=n/2; k++)
+		symmetric[k] = 0.5f*(spectrum[k] + conj(spectrum[(n-k)%n]));
+	runInverseRealFFT(&symmetric[0], signal, n);
+	for (int i=0; i<n; i++) { signal[i] /= n; }
+	return true;
+}
 
-	if (cutoff > 0)
-		for (int i=cutoff; i<n; i++) { fft.data[i][0] = fft.data[i][1] = 0.0f; }
+bool computeInverseFFT(complex<float>* spectrum, complex<float>* signal, int n)
+{
+	if (n < 1) return false;
+	runComplexFFT(spectrum, signal, n, false);
+	for (int i=0; i<n; i++) { signal[i] /= complex<float>(float(n),0.0f); }
+	return true;
+}
 
-	bwd_plan = fftw_plan_dft_1d(n, fft.data, recon_signal.data, FFTW_BACKWARD, FFTW_ESTIMATE);
-	fftw_execute(bwd_plan); 
-	fftw_destroy_plan(bwd_plan);
-	for (int i=0; i<n; i++) { recon_signal.data[i][0] /= n; recon_signal.data[i][1] /= n;}
+bool computeRealFFT(const float* signal, complex<float>* spectrum, int n)
+{
+	if (n < 1) return false;
+	runRealFFT(signal, spectrum, n);
+	return true;
 }
 
-static void runFFTwithFilter(float* signal, complex<float>* spectrum, float* recon_signal, int n, int cutoff=-1)
+bool computeInverseRealFFT(const complex<float>* spectrum, float* signal, int n)
 {
-	computeFFT(signal, spectrum, n);
+	if (n < 1) return false;
+	runInverseRealFFT(spectrum, signal, n);
+	for (int i=0; i<n; i++) { signal[i] /= n; }
+	return true;
+}
 
-	if (cutoff > 0)
-		for (int i=cutoff; i<n; i++) { spectrum[i] = complex<float>(0.0f,0.0f); }
+// columns transformed together per call
+static const int LOW_PASS_BATCH = 32;
 
-	computeInverseFFT(spectrum, recon_signal, n);
+// Filters columns [first, last), all with positive cutoffs, as one batch.
+static void lowPassBatch(float* data, int num_frames, const int* cutoffs, int first, int last)
+{
+	int howmany = last - first;
+	int h = num_frames/2+1;
+	static thread_local vector<complex<float> > spectra;
+	spectra.resize(long(h)*howmany);
+	float* columns = data + long(first)*num_frames;
+	runRealFFTMany(columns, &spectra[0], num_frames, howmany);
+	for (int c=0; c<howmany; c++)
+	{
+		complex<float>* spectrum = &spectra[long(c)*h];
+		for (int k=cutoffs[first+c]; k<h; k++) spectrum[k] = complex<float>(0.0f, 0.0f);
+	}
+	runInverseRealFFTMany(&spectra[0], columns, num_frames, howmany);
+	float scale = 1.0f/num_frames;
+	for (long i=0; i<long(num_frames)*howmany; i++) columns[i] *= scale;
+}
 
-	for (int i=0; i<n; i++) { recon_signal[i] /= n; }
+void lowPassChannels(float* data, int num_frames, int num_columns, const int* cutoffs, int max_threads)
+{
+	if ((num_frames < 1) || (num_columns < 1)) return;
+	// each thread takes a range of columns and filters its runs of
+	// consecutive filtered columns in batches
+	parallelForBlocks(0, num_columns, [data, num_frames, cutoffs](long begin, long end)
+	{
+		long c = begin;
+		while (c < end)
+		{
+			if (cutoffs[c] <= 0) { c++; continue; }
+			long run_end = c;
+			while ((run_end < end) && (run_end-c < LOW_PASS_BATCH) && (cutoffs[run_end] > 0)) run_end++;
+			lowPassBatch(data, num_frames, cutoffs, int(c), int(run_end));
+			c = run_end;
+		}
+	}, 1, max_threads);
 }
-#endif // ENABLE_FFTW
 
 void FFTfilter::setFilterChannels()
 {
+	filter_channels.resize(num_channels);
 	for (int channel=0; channel<num_channels; channel++)
 	{
 		filter_channels[channel] = (channel>=6);
 	}
 }
 
+void FFTfilter::setFilterChannel(int channel, bool filter)
+{
+	if ((channel >= 0) && (channel < num_channels)) filter_channels[channel] = filter;
+}
+
 void FFTfilter::initialize(MotionSequence* _motion)
 {
 	motion = _motion;
 	num_frames = motion->numFrames();
 	num_channels = motion->numChannels();
 	original.resize(num_frames, num_channels);
-	filtered.resize(num_frames, num_channels);
 	setFilterChannels();
 
 	for (int channel=0; channel<num_channels; channel++)
 	{
 		float* ptr = motion->getChannelPtr(channel);
 		memcpy(original.getColumnPtr(channel), ptr, num_frames*sizeof(float));
-		memcpy(filtered.getColumnPtr(channel), ptr, num_frames*sizeof(float));
 	}
 }
 
@@ -321,9 +373,35 @@ void FFTfilter::runFilters(int cutoff)
 
 	if (motion==NULL) return;
 
+	vector<int> cutoffs(num_channels, -1);
 	for (int channel=0; channel<num_channels; channel++)
-		if (filter_channels[channel])
-			runFilter(channel, cutoff);
+		if (filter_channels[channel]) cutoffs[channel] = cutoff;
+	runFilters(cutoffs);
+}
+
+void FFTfilter::runFilters(const vector<int>& cutoffs)
+{
+	if (motion==NULL) return;
+
+	// restart every channel from the original data, then filter the motion
+	// in place; channels without a cutoff stay unfiltered
+	vector<int> channel_cutoffs(num_channels, -1);
+	for (int channel=0; channel<num_channels; channel++)
+	{
+		if (channel < int(cutoffs.size())) channel_cutoffs[channel] = cutoffs[channel];
+		memcpy(motion->getChannelPtr(channel), original.getColumnPtr(channel), num_frames*sizeof(float));
+	}
+	lowPassChannels(motion->getChannelPtr(0), num_frames, num_channels, &channel_cutoffs[0]);
+}
+
+void FFTfilter::lowPass(MotionSequence* motion, const vector<int>& cutoffs, int max_threads)
+{
+	int num_frames = int(motion->numFrames());
+	int num_channels = motion->numChannels();
+	vector<int> channel_cutoffs(num_channels, -1);
+	for (int channel=0; (channel<num_channels) && (channel<int(cutoffs.size())); channel++)
+		channel_cutoffs[channel] = cutoffs[channel];
+	lowPassChannels(motion->getChannelPtr(0), num_frames, num_channels, &channel_cutoffs[0], max_threads);
 }
 
 bool FFTfilter::runFilter(CHANNEL_ID& channel, int cutoff)				
@@ -336,27 +414,9 @@ bool FFTfilter::runFilter(CHANNEL_ID& channel, int cutoff)
 
 void FFTfilter::runFilter(int channel, int cutoff)				
 {
-	float* original_data = original.getColumnPtr(channel);
-	float* filtered_data = filtered.getColumnPtr(channel);
-#if ENABLE_FFTW==1
-	if (cutoff < 0)
-	{
-		memcpy(filtered_data, original_data, num_frames*sizeof(float));
-	}
-	else
-	{
-		FFTW_Array signal, fft, recon_signal;
-		signal.resize(num_frames);
-		fft.resize(num_frames);
-		recon_signal.resize(num_frames);
-		signal.load(original_data);
-		runFFTwithFilter(signal, fft, recon_signal, cutoff);
-		recon_signal.extract(filtered_data);
-	}
-	memcpy(motion->data.getColumnPtr(channel), filtered_data, num_frames*sizeof(float));
-#else // ENABLE_FFTW==0
-	memcpy(filtered_data, original_data, num_frames*sizeof(float));
-#endif // ENABLE_FFTW
+	float* data = motion->getChannelPtr(channel);
+	memcpy(data, original.getColumnPtr(channel), num_frames*sizeof(float));
+	lowPassChannels(data, num_frames, 1, &cutoff, 1);
 }
 
 int FFTfilter::computeFFT(CHANNEL_ID& channel, float result[], int len)
@@ -366,32 +426,15 @@ int FFTfilter::computeFFT(CHANNEL_ID& channel, float result[], int len)
 	return computeFFT(i, result, len);
 }
 
-
-
+// real parts of the channel's spectrum
 int FFTfilter::computeFFT(int channel, float result[], int len)
 {
-#if ENABLE_FFTW==1
 	int n = num_frames;
-	float* original_data = original.getColumnPtr(channel);
-	float* fft_input = new float[n];
-	memcpy(fft_input, original_data, n*sizeof(float));
-	float* fft_data = new float[n];
-
-	FFTW_Array signal, fft, recon_signal;
-	signal.resize(n);
-	fft.resize(n);
-	signal.load(fft_input);
-	runFFTwithFilter(signal, fft, recon_signal);
-	fft.extract(fft_data);
-
+	vector<complex<float> > spectrum(n);
+	if (!::computeFFT(original.getColumnPtr(channel), &spectrum[0], n)) return 0;
 	if (n > len) n = len;
-	memcpy(result, fft_data, n*sizeof(float));
-	delete [] fft_data;
-
+	for (int i=0; i<n; i++) result[i] = spectrum[i].real();
 	return n;
-#else // ENABLE_FFTW==0
-	return 0;
-#endif // ENABLE_FFTW
 }
 
 int FFTfilter::computeFFT(CHANNEL_ID& channel, complex<float> result[], int len)
@@ -401,29 +444,12 @@ int FFTfilter::computeFFT(CHANNEL_ID& channel, complex<float> result[], int len)
 	return computeFFT(i, result, len);
 }
 
-// INWORK - modify this to extract both real and imaginary components
 int FFTfilter::computeFFT(int channel, complex<float> result[], int len)
 {
-#if ENABLE_FFTW==1
 	int n = num_frames;
-	float* original_data = original.getColumnPtr(channel);
-	float* fft_input = new float[n];
-	memcpy(fft_input, original_data, n*sizeof(float));
-	float* fft_data = new float[n];
-
-	FFTW_Array signal, fft, recon_signal;
-	signal.resize(n);
-	fft.resize(n);
-	signal.load(fft_input);
-	runFFTwithFilter(signal, fft, recon_signal);
-	fft.extract(fft_data);
-
+	vector<complex<float> > spectrum(n);
+	if (!::computeFFT(original.getColumnPtr(channel), &spectrum[0], n)) return 0;
 	if (n > len) n = len;
-	memcpy(result, fft_data, n*sizeof(float));
-	delete [] fft_data;
-
+	for (int i=0; i<n; i++) result[i] = spectrum[i];
 	return n;
-#else // ENABLE_FFTW==0
-	return 0;
-#endif // ENABLE_FFTW
-}
\ No newline at end of file
+}
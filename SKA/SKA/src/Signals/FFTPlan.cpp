@@ -0,0 +1,473 @@
+//-----------------------------------------------------------------------------
+// FFTPlan.cpp
+//	 Built-in Fast Fourier Transform, used by the functions in FFT.h when
+//   the FFTW library is not enabled.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+using namespace std;
+#include <Signals/FFTPlan.h>
+#include <Math/Math.h>
+#include <Math/Float4.h>
+
+// largest prime handled by a generic radix stage, larger ones use Bluestein
+static const int MAX_RADIX = 31;
+
+static const double FFT_TWO_PI = 6.283185307179586;
+
+static complex<float> unitRoot(double sign, long long k, long long n)
+{
+	double a = sign * FFT_TWO_PI * double(k % n) / double(n);
+	return complex<float>(float(cos(a)), float(sin(a)));
+}
+
+//-----------------------------------------------------------------------------
+// Two complex numbers per Float4, interleaved (re0, im0, re1, im1).
+//-----------------------------------------------------------------------------
+
+// a times i
+static inline Float4 c2muli(Float4 a)
+{
+	return f4mul(f4swappairs(a), f4set(-1.0f, 1.0f, -1.0f, 1.0f));
+}
+
+// a times w, with wr = (w.re, w.re, w.re, w.re), wi = (-w.im, w.im, -w.im, w.im)
+static inline Float4 c2mul(Float4 a, Float4 wr, Float4 wi)
+{
+	return f4madd(f4swappairs(a), wi, f4mul(a, wr));
+}
+
+static inline void c2split(complex<float> w, Float4& wr, Float4& wi)
+{
+	wr = f4set1(w.real());
+	wi = f4set(-w.imag(), w.imag(), -w.imag(), w.imag());
+}
+
+// one or two complex values starting at complex index i
+static inline Float4 c2load(const float* x, long i, bool two)
+{
+	if (two) return f4loadu(x + 2*i);
+	return f4set(x[2*i], x[2*i+1], 0.0f, 0.0f);
+}
+
+static inline void c2store(float* y, long i, Float4 v, bool two)
+{
+	if (two) { f4storeu(y + 2*i, v); return; }
+	float t[4];
+	f4storeu(t, v);
+	y[2*i] = t[0]; y[2*i+1] = t[1];
+}
+
+//-----------------------------------------------------------------------------
+// per-thread working memory
+//   Each use has its own slot, so nested transforms (Bluestein, real
+//   transforms through a complex plan) never share a buffer:
+//   SCRATCH_STAGES for the mixed radix stages, SCRATCH_BLUESTEIN for the
+//   convolution, SCRATCH_REAL for the packed half length data.
+//-----------------------------------------------------------------------------
+
+enum { SCRATCH_STAGES, SCRATCH_BLUESTEIN, SCRATCH_REAL, NUM_SCRATCH };
+
+struct FFTScratch
+{
+	float* buffer;
+	long capacity;		// complex values
+	FFTScratch() : buffer(NULL), capacity(0) { }
+	~FFTScratch() { delete [] buffer; }
+	// 16 byte aligned space for at least size complex values
+	complex<float>* get(long size)
+	{
+		if (size > capacity)
+		{
+			delete [] buffer;
+			capacity = size;
+			buffer = new float[2*capacity + 4];
+		}
+		size_t misalign = (size_t(buffer) & 15) / sizeof(float);
+		return (complex<float>*)(buffer + ((4 - misalign) & 3));
+	}
+};
+
+static complex<float>* scratch(int slot, long size)
+{
+	static thread_local FFTScratch buffers[NUM_SCRATCH];
+	return buffers[slot].get(size);
+}
+
+//-----------------------------------------------------------------------------
+// construction
+//-----------------------------------------------------------------------------
+
+FFTPlan::FFTPlan(int _n, FFT_DIRECTION _direction, FFT_TYPE _type)
+	: n(_n), direction(_direction), type(_type), bluestein(false), m(0),
+	forward_m(NULL), backward_m(NULL), complex_plan(NULL)
+{
+	if (n < 1) throw MathException("FFTPlan: size must be positive");
+	double sign = (direction == FFT_FORWARD) ? -1.0 : 1.0;
+
+	if (type == FFT_REAL)
+	{
+		if (n % 2 == 0)
+		{
+			// n real values packed as n/2 complex values
+			complex_plan = new FFTPlan(n/2, direction);
+			real_twiddles.resize(n/2);
+			for (int k=0; k<n/2; k++) real_twiddles[k] = unitRoot(sign, k, n);
+		}
+		else
+		{
+			complex_plan = new FFTPlan(n, direction);
+		}
+		return;
+	}
+
+	// factor n, radix 4 stages first
+	int remaining = n;
+	while (remaining % 4 == 0) { radices.push_back(4); remaining /= 4; }
+	if (remaining % 2 == 0) { radices.push_back(2); remaining /= 2; }
+	for (int p=3; remaining>1; p+=2)
+	{
+		if (p > MAX_RADIX)
+		{
+			bluestein = true;
+			break;
+		}
+		while (remaining % p == 0) { radices.push_back(p); remaining /= p; }
+	}
+
+	if (bluestein)
+	{
+		radices.clear();
+		m = 1;
+		while (m < 2*long(n)-1) m *= 2;
+		chirp.resize(n);
+		for (long k=0; k<n; k++)
+		{
+			// exp(sign*i*pi*k^2/n), with k^2 reduced mod 2n to keep precision
+			chirp[k] = unitRoot(sign, ((long long)k*k) % (2*(long long)n), 2*(long long)n);
+		}
+		vector<complex<float> > kernel(m, complex<float>(0.0f, 0.0f));
+		kernel[0] = conj(chirp[0]);
+		for (long k=1; k<n; k++) kernel[k] = kernel[m-k] = conj(chirp[k]);
+		forward_m = new FFTPlan(int(m), FFT_FORWARD);
+		backward_m = new FFTPlan(int(m), FFT_BACKWARD);
+		kernel_spectrum.resize(m);
+		forward_m->execute(&kernel[0], &kernel_spectrum[0]);
+		float scale = 1.0f/float(m);
+		for (long k=0; k<m; k++) kernel_spectrum[k] *= scale;
+		return;
+	}
+
+	// stage twiddles: w[p*(r-1) + k-1] = exp(sign*2*pi*i*p*k/len)
+	long len = n;
+	for (unsigned int stage=0; stage<radices.size(); stage++)
+	{
+		int r = radices[stage];
+		long sub = len / r;
+		twiddle_offsets.push_back(long(twiddles.size()));
+		for (long p=0; p<sub; p++)
+			for (int k=1; k<r; k++)
+				twiddles.push_back(unitRoot(sign, (long long)p*k, len));
+		len = sub;
+	}
+}
+
+FFTPlan::~FFTPlan()
+{
+	delete forward_m;
+	delete backward_m;
+	delete complex_plan;
+}
+
+//-----------------------------------------------------------------------------
+// mixed radix stages
+//   Each stage (Stockham autosort) takes a length len sub-transform, stride
+//   s = n/len, to r sub-transforms of length len/r and stride s*r:
+//     y[q + s*(r*p + k)] = w^(p*k) * sum over j of x[q + s*(p + j*len/r)] * v^(j*k)
+//   with w and v the len-th and r-th roots of unity. The inner loop runs
+//   over q, two complex values per Float4, with one twiddle for all q.
+//-----------------------------------------------------------------------------
+
+void FFTPlan::runStage(int stage, long len, const float* x, float* y) const
+{
+	int r = radices[stage];
+	long s = n / len;
+	long sub = len / r;
+	const complex<float>* tw = &twiddles[twiddle_offsets[stage]];
+	bool forward = (direction == FFT_FORWARD);
+	double sign = forward ? -1.0 : 1.0;
+
+	Float4 a[MAX_RADIX], b[MAX_RADIX];
+	Float4 wr[MAX_RADIX], wi[MAX_RADIX];
+
+	// butterfly constants
+	Float4 c3 = f4set1(-0.5f);
+	Float4 s3 = f4set1(float(sign * 0.86602540378443865));
+	Float4 c51 = f4set1(0.30901699437494742f), c52 = f4set1(-0.80901699437494742f);
+	Float4 s51 = f4set1(float(sign * 0.95105651629515357));
+	Float4 s52 = f4set1(float(sign * 0.58778525229247313));
+	Float4 rr[MAX_RADIX], ri[MAX_RADIX];
+	if (r > 5)
+	{
+		for (int j=0; j<r; j++) c2split(unitRoot(sign, j, r), rr[j], ri[j]);
+	}
+
+	for (long p=0; p<sub; p++)
+	{
+		for (int k=1; k<r; k++) c2split(tw[p*(r-1) + k-1], wr[k], wi[k]);
+		for (long q=0; q<s; q+=2)
+		{
+			bool two = (q+1 < s);
+			for (int j=0; j<r; j++) a[j] = c2load(x, q + s*(p + j*sub), two);
+			switch (r)
+			{
+			case 2:
+				b[0] = f4add(a[0], a[1]);
+				b[1] = f4sub(a[0], a[1]);
+				break;
+			case 3:
+			{
+				Float4 t1 = f4add(a[1], a[2]);
+				Float4 t2 = f4madd(t1, c3, a[0]);
+				Float4 t3 = c2muli(f4mul(s3, f4sub(a[1], a[2])));
+				b[0] = f4add(a[0], t1);
+				b[1] = f4add(t2, t3);
+				b[2] = f4sub(t2, t3);
+				break;
+			}
+			case 4:
+			{
+				Float4 t0 = f4add(a[0], a[2]);
+				Float4 t1 = f4sub(a[0], a[2]);
+				Float4 t2 = f4add(a[1], a[3]);
+				Float4 t3 = c2muli(f4sub(a[1], a[3]));
+				if (forward) t3 = f4neg(t3);
+				b[0] = f4add(t0, t2);
+				b[1] = f4add(t1, t3);
+				b[2] = f4sub(t0, t2);
+				b[3] = f4sub(t1, t3);
+				break;
+			}
+			case 5:
+			{
+				Float4 t1 = f4add(a[1], a[4]), t2 = f4add(a[2], a[3]);
+				Float4 t3 = f4sub(a[1], a[4]), t4 = f4sub(a[2], a[3]);
+				Float4 u1 = f4add(a[0], f4add(f4mul(c51, t1), f4mul(c52, t2)));
+				Float4 u2 = f4add(a[0], f4add(f4mul(c52, t1), f4mul(c51, t2)));
+				Float4 v1 = c2muli(f4add(f4mul(s51, t3), f4mul(s52, t4)));
+				Float4 v2 = c2muli(f4sub(f4mul(s52, t3), f4mul(s51, t4)));
+				b[0] = f4add(a[0], f4add(t1, t2));
+				b[1] = f4add(u1, v1);
+				b[4] = f4sub(u1, v1);
+				b[2] = f4add(u2, v2);
+				b[3] = f4sub(u2, v2);
+				break;
+			}
+			default:
+				for (int k=0; k<r; k++)
+				{
+					Float4 sum = a[0];
+					for (int j=1; j<r; j++)
+					{
+						int e = (j*k) % r;
+						sum = f4add(sum, c2mul(a[j], rr[e], ri[e]));
+					}
+					b[k] = sum;
+				}
+				break;
+			}
+			long out = q + s*r*p;
+			c2store(y, out, b[0], two);
+			for (int k=1; k<r; k++) c2store(y, out + s*k, c2mul(b[k], wr[k], wi[k]), two);
+		}
+	}
+}
+
+void FFTPlan::executeStages(const complex<float>* in, complex<float>* out, complex<float>* work) const
+{
+	int num_stages = int(radices.size());
+	if (num_stages == 0)
+	{
+		out[0] = in[0];
+		return;
+	}
+	// stages alternate between out and work, ending in out
+	const float* x = (const float*)in;
+	long len = n;
+	for (int stage=0; stage<num_stages; stage++)
+	{
+		float* y = ((num_stages-1-stage) % 2 == 0) ? (float*)out : (float*)work;
+		runStage(stage, len, x, y);
+		len /= radices[stage];
+		x = y;
+	}
+}
+
+void FFTPlan::executeBluestein(const complex<float>* in, complex<float>* out) const
+{
+	complex<float>* a = scratch(SCRATCH_BLUESTEIN, m);
+	for (long k=0; k<n; k++) a[k] = in[k] * chirp[k];
+	for (long k=n; k<m; k++) a[k] = complex<float>(0.0f, 0.0f);
+	forward_m->execute(a, a);
+	for (long k=0; k<m; k++) a[k] *= kernel_spectrum[k];
+	backward_m->execute(a, a);
+	for (long k=0; k<n; k++) out[k] = a[k] * chirp[k];
+}
+
+//-----------------------------------------------------------------------------
+// public transforms
+//-----------------------------------------------------------------------------
+
+void FFTPlan::execute(const complex<float>* in, complex<float>* out) const
+{
+	if (type != FFT_COMPLEX) throw MathException("FFTPlan::execute: not a complex plan");
+	if (bluestein)
+	{
+		executeBluestein(in, out);
+		return;
+	}
+	complex<float>* work = scratch(SCRATCH_STAGES, 2*long(n));
+	if (in == out)
+	{
+		// keep a copy of the input, the stages overwrite out
+		memcpy(work+n, in, n*sizeof(complex<float>));
+		in = work+n;
+	}
+	executeStages(in, out, work);
+}
+
+// With z[j] = x[2j] + i*x[2j+1] and Z its half length transform,
+//   the transforms of the even and odd samples are
+//   E[k] = (Z[k] + conj(Z[h-k]))/2 and O[k] = (Z[k] - conj(Z[h-k]))/(2i),
+//   and X[k] = E[k] + exp(-2*pi*i*k/n)*O[k].
+void FFTPlan::executeReal(const float* in, complex<float>* out) const
+{
+	if ((type != FFT_REAL) || (direction != FFT_FORWARD))
+		throw MathException("FFTPlan::executeReal: not a real forward plan");
+	if (n % 2 != 0)
+	{
+		complex<float>* z = scratch(SCRATCH_REAL, n);
+		for (int j=0; j<n; j++) z[j] = complex<float>(in[j], 0.0f);
+		complex_plan->execute(z, z);
+		for (int k=0; k<=n/2; k++) out[k] = z[k];
+		return;
+	}
+	int h = n/2;
+	complex<float>* Z = scratch(SCRATCH_REAL, h);
+	complex_plan->execute((const complex<float>*)in, Z);
+	const complex<float> minus_half_i(0.0f, -0.5f);
+	for (int k=0; k<h; k++)
+	{
+		complex<float> zk = Z[k];
+		complex<float> zc = conj(Z[(h-k) % h]);
+		complex<float> even = 0.5f*(zk + zc);
+		complex<float> odd = minus_half_i*(zk - zc);
+		out[k] = even + real_twiddles[k]*odd;
+	}
+	complex<float> even0 = complex<float>(Z[0].real(), 0.0f);
+	complex<float> odd0 = complex<float>(Z[0].imag(), 0.0f);
+	out[h] = even0 - odd0;
+}
+
+// The reverse of the forward case:
+//   Z[k] = (X[k] + X[k+h]) + i*exp(2*pi*i*k/n)*(X[k] - X[k+h]),
+//   with X[k+h] = conj(X[h-k]), and the half length backward transform
+//   of Z holds the even samples in its real parts and odd samples in its
+//   imaginary parts (scaled by n, as for the complex transform).
+void FFTPlan::executeReal(const complex<float>* in, float* out) const
+{
+	if ((type != FFT_REAL) || (direction != FFT_BACKWARD))
+		throw MathException("FFTPlan::executeReal: not a real backward plan");
+	if (n % 2 != 0)
+	{
+		complex<float>* z = scratch(SCRATCH_REAL, n);
+		z[0] = complex<float>(in[0].real(), 0.0f);
+		for (int k=1; k<=n/2; k++)
+		{
+			z[k] = in[k];
+			z[n-k] = conj(in[k]);
+		}
+		complex_plan->execute(z, z);
+		for (int j=0; j<n; j++) out[j] = z[j].real();
+		return;
+	}
+	int h = n/2;
+	complex<float>* Z = scratch(SCRATCH_REAL, h);
+	const complex<float> i_unit(0.0f, 1.0f);
+	for (int k=0; k<h; k++)
+	{
+		complex<float> xk = in[k];
+		complex<float> xkh = conj(in[h-k]);
+		if (k == 0)
+		{
+			xk = complex<float>(in[0].real(), 0.0f);
+			xkh = complex<float>(in[h].real(), 0.0f);
+		}
+		Z[k] = (xk + xkh) + i_unit*real_twiddles[k]*(xk - xkh);
+	}
+	complex_plan->execute(Z, (complex<float>*)out);
+}
+
+void FFTPlan::executeReal(const float* in, long in_distance, complex<float>* out, long out_distance, int howmany) const
+{
+	for (int t=0; t<howmany; t++) executeReal(in + t*in_distance, out + t*out_distance);
+}
+
+void FFTPlan::executeReal(const complex<float>* in, long in_distance, float* out, long out_distance, int howmany) const
+{
+	for (int t=0; t<howmany; t++) executeReal(in + t*in_distance, out + t*out_distance);
+}
+
+//-----------------------------------------------------------------------------
+// plan cache
+//-----------------------------------------------------------------------------
+
+struct FFTPlanKey
+{
+	int n;
+	FFT_DIRECTION direction;
+	FFT_TYPE type;
+	bool operator<(const FFTPlanKey& other) const
+	{
+		if (n != other.n) return n < other.n;
+		if (direction != other.direction) return direction < other.direction;
+		return type < other.type;
+	}
+};
+
+static mutex plan_cache_lock;
+static map<FFTPlanKey, FFTPlan*> plan_cache;
+
+const FFTPlan& FFTPlan::cached(int n, FFT_DIRECTION direction, FFT_TYPE type)
+{
+	FFTPlanKey key = { n, direction, type };
+	lock_guard<mutex> guard(plan_cache_lock);
+	map<FFTPlanKey, FFTPlan*>::iterator iter = plan_cache.find(key);
+	if (iter != plan_cache.end()) return *(iter->second);
+	// planning is cheap next to the transforms it is reused for,
+	// so it is done under the lock
+	FFTPlan* plan = new FFTPlan(n, direction, type);
+	plan_cache[key] = plan;
+	return *plan;
+}
+
+void FFTPlan::clearCache()
+{
+	lock_guard<mutex> guard(plan_cache_lock);
+	map<FFTPlanKey, FFTPlan*>::iterator iter;
+	for (iter=plan_cache.begin(); iter!=plan_cache.end(); iter++) delete iter->second;
+	plan_cache.clear();
+}
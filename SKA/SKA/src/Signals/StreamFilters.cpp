@@ -0,0 +1,295 @@
+//-----------------------------------------------------------------------------
+// StreamFilters.cpp
+//	 Causal filters for smoothing channels one frame at a time.
+//-----------------------------------------------------------------------------
+// This software is part of the Skeleton Animation Toolkit (SKA) developed 
+// at the University of the Pacific, under the guidance of Michael Doherty.
+// For information please contact mdoherty@pacific.edu.
+//-----------------------------------------------------------------------------
+// This is open software. You are free to use it as you see fit.
+// The University of the Pacific and identified authors would appreciate
+// being credited for any significant use, particularly if used for
+// commercial projects or academic research publications.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <cstring>
+using namespace std;
+#include <Signals/StreamFilters.h>
+#include <Math/Math.h>
+#include <Math/Float4.h>
+
+StreamFilterBank::StreamFilterBank(int _num_channels)
+	: type(SF_NONE), num_channels(0), padded(0), primed(false),
+	num_sections(0), window(0), newest(0),
+	min_cutoff(1.0f), beta(0.0f), derivative_cutoff(1.0f), last_dt(0.0f)
+{
+	setNumChannels(_num_channels);
+}
+
+void StreamFilterBank::setNumChannels(int _num_channels)
+{
+	if (_num_channels < 0) throw MathException("StreamFilterBank: negative channel count");
+	num_channels = _num_channels;
+	padded = (num_channels + 3) & ~3;
+	allocate();
+}
+
+void StreamFilterBank::allocate()
+{
+	input.assign(padded, 0.0f);
+	state.assign(2*num_sections*padded, 0.0f);
+	history.assign(window*padded, 0.0f);
+	previous.assign(type == SF_ONE_EURO ? padded : 0, 0.0f);
+	derivative.assign(type == SF_ONE_EURO ? padded : 0, 0.0f);
+	primed = false;
+}
+
+void StreamFilterBank::setNone()
+{
+	type = SF_NONE;
+	num_sections = 0;
+	window = 0;
+	allocate();
+}
+
+// Butterworth poles come in conjugate pairs at angles (2k+1)*pi/(2*order),
+//   one biquad per pair with Q = 1/(2*cos(angle)). Each biquad is the
+//   bilinear transform low-pass (Bristow-Johnson's audio EQ cookbook).
+void StreamFilterBank::setButterworth(float cutoff, float sample_rate, int order)
+{
+	if ((order < 2) || (order > 8) || (order % 2 != 0))
+		throw MathException("StreamFilterBank::setButterworth: order must be 2, 4, 6 or 8");
+	if ((cutoff <= 0.0f) || (cutoff >= 0.5f*sample_rate))
+		throw MathException("StreamFilterBank::setButterworth: cutoff must be between 0 and half the sample rate");
+	type = SF_BUTTERWORTH;
+	num_sections = order/2;
+	window = 0;
+	coefficients.resize(5*num_sections);
+	double w0 = 2.0*PI*cutoff/sample_rate;
+	double cw = cos(w0), sw = sin(w0);
+	for (int s=0; s<num_sections; s++)
+	{
+		double q = 1.0/(2.0*cos((2*s+1)*PI/(2.0*order)));
+		double alpha = sw/(2.0*q);
+		double a0 = 1.0 + alpha;
+		float* c = &coefficients[5*s];
+		c[0] = float((1.0-cw)/2.0/a0);		// b0
+		c[1] = float((1.0-cw)/a0);			// b1
+		c[2] = c[0];						// b2
+		c[3] = float(-2.0*cw/a0);			// a1
+		c[4] = float((1.0-alpha)/a0);		// a2
+	}
+	allocate();
+}
+
+// Least squares fit of a degree d polynomial to samples at t = 0, -1, ...,
+//   -(window-1), evaluated at t = 0. The result is linear in the samples:
+//   weights[i] = sum over j of g[j]*(-i)^j, with (A^T A) g = e0.
+void StreamFilterBank::setSavitzkyGolay(int _window, int degree)
+{
+	if ((degree < 0) || (degree > 4) || (_window <= degree))
+		throw MathException("StreamFilterBank::setSavitzkyGolay: need 0 <= degree <= 4 and window > degree");
+	type = SF_SAVITZKY_GOLAY;
+	num_sections = 0;
+	window = _window;
+	int d = degree+1;
+	double ata[5][6];
+	for (int r=0; r<d; r++)
+	{
+		for (int c=0; c<d; c++)
+		{
+			double sum = 0.0;
+			for (int i=0; i<window; i++) sum += pow(-double(i), r+c);
+			ata[r][c] = sum;
+		}
+		ata[r][d] = (r == 0) ? 1.0 : 0.0;
+	}
+	// Gauss-Jordan elimination with partial pivoting
+	for (int col=0; col<d; col++)
+	{
+		int pivot = col;
+		for (int r=col+1; r<d; r++) if (fabs(ata[r][col]) > fabs(ata[pivot][col])) pivot = r;
+		for (int c=0; c<=d; c++) swap(ata[col][c], ata[pivot][c]);
+		for (int r=0; r<d; r++)
+		{
+			if (r == col) continue;
+			double f = ata[r][col]/ata[col][col];
+			for (int c=col; c<=d; c++) ata[r][c] -= f*ata[col][c];
+		}
+	}
+	weights.resize(window);
+	for (int i=0; i<window; i++)
+	{
+		double w = 0.0;
+		for (int j=0; j<d; j++) w += ata[j][d]/ata[j][j] * pow(-double(i), j);
+		weights[i] = float(w);
+	}
+	allocate();
+}
+
+void StreamFilterBank::setOneEuro(float _min_cutoff, float _beta, float _derivative_cutoff)
+{
+	if ((_min_cutoff <= 0.0f) || (_derivative_cutoff <= 0.0f) || (_beta < 0.0f))
+		throw MathException("StreamFilterBank::setOneEuro: cutoffs must be positive and beta non-negative");
+	type = SF_ONE_EURO;
+	num_sections = 0;
+	window = 0;
+	min_cutoff = _min_cutoff;
+	beta = _beta;
+	derivative_cutoff = _derivative_cutoff;
+	allocate();
+}
+
+// filter state for a constant input equal to the first frame
+void StreamFilterBank::prime(const float* in)
+{
+	switch (type)
+	{
+	case SF_BUTTERWORTH:
+		// each section has unit gain at zero frequency, so y = x
+		for (int s=0; s<num_sections; s++)
+		{
+			const float* c = &coefficients[5*s];
+			float* z1 = &state[(2*s)*padded];
+			float* z2 = &state[(2*s+1)*padded];
+			for (int k=0; k<padded; k++)
+			{
+				z2[k] = (c[2] - c[4])*in[k];
+				z1[k] = (c[1] - c[3])*in[k] + z2[k];
+			}
+		}
+		break;
+	case SF_SAVITZKY_GOLAY:
+		for (int slot=0; slot<window; slot++) memcpy(&history[slot*padded], in, padded*sizeof(float));
+		newest = 0;
+		break;
+	case SF_ONE_EURO:
+		memcpy(&previous[0], in, padded*sizeof(float));
+		for (int k=0; k<padded; k++) derivative[k] = 0.0f;
+		break;
+	default:
+		break;
+	}
+	primed = true;
+}
+
+void StreamFilterBank::process(const float* in, float* out, float dt)
+{
+	if (num_channels == 0) return;
+	memcpy(&input[0], in, num_channels*sizeof(float));
+	float* x = &input[0];
+	if (!primed)
+	{
+		prime(x);
+		if (out != in) memcpy(out, in, num_channels*sizeof(float));
+		return;
+	}
+	if (dt > 0.0f) last_dt = dt;
+
+	switch (type)
+	{
+	case SF_BUTTERWORTH:
+		for (int s=0; s<num_sections; s++)
+		{
+			const float* c = &coefficients[5*s];
+			Float4 b0 = f4set1(c[0]), b1 = f4set1(c[1]), b2 = f4set1(c[2]);
+			Float4 a1 = f4set1(c[3]), a2 = f4set1(c[4]);
+			float* z1 = &state[(2*s)*padded];
+			float* z2 = &state[(2*s+1)*padded];
+			// transposed direct form II
+			for (int k=0; k<padded; k+=4)
+			{
+				Float4 xk = f4loadu(x+k);
+				Float4 s1 = f4loadu(z1+k), s2 = f4loadu(z2+k);
+				Float4 y = f4madd(b0, xk, s1);
+				f4storeu(z1+k, f4sub(f4madd(b1, xk, s2), f4mul(a1, y)));
+				f4storeu(z2+k, f4sub(f4mul(b2, xk), f4mul(a2, y)));
+				f4storeu(x+k, y);
+			}
+		}
+		break;
+	case SF_SAVITZKY_GOLAY:
+	{
+		newest = (newest + 1) % window;
+		memcpy(&history[newest*padded], x, padded*sizeof(float));
+		for (int k=0; k<padded; k+=4)
+		{
+			Float4 sum = f4zero();
+			for (int i=0; i<window; i++)
+			{
+				int slot = (newest - i + window) % window;
+				sum = f4madd(f4set1(weights[i]), f4loadu(&history[slot*padded + k]), sum);
+			}
+			f4storeu(x+k, sum);
+		}
+		break;
+	}
+	case SF_ONE_EURO:
+	{
+		// a time step with no elapsed time repeats the previous output
+		if (dt <= 0.0f)
+		{
+			memcpy(x, &previous[0], padded*sizeof(float));
+			break;
+		}
+		// smoothing factor r/(1+r) with r = 2*pi*cutoff*dt
+		float rd = float(2.0*PI)*derivative_cutoff*dt;
+		Float4 alpha_d = f4set1(rd/(1.0f + rd));
+		Float4 rate = f4set1(1.0f/dt);
+		Float4 scale = f4set1(float(2.0*PI)*dt);
+		Float4 fmin = f4set1(min_cutoff), fbeta = f4set1(beta);
+		Float4 one = f4set1(1.0f);
+		for (int k=0; k<padded; k+=4)
+		{
+			Float4 xk = f4loadu(x+k);
+			Float4 prev = f4loadu(&previous[k]);
+			Float4 dprev = f4loadu(&derivative[k]);
+			Float4 dx = f4mul(f4sub(xk, prev), rate);
+			Float4 dhat = f4madd(alpha_d, f4sub(dx, dprev), dprev);
+			Float4 r = f4mul(scale, f4madd(fbeta, f4abs(dhat), fmin));
+			Float4 alpha = f4div(r, f4add(one, r));
+			Float4 y = f4madd(alpha, f4sub(xk, prev), prev);
+			f4storeu(&derivative[k], dhat);
+			f4storeu(&previous[k], y);
+			f4storeu(x+k, y);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	memcpy(out, x, num_channels*sizeof(float));
+}
+
+float StreamFilterBank::latencyFrames() const
+{
+	switch (type)
+	{
+	case SF_BUTTERWORTH:
+	{
+		// group delay of B(z)/A(z) at z=1 is B'/B - A'/A in powers of 1/z
+		double delay = 0.0;
+		for (int s=0; s<num_sections; s++)
+		{
+			const float* c = &coefficients[5*s];
+			delay += (c[1] + 2.0*c[2])/(c[0] + c[1] + c[2]);
+			delay -= (c[3] + 2.0*c[4])/(1.0 + c[3] + c[4]);
+		}
+		return float(delay);
+	}
+	case SF_SAVITZKY_GOLAY:
+	{
+		double moment = 0.0, sum = 0.0;
+		for (int i=0; i<window; i++) { moment += i*weights[i]; sum += weights[i]; }
+		return float(moment/sum);
+	}
+	case SF_ONE_EURO:
+		// one pole low-pass at min_cutoff: (1-alpha)/alpha = 1/r
+		if (last_dt <= 0.0f) return 0.0f;
+		return 1.0f/(float(2.0*PI)*min_cutoff*last_dt);
+	default:
+		return 0.0f;
+	}
+}
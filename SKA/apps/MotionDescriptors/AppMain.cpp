@@ -98,6 +98,8 @@ void loadNextMotion() {
 			frame_duration = 1.0f/process_control.currentRequest().fps;
 		motion_analyzer = new MotionAnalyzer(anim_ctrl.numFrames(), frame_duration,
 			anim_ctrl.getSkeleton());
+		// analyze the whole take now, rather than frame by frame as it plays
+		motion_analyzer->analyzeAllFrames(anim_ctrl.getFrameDuration());
 	}
 	if (shoulder_analyzer != NULL) { delete shoulder_analyzer; shoulder_analyzer = NULL; }
 	if (process_control.currentRequest().shoulder_mode != ProcessControl::NONE)
@@ -7,6 +7,8 @@
 //-----------------------------------------------------------------------------
 // SKA configuration
 #include <Core/SystemConfiguration.h>
+// C/C++ libraries
+#include <limits>
 // local application
 #include "MotionAnalyzer.h"
 #include "ProcessControl.h"
@@ -38,7 +40,6 @@ problem occurs relatively rarely in natural human motion because
 of human joint limits.
 
 Work in progress:
-- Verify the euler->quaternion code in Quaternion.h or redefine it from theory.
 - Verify MotionAnalyzer::calcAngularVel(Quaternion& q0, Quaternion& q1) method.
 - Fix zero value for angular velocity (early frames with no prior data).
 */
@@ -105,29 +106,29 @@ void MotionAnalyzer::extractJointPositionsAndOrientations() {
 		joint_positions[right_fingertip] = ourSkel->getBone("rfingers")->getEndPosition();
 
 		// FIXIT:170630 mapping between bone orientations and joint orientations is not yet verified
-		joint_orientations[sacrum] = ourSkel->getBone("root")->getOrientation();
-		joint_orientations[mid_spine] = ourSkel->getBone("upperback")->getOrientation();
-		joint_orientations[upper_spine] = ourSkel->getBone("lowerneck")->getOrientation();
-		joint_orientations[atlas] = ourSkel->getBone("upperneck")->getOrientation();
-		joint_orientations[skull_top] = Vector3D(0.0f, 0.0f, 0.0f);
-
-		joint_orientations[left_hip] = ourSkel->getBone("lhipjoint")->getOrientation();
-		joint_orientations[left_knee] = ourSkel->getBone("lfemur")->getOrientation();
-		joint_orientations[left_ankle] = ourSkel->getBone("ltibia")->getOrientation();
-		joint_orientations[left_toetip] = Vector3D(0.0f, 0.0f, 0.0f);
-		joint_orientations[right_hip] = ourSkel->getBone("rhipjoint")->getOrientation();
-		joint_orientations[right_knee] = ourSkel->getBone("rfemur")->getOrientation();
-		joint_orientations[right_ankle] = ourSkel->getBone("rtibia")->getOrientation();
-		joint_orientations[right_toetip] = Vector3D(0.0f, 0.0f, 0.0f);
-
-		joint_orientations[left_shoulder] = ourSkel->getBone("lclavicle")->getOrientation();
-		joint_orientations[left_elbow] = ourSkel->getBone("lhumerus")->getOrientation();
-		joint_orientations[left_wrist] = ourSkel->getBone("lradius")->getOrientation();
-		joint_orientations[left_fingertip] = Vector3D(0.0f, 0.0f, 0.0f);
-		joint_orientations[right_shoulder] = ourSkel->getBone("rclavicle")->getOrientation();
-		joint_orientations[right_elbow] = ourSkel->getBone("rhumerus")->getOrientation();
-		joint_orientations[right_wrist] = ourSkel->getBone("rradius")->getOrientation();
-		joint_orientations[right_fingertip] = Vector3D(0.0f, 0.0f, 0.0f);
+		setJointOrientation(sacrum, ourSkel->getBone("root"));
+		setJointOrientation(mid_spine, ourSkel->getBone("upperback"));
+		setJointOrientation(upper_spine, ourSkel->getBone("lowerneck"));
+		setJointOrientation(atlas, ourSkel->getBone("upperneck"));
+		setJointOrientation(skull_top, NULL);
+
+		setJointOrientation(left_hip, ourSkel->getBone("lhipjoint"));
+		setJointOrientation(left_knee, ourSkel->getBone("lfemur"));
+		setJointOrientation(left_ankle, ourSkel->getBone("ltibia"));
+		setJointOrientation(left_toetip, NULL);
+		setJointOrientation(right_hip, ourSkel->getBone("rhipjoint"));
+		setJointOrientation(right_knee, ourSkel->getBone("rfemur"));
+		setJointOrientation(right_ankle, ourSkel->getBone("rtibia"));
+		setJointOrientation(right_toetip, NULL);
+
+		setJointOrientation(left_shoulder, ourSkel->getBone("lclavicle"));
+		setJointOrientation(left_elbow, ourSkel->getBone("lhumerus"));
+		setJointOrientation(left_wrist, ourSkel->getBone("lradius"));
+		setJointOrientation(left_fingertip, NULL);
+		setJointOrientation(right_shoulder, ourSkel->getBone("rclavicle"));
+		setJointOrientation(right_elbow, ourSkel->getBone("rhumerus"));
+		setJointOrientation(right_wrist, ourSkel->getBone("rradius"));
+		setJointOrientation(right_fingertip, NULL);
 	}
 	/*
 	"root" 
@@ -165,32 +166,44 @@ void MotionAnalyzer::extractJointPositionsAndOrientations() {
 		joint_positions[right_fingertip] = ourSkel->getBone("RightHand")->getEndPosition();
 
 		// FIXIT:170630 mapping between bone orientations and joint orientations is not yet verified
-		joint_orientations[sacrum] = ourSkel->getBone("Spine")->getOrientation();
-		joint_orientations[mid_spine] = ourSkel->getBone("Spine1__0")->getOrientation();
-		joint_orientations[upper_spine] = ourSkel->getBone("Neck")->getOrientation();
-		joint_orientations[atlas] = ourSkel->getBone("Head")->getOrientation();
-		joint_orientations[skull_top] = Vector3D(0.0f, 0.0f, 0.0f);
-
-		joint_orientations[left_hip] = ourSkel->getBone("LeftUpLeg")->getOrientation();
-		joint_orientations[left_knee] = ourSkel->getBone("LeftLeg")->getOrientation();
-		joint_orientations[left_ankle] = ourSkel->getBone("LeftFoot")->getOrientation();
-		joint_orientations[left_toetip] = Vector3D(0.0f, 0.0f, 0.0f);
-		joint_orientations[right_hip] = ourSkel->getBone("RightUpLeg")->getOrientation();
-		joint_orientations[right_knee] = ourSkel->getBone("RightLeg")->getOrientation();
-		joint_orientations[right_ankle] = ourSkel->getBone("RightFoot")->getOrientation();
-		joint_orientations[right_toetip] = Vector3D(0.0f, 0.0f, 0.0f);
-
-		joint_orientations[left_shoulder] = ourSkel->getBone("LeftArm")->getOrientation();
-		joint_orientations[left_elbow] = ourSkel->getBone("LeftForeArm")->getOrientation();
-		joint_orientations[left_wrist] = ourSkel->getBone("LeftHand")->getOrientation();
-		joint_orientations[left_fingertip] = Vector3D(0.0f, 0.0f, 0.0f);
-		joint_orientations[right_shoulder] = ourSkel->getBone("RightArm")->getOrientation();
-		joint_orientations[right_elbow] = ourSkel->getBone("RightForeArm")->getOrientation();
-		joint_orientations[right_wrist] = ourSkel->getBone("RightHand")->getOrientation();
-		joint_orientations[right_fingertip] = Vector3D(0.0f, 0.0f, 0.0f);
+		setJointOrientation(sacrum, ourSkel->getBone("Spine"));
+		setJointOrientation(mid_spine, ourSkel->getBone("Spine1__0"));
+		setJointOrientation(upper_spine, ourSkel->getBone("Neck"));
+		setJointOrientation(atlas, ourSkel->getBone("Head"));
+		setJointOrientation(skull_top, NULL);
+
+		setJointOrientation(left_hip, ourSkel->getBone("LeftUpLeg"));
+		setJointOrientation(left_knee, ourSkel->getBone("LeftLeg"));
+		setJointOrientation(left_ankle, ourSkel->getBone("LeftFoot"));
+		setJointOrientation(left_toetip, NULL);
+		setJointOrientation(right_hip, ourSkel->getBone("RightUpLeg"));
+		setJointOrientation(right_knee, ourSkel->getBone("RightLeg"));
+		setJointOrientation(right_ankle, ourSkel->getBone("RightFoot"));
+		setJointOrientation(right_toetip, NULL);
+
+		setJointOrientation(left_shoulder, ourSkel->getBone("LeftArm"));
+		setJointOrientation(left_elbow, ourSkel->getBone("LeftForeArm"));
+		setJointOrientation(left_wrist, ourSkel->getBone("LeftHand"));
+		setJointOrientation(left_fingertip, NULL);
+		setJointOrientation(right_shoulder, ourSkel->getBone("RightArm"));
+		setJointOrientation(right_elbow, ourSkel->getBone("RightForeArm"));
+		setJointOrientation(right_wrist, ourSkel->getBone("RightHand"));
+		setJointOrientation(right_fingertip, NULL);
 	}
 }
 
+// The quaternion is built from the bone's own rotation transform, so the
+// angles are applied in the order of the bone's channels in the file.
+void MotionAnalyzer::setJointOrientation(JointID jid, Bone* bone) {
+	if (bone == NULL) {
+		joint_orientations[jid] = Vector3D(0.0f, 0.0f, 0.0f);
+		joint_rotations[jid] = Quaternion();
+		return;
+	}
+	joint_orientations[jid] = bone->getOrientation();
+	joint_rotations[jid].fromRotationMatrix(bone->getM());
+}
+
 void MotionAnalyzer::storeResults(const string& directory, const string& tag)
 {
 	string fname = directory + tag + string("pos") + string(".csv");
@@ -228,12 +241,29 @@ void MotionAnalyzer::storeResults(const string& directory, const string& tag)
 	}
 }
 
+// Mass fraction of each tracked joint, used for the centre of mass and the
+// quantity of motion. Joints that are not listed count as zero.
+static float jointMassFraction(MotionAnalyzer::JointID jid) {
+	switch (jid) {
+	case MotionAnalyzer::sacrum: return .497f;
+	case MotionAnalyzer::atlas: return .081f;
+	case MotionAnalyzer::left_shoulder: case MotionAnalyzer::right_shoulder: return .028f;
+	case MotionAnalyzer::left_elbow: case MotionAnalyzer::right_elbow: return .016f;
+	case MotionAnalyzer::left_wrist: case MotionAnalyzer::right_wrist: return .006f;
+	case MotionAnalyzer::left_hip: case MotionAnalyzer::right_hip: return .1f;
+	case MotionAnalyzer::left_knee: case MotionAnalyzer::right_knee: return .0465f;
+	case MotionAnalyzer::left_ankle: case MotionAnalyzer::right_ankle: return .0145f;
+	default: return 0.0f;
+	}
+}
+
 void MotionAnalyzer::initialize(long _num_frames, float _frame_duration, Skeleton* _skel) {
 	
 	// Reset storage structures
 	joint_data.clear();
 	body_data.clear();
 	frame_data_calculated.clear();
+	clip_descriptors = ClipDescriptors();
 
 	if (_skel == NULL)
 	{
@@ -265,27 +295,15 @@ void MotionAnalyzer::initialize(long _num_frames, float _frame_duration, Skeleto
 
 		for (i = 0; i < num_frames; i++) {
 			for (j = 0; j < num_joints; j++) {
-				joint_data[i][j].joint_name = toString(JointID(i));
+				joint_data[i][j].joint_name = toString(JointID(j));
 				joint_data[i][j].frame = i;
 			}
 		}
 
-		// reinitialize bone parameters (weight maps)
-		//Init QoMWeightMap (all 1's for now)
-		QoMWeightMap.clear();
-		for (i = 0; i < num_joints; i++) {
-			string boneName = joint_data[0][i].joint_name;
-			QoMWeightMap[boneName] = 1.0;
-		}
-		//Initializaing WeightMap for each animation
-		weightMap["root"] = .497f;
-		weightMap["Shoulder"] = .028f;
-		weightMap["ForeArm"] = .016f; //elbow (beginning of ForeArm)
-		weightMap["Hand"] = .006f;
-		weightMap["UpLeg"] = .1f; //thigh (beginning of UpLeg)
-		weightMap["Leg"] = .0465f; //knees (beginning of leg)
-		weightMap["Foot"] = .0145f;
-		weightMap["Head"] = .081f;
+		// joint weights for the centre of mass and the quantity of motion
+		vector<float> mass(num_joints);
+		for (j = 0; j < num_joints; j++) mass[j] = jointMassFraction(JointID(j));
+		body_weights = MotionDescriptorEngine::bodyWeightFractions(mass, num_joints);
 	}
 }
 
@@ -444,7 +462,7 @@ pair <Quaternion, float> MotionAnalyzer::calcAngularVel(Quaternion& q0, Quaterni
 	Quaternion q = q1*conjugate(q0);
 	double len = sqrt(q.x*q.x + q.y*q.y + q.z*q.z);
 	if (len <= epsilon) {
-		Quaternion dq = Quaternion(0.0f, 2.0f * q.x, 2.0f * q.y, 2.0f * q.z);
+		Quaternion dq = Quaternion(0.0f, 2.0f * q.x / frame_duration, 2.0f * q.y / frame_duration, 2.0f * q.z / frame_duration);
 		float dq_mag = dq.magnitude();
 		return pair<Quaternion, float>(dq, dq_mag);
 	}
@@ -459,7 +477,8 @@ pair <Quaternion, float> MotionAnalyzer::calcAngularVel(Quaternion& q0, Quaterni
 //Mag(a_k(ti) X v_k(ti))/mag(v_k (ti))^3
 //PER BONE
 float MotionAnalyzer::calcCurvature(Vector3D accel, Vector3D velVector, float velMag) {
-
+	// zero where the joint does not move, as in MotionDescriptorEngine
+	if (velMag <= 0.0f) return 0.0f;
 	Vector3D top = accel.cross(velVector);
 	float top_mag = top.magnitude();
 	return top_mag / pow(velMag, 3);
@@ -467,77 +486,23 @@ float MotionAnalyzer::calcCurvature(Vector3D accel, Vector3D velVector, float ve
 }
 
 float MotionAnalyzer::calcRadiusOfCurvature(float curve) {
+	if (curve <= 0.0f) return 0.0f;
 	return 1 / curve;
 }
 
+// Same formulas as MotionDescriptorEngine, with the same weights.
 float MotionAnalyzer::calculateQoM(int frame) {
-	std::map<string, float>::iterator it = QoMWeightMap.begin();
-	float weight;//weight is represented as a percentage
-	int avg_counter = 0;
-	int i = 0;
-	float runningSum = 0.0;
-	for (i = 0; i < (int)joint_data[frame].size(); i++) {
-		//avg_counter = 0;
-		it = weightMap.begin();
-		float tmp_vel = joint_data[frame][i].velocity_mag;
-		string tmp_bone_name = joint_data[frame][i].joint_name;
-
-		// strip off "Left" or "Right" prefix
-		if (tmp_bone_name.find("Right") == 0) tmp_bone_name = tmp_bone_name.substr(5);
-		if (tmp_bone_name.find("Left") == 0) tmp_bone_name = tmp_bone_name.substr(4);
-
-		while (it != weightMap.end()) {
-			if (tmp_bone_name.compare(it->first) == 0) {//if we find the bone name in our weightMap
-				avg_counter += 1;
-				weight = it->second;
-				float tmpVal = weight*tmp_vel;
-				runningSum += tmpVal;
-				//runningAvg /= (float)avg_counter;
-				break;
-			}
-			else {
-				it++;
-			}
-		}
-	}
-	return runningSum / (float)avg_counter;
+	float qom = 0.0f;
+	for (int j = 0; j < num_joints; j++)
+		qom += body_weights[j] * joint_data[frame][j].velocity_mag;
+	return qom;
 }
 
 Vector3D MotionAnalyzer::calculateCoM(int frame) {
-	std::map<std::string, float>::iterator it = weightMap.begin();
-	float weight;//weight is represented as a percentage
-	int avg_counter = 0;
-	int i = 0;
-	Vector3D runningSum;
-	for (i = 0; i < (int)joint_data[frame].size(); i++) {
-		//avg_counter = 0;
-		it = weightMap.begin();
-		Vector3D tmp_pos = joint_data[frame][i].position;
-		string tmp_bone_name = joint_data[frame][i].joint_name;
-
-		// strip off "Left" or "Right" prefix
-		if (tmp_bone_name.find("Right") == 0) tmp_bone_name = tmp_bone_name.substr(5);
-		if (tmp_bone_name.find("Left") == 0) tmp_bone_name = tmp_bone_name.substr(4);
-
-		while (it != weightMap.end()) {
-			if (tmp_bone_name.compare(it->first) == 0) {//if wefind the bone name in our weightMap
-														//std::cout << "name match: " << BoneVector[frame][i].getBone()->getName() << " matches " << it->first << std::endl;
-				avg_counter += 1;
-				weight = it->second;
-				float tmpValx = weight*tmp_pos.getX(); //no * overload? Just manually multiply x y z
-				float tmpValy = weight*tmp_pos.getY();
-				float tmpValz = weight*tmp_pos.getZ();
-				Vector3D tmpVal(tmpValx, tmpValy, tmpValz);
-				runningSum += tmpVal;
-				//runningAvg /= (float)avg_counter;
-				break;
-			}
-			else {
-				it++;
-			}
-		}
-	}
-	return runningSum / (float)avg_counter;
+	Vector3D com(0.0f, 0.0f, 0.0f);
+	for (int j = 0; j < num_joints; j++)
+		com += joint_data[frame][j].position * body_weights[j];
+	return com;
 }
 
 void MotionAnalyzer::analyzeCurrentFrame(long frame_id, float _frame_duration)
@@ -558,12 +523,7 @@ void MotionAnalyzer::analyzeCurrentFrame(long frame_id, float _frame_duration)
 	for (int j = 0; j < num_joints; j++) {
 		joint_data[animation_frame][j].position = joint_positions[j];
 		joint_data[animation_frame][j].orientation_euler = joint_orientations[j];
-		Quaternion q;
-		// FIXIT! CMU ASM: build rotation transform as RxRyRz
-		//        UOP BVH: build rotation transform as RyRxRz
-		// The following function needs to handle different application orders.
-		q.fromEuler(joint_orientations[j]);
-		joint_data[animation_frame][j].orientation_quat = q;
+		joint_data[animation_frame][j].orientation_quat = joint_rotations[j];
 	}
 
 	// data for individual joints
@@ -671,3 +631,69 @@ void MotionAnalyzer::analyzeCurrentFrame(long frame_id, float _frame_duration)
 	float QoM = calculateQoM(animation_frame);
 	body_data[animation_frame].setQoM(QoM);
 }
+
+void MotionAnalyzer::analyzeAllFrames(float frame_step, int max_threads)
+{
+	if ((ourSkel == NULL) || (num_frames <= 0)) return;
+
+	// gather the joint trajectories of the whole animation
+	JointTrajectories trajectories;
+	trajectories.resize(num_joints, num_frames);
+	for (long f = 0; f < num_frames; f++) {
+		ourSkel->update(f*frame_step);
+		extractJointPositionsAndOrientations();
+		for (int j = 0; j < num_joints; j++) {
+			const Quaternion& q = joint_rotations[j];
+			joint_data[f][j].position = joint_positions[j];
+			joint_data[f][j].orientation_euler = joint_orientations[j];
+			joint_data[f][j].orientation_quat = q;
+			trajectories.column(j, JointTrajectories::PX)[f] = joint_positions[j].x;
+			trajectories.column(j, JointTrajectories::PY)[f] = joint_positions[j].y;
+			trajectories.column(j, JointTrajectories::PZ)[f] = joint_positions[j].z;
+			trajectories.column(j, JointTrajectories::QW)[f] = q.w;
+			trajectories.column(j, JointTrajectories::QX)[f] = q.x;
+			trajectories.column(j, JointTrajectories::QY)[f] = q.y;
+			trajectories.column(j, JointTrajectories::QZ)[f] = q.z;
+		}
+	}
+	ourSkel->update(0.0f);
+
+	MotionDescriptorEngine engine(max_threads);
+	engine.setBodyWeights(body_weights);
+	engine.analyze(trajectories, frame_duration, clip_descriptors);
+
+	// copy the columns back into the per frame records
+	const ClipDescriptors& cd = clip_descriptors;
+	vector<Vector3D> points(num_joints);
+	for (long f = 0; f < num_frames; f++) {
+		for (int j = 0; j < num_joints; j++) {
+			JointData& jd = joint_data[f][j];
+			jd.velocity_vec = Vector3D(cd.jointColumn(j, ClipDescriptors::VX)[f],
+				cd.jointColumn(j, ClipDescriptors::VY)[f], cd.jointColumn(j, ClipDescriptors::VZ)[f]);
+			jd.velocity_mag = cd.jointColumn(j, ClipDescriptors::V_MAG)[f];
+			jd.acceleration_vec = Vector3D(cd.jointColumn(j, ClipDescriptors::AX)[f],
+				cd.jointColumn(j, ClipDescriptors::AY)[f], cd.jointColumn(j, ClipDescriptors::AZ)[f]);
+			jd.acceleration_mag = cd.jointColumn(j, ClipDescriptors::A_MAG)[f];
+			jd.jerk_vec = Vector3D(cd.jointColumn(j, ClipDescriptors::JX)[f],
+				cd.jointColumn(j, ClipDescriptors::JY)[f], cd.jointColumn(j, ClipDescriptors::JZ)[f]);
+			jd.jerk_mag = cd.jointColumn(j, ClipDescriptors::J_MAG)[f];
+			jd.curvature = cd.jointColumn(j, ClipDescriptors::CURVATURE)[f];
+			jd.curvature_radius = cd.jointColumn(j, ClipDescriptors::CURVATURE_RADIUS)[f];
+			jd.ang_velocity_quat = Quaternion(0.0f, cd.jointColumn(j, ClipDescriptors::WX)[f],
+				cd.jointColumn(j, ClipDescriptors::WY)[f], cd.jointColumn(j, ClipDescriptors::WZ)[f]);
+			jd.ang_velocity_mag = cd.jointColumn(j, ClipDescriptors::W_MAG)[f];
+			points[j] = jd.position;
+		}
+		body_data[f].setFrame(f);
+		body_data[f].setBoundingBox(
+			Vector3D(cd.bodyColumn(ClipDescriptors::BOX_MIN_X)[f], cd.bodyColumn(ClipDescriptors::BOX_MIN_Y)[f],
+				cd.bodyColumn(ClipDescriptors::BOX_MIN_Z)[f]),
+			Vector3D(cd.bodyColumn(ClipDescriptors::BOX_MAX_X)[f], cd.bodyColumn(ClipDescriptors::BOX_MAX_Y)[f],
+				cd.bodyColumn(ClipDescriptors::BOX_MAX_Z)[f]));
+		body_data[f].setBoundingSphere(calcBoundingSphere(points));
+		body_data[f].setCoM(Vector3D(cd.bodyColumn(ClipDescriptors::COM_X)[f],
+			cd.bodyColumn(ClipDescriptors::COM_Y)[f], cd.bodyColumn(ClipDescriptors::COM_Z)[f]));
+		body_data[f].setQoM(cd.bodyColumn(ClipDescriptors::QOM)[f]);
+		frame_data_calculated[f] = true;
+	}
+}
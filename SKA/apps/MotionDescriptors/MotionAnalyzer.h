@@ -16,6 +16,7 @@
 #include "JointData.h"
 #include "FullBodyData.h"
 #include "AnimationControl.h"
+#include "MotionDescriptorEngine.h"
 
 class MotionAnalyzer {
 public:
@@ -64,6 +65,7 @@ public:
 		num_joints = right_fingertip + 1;
 		joint_positions.resize(num_joints);
 		joint_orientations.resize(num_joints);
+		joint_rotations.resize(num_joints);
 		initialize(_num_frames, _frame_duration, _skel);
 	}
 
@@ -74,6 +76,14 @@ public:
 	// Do analysis for the current frame.
 	void analyzeCurrentFrame(long frame_id, float _frame_duration = 0.0);
 
+	// Do analysis for all frames at once, stepping the skeleton through the
+	// animation (frame_step is the time between animation frames).
+	// analyzeCurrentFrame() then has nothing left to do.
+	void analyzeAllFrames(float frame_step, int max_threads = 0);
+
+	// Results of analyzeAllFrames(), one column per descriptor.
+	const ClipDescriptors& clipDescriptors() const { return clip_descriptors; }
+
 	void storeResults(const string& directory, const string& tag);
 
 private:
@@ -88,14 +98,17 @@ private:
 	// These are temporary locations for extracting data from the skeleton.
 	vector<Vector3D> joint_positions;
 	vector<Vector3D> joint_orientations; 
+	// rotation of each joint's bone, applied in the bone's channel order
+	vector<Quaternion> joint_rotations;
 
 	// These are the permanent locations indexed by frame.
 	vector<vector<JointData> > joint_data;
 	vector<FullBodyData> body_data;
 	vector<bool> frame_data_calculated;
+	ClipDescriptors clip_descriptors;
 
-	std::map<std::string, float> weightMap;//used for CoM
-	std::map<std::string, float> QoMWeightMap; //used for QoM
+	// joint weights for CoM and QoM, summing to 1
+	vector<float> body_weights;
 
 	// data that comes from the animation module
 	Skeleton* ourSkel;
@@ -119,6 +132,8 @@ private:
 	Vector3D calculateCoM(int frame);
 
 	void extractJointPositionsAndOrientations();
+	// bone == NULL for joints without an orientation (tips)
+	void setJointOrientation(JointID jid, Bone* bone);
 
 };
 
@@ -0,0 +1,243 @@
+//-----------------------------------------------------------------------------
+// MotionDescriptors project - Builds with SKA Version 4.0
+//-----------------------------------------------------------------------------
+// MotionDescriptorEngine.cpp
+//			Computes the motion descriptors of MotionAnalyzer for a whole clip.
+//-----------------------------------------------------------------------------
+// SKA configuration
+#include <Core/SystemConfiguration.h>
+// C/C++ libraries
+#include <cmath>
+#include <algorithm>
+#include <limits>
+using namespace std;
+// SKA modules
+#include <Core/Parallel.h>
+#include <Math/Float4.h>
+// local application
+#include "MotionDescriptorEngine.h"
+
+// rotations smaller than this are treated as infinitesimal by the angular velocity
+static const float ANGULAR_EPSILON = 0.00001f;
+// frame blocks (of four frames) per parallel work item for the full body descriptors
+static const long BODY_MIN_BLOCKS = 256;
+
+// Columns are padded so that a four frame block starting at any frame of
+// the clip can be read and written.
+static long paddedStride(long num_frames)
+{
+	return ((num_frames + 3) / 4) * 4 + 4;
+}
+
+void JointTrajectories::resize(int _num_joints, long _num_frames)
+{
+	num_joints = _num_joints;
+	num_frames = _num_frames;
+	stride = paddedStride(num_frames);
+	data.assign(NUM_COMPONENTS*num_joints*stride, 0.0f);
+}
+
+void ClipDescriptors::resize(int _num_joints, long _num_frames)
+{
+	num_joints = _num_joints;
+	num_frames = _num_frames;
+	stride = paddedStride(num_frames);
+	// every frame is overwritten by the analysis, so old values can stay
+	joint_data.resize(NUM_JOINT_COLUMNS*num_joints*stride);
+	body_data.resize(NUM_BODY_COLUMNS*stride);
+}
+
+// Rotation angle of the relative rotation (w, x, y, z) divided by the length
+// of (x, y, z). For tiny rotations this tends to 2.
+static float rotationScale(float len, float w)
+{
+	if (len <= ANGULAR_EPSILON) return 2.0f;
+	return 2.0f * atan2(len, w) / len;
+}
+
+// All descriptors of one joint for frame f, for the first frames of a clip,
+// where the stencils reach back before frame 0.
+static void scalarFrame(const float* const p[3], const float* const q[4], float* const out[], long f,
+	float inv_dt)
+{
+	float v[3] = { 0.0f, 0.0f, 0.0f };
+	float a[3] = { 0.0f, 0.0f, 0.0f };
+	float j[3] = { 0.0f, 0.0f, 0.0f };
+	for (int k = 0; k < 3; k++) {
+		if (f >= 1) v[k] = (p[k][f] - p[k][f-1])*inv_dt;
+		if (f >= 2) a[k] = (p[k][f] - 2.0f*p[k][f-1] + p[k][f-2])*inv_dt*inv_dt;
+		if (f >= 3) j[k] = (p[k][f] - 3.0f*p[k][f-1] + 3.0f*p[k][f-2] - p[k][f-3])*inv_dt*inv_dt*inv_dt;
+		out[ClipDescriptors::VX + k][f] = v[k];
+		out[ClipDescriptors::AX + k][f] = a[k];
+		out[ClipDescriptors::JX + k][f] = j[k];
+	}
+	float v_mag = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+	out[ClipDescriptors::V_MAG][f] = v_mag;
+	out[ClipDescriptors::A_MAG][f] = sqrt(a[0]*a[0] + a[1]*a[1] + a[2]*a[2]);
+	out[ClipDescriptors::J_MAG][f] = sqrt(j[0]*j[0] + j[1]*j[1] + j[2]*j[2]);
+
+	float curvature = 0.0f;
+	if ((f >= 2) && (v_mag > 0.0f)) {
+		float cx = a[1]*v[2] - a[2]*v[1];
+		float cy = a[2]*v[0] - a[0]*v[2];
+		float cz = a[0]*v[1] - a[1]*v[0];
+		curvature = sqrt(cx*cx + cy*cy + cz*cz) / (v_mag*v_mag*v_mag);
+	}
+	out[ClipDescriptors::CURVATURE][f] = curvature;
+	out[ClipDescriptors::CURVATURE_RADIUS][f] = (curvature > 0.0f) ? 1.0f/curvature : 0.0f;
+
+	float w[3] = { 0.0f, 0.0f, 0.0f };
+	if (f >= 1) {
+		// relative rotation current*conjugate(previous)
+		float cw = q[0][f], cx = q[1][f], cy = q[2][f], cz = q[3][f];
+		float pw = q[0][f-1], px = q[1][f-1], py = q[2][f-1], pz = q[3][f-1];
+		float rw = cw*pw + cx*px + cy*py + cz*pz;
+		float rx = -cw*px + cx*pw - cy*pz + cz*py;
+		float ry = -cw*py + cy*pw - cz*px + cx*pz;
+		float rz = -cw*pz + cz*pw - cx*py + cy*px;
+		float scale = rotationScale(sqrt(rx*rx + ry*ry + rz*rz), rw)*inv_dt;
+		w[0] = rx*scale; w[1] = ry*scale; w[2] = rz*scale;
+	}
+	for (int k = 0; k < 3; k++) out[ClipDescriptors::WX + k][f] = w[k];
+	out[ClipDescriptors::W_MAG][f] = sqrt(w[0]*w[0] + w[1]*w[1] + w[2]*w[2]);
+}
+
+static inline Float4 length4(Float4 x, Float4 y, Float4 z)
+{
+	return f4sqrt(f4madd(x, x, f4madd(y, y, f4mul(z, z))));
+}
+
+void MotionDescriptorEngine::analyzeJoint(const JointTrajectories& trajectories, int joint,
+	float frame_duration, ClipDescriptors& descriptors) const
+{
+	const float* p[3];
+	const float* q[4];
+	for (int k = 0; k < 3; k++) p[k] = trajectories.column(joint, JointTrajectories::PX + k);
+	for (int k = 0; k < 4; k++) q[k] = trajectories.column(joint, JointTrajectories::QW + k);
+	float* out[ClipDescriptors::NUM_JOINT_COLUMNS];
+	for (int c = 0; c < ClipDescriptors::NUM_JOINT_COLUMNS; c++) out[c] = descriptors.jointColumn(joint, c);
+
+	long n = trajectories.num_frames;
+	float inv_dt = 1.0f/frame_duration;
+	for (long f = 0; f < min(3L, n); f++) scalarFrame(p, q, out, f, inv_dt);
+
+	// From frame 3 on every stencil is complete. The last block may run into
+	// the padding at the end of the columns, which is never read back.
+	Float4 v_scale = f4set1(inv_dt);
+	Float4 a_scale = f4set1(inv_dt*inv_dt);
+	Float4 j_scale = f4set1(inv_dt*inv_dt*inv_dt);
+	Float4 two = f4set1(2.0f), three = f4set1(3.0f), zero = f4zero(), one = f4set1(1.0f);
+	for (long f = 3; f < n; f += 4) {
+		Float4 v[3], a[3], j[3];
+		for (int k = 0; k < 3; k++) {
+			Float4 p0 = f4loadu(p[k] + f);
+			Float4 p1 = f4loadu(p[k] + f - 1);
+			Float4 p2 = f4loadu(p[k] + f - 2);
+			Float4 p3 = f4loadu(p[k] + f - 3);
+			v[k] = f4mul(f4sub(p0, p1), v_scale);
+			a[k] = f4mul(f4add(f4sub(p0, f4mul(two, p1)), p2), a_scale);
+			j[k] = f4mul(f4sub(f4add(f4sub(p0, f4mul(three, p1)), f4mul(three, p2)), p3), j_scale);
+			f4storeu(out[ClipDescriptors::VX + k] + f, v[k]);
+			f4storeu(out[ClipDescriptors::AX + k] + f, a[k]);
+			f4storeu(out[ClipDescriptors::JX + k] + f, j[k]);
+		}
+		Float4 v_mag = length4(v[0], v[1], v[2]);
+		f4storeu(out[ClipDescriptors::V_MAG] + f, v_mag);
+		f4storeu(out[ClipDescriptors::A_MAG] + f, length4(a[0], a[1], a[2]));
+		f4storeu(out[ClipDescriptors::J_MAG] + f, length4(j[0], j[1], j[2]));
+
+		// |a x v| / |v|^3, zero where the joint does not move
+		Float4 cx = f4sub(f4mul(a[1], v[2]), f4mul(a[2], v[1]));
+		Float4 cy = f4sub(f4mul(a[2], v[0]), f4mul(a[0], v[2]));
+		Float4 cz = f4sub(f4mul(a[0], v[1]), f4mul(a[1], v[0]));
+		Float4 moving = f4cmpgt(v_mag, zero);
+		Float4 v3 = f4select(moving, f4mul(v_mag, f4mul(v_mag, v_mag)), one);
+		Float4 curvature = f4select(moving, f4div(length4(cx, cy, cz), v3), zero);
+		Float4 curved = f4cmpgt(curvature, zero);
+		Float4 radius = f4select(curved, f4div(one, f4select(curved, curvature, one)), zero);
+		f4storeu(out[ClipDescriptors::CURVATURE] + f, curvature);
+		f4storeu(out[ClipDescriptors::CURVATURE_RADIUS] + f, radius);
+
+		// relative rotation current*conjugate(previous); only the angle needs scalar code
+		Float4 cw = f4loadu(q[0] + f), qx = f4loadu(q[1] + f), qy = f4loadu(q[2] + f), qz = f4loadu(q[3] + f);
+		Float4 pw = f4loadu(q[0] + f - 1), px = f4loadu(q[1] + f - 1), py = f4loadu(q[2] + f - 1), pz = f4loadu(q[3] + f - 1);
+		Float4 rw = f4madd(cw, pw, f4madd(qx, px, f4madd(qy, py, f4mul(qz, pz))));
+		Float4 rx = f4sub(f4add(f4mul(qx, pw), f4mul(qz, py)), f4add(f4mul(cw, px), f4mul(qy, pz)));
+		Float4 ry = f4sub(f4add(f4mul(qy, pw), f4mul(qx, pz)), f4add(f4mul(cw, py), f4mul(qz, px)));
+		Float4 rz = f4sub(f4add(f4mul(qz, pw), f4mul(qy, px)), f4add(f4mul(cw, pz), f4mul(qx, py)));
+		float lens[4], ws[4], scales[4];
+		f4storeu(lens, length4(rx, ry, rz));
+		f4storeu(ws, rw);
+		for (int i = 0; i < 4; i++) scales[i] = rotationScale(lens[i], ws[i])*inv_dt;
+		Float4 scale = f4loadu(scales);
+		Float4 wx = f4mul(rx, scale), wy = f4mul(ry, scale), wz = f4mul(rz, scale);
+		f4storeu(out[ClipDescriptors::WX] + f, wx);
+		f4storeu(out[ClipDescriptors::WY] + f, wy);
+		f4storeu(out[ClipDescriptors::WZ] + f, wz);
+		f4storeu(out[ClipDescriptors::W_MAG] + f, length4(wx, wy, wz));
+	}
+}
+
+vector<float> MotionDescriptorEngine::bodyWeightFractions(const vector<float>& weights, int num_joints)
+{
+	vector<float> fractions(num_joints, 1.0f);
+	if (!weights.empty())
+		for (int j = 0; j < num_joints; j++)
+			fractions[j] = (j < (int)weights.size()) ? weights[j] : 0.0f;
+	float total = 0.0f;
+	for (int j = 0; j < num_joints; j++) total += fractions[j];
+	if (total > 0.0f)
+		for (int j = 0; j < num_joints; j++) fractions[j] /= total;
+	return fractions;
+}
+
+void MotionDescriptorEngine::analyzeBody(const JointTrajectories& trajectories, const vector<float>& weights,
+	long first_frame, long last_frame, ClipDescriptors& descriptors) const
+{
+	int num_joints = trajectories.num_joints;
+	float* out[ClipDescriptors::NUM_BODY_COLUMNS];
+	for (int c = 0; c < ClipDescriptors::NUM_BODY_COLUMNS; c++) out[c] = descriptors.bodyColumn(c);
+	for (long f = first_frame; f < last_frame; f += 4) {
+		Float4 box_min[3], box_max[3], com[3];
+		Float4 qom = f4zero();
+		for (int k = 0; k < 3; k++) {
+			box_min[k] = f4set1(numeric_limits<float>::max());
+			box_max[k] = f4set1(-numeric_limits<float>::max());
+			com[k] = f4zero();
+		}
+		for (int j = 0; j < num_joints; j++) {
+			Float4 w = f4set1(weights[j]);
+			for (int k = 0; k < 3; k++) {
+				Float4 p = f4loadu(trajectories.column(j, JointTrajectories::PX + k) + f);
+				box_min[k] = f4min(box_min[k], p);
+				box_max[k] = f4max(box_max[k], p);
+				com[k] = f4madd(w, p, com[k]);
+			}
+			qom = f4madd(w, f4loadu(descriptors.jointColumn(j, ClipDescriptors::V_MAG) + f), qom);
+		}
+		for (int k = 0; k < 3; k++) {
+			f4storeu(out[ClipDescriptors::BOX_MIN_X + k] + f, box_min[k]);
+			f4storeu(out[ClipDescriptors::BOX_MAX_X + k] + f, box_max[k]);
+			f4storeu(out[ClipDescriptors::COM_X + k] + f, com[k]);
+		}
+		f4storeu(out[ClipDescriptors::QOM] + f, qom);
+	}
+}
+
+void MotionDescriptorEngine::analyze(const JointTrajectories& trajectories, float frame_duration,
+	ClipDescriptors& descriptors) const
+{
+	descriptors.resize(trajectories.num_joints, trajectories.num_frames);
+	if ((trajectories.num_frames == 0) || (frame_duration <= 0.0f)) return;
+
+	parallelFor(0, trajectories.num_joints, [&](long joint) {
+		analyzeJoint(trajectories, int(joint), frame_duration, descriptors);
+	}, 1, max_threads);
+
+	// the quantity of motion needs the velocities of all joints
+	vector<float> weights = bodyWeightFractions(body_weights, trajectories.num_joints);
+	long num_blocks = (trajectories.num_frames + 3) / 4;
+	parallelForBlocks(0, num_blocks, [&](long first_block, long last_block) {
+		analyzeBody(trajectories, weights, 4*first_block, min(4*last_block, trajectories.num_frames), descriptors);
+	}, BODY_MIN_BLOCKS, max_threads);
+}
@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+// MotionDescriptors project - Builds with SKA Version 4.0
+//-----------------------------------------------------------------------------
+// MotionDescriptorEngine.h
+//			Computes the motion descriptors of MotionAnalyzer for a whole clip
+//          at once, instead of one frame at a time as the clip plays.
+//          Input and output are stored one column (array over frames) per
+//          joint component, so the finite difference stencils run over four
+//          frames at a time with Float4 operations. Joints are spread across
+//          threads.
+//-----------------------------------------------------------------------------
+
+#ifndef MOTIONDESCRIPTORENGINE_DOT_H
+#define MOTIONDESCRIPTORENGINE_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+
+// Joint positions and orientations of every frame of a clip.
+struct JointTrajectories
+{
+	enum Component { PX, PY, PZ, QW, QX, QY, QZ, NUM_COMPONENTS };
+
+	int num_joints;
+	long num_frames;
+	// component c of joint j for frame f is at data[(NUM_COMPONENTS*j + c)*stride + f]
+	long stride;
+	vector<float> data;
+
+	JointTrajectories() : num_joints(0), num_frames(0), stride(0) { }
+	void resize(int _num_joints, long _num_frames);
+	float* column(int joint, int component) { return &data[(NUM_COMPONENTS*joint + component)*stride]; }
+	const float* column(int joint, int component) const { return &data[(NUM_COMPONENTS*joint + component)*stride]; }
+};
+
+// Descriptors of every frame of a clip, per joint and for the full body.
+struct ClipDescriptors
+{
+	// Velocity, acceleration and jerk are backward differences, so they are
+	// zero in the first 1, 2 and 3 frames. Curvature is |a x v| / |v|^3, and
+	// zero where the joint does not move. W is the angular velocity (radians
+	// per second about the axis WX, WY, WZ).
+	enum JointColumn {
+		VX, VY, VZ, V_MAG,
+		AX, AY, AZ, A_MAG,
+		JX, JY, JZ, J_MAG,
+		CURVATURE, CURVATURE_RADIUS,
+		WX, WY, WZ, W_MAG,
+		NUM_JOINT_COLUMNS
+	};
+	// bounding box of the joints, weighted centre of mass and quantity of motion
+	enum BodyColumn {
+		BOX_MIN_X, BOX_MIN_Y, BOX_MIN_Z,
+		BOX_MAX_X, BOX_MAX_Y, BOX_MAX_Z,
+		COM_X, COM_Y, COM_Z,
+		QOM,
+		NUM_BODY_COLUMNS
+	};
+
+	int num_joints;
+	long num_frames;
+	long stride;
+	vector<float> joint_data;
+	vector<float> body_data;
+
+	ClipDescriptors() : num_joints(0), num_frames(0), stride(0) { }
+	void resize(int _num_joints, long _num_frames);
+	float* jointColumn(int joint, int column) { return &joint_data[(NUM_JOINT_COLUMNS*joint + column)*stride]; }
+	const float* jointColumn(int joint, int column) const { return &joint_data[(NUM_JOINT_COLUMNS*joint + column)*stride]; }
+	float* bodyColumn(int column) { return &body_data[column*stride]; }
+	const float* bodyColumn(int column) const { return &body_data[column*stride]; }
+};
+
+class MotionDescriptorEngine
+{
+public:
+	// max_threads <= 0 uses all hardware threads (see Core/Parallel.h)
+	MotionDescriptorEngine(int _max_threads = 0) : max_threads(_max_threads) { }
+
+	// Relative mass of each joint, used for the centre of mass and the
+	// quantity of motion. Joints without a weight count as zero.
+	// If no weights are set, all joints count equally.
+	void setBodyWeights(const vector<float>& weights) { body_weights = weights; }
+
+	// The weights actually applied to num_joints joints: the given weights
+	// (or all equal if there are none) scaled to sum to 1. The centre of mass
+	// is the sum of these times the joint positions, and the quantity of
+	// motion the sum of these times the joint speeds.
+	static vector<float> bodyWeightFractions(const vector<float>& weights, int num_joints);
+
+	// frame_duration is the time between frames, in seconds.
+	void analyze(const JointTrajectories& trajectories, float frame_duration, ClipDescriptors& descriptors) const;
+
+private:
+	int max_threads;
+	vector<float> body_weights;
+
+	void analyzeJoint(const JointTrajectories& trajectories, int joint, float frame_duration,
+		ClipDescriptors& descriptors) const;
+	void analyzeBody(const JointTrajectories& trajectories, const vector<float>& weights,
+		long first_frame, long last_frame, ClipDescriptors& descriptors) const;
+};
+
+#endif // MOTIONDESCRIPTORENGINE_DOT_H
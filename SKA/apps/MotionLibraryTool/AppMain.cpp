@@ -0,0 +1,339 @@
+//-----------------------------------------------------------------------------
+// MotionLibraryTool project - Builds with SKA Version 4.0
+//-----------------------------------------------------------------------------
+// AppMain.cpp
+//    Command line tool for building and inspecting motion library (SKL) files.
+//
+//    MotionLibraryTool build [-z] <library.skl> <file or directory> ...
+//        BVH files are added directly. AMC files are paired with the ASF
+//        file in the same directory (CMU style "02/02.asf" + "02/02_01.amc").
+//        Directories are scanned recursively. Clips are named by their
+//        path below the directory given on the command line.
+//        -z stores the clips with lossless compression.
+//    MotionLibraryTool list <library.skl>
+//    MotionLibraryTool extract <library.skl> <clip name> <output.bvh>
+//    MotionLibraryTool catalog build <catalog.skc> <directory> ...
+//        Reads the headers of every motion file below the directories
+//        and saves them in a catalog (index) file.
+//    MotionLibraryTool catalog query <catalog.skc> [conditions]
+//    MotionLibraryTool catalog commands <catalog.skc> <skacommands.txt> [conditions]
+//        Writes a ProcessControl command file for the matching BVH and AMC files.
+//    Conditions are name=<pattern> skeleton=<pattern> format=<BVH|AMC|...>
+//    min=<seconds> max=<seconds>. Patterns may use '*' and '?'.
+//-----------------------------------------------------------------------------
+// SKA configuration.
+#include <Core/SystemConfiguration.h>
+// C/C++ libraries
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+using namespace std;
+// SKA modules
+#include <Core/BasicException.h>
+#include <Core/SystemLog.h>
+#include <DataManagement/DataManager.h>
+#include <DataManagement/DataManagementException.h>
+#include <DataManagement/FileSystem.h>
+#include <DataManagement/MotionLibrary.h>
+#include <DataManagement/MotionCatalog.h>
+#include <Animation/Skeleton.h>
+#include <Animation/MotionSequence.h>
+
+static string lowerExtension(const string& name)
+{
+	size_t dot = name.rfind('.');
+	if (dot == string::npos) return string("");
+	string ext = name.substr(dot+1);
+	for (unsigned int i=0; i<ext.size(); i++) ext[i] = char(tolower(ext[i]));
+	return ext;
+}
+
+static string stripExtension(const string& name)
+{
+	size_t dot = name.rfind('.');
+	if (dot == string::npos) return name;
+	return name.substr(0, dot);
+}
+
+static string baseName(const string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	if (slash == string::npos) return path;
+	return path.substr(slash+1);
+}
+
+static void addBVH(MotionLibraryBuilder& builder, const string& file, const string& clip_name)
+{
+	try {
+		pair<Skeleton*, MotionSequence*> motion = data_manager.readBVH(file.c_str());
+		if (builder.addClip(clip_name.c_str(), motion.first, motion.second, file.c_str()))
+			cout << "  added " << clip_name << " (" << motion.second->numFrames() << " frames)" << endl;
+		delete motion.first;
+		delete motion.second;
+	}
+	catch (BasicException& e) { cout << "  skipped " << file << ": " << e.msg << endl; }
+}
+
+static void addAMC(MotionLibraryBuilder& builder, const string& asf_file, const string& amc_file, const string& clip_name)
+{
+	try {
+		pair<Skeleton*, MotionSequence*> motion = data_manager.readASFAMC(asf_file.c_str(), amc_file.c_str());
+		if (builder.addClip(clip_name.c_str(), motion.first, motion.second, amc_file.c_str()))
+			cout << "  added " << clip_name << " (" << motion.second->numFrames() << " frames)" << endl;
+		delete motion.first;
+		delete motion.second;
+	}
+	catch (BasicException& e) { cout << "  skipped " << amc_file << ": " << e.msg << endl; }
+}
+
+// choose the skeleton for an AMC file: "02_01.amc" -> "02.asf", else the only ASF in the directory
+static string matchASF(const string& amc_name, list<string>& asf_names)
+{
+	string prefix = amc_name.substr(0, amc_name.find('_'));
+	list<string>::iterator iter;
+	for (iter=asf_names.begin(); iter!=asf_names.end(); iter++)
+		if (stripExtension(*iter) == prefix) return *iter;
+	if (asf_names.size() == 1) return asf_names.front();
+	return string("");
+}
+
+static void addDirectory(MotionLibraryBuilder& builder, const string& dir, const string& clip_prefix)
+{
+	list<string> files, subdirs;
+	if (!FileSystem::listDirectory(dir.c_str(), files, subdirs))
+	{
+		cout << "  could not read directory " << dir << endl;
+		return;
+	}
+	files.sort();
+	subdirs.sort();
+	list<string> asf_names;
+	list<string>::iterator iter;
+	for (iter=files.begin(); iter!=files.end(); iter++)
+		if (lowerExtension(*iter) == "asf") asf_names.push_back(*iter);
+	for (iter=files.begin(); iter!=files.end(); iter++)
+	{
+		string ext = lowerExtension(*iter);
+		string clip_name = clip_prefix + stripExtension(*iter);
+		if (ext == "bvh") addBVH(builder, dir + "/" + *iter, clip_name);
+		else if (ext == "amc")
+		{
+			string asf = matchASF(*iter, asf_names);
+			if (asf.size() == 0) cout << "  skipped " << *iter << " (no matching ASF file)" << endl;
+			else addAMC(builder, dir + "/" + asf, dir + "/" + *iter, clip_name);
+		}
+	}
+	for (iter=subdirs.begin(); iter!=subdirs.end(); iter++)
+		addDirectory(builder, dir + "/" + *iter, clip_prefix + *iter + "/");
+}
+
+static int buildLibrary(int argc, char** argv)
+{
+	bool compress = (string(argv[2]) == "-z");
+	if (compress) { argv++; argc--; }
+	if (argc < 4) return -1;
+	MotionLibraryBuilder builder;
+	if (!builder.create(argv[2]))
+	{
+		cout << "Could not create " << argv[2] << endl;
+		return 1;
+	}
+	builder.setCompression(compress);
+	for (int i=3; i<argc; i++)
+	{
+		string path = argv[i];
+		while ((path.size() > 1) && ((path[path.size()-1] == '/') || (path[path.size()-1] == '\\')))
+			path.erase(path.size()-1);
+		if (FileSystem::dirExists(path.c_str()))
+			addDirectory(builder, path, baseName(path) + "/");
+		else if (lowerExtension(path) == "bvh")
+			addBVH(builder, path, stripExtension(baseName(path)));
+		else
+			cout << "  skipped " << path << " (not a BVH file or directory)" << endl;
+	}
+	if (!builder.finish())
+	{
+		cout << "Could not write " << argv[2] << endl;
+		return 1;
+	}
+	cout << "Wrote " << builder.numClips() << " clips to " << argv[2] << endl;
+	return 0;
+}
+
+static int listLibrary(int argc, char** argv)
+{
+	MotionLibrary library;
+	if (!library.open(argv[2]))
+	{
+		cout << "Could not open " << argv[2] << endl;
+		return 1;
+	}
+	for (long c=0; c<library.numClips(); c++)
+	{
+		cout << library.clipName(c)
+			<< "  skeleton=" << library.clipSkeletonId(c)
+			<< "  frames=" << library.clipFrames(c)
+			<< "  fps=" << library.clipFrameRate(c)
+			<< "  channels=" << library.clipNumChannels(c)
+			<< "  bytes=" << library.clipStoredSize(c)
+			<< (library.clipCompressed(c) ? " (compressed)" : "") << endl;
+	}
+	return 0;
+}
+
+static int extractClip(int argc, char** argv)
+{
+	try {
+		data_manager.openMotionLibrary(argv[2], true);
+		pair<Skeleton*, MotionSequence*> motion = data_manager.readLibraryClip(argv[3]);
+		data_manager.writeBVH(motion.first, motion.second, argv[4]);
+		delete motion.first;
+		delete motion.second;
+	}
+	catch (BasicException& e)
+	{
+		cout << e.msg << endl;
+		return 1;
+	}
+	return 0;
+}
+
+static bool parseConditions(int first, int argc, char** argv, MotionCatalogQuery& q)
+{
+	for (int i=first; i<argc; i++)
+	{
+		string arg = argv[i];
+		size_t eq = arg.find('=');
+		if (eq == string::npos) return false;
+		string key = arg.substr(0, eq);
+		string value = arg.substr(eq+1);
+		if (key == "name") q.name_pattern = value;
+		else if (key == "skeleton") q.skeleton_pattern = value;
+		else if (key == "format")
+		{
+			for (unsigned int c=0; c<value.size(); c++) value[c] = char(toupper(value[c]));
+			q.format = value;
+		}
+		else if (key == "min") q.min_duration = float(atof(value.c_str()));
+		else if (key == "max") q.max_duration = float(atof(value.c_str()));
+		else return false;
+	}
+	return true;
+}
+
+static int catalogCommand(int argc, char** argv)
+{
+	string command = argv[2];
+	MotionCatalog catalog;
+	if (command == "build")
+	{
+		for (int i=4; i<argc; i++)
+		{
+			long n = catalog.scan(argv[i]);
+			cout << argv[i] << ": " << n << " entries" << endl;
+		}
+		if (!catalog.save(argv[3]))
+		{
+			cout << "Could not write " << argv[3] << endl;
+			return 1;
+		}
+		cout << "Wrote " << catalog.numEntries() << " entries to " << argv[3] << endl;
+		return 0;
+	}
+
+	if (!catalog.load(argv[3]))
+	{
+		cout << "Could not read " << argv[3] << endl;
+		return 1;
+	}
+	MotionCatalogQuery q;
+	vector<long> matches;
+	if (command == "query")
+	{
+		if (!parseConditions(4, argc, argv, q)) return -1;
+		catalog.query(q, matches);
+		for (unsigned int m=0; m<matches.size(); m++)
+		{
+			MotionCatalogEntry& e = catalog.entry(matches[m]);
+			cout << e.name << "  " << e.format
+				<< "  skeleton=" << e.skeleton_id
+				<< "  frames=" << e.frames
+				<< "  fps=" << e.frame_rate
+				<< "  seconds=" << e.duration() << endl;
+		}
+		cout << matches.size() << " of " << catalog.numEntries() << " entries" << endl;
+		return 0;
+	}
+	if ((command == "commands") && (argc >= 5))
+	{
+		if (!parseConditions(5, argc, argv, q)) return -1;
+		catalog.query(q, matches);
+		ofstream out(argv[4]);
+		if (!out)
+		{
+			cout << "Could not write " << argv[4] << endl;
+			return 1;
+		}
+		// one INPUT_FOLDER line each time the directory changes
+		string folder;
+		long count = 0;
+		for (unsigned int m=0; m<matches.size(); m++)
+		{
+			MotionCatalogEntry& e = catalog.entry(matches[m]);
+			if ((e.format != "BVH") && (e.format != "AMC")) continue;
+			size_t slash = e.path.find_last_of("/\\");
+			string dir = (slash == string::npos) ? string(".") : e.path.substr(0, slash);
+			string file = (slash == string::npos) ? e.path : e.path.substr(slash+1);
+			if (dir != folder)
+			{
+				out << "INPUT_FOLDER=\"" << dir << "\"" << endl;
+				folder = dir;
+			}
+			if (e.format == "BVH")
+				out << "PROCESS BVH=\"" << file << "\" SM=N LOOP=N MA=Y SKIP=5 FPS=" << int(e.frame_rate+0.5f) << endl;
+			else
+			{
+				if (e.skeleton_file.size() == 0) continue;
+				out << "PROCESS AMC=\"" << file << "\" ASF=\"" << baseName(e.skeleton_file)
+					<< "\" SM=N LOOP=N MA=Y SKIP=5 FPS=" << int(e.frame_rate+0.5f) << endl;
+			}
+			count++;
+		}
+		cout << "Wrote " << count << " PROCESS commands to " << argv[4] << endl;
+		return 0;
+	}
+	return -1;
+}
+
+int main(int argc, char** argv)
+{
+	string command = (argc > 1) ? argv[1] : "";
+	if ((command == "build") && (argc >= 4))
+	{
+		int result = buildLibrary(argc, argv);
+		if (result >= 0) return result;
+	}
+	if ((command == "list") && (argc == 3)) return listLibrary(argc, argv);
+	if ((command == "extract") && (argc == 5)) return extractClip(argc, argv);
+	if ((command == "catalog") && (argc >= 4))
+	{
+		int result = catalogCommand(argc, argv);
+		if (result >= 0) return result;
+	}
+
+	cout << "usage:" << endl;
+	cout << "  MotionLibraryTool build [-z] <library.skl> <file or directory> ..." << endl;
+	cout << "  MotionLibraryTool list <library.skl>" << endl;
+	cout << "  MotionLibraryTool extract <library.skl> <clip name> <output.bvh>" << endl;
+	cout << "  MotionLibraryTool catalog build <catalog.skc> <directory> ..." << endl;
+	cout << "  MotionLibraryTool catalog query <catalog.skc> [conditions]" << endl;
+	cout << "  MotionLibraryTool catalog commands <catalog.skc> <skacommands.txt> [conditions]" << endl;
+	cout << "    conditions: name=<pattern> skeleton=<pattern> format=<type> min=<seconds> max=<seconds>" << endl;
+	return 1;
+}
@@ -10,6 +10,7 @@
 #include "Core/SystemConfiguration.h"
 #include "ExperimentalController.h"
 #include "Animation/AnimationException.h"
+#include "Signals/CompiledSignal.h"
 
 ExperimentalController::ExperimentalController() 
 	: MotionController(), skeleton(NULL)
@@ -21,6 +22,16 @@ ExperimentalController::ExperimentalController()
 	//signals[LFEMUR_BONE_ID][CT_RX] = new SineGenerator(1.0f, 0.1f, 0.0f);
 	signals[LFEMUR_BONE_ID][CT_RX] = new SignalAdder(new SineGenerator(1.0f, 0.1f, 0.0f),
 		new SineGenerator(0.1f, 0.5f, 00.2f));
+
+	// replace each generator tree with a single compiled kernel
+	for (int b=0; b<9; b++)
+		for (int d=0; d<6; d++)
+		{
+			CompiledSignal* compiled = compileSignalGenerator(signals[b][d]);
+			if (compiled == NULL) continue;
+			delete signals[b][d];
+			signals[b][d] = compiled;
+		}
 }
 
 ExperimentalController::~ExperimentalController() 
@@ -71,3 +82,37 @@ float ExperimentalController::getValue(CHANNEL_ID _channel, float _time)
 
 	return signals[_channel.bone_id][_channel.channel_type ]->signal(_time);
 }
+
+MotionSequence* ExperimentalController::bakeMotion(long num_frames, float frame_rate)
+{
+	vector<CHANNEL_ID> channels;
+	vector<SignalGenerator*> generators;
+	for (int b=0; b<9; b++)
+		for (int d=0; d<6; d++)
+		{
+			CHANNEL_ID cid(b, CHANNEL_TYPE(d));
+			if (!isValidChannel(cid)) continue;
+			channels.push_back(cid);
+			generators.push_back(signals[b][d]);
+		}
+	MotionSequence* motion = bakeSignalGenerators(channels, generators, num_frames, frame_rate);
+
+	// channels without a generator are zero, as in getValue()
+	for (unsigned int c=0; c<channels.size(); c++)
+	{
+		if (generators[c] != NULL) continue;
+		float* column = motion->getChannelPtr(channels[c]);
+		for (long f=0; f<num_frames; f++) column[f] = 0.0f;
+	}
+
+	// the left knee follows the left hip, as in getValue()
+	CHANNEL_ID femur(LFEMUR_BONE_ID, CT_RX), tibia(LTIBIA_BONE_ID, CT_RX);
+	float* hip = motion->getChannelPtr(femur);
+	float* knee = motion->getChannelPtr(tibia);
+	for (long f=0; f<num_frames; f++)
+	{
+		float angle = 0.5f*hip[f];
+		knee[f] = (angle < 0.0f) ? 0.0f : angle;
+	}
+	return motion;
+}
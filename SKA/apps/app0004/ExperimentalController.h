@@ -11,6 +11,7 @@
 #include "Core/SystemConfiguration.h"
 #include "Animation/MotionController.h"
 #include "Animation/Skeleton.h"
+#include "Animation/MotionSequence.h"
 #include "Signals/Signals.h"
 
 #define ROOT_BONE_ID 0
@@ -36,6 +37,10 @@ public:
 
 	void setSkelton(Skeleton* _skel) { skeleton = _skel; }
 
+	// Sample every controlled channel into a new MotionSequence, starting
+	// at time 0. The caller owns the result.
+	MotionSequence* bakeMotion(long num_frames, float frame_rate);
+
 private:
 	SignalGenerator* signals[9][6]; // first index is bone_id, second index = dof_id
 	Skeleton* skeleton;         // pointer back to the skeleton this controller is controlling
@@ -16,6 +16,7 @@
 #include <Animation/Skeleton.h>
 #include <DataManagement/DataManager.h>
 #include <DataManagement/DataManagementException.h>
+#include <DataManagement/MotionCatalog.h>
 #include <Math/Quaternion.h>
 // Application
 #include "AppConfig.h"
@@ -52,9 +53,32 @@ AnimationControl::~AnimationControl()
 
 void AnimationControl::initializeMotionFileList()
 {
-	motion_data_specs.addSpec(string("swing1"), string("swing1.bvh"), string("swing1quat.bvh"));
-	motion_data_specs.addSpec(string("swing2"), string("swing2.bvh"), string("swing2quat.bvh"));
-	motion_data_specs.addSpec(string("swing3"), string("swing3.bvh"), string("swing3quat.bvh"));
+	if (initializeMotionFileListFromCatalog(MOTION_CATALOG_FILE)) return;
+	motion_data_specs.addSpec(string("swing1"), string("swing1.bvh"));
+	motion_data_specs.addSpec(string("swing2"), string("swing2.bvh"));
+	motion_data_specs.addSpec(string("swing3"), string("swing3.bvh"));
+}
+
+bool AnimationControl::initializeMotionFileListFromCatalog(const char* catalog_file)
+{
+	MotionCatalog catalog;
+	if (!catalog.load(catalog_file)) return false;
+	MotionCatalogQuery q;
+	q.format = "BVH";
+	vector<long> matches;
+	catalog.query(q, matches);
+	string skeleton_id;
+	for (unsigned int m=0; m<matches.size(); m++)
+	{
+		MotionCatalogEntry& e = catalog.entry(matches[m]);
+		// skip quaternion files generated by earlier versions of this app
+		if (MotionCatalog::matchPattern("*quat", e.name.c_str())) continue;
+		if (skeleton_id.size() == 0) skeleton_id = e.skeleton_id;
+		if (e.skeleton_id != skeleton_id) continue;
+		string seq_id = e.name.substr(e.name.find_last_of('/')+1);
+		motion_data_specs.addSpec(seq_id, e.path);
+	}
+	return motion_data_specs.size() > 0;
 }
 
 bool AnimationControl::updateAnimation(float _elapsed_time)
@@ -84,7 +108,7 @@ void AnimationControl::loadCharacters(list<Object*>& render_list)
 
 	logout << "MotionGraphController initialization starting" << endl;
 
-	motion_graph = new MotionGraph(motion_data_specs);
+	motion_graph = new MotionGraph(motion_data_specs, MOTION_GRAPH_CACHE_FILE);
 
 	motion_graph_controller = new MotionGraphController(motion_graph, motion_data_specs, character_size_scale);
 
@@ -169,7 +193,7 @@ vector<string> AnimationControl::statusReport()
 		ss[3] << "frame zero time: " << mgcstate.frame_zero_time;
 		report.push_back(ss[3].str());
 
-		ss[4] << "active sequence: " << mgcstate.active_seqID;
+		ss[4] << "active sequence: " << motion_graph_controller->sequenceID(mgcstate.active_seq);
 		report.push_back(ss[4].str());
 
 		ss[5] << "active frame: " << mgcstate.active_frame;
@@ -178,7 +202,7 @@ vector<string> AnimationControl::statusReport()
 		ss[6] << "transition trigger frame: " << mgcstate.transition_trigger_frame;
 		report.push_back(ss[6].str());
 
-		ss[7] << "transition sequence: " << mgcstate.transition_seqID;
+		ss[7] << "transition sequence: " << motion_graph_controller->sequenceID(mgcstate.transition_seq);
 		report.push_back(ss[7].str());
 	
 		ss[8] << "transition frame: " << mgcstate.transition_frame;
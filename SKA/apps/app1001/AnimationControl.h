@@ -24,23 +24,21 @@ private:
 	{
 		string seqID;
 		string BVH_file;
-		string quat_file;
-		MotionDataSpec(string _seqID, string _BVH_file, string _quat_file)
+		MotionDataSpec(string _seqID, string _BVH_file)
 		{
-			seqID = _seqID; BVH_file = _BVH_file; quat_file = _quat_file;
+			seqID = _seqID; BVH_file = _BVH_file;
 		}
 	};
 	vector<MotionDataSpec> specs;
 
 public:
 	short size() { return (short)specs.size(); }
-	void addSpec(string _seqID, string _BVH_file, string _quat_file)
+	void addSpec(string _seqID, string _BVH_file)
 	{
-		specs.push_back(MotionDataSpec(_seqID, _BVH_file, _quat_file));
+		specs.push_back(MotionDataSpec(_seqID, _BVH_file));
 	}
 	string getSeqID(short i) { return specs[i].seqID; }
 	string getBvhFilename(short i) { return specs[i].BVH_file; }
-	string getQuatFilename(short i) { return specs[i].quat_file; }
 };
 
 struct AnimationControl
@@ -54,9 +52,10 @@ private:
 	bool freeze;
 	float time_warp;
 
-	// in each pair: first name is the regular BVH for playback, second name is the quaterion file.
+	// sequence ID and BVH file of each motion
 	MotionDataSpecification motion_data_specs;
 	void initializeMotionFileList();
+	bool initializeMotionFileListFromCatalog(const char* catalog_file);
 
 	// keep a pointer to the motion graph controller, so that state reports can be easily extracted
 	class MotionGraphController* motion_graph_controller;
@@ -12,6 +12,13 @@
 
 // root path to the BVH files
 #define BVH_MOTION_FILE_PATH "../../data/motion/BVH/Baseball_Swings"
+// Optional catalog of the motions to use (built with "MotionLibraryTool catalog build").
+// If it exists, every BVH file in it that uses the same skeleton as the first one
+// is added to the motion graph. Otherwise the built in list of swings is used.
+#define MOTION_CATALOG_FILE "motiongraph.skc"
+// Cache of the built motion graph. Only transitions involving new or changed
+// clips are recomputed at startup.
+#define MOTION_GRAPH_CACHE_FILE "motiongraph.mgc"
 // textures are BMP files that are used to color some objects (such as the sky)
 #define TEXTURE_FILE_PATH "../../data/textures"
 
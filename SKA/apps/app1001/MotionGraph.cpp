@@ -8,180 +8,341 @@
 // SKA configuration
 #include <Core/SystemConfiguration.h>
 #include <Core/SystemLog.h>
-#include <Core/Utilities.h>
+#include <Core/Parallel.h>
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
 using namespace std;
 // SKA modules
 #include <DataManagement/DataManager.h>
-#include <Math/Quaternion.h>
+#include <DataManagement/BinaryStream.h>
+#include <DataManagement/DataManagementException.h>
+#include <Animation/PoseFeatures.h>
+#include <Animation/RawMotionController.h>
+#include <Math/PoseIndex.h>
 #include "AppConfig.h"
 #include "MotionGraph.h"
-#include "BVH2Quaternion.h"
 
-MotionGraph::MotionGraph(MotionDataSpecification& motion_data_specs)
+// Transition search parameters
+// FUTUREWORK (150618) - these should be parameters
+// Distance used to compare poses:
+//   true  - windowed point cloud distance (see PoseDistance.h), the RMS
+//           distance between joint positions over POINT_CLOUD_WINDOW frames
+//   false - sum over joints of quaternion differences, for single frames
+static const bool USE_POINT_CLOUD_DISTANCE = true;
+// Frames compared from each transition point on; at most END_MARGIN+1
+static const int POINT_CLOUD_WINDOW = 20;
+// Upper theshold for initial threshold culling
+static const float MAX_TRANSITION_DISTANCE = USE_POINT_CLOUD_DISTANCE ? 5.0f : 12.0f;
+// Transitions closer than this many frames in both motions are duplicates
+static const int DUPLICATE_WINDOW = 5;
+// Only frames more than this many frames from either end can be transition points
+static const int END_MARGIN = 30;
+// Most transitions kept for each pair of motions, 0 for no limit
+static const unsigned int MAX_TRANSITIONS_PER_PAIR = 0;
+// With at least this many sequences, transitions are only searched for in
+// the blocks of POSE_INDEX_BLOCK by POSE_INDEX_BLOCK frames of each distance
+// matrix that pair a frame with one of its POSE_INDEX_NEIGHBOURS nearest
+// poses in a PoseIndex. The search is approximate: a transition in a block with no
+// near pose pair is missed.
+static const int POSE_INDEX_MIN_SEQUENCES = 16;
+static const int POSE_INDEX_NEIGHBOURS = 128;
+static const int POSE_INDEX_BLOCK = 64;
+// Only every POSE_INDEX_STEP-th frame is indexed, so that the neighbours are
+// not mostly the frames around a single best match.
+static const int POSE_INDEX_STEP = 8;
+// The KD-tree stops pruning in many dimensions. The distance matrices are
+// used instead if the PCA reduction keeps more than this many.
+static const int POSE_INDEX_MAX_DIMENSION = 24;
+
+// Graph cache file format
+static const char GRAPH_CACHE_MAGIC[8] = { 'S','K','A','M','G','R','C','\0' };
+static const unsigned int GRAPH_CACHE_VERSION = 5;
+
+MotionGraph::MotionGraph(MotionDataSpecification& motion_data_specs, const char* cache_filename)
 {
-	buildMotionGraph(motion_data_specs);
+	buildMotionGraph(motion_data_specs, cache_filename);
 }
 
-void MotionGraph::findTransitions(string& from_seqID, int from_frame, vector<Transition>& transitions)
+int MotionGraph::sequenceIndex(const string& seq_ID) const
 {
-	for (unsigned long g=0; g<graph.size(); g++)
+	for (unsigned int s=0; s<seq_IDs.size(); s++)
+		if (seq_IDs[s] == seq_ID) return int(s);
+	return -1;
+}
+
+MotionGraph::TransitionSpan MotionGraph::transitionsFrom(int from_seq) const
+{
+	if ((from_seq < 0) || (from_seq >= numSequences()) || transitions.empty()) return TransitionSpan();
+	const Transition* base = &transitions[0];
+	return TransitionSpan(base + transition_start[from_seq], base + transition_start[from_seq+1]);
+}
+
+static bool frameBefore(int frame, const MotionGraph::Transition& t)
+{
+	return frame < t.from_frame;
+}
+
+MotionGraph::TransitionSpan MotionGraph::findTransitions(int from_seq, int from_frame) const
+{
+	TransitionSpan all = transitionsFrom(from_seq);
+	return TransitionSpan(upper_bound(all.begin(), all.end(), from_frame, frameBefore), all.end());
+}
+
+static bool transitionOrder(const MotionGraph::Transition& a, const MotionGraph::Transition& b)
+{
+	if (a.from_frame != b.from_frame) return a.from_frame < b.from_frame;
+	if (a.to_seq != b.to_seq) return a.to_seq < b.to_seq;
+	return a.to_frame < b.to_frame;
+}
+
+// facing angle of a root rotation (w, x, y, z): its local z axis projected on the floor
+static float rootHeading(const float* q)
+{
+	float fx = 2.0f*(q[1]*q[3] + q[0]*q[2]);
+	float fz = 1.0f - 2.0f*(q[1]*q[1] + q[2]*q[2]);
+	return atan2(fx, fz);
+}
+
+// 64 bit FNV-1a hash of a file's contents, to tell whether a clip changed
+static unsigned long long hashFile(const string& filepath)
+{
+	FILE* fp = fopen(filepath.c_str(), "rb");
+	if (fp == NULL)
 	{
-		for (unsigned long i = 0; i < graph[g].transitions.size(); i++)
+		stringstream ss;
+		ss << "MotionGraph::hashFile cannot open file " << filepath;
+		throw AppException(ss.str().c_str());
+	}
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned char buffer[1<<16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+	{
+		for (size_t i=0; i<n; i++)
 		{
-			// FUTUREWORK (150626) - The +10 is to avoid jumping too soon.
-			//                       It should be parameterized.
-			if ((graph[g].from_seq_ID == from_seqID) &&
-				(graph[g].transitions[i].from_frame > from_frame+10))
-			{
-				Transition t;
-				t.from_seqID = graph[g].transitions[i].from_seqID;
-				t.to_seqID = graph[g].transitions[i].to_seqID;
-				t.from_frame = graph[g].transitions[i].from_frame;
-				t.to_frame = graph[g].transitions[i].to_frame;
-				transitions.push_back(t);
-			}
+			hash ^= buffer[i];
+			hash *= 1099511628211ULL;
 		}
 	}
+	fclose(fp);
+	return hash;
 }
 
-void MotionGraph::buildMotionGraph(MotionDataSpecification& motion_data_specs)
+void MotionGraph::buildMotionGraph(MotionDataSpecification& motion_data_specs, const char* cache_filename)
 {
 	vector<Sequence> sequences;
 
+	// Clips whose ID and file contents match a cached clip take their poses
+	// from the cache instead of being parsed again.
+	vector<Sequence> cached;
+	vector<Transition> cached_transitions;
+	bool cached_indexed = false;
+	if ((cache_filename != NULL) && loadCache(cache_filename, cached, cached_transitions, cached_indexed))
+		logout << "MotionGraph::buildMotionGraph loaded " << cached.size() << " clips from " << cache_filename << endl;
+	vector<int> new_index(cached.size(), -1);
+	vector<int> reused;
+
 	for (unsigned short i=0; i<motion_data_specs.size(); i++)
 	{
-		Sequence seq = fileReader(motion_data_specs, i);
+		string bvh_filename = motion_data_specs.getBvhFilename(i);
+		char* found = data_manager.findFile(bvh_filename.c_str());
+		if (found == NULL)
+		{
+			stringstream ss;
+			ss << "MotionGraph::buildMotionGraph cannot find file " << bvh_filename;
+			throw AppException(ss.str().c_str());
+		}
+		string bvh_filepath = found;
+		delete [] found;
+		unsigned long long hash = hashFile(bvh_filepath);
+
+		int c = -1;
+		for (unsigned int k=0; (k<cached.size()) && (c<0); k++)
+		{
+			if ((new_index[k] < 0) && (cached[k].seq_ID == motion_data_specs.getSeqID(i)) && (cached[k].content_hash == hash))
+				c = int(k);
+		}
+		Sequence seq;
+		if (c >= 0)
+		{
+			seq = cached[c];
+			seq.seq_index = i;
+			seq.source_filename = bvh_filename;
+			seq.source_full_pathname = bvh_filepath;
+			new_index[c] = i;
+		}
+		else
+		{
+			seq = fileReader(motion_data_specs, i, bvh_filepath);
+			seq.content_hash = hash;
+		}
+		reused.push_back(c);
+		if ((i > 0) && ((seq.poses.num_joints != sequences[0].poses.num_joints) ||
+			(seq.clouds.num_points != sequences[0].clouds.num_points)))
+		{
+			stringstream ss;
+			ss << "MotionGraph::buildMotionGraph Different number of joints in "
+				<< sequences[0].seq_ID << " and " << seq.seq_ID;
+			throw AppException(ss.str().c_str());
+		}
 		sequences.push_back(seq);
 	}
 
 	// find transitions between each pair of sequences
 	// FUTUREWORK (150618) - does not currently allow for any transitions to self
+	vector<int> from, to;
 	for (unsigned short i=0; i<motion_data_specs.size(); i++)
 	{
-		TransitionSet ts;
 		for (unsigned short j=0; j<motion_data_specs.size(); j++)
 		{
 			if (i == j) continue;
-			ts.from_seq_ID = motion_data_specs.getSeqID(i);
-			computeTransitions(sequences[i], sequences[j], ts.transitions);
+			from.push_back(i);
+			to.push_back(j);
 		}
-		graph.push_back(ts);
 	}
-}
 
-static string verifyQuaternionFile(string& bvh_filename, string& quat_filename)
-{
-	if (bvh_filename == quat_filename)
+	long num_pairs = long(from.size());
+	vector<vector<Transition> > pair_transitions(num_pairs);
+
+	// The indexed search depends on every clip, so its transitions are only
+	// reused if no clip changed. Dense transitions between two unchanged
+	// clips are copied from the cache, and only pairs involving a new or
+	// changed clip are computed. Either way the graph does not depend on
+	// what was cached.
+	int num_seqs = int(sequences.size());
+	bool unchanged = (cached.size() == sequences.size());
+	for (int i=0; i<num_seqs; i++)
+		if (reused[i] != i) unchanged = false;
+	bool indexed = unchanged && cached_indexed;
+	if (!unchanged && (num_seqs >= POSE_INDEX_MIN_SEQUENCES))
 	{
-		stringstream ss;
-		ss << "MotionGraph::fileReader bvh file and quat file have the same name "
-			<< quat_filename << " == " << bvh_filename;
-		throw AppException(ss.str().c_str());
+		logout << "MotionGraph::buildMotionGraph searching all " << num_pairs << " sequence pairs with a pose index" << endl;
+		indexed = computeTransitionsIndexed(sequences, pair_transitions);
 	}
-
-	char* quat_filepath = data_manager.findFile(quat_filename.c_str());
-
-	// if we can't find the quaternion file, attempt to generate it
-	if (quat_filepath == NULL)
+	if (unchanged || (!indexed && !cached_indexed))
 	{
-		char* bvh_filepath = data_manager.findFile(bvh_filename.c_str());
-		if (bvh_filepath == NULL)
+		for (unsigned long t=0; t<cached_transitions.size(); t++)
 		{
-			stringstream ss;
-			ss << "MotionGraph::fileReader cannot find file "
-				<< quat_filename << " or " << bvh_filename;
-			throw AppException(ss.str().c_str());
+			int a = new_index[cached_transitions[t].from_seq];
+			int b = new_index[cached_transitions[t].to_seq];
+			if ((a < 0) || (b < 0)) continue;
+			Transition copy = cached_transitions[t];
+			copy.from_seq = a;
+			copy.to_seq = b;
+			pair_transitions[long(a)*(num_seqs-1) + ((b < a) ? b : b-1)].push_back(copy);
 		}
-		string bvh_fullfilepath = bvh_filepath;
-
-		// extract the directory of the located bvh file
-		char* bvh_dir = strClone(bvh_filepath);
-		char* name_starts = strrchr(bvh_dir, '/');
-		if (name_starts == NULL) bvh_dir[0] = '\n';
-		else *(name_starts+1) = '\0';
-
-		// attempt to create a new file in the same directory as the source BVH file.
-		quat_filepath = new char[strlen(bvh_dir)+quat_filename.length()+20];
-		sprintf(quat_filepath, "%s%s", bvh_dir, quat_filename.c_str());
-
-		// be careful not to override the source BVH file.
-		if (strcmp(bvh_filepath, quat_filepath) == 0)
+	}
+	vector<long> pending;
+	if (!indexed)
+	{
+		for (long p=0; p<num_pairs; p++)
+			if (cached_indexed || (reused[from[p]] < 0) || (reused[to[p]] < 0)) pending.push_back(p);
+		logout << "MotionGraph::buildMotionGraph computing " << pending.size() << " of "
+			<< num_pairs << " sequence pairs" << endl;
+
+		// Pairs run in parallel when there are enough of them to keep every
+		// thread busy, otherwise each pair's distance matrix is split up.
+		long num_pending = long(pending.size());
+		bool parallel_pairs = num_pending >= parallelThreadCount();
+		parallelFor(0, num_pending, [&](long k)
 		{
-			sprintf(quat_filepath, "%sqq_%s", quat_filepath, quat_filename.c_str());
-		}
-
-		string qfp(quat_filepath);
-		convertBVH2Quaternion(bvh_fullfilepath, qfp);
+			long p = pending[k];
+			computeTransitions(sequences[from[p]], sequences[to[p]], pair_transitions[p], parallel_pairs ? 1 : 0);
+		}, 1, parallel_pairs ? 0 : 1);
+	}
 
-		// verify that the new file exists
-		char* tmp = data_manager.findFile(quat_filepath);
-		if (tmp == NULL)
+	seq_IDs.clear();
+	transition_start.assign(1, 0);
+	transitions.clear();
+	root_tracks.clear();
+	frame_rates.clear();
+	long p = 0;
+	for (unsigned short i=0; i<motion_data_specs.size(); i++)
+	{
+		seq_IDs.push_back(motion_data_specs.getSeqID(i));
+		root_tracks.push_back(sequences[i].root_track);
+		frame_rates.push_back(sequences[i].frame_rate);
+		long first = long(transitions.size());
+		for (; (p < num_pairs) && (from[p] == i); p++)
 		{
-			stringstream ss;
-			ss << "MotionGraph::fileReader cannot find generated quaternion file " << quat_filepath;
-			throw AppException(ss.str().c_str());
+			logout << "MotionGraph::buildMotionGraph found " << pair_transitions[p].size() 
+				<< " transitions from " << sequences[from[p]].seq_ID 
+				<< " to " << sequences[to[p]].seq_ID << endl;
+			transitions.insert(transitions.end(), pair_transitions[p].begin(), pair_transitions[p].end());
 		}
-		delete [] tmp;
+		sort(transitions.begin() + first, transitions.end(), transitionOrder);
+		transition_start.push_back(long(transitions.size()));
+	}
+
+	if ((cache_filename != NULL) && !unchanged)
+	{
+		if (saveCache(cache_filename, sequences, indexed))
+			logout << "MotionGraph::buildMotionGraph saved " << cache_filename << endl;
+		else
+			logout << "MotionGraph::buildMotionGraph could not save " << cache_filename << endl;
 	}
-	string filepath = quat_filepath;
-	delete [] quat_filepath;
-	return filepath;
 }
 
-// Read a quaternion format data file and store it as a Sequence
-MotionGraph::Sequence MotionGraph::fileReader(MotionDataSpecification& motion_data_specs, short index)
+// Read a BVH file and store its poses as a Sequence
+MotionGraph::Sequence MotionGraph::fileReader(MotionDataSpecification& motion_data_specs, short index,
+	const string& bvh_filepath)
 {
-	string seq_ID = motion_data_specs.getSeqID(index);
-	string bvh_filename = motion_data_specs.getBvhFilename(index);
-	string quat_filename = motion_data_specs.getQuatFilename(index);
-
-	string quat_filepath = verifyQuaternionFile(bvh_filename, quat_filename);
-
-	vector<Frame> single_sequence;
 	Sequence sequence;
-	sequence.seq_ID = seq_ID;
-	sequence.source_filename = quat_filename;
-	sequence.source_full_pathname = quat_filepath;
+	sequence.seq_index = index;
+	sequence.content_hash = 0;
+	sequence.seq_ID = motion_data_specs.getSeqID(index);
+	sequence.source_filename = motion_data_specs.getBvhFilename(index);
+	sequence.source_full_pathname = bvh_filepath;
 
-	cout << "MotionGraph::fileReader is opening: " << quat_filepath << endl;
+	cout << "MotionGraph::fileReader is opening: " << bvh_filepath << endl;
 
-	ifstream data(quat_filepath.c_str());
-	if (!data)
+	pair<Skeleton*, MotionSequence*> read_result;
+	try
+	{
+		read_result = data_manager.readBVH(bvh_filepath.c_str());
+	}
+	catch (const DataManagementException& dme)
 	{
 		stringstream ss;
-		ss << "MotionGraph::fileReader cannot open file " << quat_filepath;
+		ss << "MotionGraph::fileReader cannot read file " << bvh_filepath << ": " << dme.msg;
 		throw AppException(ss.str().c_str());
 	}
-	string line;
-	Frame tmp_frame;
-	Quaternion tmp_quat;
-
-	while (!data.eof())
+	PoseFeatures features;
+	features.extract(read_result.first, read_result.second);
+	sequence.frame_rate = features.getFrameRate();
+	bool root_rotates = (features.numJoints() > 0) && (features.jointBone(0) == 0);
+	sequence.root_track.resize(features.numFrames());
+	for (long f=0; f<features.numFrames(); f++)
 	{
-		getline(data, line);
-		data >> tmp_frame.root_position.x;
-		data >> tmp_frame.root_position.y;
-		data >> tmp_frame.root_position.z;
-
-		// FUTUREWORK (150626) - 20 joint count needs to be parameterized.
-		//   needs to be coordinated with convertBVH2Quaternion()
-		for (int j = 0; j < 20; j++)
-		{
-			data >> tmp_quat.w;
-			data >> tmp_quat.z;
-			data >> tmp_quat.x;
-			data >> tmp_quat.y;
-			tmp_frame.joints.push_back(tmp_quat);
-		}
-
-		single_sequence.push_back(tmp_frame);
-		tmp_frame.joints.clear();
+		RootFrame& root = sequence.root_track[f];
+		root.x = features.rootPosition(f)[0];
+		root.z = features.rootPosition(f)[2];
+		root.heading = root_rotates ? rootHeading(features.jointRotation(f, 0)) : 0.0f;
 	}
 
-	sequence.frames = single_sequence;
+	// joint positions: the end of every bone in every frame
+	RawMotionController controller(read_result.second);
+	read_result.first->attachMotionController(&controller);
+	Array2D<float> positions;
+	read_result.first->buildPositionMatrix(positions);
+	int num_frames = int(positions.getRows());
+	int num_points = int(positions.getColumns()/3);
+	vector<float> points(3L*num_frames*num_points);
+	for (int f=0; f<num_frames; f++)
+		for (int c=0; c<3*num_points; c++)
+			points[3L*f*num_points + c] = positions.get(f, c);
+	sequence.clouds.pack(points.empty() ? NULL : &points[0], num_frames, num_points);
+	delete read_result.first;
+	delete read_result.second;
+
+	// The root rotation is left out: it holds the facing direction, which
+	// does not need to match for a transition.
+	sequence.poses.pack(features, 1);
 	return sequence;
 }
 
@@ -191,112 +352,425 @@ struct CandidateTransition {
 	float distance;
 };
 
-// FUTUREWORK (150618)
-// This function would probably be more efficient if we used lists instead of vectors,
-// since it is often erasing the first element in the vector/list.
-void MotionGraph::computeTransitions(Sequence& motion1, Sequence& motion2, vector<Transition>& result)
+// heap order that pops the smallest distance first, ties in frame order
+struct LaterCandidate
 {
-	logout << "MotionGraph::findTransitions starting" << endl;
-
-	vector<CandidateTransition> candidate_transitions;
-
-	// Calculate distances between each pair of frames from the two motions
+	bool operator()(const CandidateTransition& a, const CandidateTransition& b) const
+	{
+		if (a.distance != b.distance) return a.distance > b.distance;
+		if (a.motion1_frame != b.motion1_frame) return a.motion1_frame > b.motion1_frame;
+		return a.motion2_frame > b.motion2_frame;
+	}
+};
 
-	// Upper theshold for initial threshold culling
-	// FUTUREWORK (150618) - max_distance should be a parameter
-	float max_distance = 12.0;
+static bool frameOrder(const CandidateTransition& a, const CandidateTransition& b)
+{
+	if (a.motion1_frame != b.motion1_frame) return a.motion1_frame < b.motion1_frame;
+	return a.motion2_frame < b.motion2_frame;
+}
 
-	// loop through all frame pairs <i,j>, where i is from motion 1 and j is from motion 2
-	for (unsigned int i = 0; i < motion1.frames.size(); i += 1)
+// Minimum of each entry's neighbors within radius r in both directions,
+// computed one direction at a time: O(rows*cols*r).
+static void windowMinimum(const vector<float>& m, long rows, long cols, int r, vector<float>& result)
+{
+	vector<float> across(m.size());
+	for (long i=0; i<rows; i++)
+	{
+		const float* row = &m[i*cols];
+		for (long j=0; j<cols; j++)
+		{
+			long j0 = (j-r < 0) ? 0 : j-r, j1 = (j+r >= cols) ? cols-1 : j+r;
+			float v = row[j0];
+			for (long k=j0+1; k<=j1; k++) v = min(v, row[k]);
+			across[i*cols + j] = v;
+		}
+	}
+	result.resize(m.size());
+	for (long i=0; i<rows; i++)
 	{
-		for (unsigned int j = 0; j < motion2.frames.size(); j += 1)
+		long i0 = (i-r < 0) ? 0 : i-r, i1 = (i+r >= rows) ? rows-1 : i+r;
+		float* out = &result[i*cols];
+		memcpy(out, &across[i0*cols], cols*sizeof(float));
+		for (long k=i0+1; k<=i1; k++)
 		{
-			float distance = 0;
+			const float* in = &across[k*cols];
+			for (long j=0; j<cols; j++) out[j] = min(out[j], in[j]);
+		}
+	}
+}
 
-			if (motion1.frames[i].joints.size() != motion2.frames[j].joints.size())
-			{
-				stringstream ss;
-				ss << "Error in MotionGraph::findTransitions. Different number of joints. "
-					<< motion1.seq_ID << " frame " << i << " to " << motion2.seq_ID << " frame " << j;
-				throw AppException(ss.str().c_str());
-			}
+// Take candidates in order of increasing distance, dropping any within the
+// duplicate window of one already selected. Selected transitions are at
+// least a window apart, so each window sized grid cell holds at most one
+// and only the 3x3 cells around a candidate need to be checked.
+// Candidate frames must be in [i_begin,i_end) and [j_begin,j_end).
+static void selectTransitions(vector<CandidateTransition>& candidates,
+	int i_begin, int i_end, int j_begin, int j_end, vector<CandidateTransition>& selected)
+{
+	int window = DUPLICATE_WINDOW;
+	LaterCandidate later;
+	make_heap(candidates.begin(), candidates.end(), later);
+	long grid_rows = (i_end - i_begin)/window + 1, grid_cols = (j_end - j_begin)/window + 1;
+	vector<int> grid(grid_rows*grid_cols, -1);
+	while (!candidates.empty() &&
+		((MAX_TRANSITIONS_PER_PAIR == 0) || (selected.size() < MAX_TRANSITIONS_PER_PAIR)))
+	{
+		pop_heap(candidates.begin(), candidates.end(), later);
+		CandidateTransition c = candidates.back();
+		candidates.pop_back();
 
-			// distance is the sum of the quaterian differences of each joint
-			for (unsigned short k = 0; k < motion1.frames[i].joints.size(); k++)
+		long ci = (c.motion1_frame - i_begin)/window, cj = (c.motion2_frame - j_begin)/window;
+		bool duplicate = false;
+		for (long gi = max(ci-1, 0L); (gi <= min(ci+1, grid_rows-1)) && !duplicate; gi++)
+		{
+			for (long gj = max(cj-1, 0L); gj <= min(cj+1, grid_cols-1); gj++)
 			{
-				Quaternion diffq = motion1.frames[i].joints[k] - motion2.frames[j].joints[k];
-				distance += diffq.magnitude();
+				int s = grid[gi*grid_cols + gj];
+				if ((s >= 0) &&
+					(abs(c.motion1_frame - selected[s].motion1_frame) < window) &&
+					(abs(c.motion2_frame - selected[s].motion2_frame) < window))
+				{
+					duplicate = true;
+					break;
+				}
 			}
+		}
+		if (duplicate) continue;
+		grid[ci*grid_cols + cj] = int(selected.size());
+		selected.push_back(c);
+	}
+}
+
+static void appendTransitions(int from_seq, int to_seq,
+	const vector<CandidateTransition>& selected, vector<MotionGraph::Transition>& result)
+{
+	for (unsigned int i = 0; i < selected.size(); i++)
+	{
+		MotionGraph::Transition t;
+		t.from_seq = from_seq;
+		t.from_frame = selected[i].motion1_frame;
+		t.to_seq = to_seq;
+		t.to_frame = selected[i].motion2_frame;
+		t.distance = selected[i].distance;
+		result.push_back(t);
+	}
+}
 
-			// store this pair as a candidate transition if it meets the criteria
-			// FUTUREWORK (150618) - 30 should be a parameter
-			if (abs(distance) < max_distance &&
-				distance != 0 &&
-				j < motion2.frames.size() - 30 &&
-				i < motion1.frames.size() - 30 &&
-				i > 30 &&
-				j > 30)
+// Adds the local minima of the distance matrix in rows [i_begin,i_end) and
+// columns [j_begin,j_end) that are under MAX_TRANSITION_DISTANCE: any other
+// pair within the duplicate window has a nearer pair that would suppress it.
+// The matrix is computed margin frames past the block on each side, within
+// the frames that can be transition points, so with a margin of at least
+// DUPLICATE_WINDOW-1 the block has the minima of the whole matrix.
+static void addLocalMinima(const PackedPoses& poses1, const PointClouds& clouds1,
+	const PackedPoses& poses2, const PointClouds& clouds2,
+	int i_begin, int i_end, int j_begin, int j_end, int margin, int max_threads,
+	vector<CandidateTransition>& candidates)
+{
+	int i0 = max(i_begin - margin, END_MARGIN+1), i1 = min(i_end + margin, poses1.num_frames - END_MARGIN);
+	int j0 = max(j_begin - margin, END_MARGIN+1), j1 = min(j_end + margin, poses2.num_frames - END_MARGIN);
+	long height = i1 - i0;
+	long width = j1 - j0;
+	vector<float> distances(height*width);
+	if (USE_POINT_CLOUD_DISTANCE)
+		computeWindowedDistances(clouds1, clouds2, POINT_CLOUD_WINDOW,
+			i0, i1, j0, j1, &distances[0], width, max_threads);
+	else
+		computePoseDistances(poses1, poses2, i0, i1, j0, j1,
+			MAX_TRANSITION_DISTANCE, &distances[0], width, max_threads);
+
+	vector<float> local_min;
+	windowMinimum(distances, height, width, DUPLICATE_WINDOW-1, local_min);
+	for (long i = i_begin - i0; i < i_end - i0; i++)
+	{
+		for (long j = j_begin - j0; j < j_end - j0; j++)
+		{
+			float distance = distances[i*width + j];
+			if (distance < MAX_TRANSITION_DISTANCE && distance != 0 && distance == local_min[i*width + j])
 			{
 				CandidateTransition transition;
-				transition.motion1_frame = i;
-				transition.motion2_frame = j;
+				transition.motion1_frame = int(i0 + i);
+				transition.motion2_frame = int(j0 + j);
 				transition.distance = distance;
-				candidate_transitions.push_back(transition);
+				candidates.push_back(transition);
 			}
 		}
 	}
+}
+
+// Called from several threads at once, so it does not write to the log.
+void MotionGraph::computeTransitions(Sequence& motion1, Sequence& motion2, vector<Transition>& result, int max_threads)
+{
+	vector<CandidateTransition> candidate_transitions;
+
+	int i_begin = END_MARGIN+1, i_end = motion1.poses.num_frames - END_MARGIN;
+	int j_begin = END_MARGIN+1, j_end = motion2.poses.num_frames - END_MARGIN;
+	if ((i_end <= i_begin) || (j_end <= j_begin)) return;
 
-	// sort the candidate transitions in order of increasing distance
+	addLocalMinima(motion1.poses, motion1.clouds, motion2.poses, motion2.clouds,
+		i_begin, i_end, j_begin, j_end, 0, max_threads, candidate_transitions);
 
-	vector<CandidateTransition> ordered_transitions;
-	while (candidate_transitions.size() > 0)
+	vector<CandidateTransition> selected_transitions;
+	selectTransitions(candidate_transitions, i_begin, i_end, j_begin, j_end, selected_transitions);
+	appendTransitions(motion1.seq_index, motion2.seq_index, selected_transitions, result);
+}
+
+// block of the distance matrix between two sequences, in units of POSE_INDEX_BLOCK frames
+struct MatrixBlock {
+	int seq;
+	int row;
+	int col;
+};
+
+static bool blockOrder(const MatrixBlock& a, const MatrixBlock& b)
+{
+	if (a.seq != b.seq) return a.seq < b.seq;
+	if (a.row != b.row) return a.row < b.row;
+	return a.col < b.col;
+}
+
+static bool sameBlock(const MatrixBlock& a, const MatrixBlock& b)
+{
+	return (a.seq == b.seq) && (a.row == b.row) && (a.col == b.col);
+}
+
+bool MotionGraph::computeTransitionsIndexed(vector<Sequence>& sequences, vector<vector<Transition> >& pair_transitions)
+{
+	// one item per POSE_INDEX_STEP frames that can be transition points
+	int num_seqs = int(sequences.size());
+	int feature_dim = 4*sequences[0].poses.num_joints;
+	vector<int> item_seq, item_frame;
+	vector<float> features;
+	for (int s=0; s<num_seqs; s++)
 	{
-		int lowestCompValLocation = 0;
-		for (unsigned int i = 1; i < candidate_transitions.size(); i++)
+		for (int f=END_MARGIN+1; f<sequences[s].poses.num_frames-END_MARGIN; f+=POSE_INDEX_STEP)
 		{
-			if (candidate_transitions[lowestCompValLocation].distance > candidate_transitions[i].distance)
-				lowestCompValLocation = i;
+			item_seq.push_back(s);
+			item_frame.push_back(f);
+			features.resize(features.size() + feature_dim);
+			sequences[s].poses.feature(f, &features[features.size() - feature_dim]);
 		}
-		ordered_transitions.push_back(candidate_transitions[lowestCompValLocation]);
-		candidate_transitions.erase(candidate_transitions.begin() + lowestCompValLocation);
 	}
+	if (item_seq.empty()) return true;
+
+	PoseIndex index;
+	index.build(&features[0], long(item_seq.size()), feature_dim);
+	logout << "MotionGraph::computeTransitionsIndexed indexed " << index.size() << " frames with "
+		<< index.reducedDimension() << " of " << feature_dim << " dimensions" << endl;
+	if (index.reducedDimension() > POSE_INDEX_MAX_DIMENSION) return false;
+
+	// Items are numbered sequence by sequence, so the frames of sequence s
+	// are items [first_item[s],first_item[s+1]).
+	vector<long> first_item(num_seqs+1);
+	for (int s=0; s<=num_seqs; s++)
+		first_item[s] = lower_bound(item_seq.begin(), item_seq.end(), s) - item_seq.begin();
+
+	// A block of the distance matrix is searched when one of its rows has
+	// one of its columns among its nearest neighbours. Its local minima are
+	// then the same as those of the whole matrix.
+	int first = END_MARGIN+1;
+	vector<long> searched(num_seqs, 0);
+	parallelFor(0, num_seqs, [&](long a)
+	{
+		const Sequence& motion1 = sequences[a];
+		vector<MatrixBlock> blocks;
+		vector<long> hits;
+		for (long item=first_item[a]; item<first_item[a+1]; item++)
+		{
+			index.nearest(&features[item*feature_dim], POSE_INDEX_NEIGHBOURS, hits, NULL, first_item[a], first_item[a+1]);
+			for (unsigned int h=0; h<hits.size(); h++)
+			{
+				MatrixBlock block;
+				block.seq = item_seq[hits[h]];
+				block.row = (item_frame[item] - first)/POSE_INDEX_BLOCK;
+				block.col = (item_frame[hits[h]] - first)/POSE_INDEX_BLOCK;
+				blocks.push_back(block);
+			}
+		}
+		sort(blocks.begin(), blocks.end(), blockOrder);
+		blocks.erase(unique(blocks.begin(), blocks.end(), sameBlock), blocks.end());
+		searched[a] = long(blocks.size());
+
+		vector<CandidateTransition> candidates;
+		for (unsigned long k=0; k<blocks.size(); k++)
+		{
+			const Sequence& motion2 = sequences[blocks[k].seq];
+			int i_end = motion1.poses.num_frames - END_MARGIN, j_end = motion2.poses.num_frames - END_MARGIN;
+			int i = first + blocks[k].row*POSE_INDEX_BLOCK, j = first + blocks[k].col*POSE_INDEX_BLOCK;
+			addLocalMinima(motion1.poses, motion1.clouds, motion2.poses, motion2.clouds,
+				i, min(i + POSE_INDEX_BLOCK, i_end), j, min(j + POSE_INDEX_BLOCK, j_end),
+				DUPLICATE_WINDOW-1, 1, candidates);
+			if ((k+1 < blocks.size()) && (blocks[k+1].seq == blocks[k].seq)) continue;
+
+			// last block with this sequence
+			int b = blocks[k].seq;
+			vector<CandidateTransition> selected;
+			selectTransitions(candidates, first, i_end, first, j_end, selected);
+			// same pair order as buildMotionGraph
+			long p = a*(num_seqs-1) + ((b < a) ? b : b-1);
+			appendTransitions(int(a), b, selected, pair_transitions[p]);
+			candidates.clear();
+		}
+	}, 1);
 
-	// select the best pairs from local sequences of pairs
+	// every block of every pair, other than a sequence with itself
+	long num_searched = 0, all_blocks = 0, same_blocks = 0;
+	for (int s=0; s<num_seqs; s++)
+	{
+		long n = (max(sequences[s].poses.num_frames - 2*END_MARGIN - 1, 0) + POSE_INDEX_BLOCK-1)/POSE_INDEX_BLOCK;
+		num_searched += searched[s];
+		all_blocks += n;
+		same_blocks += n*n;
+	}
+	long num_blocks = all_blocks*all_blocks - same_blocks;
+	logout << "MotionGraph::computeTransitionsIndexed searched " << num_searched << " of "
+		<< num_blocks << " distance matrix blocks" << endl;
+	return true;
+}
 
-	vector<CandidateTransition> selected_transitions;
-	selected_transitions.push_back(ordered_transitions[0]);
-	ordered_transitions.erase(ordered_transitions.begin());
-	while (ordered_transitions.size() > 0)
+// The cache holds the transition search parameters, each clip's ID, file
+// name, content hash, packed poses, point clouds and root track, and every
+// transition, flagged if they came from computeTransitionsIndexed.
+bool MotionGraph::saveCache(const char* filename, const vector<Sequence>& sequences, bool indexed) const
+{
+	ByteWriter w;
+	w.putBytes(GRAPH_CACHE_MAGIC, 8);
+	w.putU32(GRAPH_CACHE_VERSION);
+	w.putU32(USE_POINT_CLOUD_DISTANCE ? (unsigned int)POINT_CLOUD_WINDOW : 0);
+	w.putF32(MAX_TRANSITION_DISTANCE);
+	w.putU32((unsigned int)DUPLICATE_WINDOW);
+	w.putU32((unsigned int)END_MARGIN);
+	w.putU32(MAX_TRANSITIONS_PER_PAIR);
+	w.putU32((unsigned int)POSE_INDEX_MIN_SEQUENCES);
+	w.putU32((unsigned int)POSE_INDEX_NEIGHBOURS);
+	w.putU32((unsigned int)POSE_INDEX_BLOCK);
+	w.putU32((unsigned int)POSE_INDEX_STEP);
+	w.putU32((unsigned int)POSE_INDEX_MAX_DIMENSION);
+	w.putU32((unsigned int)sequences.size());
+	for (unsigned int s=0; s<sequences.size(); s++)
 	{
-		bool addToList = true;
-		for (unsigned int i = 0; i < selected_transitions.size(); i++)
+		const PackedPoses& poses = sequences[s].poses;
+		w.putString(sequences[s].seq_ID);
+		w.putString(sequences[s].source_filename);
+		w.putU64(sequences[s].content_hash);
+		w.putU32((unsigned int)poses.num_frames);
+		w.putU32((unsigned int)poses.num_joints);
+		for (unsigned long k=0; k<poses.data.size(); k++) w.putF32(poses.data[k]);
+		const PointClouds& clouds = sequences[s].clouds;
+		w.putU32((unsigned int)clouds.num_frames);
+		w.putU32((unsigned int)clouds.num_points);
+		for (unsigned long k=0; k<clouds.data.size(); k++) w.putF32(clouds.data[k]);
+		const vector<RootFrame>& root_track = sequences[s].root_track;
+		w.putF32(sequences[s].frame_rate);
+		w.putU32((unsigned int)root_track.size());
+		for (unsigned long f=0; f<root_track.size(); f++)
 		{
-			// If the lowest comparison value in sortedComparisons frame 1 and 2 are within 10 frames
-			// of any motion already stored then don't add to final list
-			// FUTUREWORK (150618) - 5 should be a parameter
-			if (ordered_transitions[0].motion1_frame < selected_transitions[i].motion1_frame + 5 &&
-				ordered_transitions[0].motion1_frame > selected_transitions[i].motion1_frame - 5 &&
-				ordered_transitions[0].motion2_frame < selected_transitions[i].motion2_frame + 5 &&
-				ordered_transitions[0].motion2_frame < selected_transitions[i].motion2_frame - 5)
-				addToList = false;
+			w.putF32(root_track[f].x);
+			w.putF32(root_track[f].z);
+			w.putF32(root_track[f].heading);
 		}
-		if (addToList)
-			selected_transitions.push_back(ordered_transitions[0]);
-		ordered_transitions.erase(ordered_transitions.begin());
 	}
-
-	logout << "MotionGraph::findTransitions found " << selected_transitions.size() << " transitions " << endl;
-
-	for (unsigned int i = 0; i < selected_transitions.size(); i++)
+	w.putU32(indexed ? 1 : 0);
+	w.putU64((unsigned long long)transitions.size());
+	for (unsigned long t=0; t<transitions.size(); t++)
 	{
-		Transition t;
-		t.from_seqID = motion1.seq_ID;
-		t.from_frame = selected_transitions[i].motion1_frame;
-		t.to_seqID = motion2.seq_ID;
-		t.to_frame = selected_transitions[i].motion2_frame;
-		t.distance = selected_transitions[i].distance;
-		result.push_back(t);
+		w.putU32((unsigned int)transitions[t].from_seq);
+		w.putI32(transitions[t].from_frame);
+		w.putU32((unsigned int)transitions[t].to_seq);
+		w.putI32(transitions[t].to_frame);
+		w.putF32(transitions[t].distance);
 	}
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL) return false;
+	bool ok = (fwrite(&w.bytes[0], 1, w.bytes.size(), fp) == w.bytes.size());
+	if (fclose(fp) != 0) ok = false;
+	return ok;
+}
 
-	logout << "MotionGraph::findTransitions finished" << endl;
+// Returns false, leaving the results empty, if the file is missing, damaged
+// or was built with different parameters.
+bool MotionGraph::loadCache(const char* filename, vector<Sequence>& clips, vector<Transition>& clip_transitions,
+	bool& indexed) const
+{
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) return false;
+	vector<unsigned char> bytes;
+	unsigned char buffer[1<<16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer+n);
+	fclose(fp);
+	if (bytes.size() < 32) return false;
+
+	ByteReader r(&bytes[0], long(bytes.size()));
+	if ((memcmp(r.getBytes(8), GRAPH_CACHE_MAGIC, 8) != 0) || (r.getU32() != GRAPH_CACHE_VERSION)) return false;
+	if ((r.getU32() != (USE_POINT_CLOUD_DISTANCE ? (unsigned int)POINT_CLOUD_WINDOW : 0)) ||
+		(r.getF32() != MAX_TRANSITION_DISTANCE) || (r.getU32() != (unsigned int)DUPLICATE_WINDOW) ||
+		(r.getU32() != (unsigned int)END_MARGIN) || (r.getU32() != MAX_TRANSITIONS_PER_PAIR))
+		return false;
+	if ((r.getU32() != (unsigned int)POSE_INDEX_MIN_SEQUENCES) || (r.getU32() != (unsigned int)POSE_INDEX_NEIGHBOURS) ||
+		(r.getU32() != (unsigned int)POSE_INDEX_BLOCK) || (r.getU32() != (unsigned int)POSE_INDEX_STEP) ||
+		(r.getU32() != (unsigned int)POSE_INDEX_MAX_DIMENSION))
+		return false;
+
+	unsigned int num_clips = r.getU32();
+	if (20L*num_clips > r.remaining()) return false;
+	vector<Sequence> loaded(num_clips);
+	for (unsigned int s=0; (s<loaded.size()) && r.good(); s++)
+	{
+		Sequence& seq = loaded[s];
+		seq.seq_index = int(s);
+		seq.seq_ID = r.getString();
+		seq.source_filename = r.getString();
+		seq.content_hash = r.getU64();
+		PackedPoses& poses = seq.poses;
+		poses.num_frames = int(r.getU32());
+		poses.num_joints = int(r.getU32());
+		poses.stride = (poses.num_frames + 7) & ~3L;
+		// check the size before allocating anything
+		long count = 4L*poses.num_joints*poses.stride;
+		if ((poses.num_frames < 0) || (poses.num_joints < 0) || (4*count > r.remaining())) return false;
+		poses.data.resize(count);
+		for (long k=0; k<count; k++) poses.data[k] = r.getF32();
+		PointClouds& clouds = seq.clouds;
+		clouds.num_frames = int(r.getU32());
+		clouds.num_points = int(r.getU32());
+		clouds.padded = (clouds.num_points + 3) & ~3;
+		count = 3L*clouds.num_frames*clouds.padded;
+		if ((clouds.num_frames < 0) || (clouds.num_points < 0) || (4*count > r.remaining())) return false;
+		clouds.data.resize(count);
+		for (long k=0; k<count; k++) clouds.data[k] = r.getF32();
+		clouds.computePrefixSums();
+		seq.frame_rate = r.getF32();
+		count = long(r.getU32());
+		if (12*count > r.remaining()) return false;
+		seq.root_track.resize(count);
+		for (long f=0; f<count; f++)
+		{
+			seq.root_track[f].x = r.getF32();
+			seq.root_track[f].z = r.getF32();
+			seq.root_track[f].heading = r.getF32();
+		}
+	}
+	unsigned int indexed_flag = r.getU32();
+	unsigned long long num_transitions = r.getU64();
+	if (!r.good() || (indexed_flag > 1) || (num_transitions*20 != (unsigned long long)r.remaining())) return false;
+	vector<Transition> loaded_transitions(num_transitions);
+	for (unsigned long t=0; t<loaded_transitions.size(); t++)
+	{
+		Transition& tr = loaded_transitions[t];
+		tr.from_seq = int(r.getU32());
+		tr.from_frame = r.getI32();
+		tr.to_seq = int(r.getU32());
+		tr.to_frame = r.getI32();
+		tr.distance = r.getF32();
+		if ((tr.from_seq < 0) || (tr.from_seq >= int(loaded.size())) ||
+			(tr.to_seq < 0) || (tr.to_seq >= int(loaded.size())))
+			return false;
+	}
+	if (!r.good()) return false;
+	clips.swap(loaded);
+	clip_transitions.swap(loaded_transitions);
+	indexed = (indexed_flag == 1);
+	return true;
 }
@@ -9,59 +9,113 @@
 #define MOTIONGRAPH_DOT_H
 // SKA configuration
 #include <Core/SystemConfiguration.h>
+#include <cstddef>
+#include <string>
 #include <vector>
 using namespace std;
 #include "AnimationControl.h"
+#include "PoseDistance.h"
 
 class MotionGraph
 {
 public:
 
-	MotionGraph(MotionDataSpecification& motion_data_specs);
+	// If cache_filename is given, the graph is kept in that file between
+	// runs. Clips whose BVH file has not changed are loaded from it,
+	// and transitions are only computed for pairs involving a new or
+	// changed clip. The file is rewritten when anything was recomputed.
+	MotionGraph(MotionDataSpecification& motion_data_specs, const char* cache_filename=NULL);
 
-	// FUTUREWORK (150618) - optimize the graph storage for faster retrieval
-	//                       of queries through findTransitions()
+	// Sequences are numbered in the order of the MotionDataSpecification.
 	struct Transition
 	{
-		string from_seqID;
+		int from_seq;
 		int from_frame;
-		string to_seqID;
+		int to_seq;
 		int to_frame;
 		float distance;
 	};
 
-	struct TransitionSet
+	// A range of transitions stored in the graph. It stays valid as long
+	// as the graph does.
+	struct TransitionSpan
 	{
-		string from_seq_ID;
-		vector<Transition> transitions;
+		const Transition* first;
+		const Transition* last;
+		TransitionSpan(const Transition* _first=NULL, const Transition* _last=NULL)
+			: first(_first), last(_last) { }
+		const Transition* begin() const { return first; }
+		const Transition* end() const { return last; }
+		unsigned long size() const { return (unsigned long)(last - first); }
+		bool empty() const { return first == last; }
+		const Transition& operator[](unsigned long i) const { return first[i]; }
 	};
 
-	vector<TransitionSet> graph;
+	int numSequences() const { return int(seq_IDs.size()); }
+	const string& sequenceID(int seq) const { return seq_IDs[seq]; }
+	// -1 if there is no sequence with this ID
+	int sequenceIndex(const string& seq_ID) const;
 
-	// find all transitions from the given motion sequence at some frame later than the given frame
-	void findTransitions(string& from_seqID, int from_frame, vector<Transition>& transitions);
+	long numTransitions() const { return long(transitions.size()); }
+	// all transitions from the given sequence, in order of from_frame
+	TransitionSpan transitionsFrom(int from_seq) const;
+	// transitions from the given sequence at some frame later than the given frame
+	TransitionSpan findTransitions(int from_seq, int from_frame) const;
 
-private:
-
-	struct Frame
+	// Root motion, for planning: floor position and facing angle (radians
+	// about y, 0 along z) of the root in each frame of a sequence.
+	struct RootFrame
 	{
-		Vector3D root_position;
-		std::vector<Quaternion> joints;
+		float x;
+		float z;
+		float heading;
 	};
+	long numFrames(int seq) const { return long(root_tracks[seq].size()); }
+	float frameRate(int seq) const { return frame_rates[seq]; }
+	const RootFrame& rootFrame(int seq, long frame) const { return root_tracks[seq][frame]; }
+
+private:
 
 	struct Sequence
 	{
-		vector<Frame> frames;
+		PackedPoses poses;
+		PointClouds clouds;		// joint positions, for the point cloud distance
+		vector<RootFrame> root_track;
+		float frame_rate;
+		int seq_index;
+		unsigned long long content_hash;	// of the BVH file
 		string seq_ID;
 		string source_filename;
 		string source_full_pathname;
 	};
 
-	void buildMotionGraph(MotionDataSpecification& motion_data_specs);
+	// Graph in compressed sparse row form: the transitions from sequence s
+	// are transitions[transition_start[s]] up to transitions[transition_start[s+1]],
+	// sorted by from_frame.
+	vector<string> seq_IDs;
+	vector<long> transition_start;
+	vector<Transition> transitions;
+	vector<vector<RootFrame> > root_tracks;
+	vector<float> frame_rates;
+
+	void buildMotionGraph(MotionDataSpecification& motion_data_specs, const char* cache_filename);
+
+	Sequence fileReader(MotionDataSpecification& motion_data_specs, short index, const string& bvh_filepath);
+
+	// indexed is true if the transitions came from computeTransitionsIndexed
+	bool saveCache(const char* filename, const vector<Sequence>& sequences, bool indexed) const;
+	bool loadCache(const char* filename, vector<Sequence>& clips, vector<Transition>& clip_transitions,
+		bool& indexed) const;
 
-	Sequence fileReader(MotionDataSpecification& motion_data_specs, short index);
+	// max_threads limits the threads used for the distance matrix (0 = all)
+	void computeTransitions(Sequence& motion1, Sequence& motion2, vector<Transition>& result, int max_threads=0);
 
-	void computeTransitions(Sequence& motion1, Sequence& motion2, vector<Transition>& result);
+	// Transitions for every ordered pair of sequences, searched for only in
+	// the blocks of the distance matrices where nearest neighbour queries on
+	// a PoseIndex find similar poses. pair_transitions is ordered like the pairs in buildMotionGraph.
+	// Returns false, leaving pair_transitions empty, if the poses do not
+	// reduce to few enough dimensions for the index to help.
+	bool computeTransitionsIndexed(vector<Sequence>& sequences, vector<vector<Transition> >& pair_transitions);
 };
 
 #endif
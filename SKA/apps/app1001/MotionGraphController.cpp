@@ -9,6 +9,10 @@
 #include <Core/SystemLog.h>
 #include "MotionGraphController.h"
 
+// FUTUREWORK (150626) - Transitions are only taken this many frames ahead
+//                       to avoid jumping too soon. It should be parameterized.
+static const int MIN_TRANSITION_LEAD = 10;
+
 MotionGraphController::MotionGraphController(MotionGraph* _motion_graph,
 	MotionDataSpecification& _motion_data_specs,
 	float _character_size_scale)
@@ -17,23 +21,24 @@ MotionGraphController::MotionGraphController(MotionGraph* _motion_graph,
 	readInMotionSequences(_motion_data_specs);
 	motion_graph = _motion_graph;
 
+	if (motion_graph->numSequences() != int(motion_sequences.size()))
+		throw AppException("MotionGraphController: motion graph and motion data specification do not match");
+
 	// force a transition to start of first sequence
-	string initial_seqID = _motion_data_specs.getSeqID(0);
-	status.active_seqID = initial_seqID;
+	status.active_seq = 0;
 	status.active_frame = 0;
 	status.active_frame = LONG_MAX;
 	status.transition_trigger_frame = 0;
 	status.transition_frame = 0;
-	status.transition_seqID = initial_seqID;
+	status.transition_seq = 0;
 	status.current_time = -1.0f;
 	status.frame_zero_time = 0.0f;
 }
 
 MotionGraphController::~MotionGraphController()
 {
-	map<string, MotionSequence*>::iterator it;
-	for (it = motion_sequence_map.begin(); it != motion_sequence_map.end(); it++)
-		delete it->second;
+	for (unsigned int i = 0; i < motion_sequences.size(); i++)
+		delete motion_sequences[i];
 }
 
 //---------- Runtime Access Methods ---------------
@@ -43,11 +48,11 @@ bool MotionGraphController::isValidChannel(CHANNEL_ID _channel, float _time)
 	// update internal state (if time has passed since last external access)
 	update(_time);
 
-	MotionSequence *motion_sequence = lookupMotionSequenceByID(status.active_seqID);
+	MotionSequence *motion_sequence = lookupMotionSequence(status.active_seq);
 	if (motion_sequence == NULL)
 	{
 		stringstream ss;
-		ss << "MotionGraphController::isValidChannel: MotionGraphController has no attached MotionSequence for " << status.active_seqID;
+		ss << "MotionGraphController::isValidChannel: MotionGraphController has no attached MotionSequence for sequence " << status.active_seq;
 		logout << ss.str();
 		throw AppException(ss.str().c_str());
 	}
@@ -59,11 +64,11 @@ float MotionGraphController::getValue(CHANNEL_ID _channel, float _time)
 	// update internal state (if time has passed since last external access)
 	update(_time);
 
-	MotionSequence *motion_sequence = lookupMotionSequenceByID(status.active_seqID);
+	MotionSequence *motion_sequence = lookupMotionSequence(status.active_seq);
 	if (motion_sequence == NULL)
 	{
 		stringstream ss;
-		ss << "MotionGraphController::getValue: MotionGraphController has no attached MotionSequence for " << status.active_seqID;
+		ss << "MotionGraphController::getValue: MotionGraphController has no attached MotionSequence for sequence " << status.active_seq;
 		logout << ss.str() << endl;
 		throw AppException(ss.str().c_str());
 	}
@@ -95,7 +100,7 @@ void MotionGraphController::update(float _time)
 	if (status.active_frame >= status.transition_trigger_frame)
 	{
 		// make the transition
-		status.active_seqID = status.transition_seqID;
+		status.active_seq = status.transition_seq;
 		status.active_frame = status.transition_frame;
 		status.frame_zero_time = status.current_time - status.active_frame/frame_rate;
 		computeCurrentFrame();
@@ -108,15 +113,15 @@ void MotionGraphController::update(float _time)
 void MotionGraphController::setupNextTransition()
 {
 	// traverse the motion graph and find all transitions from remaining part of current sequence
-	vector<MotionGraph::Transition> candidate_transitions;
-	motion_graph->findTransitions(status.active_seqID, status.active_frame, candidate_transitions);
+	MotionGraph::TransitionSpan candidate_transitions =
+		motion_graph->findTransitions(status.active_seq, int(status.active_frame) + MIN_TRANSITION_LEAD);
 
 	// if nothing else is available, next transition is loop back from end of sequence
-	if (candidate_transitions.size() < 1)
+	if (candidate_transitions.empty())
 	{
-		status.transition_seqID = status.active_seqID;
+		status.transition_seq = status.active_seq;
 		status.transition_frame = 0;
-		status.transition_trigger_frame = lookupMotionSequenceByID(status.active_seqID)->numFrames() - 1;
+		status.transition_trigger_frame = lookupMotionSequence(status.active_seq)->numFrames() - 1;
 		return;
 	}
 
@@ -124,7 +129,7 @@ void MotionGraphController::setupNextTransition()
 	unsigned int choice = rand() % candidate_transitions.size();
 
 	// enable the selected transition
-	status.transition_seqID = candidate_transitions[choice].to_seqID;
+	status.transition_seq = candidate_transitions[choice].to_seq;
 	status.transition_frame = candidate_transitions[choice].to_frame;
 	status.transition_trigger_frame = candidate_transitions[choice].from_frame;
 }
@@ -136,11 +141,10 @@ void MotionGraphController::computeCurrentFrame()
 	status.active_frame = long((status.current_time - status.frame_zero_time) * frame_rate);
 }
 
-MotionSequence* MotionGraphController::lookupMotionSequenceByID(string ID)
+MotionSequence* MotionGraphController::lookupMotionSequence(int seq)
 {
-	map<string, MotionSequence*>::iterator iter =  motion_sequence_map.find(ID);
-	if (iter == motion_sequence_map.end()) return NULL;
-	return iter->second;
+	if ((seq < 0) || (seq >= int(motion_sequences.size()))) return NULL;
+	return motion_sequences[seq];
 }
 
 //---------- Setup Methods ---------------
@@ -193,7 +197,7 @@ void MotionGraphController::readInMotionSequences(MotionDataSpecification& motio
 			ms->scaleChannel(CHANNEL_ID(0, CT_TY), character_size_scale);
 			ms->scaleChannel(CHANNEL_ID(0, CT_TZ), character_size_scale);
 
-			motion_sequence_map.insert(pair<string, MotionSequence*>(seqID, ms));
+			motion_sequences.push_back(ms);
 		}
 		catch (BasicException& e)
 		{
@@ -203,7 +207,7 @@ void MotionGraphController::readInMotionSequences(MotionDataSpecification& motio
 			throw AppException(ss.str().c_str());
 		}
 	}
-	logout << "the number of motion sequences is : " << motion_sequence_map.size() << endl;
+	logout << "the number of motion sequences is : " << motion_sequences.size() << endl;
 	logout << "... MotionGraphController::readInMotionSequences finished" << endl;
 }
 
@@ -213,9 +217,9 @@ void MotionGraphController::printStatus()
 {
 	logout << endl << "MotionGraphController::printStatus" << endl;
 	logout << "current_time: " << status.current_time << endl;
-	logout << "status.active_seqID: " << status.active_seqID << endl;
+	logout << "status.active_seq: " << sequenceID(status.active_seq) << endl;
 	logout << "status.active_frame: " << status.active_frame << endl;
 	logout << "status.transition_trigger_frame: " << status.transition_trigger_frame << endl;
-	logout << "status.transition_seqID: " << status.transition_seqID << endl;
+	logout << "status.transition_seq: " << sequenceID(status.transition_seq) << endl;
 	logout << "status.transition_frame: " << status.transition_frame << endl;
 }
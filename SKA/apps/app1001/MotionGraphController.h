@@ -11,7 +11,6 @@
 #include <Animation/MotionController.h>
 #include <Animation/MotionSequence.h>
 #include <vector>
-#include <map>
 #include "AppConfig.h"
 #include "MotionGraph.h"
 #include <DataManagement/DataManager.h>
@@ -41,10 +40,10 @@ public:
 //---------- Internal state of the MotionGraphController ---------------
 	// public to allow for display and logging
 	struct State {
-		string active_seqID;			// current sequence
+		int active_seq;					// current sequence (MotionGraph numbering)
 		long active_frame;				// current frame number
 		long transition_trigger_frame;	// what frame number is the transition
-		string transition_seqID;		// sequence to transition to
+		int transition_seq;				// sequence to transition to
 		long transition_frame;			// what frame to start after transition
 		float current_time;				// time of last internal state update
 		float frame_zero_time;			// time that the current sequence effectively began
@@ -52,13 +51,14 @@ public:
 
 //---------- Runtime Debugging Methods ---------------
 	State getState() { return status; }
+	const string& sequenceID(int seq) { return motion_graph->sequenceID(seq); }
 
 private:
 
 	MotionGraph* motion_graph;
 
-	// loaded motion sequences indexed by sequence ID
-	map<string, MotionSequence*> motion_sequence_map;
+	// loaded motion sequences indexed by MotionGraph sequence number
+	vector<MotionSequence*> motion_sequences;
 
 	// status of the transition controller
 	State status;
@@ -76,11 +76,11 @@ private:
 
 	void setupNextTransition();
 
-	MotionSequence* lookupMotionSequenceByID(string ID);
+	MotionSequence* lookupMotionSequence(int seq);
 
 //---------- Setup Methods ---------------
 
-	// reads all the motion sequences, stores in motion_sequence_map
+	// reads all the motion sequences, stores in motion_sequences
 	void readInMotionSequences(MotionDataSpecification& motion_data_specs);
 
 //---------- Debugging Methods ---------------
@@ -0,0 +1,347 @@
+//-----------------------------------------------------------------------------
+// app1001 - Builds with SKA Version 4.0
+//-----------------------------------------------------------------------------
+// MotionGraphPlanner.cpp
+//    Plans a path through a MotionGraph that takes the character's root to a
+//    goal position within a time budget.
+//-----------------------------------------------------------------------------
+#include <Core/SystemConfiguration.h>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <queue>
+#include <functional>
+#include <algorithm>
+using namespace std;
+#include "AppConfig.h"
+#include "MotionGraphPlanner.h"
+
+// transitions are only taken this many frames after entering a sequence,
+// as in MotionGraphController
+static const int MIN_SEGMENT_FRAMES = 10;
+
+// headings are told apart in this many bins when comparing search nodes
+static const int HEADING_BINS = 16;
+
+// search time is checked every this many expanded nodes
+static const long TIME_CHECK_INTERVAL = 64;
+
+static const float PI_F = 3.14159265f;
+
+static float wrapAngle(float a)
+{
+	return atan2(sin(a), cos(a));
+}
+
+// search nodes in the same sequence frame, grid cell and heading bin are
+// treated as the same node
+struct PlannerKey
+{
+	int seq;
+	long frame;
+	int cell_x;
+	int cell_z;
+	int heading_bin;
+	bool operator==(const PlannerKey& other) const
+	{
+		return (seq == other.seq) && (frame == other.frame) && (cell_x == other.cell_x) &&
+			(cell_z == other.cell_z) && (heading_bin == other.heading_bin);
+	}
+};
+
+struct PlannerKeyHash
+{
+	size_t operator()(const PlannerKey& k) const
+	{
+		unsigned long long h = 14695981039346656037ULL;
+		long long parts[5] = { k.seq, k.frame, k.cell_x, k.cell_z, k.heading_bin };
+		for (int i=0; i<5; i++)
+		{
+			h ^= (unsigned long long)parts[i];
+			h *= 1099511628211ULL;
+		}
+		return size_t(h);
+	}
+};
+
+MotionGraphPlanner::MotionGraphPlanner(const MotionGraph* _graph, float _transition_cost,
+	float _distance_cost, float _cell_size)
+	: graph(_graph), transition_cost(_transition_cost), distance_cost(_distance_cost),
+	  cell_size(_cell_size), max_speed(0.0f)
+{
+	if (graph == NULL) throw AppException("MotionGraphPlanner: no motion graph");
+	for (int s=0; s<graph->numSequences(); s++)
+	{
+		float rate = graph->frameRate(s);
+		for (long f=1; f<graph->numFrames(s); f++)
+		{
+			const MotionGraph::RootFrame& a = graph->rootFrame(s, f-1);
+			const MotionGraph::RootFrame& b = graph->rootFrame(s, f);
+			float speed = sqrt((b.x-a.x)*(b.x-a.x) + (b.z-a.z)*(b.z-a.z))*rate;
+			max_speed = max(max_speed, speed);
+		}
+	}
+	// a graph that does not move can still turn or reach goals it starts at
+	if (max_speed <= 0.0f) max_speed = 1e-6f;
+}
+
+bool MotionGraphPlanner::plan(const Start& start, const Goal& goal, Plan& plan, const Limits& limits)
+{
+	return search(start, goal, limits, NULL, plan);
+}
+
+bool MotionGraphPlanner::replan(const Start& start, const Goal& goal, Plan& plan, const Limits& limits)
+{
+	// Replay the rest of the previous plan from the character's current
+	// position. If it still reaches the goal, its cost bounds the search.
+	Plan previous;
+	previous.reaches_goal = false;
+	previous.duration = previous.cost = 0.0f;
+	previous.expanded = 0;
+	unsigned int j = 0;
+	while ((j < plan.segments.size()) && !((plan.segments[j].seq == start.seq) &&
+		(plan.segments[j].first_frame <= start.frame) && (start.frame <= plan.segments[j].last_frame)))
+		j++;
+	Node node = { start.seq, start.frame, start.x, start.z, start.heading, 0.0f, 0.0f, -1, 0 };
+	for (unsigned int k=j; k<plan.segments.size(); k++)
+	{
+		const Segment& segment = plan.segments[k];
+		node.seq = segment.seq;
+		if (k > j) node.frame = segment.first_frame;
+		float rate = graph->frameRate(node.seq);
+		float closest = FLT_MAX;
+		long closest_frame = -1;
+		long goal_frame = scanSegment(node, segment.last_frame, goal, closest, closest_frame);
+		long last = (goal_frame >= 0) ? goal_frame : segment.last_frame;
+		Segment replayed = { node.seq, node.frame, last, node.x, node.z, node.heading };
+		previous.segments.push_back(replayed);
+		float played = (last - node.frame)/rate;
+		previous.duration += played;
+		previous.cost += played;
+		if (goal_frame >= 0)
+		{
+			previous.reaches_goal = true;
+			break;
+		}
+		if (k+1 == plan.segments.size()) break;
+		float step = transitionCost(segment.seq, segment.last_frame,
+			plan.segments[k+1].seq, plan.segments[k+1].first_frame);
+		if (step < 0.0f) break;
+		previous.cost += step;
+
+		// root at the transition
+		const MotionGraph::RootFrame& a = graph->rootFrame(node.seq, node.frame);
+		const MotionGraph::RootFrame& b = graph->rootFrame(node.seq, segment.last_frame);
+		float turn = node.heading - a.heading;
+		float c = cos(turn), s = sin(turn);
+		float wx = b.x - a.x, wz = b.z - a.z;
+		node.x += c*wx + s*wz;
+		node.z += -s*wx + c*wz;
+		node.heading = wrapAngle(b.heading + turn);
+		node.time += played;
+	}
+	return search(start, goal, limits, previous.reaches_goal ? &previous : NULL, plan);
+}
+
+const vector<MotionGraphPlanner::Edge>& MotionGraphPlanner::edgesFrom(int seq, long frame)
+{
+	long long key = ((long long)seq << 32) | (long long)frame;
+	unordered_map<long long, vector<Edge> >::iterator found = edge_memo.find(key);
+	if (found != edge_memo.end()) return found->second;
+
+	vector<Edge>& edges = edge_memo[key];
+	const MotionGraph::RootFrame& a = graph->rootFrame(seq, frame);
+	float c = cos(a.heading), s = sin(a.heading);
+	float rate = graph->frameRate(seq);
+	MotionGraph::TransitionSpan span = graph->findTransitions(seq, int(frame) + MIN_SEGMENT_FRAMES);
+	for (const MotionGraph::Transition* t=span.begin(); t!=span.end(); t++)
+	{
+		const MotionGraph::RootFrame& b = graph->rootFrame(seq, t->from_frame);
+		float wx = b.x - a.x, wz = b.z - a.z;
+		Edge edge;
+		edge.from_frame = t->from_frame;
+		edge.to_seq = t->to_seq;
+		edge.to_frame = t->to_frame;
+		edge.dx = c*wx - s*wz;
+		edge.dz = s*wx + c*wz;
+		edge.dheading = b.heading - a.heading;
+		edge.cost = (t->from_frame - frame)/rate + transition_cost + distance_cost*t->distance;
+		edges.push_back(edge);
+	}
+	return edges;
+}
+
+long MotionGraphPlanner::scanSegment(const Node& node, long last_frame, const Goal& goal,
+	float& closest, long& closest_frame) const
+{
+	float rate = graph->frameRate(node.seq);
+	long end = min(last_frame, node.frame + long((goal.time_budget - node.time)*rate));
+	const MotionGraph::RootFrame& a = graph->rootFrame(node.seq, node.frame);
+	float turn = node.heading - a.heading;
+	float c = cos(turn), s = sin(turn);
+	long f = node.frame;
+	while (f <= end)
+	{
+		const MotionGraph::RootFrame& p = graph->rootFrame(node.seq, f);
+		float wx = p.x - a.x, wz = p.z - a.z;
+		float dx = node.x + c*wx + s*wz - goal.x;
+		float dz = node.z - s*wx + c*wz - goal.z;
+		float d = sqrt(dx*dx + dz*dz);
+		if (d < closest)
+		{
+			closest = d;
+			closest_frame = f;
+		}
+		if (d <= goal.radius)
+		{
+			if (!goal.use_heading || (fabs(wrapAngle(p.heading + turn - goal.heading)) <= goal.heading_tolerance))
+				return f;
+			f++;
+		}
+		else
+		{
+			// no frame before this can be at the goal
+			f += max(1L, long((d - goal.radius)*rate/max_speed));
+		}
+	}
+	return -1;
+}
+
+float MotionGraphPlanner::heuristic(float x, float z, const Goal& goal) const
+{
+	float d = sqrt((x-goal.x)*(x-goal.x) + (z-goal.z)*(z-goal.z));
+	return max(0.0f, d - goal.radius)/max_speed;
+}
+
+float MotionGraphPlanner::transitionCost(int from_seq, long from_frame, int to_seq, long to_frame) const
+{
+	MotionGraph::TransitionSpan span = graph->findTransitions(from_seq, int(from_frame) - 1);
+	for (const MotionGraph::Transition* t=span.begin(); (t!=span.end()) && (t->from_frame==from_frame); t++)
+		if ((t->to_seq == to_seq) && (t->to_frame == to_frame))
+			return transition_cost + distance_cost*t->distance;
+	return -1.0f;
+}
+
+void MotionGraphPlanner::buildPlan(const vector<Node>& nodes, int last, long last_frame, bool reached, Plan& plan) const
+{
+	vector<int> chain;
+	for (int i=last; i>=0; i=nodes[i].parent) chain.push_back(i);
+	reverse(chain.begin(), chain.end());
+	plan.segments.clear();
+	plan.duration = 0.0f;
+	for (unsigned int k=0; k<chain.size(); k++)
+	{
+		const Node& n = nodes[chain[k]];
+		long end = (k+1 < chain.size()) ? nodes[chain[k+1]].parent_exit : last_frame;
+		Segment segment = { n.seq, n.frame, end, n.x, n.z, n.heading };
+		plan.segments.push_back(segment);
+		plan.duration += (end - n.frame)/graph->frameRate(n.seq);
+	}
+	const Node& n = nodes[last];
+	plan.cost = n.cost + (last_frame - n.frame)/graph->frameRate(n.seq);
+	plan.reaches_goal = reached;
+}
+
+bool MotionGraphPlanner::search(const Start& start, const Goal& goal, const Limits& limits,
+	const Plan* bound, Plan& plan)
+{
+	if ((start.seq < 0) || (start.seq >= graph->numSequences()) ||
+		(start.frame < 0) || (start.frame >= graph->numFrames(start.seq)))
+		throw AppException("MotionGraphPlanner: start is not a frame of the motion graph");
+	chrono::steady_clock::time_point began = chrono::steady_clock::now();
+
+	vector<Node> nodes;
+	typedef pair<float, int> Entry;
+	priority_queue<Entry, vector<Entry>, greater<Entry> > open;
+	unordered_map<PlannerKey, float, PlannerKeyHash> best_cost;
+
+	float incumbent = (bound != NULL) ? bound->cost : FLT_MAX;
+	int goal_node = -1;
+	long goal_node_frame = -1;
+	float closest = FLT_MAX;
+	int closest_node = -1;
+	long closest_frame = -1;
+
+	Node first = { start.seq, start.frame, start.x, start.z, wrapAngle(start.heading), 0.0f, 0.0f, -1, 0 };
+	nodes.push_back(first);
+	open.push(Entry(heuristic(first.x, first.z, goal), 0));
+	long expanded = 0;
+	while (!open.empty() && (expanded < limits.max_nodes))
+	{
+		if ((expanded % TIME_CHECK_INTERVAL == 0) && (expanded > 0))
+		{
+			chrono::duration<double> elapsed = chrono::steady_clock::now() - began;
+			if (elapsed.count() > limits.max_seconds) break;
+		}
+		Entry top = open.top();
+		open.pop();
+		// nothing left can beat the best plan
+		if (top.first >= incumbent) break;
+		Node n = nodes[top.second];
+		expanded++;
+
+		float rate = graph->frameRate(n.seq);
+		float node_closest = closest;
+		long node_closest_frame = -1;
+		long goal_frame = scanSegment(n, graph->numFrames(n.seq) - 1, goal, node_closest, node_closest_frame);
+		if (node_closest_frame >= 0)
+		{
+			closest = node_closest;
+			closest_node = top.second;
+			closest_frame = node_closest_frame;
+		}
+		if (goal_frame >= 0)
+		{
+			float cost = n.cost + (goal_frame - n.frame)/rate;
+			if (cost < incumbent)
+			{
+				incumbent = cost;
+				goal_node = top.second;
+				goal_node_frame = goal_frame;
+			}
+		}
+
+		const vector<Edge>& edges = edgesFrom(n.seq, n.frame);
+		float c = cos(n.heading), s = sin(n.heading);
+		for (unsigned int k=0; k<edges.size(); k++)
+		{
+			const Edge& e = edges[k];
+			// edges are in frame order: later ones leave after the goal or the budget
+			if ((goal_frame >= 0) && (e.from_frame >= goal_frame)) break;
+			float time = n.time + (e.from_frame - n.frame)/rate;
+			if (time > goal.time_budget) break;
+
+			Node child;
+			child.seq = e.to_seq;
+			child.frame = e.to_frame;
+			child.x = n.x + c*e.dx + s*e.dz;
+			child.z = n.z - s*e.dx + c*e.dz;
+			child.heading = wrapAngle(n.heading + e.dheading);
+			child.time = time;
+			child.cost = n.cost + e.cost;
+			child.parent = top.second;
+			child.parent_exit = e.from_frame;
+			float h = heuristic(child.x, child.z, goal);
+			if ((time + h > goal.time_budget) || (child.cost + h >= incumbent)) continue;
+
+			PlannerKey key;
+			key.seq = child.seq;
+			key.frame = child.frame;
+			key.cell_x = int(floor(child.x/cell_size));
+			key.cell_z = int(floor(child.z/cell_size));
+			key.heading_bin = int(floor((child.heading + PI_F)*HEADING_BINS/(2.0f*PI_F))) % HEADING_BINS;
+			unordered_map<PlannerKey, float, PlannerKeyHash>::iterator seen = best_cost.find(key);
+			if ((seen != best_cost.end()) && (seen->second <= child.cost)) continue;
+			best_cost[key] = child.cost;
+			nodes.push_back(child);
+			open.push(Entry(child.cost + h, int(nodes.size()) - 1));
+		}
+	}
+
+	if (goal_node >= 0) buildPlan(nodes, goal_node, goal_node_frame, true, plan);
+	else if (bound != NULL) plan = *bound;
+	else if (closest_node >= 0) buildPlan(nodes, closest_node, closest_frame, false, plan);
+	else buildPlan(nodes, 0, start.frame, false, plan);
+	plan.expanded = expanded;
+	return plan.reaches_goal;
+}
@@ -0,0 +1,143 @@
+//-----------------------------------------------------------------------------
+// app1001 - Builds with SKA Version 4.0
+//-----------------------------------------------------------------------------
+// MotionGraphPlanner.h
+//    Plans a path through a MotionGraph that takes the character's root to a
+//    goal position (and optionally heading) within a time budget.
+//    The search is A* over graph nodes (a sequence entered at some frame,
+//    with the root at some world position and heading). An edge plays the
+//    sequence up to a transition and takes it. Edge costs are the time
+//    played plus a penalty per transition; the heuristic is the remaining
+//    distance divided by the fastest root speed in the graph, which never
+//    overestimates the time still needed. Nodes that cannot reach the goal
+//    within the time budget are cut off (branch and bound).
+//    The outgoing edges of each node, with their root displacements, are
+//    computed once and kept for later searches. Each search is limited in
+//    nodes and in time; if it runs out it returns the plan that got closest.
+//    replan() continues from a moving character towards a moving goal,
+//    using the rest of the previous plan as the first bound on the search.
+//-----------------------------------------------------------------------------
+
+#ifndef MOTIONGRAPHPLANNER_DOT_H
+#define MOTIONGRAPHPLANNER_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+#include <unordered_map>
+using namespace std;
+#include "MotionGraph.h"
+
+class MotionGraphPlanner
+{
+public:
+	// The character is at frame of sequence seq, with its root on the
+	// floor at (x, z) facing heading (radians about y, 0 along z).
+	struct Start
+	{
+		int seq;
+		long frame;
+		float x;
+		float z;
+		float heading;
+	};
+
+	struct Goal
+	{
+		float x;
+		float z;
+		float radius;				// reached when the root is this close to (x, z)
+		bool use_heading;			// if true the root must also face heading
+		float heading;
+		float heading_tolerance;	// radians
+		float time_budget;			// seconds of motion allowed to reach the goal
+	};
+
+	// Frames first_frame to last_frame of sequence seq, played with the root
+	// of first_frame at (x, z) facing heading. Every segment but the last
+	// ends with a transition from last_frame into the next segment.
+	struct Segment
+	{
+		int seq;
+		long first_frame;
+		long last_frame;
+		float x;
+		float z;
+		float heading;
+	};
+
+	struct Plan
+	{
+		vector<Segment> segments;
+		bool reaches_goal;	// if false the plan ends as close to the goal as the search got
+		float duration;		// seconds
+		float cost;
+		long expanded;		// nodes expanded by the search
+	};
+
+	// bounds on a single search
+	struct Limits
+	{
+		long max_nodes;
+		double max_seconds;
+		Limits() : max_nodes(100000), max_seconds(0.02) { }
+	};
+
+	// transition_cost is in seconds per transition; distance_cost is seconds
+	// per unit of transition distance. cell_size is the spacing of the
+	// position grid that tells search nodes apart (in root position units).
+	MotionGraphPlanner(const MotionGraph* _graph, float _transition_cost=0.1f,
+		float _distance_cost=0.02f, float _cell_size=10.0f);
+
+	// Returns plan.reaches_goal.
+	bool plan(const Start& start, const Goal& goal, Plan& plan, const Limits& limits=Limits());
+	// As plan(), but if start lies on plan and the rest of plan still
+	// reaches goal, that is kept unless something cheaper is found.
+	bool replan(const Start& start, const Goal& goal, Plan& plan, const Limits& limits=Limits());
+
+private:
+	const MotionGraph* graph;
+	float transition_cost;
+	float distance_cost;
+	float cell_size;
+	float max_speed;		// fastest root speed in the graph, units per second
+
+	// A transition leaving a node: the root moves by (dx, dz) and turns by
+	// dheading, relative to its position and heading at the entry frame.
+	struct Edge
+	{
+		int from_frame;
+		int to_seq;
+		int to_frame;
+		float dx;
+		float dz;
+		float dheading;
+		float cost;
+	};
+	// outgoing edges of each node, by sequence and entry frame
+	unordered_map<long long, vector<Edge> > edge_memo;
+
+	struct Node
+	{
+		int seq;
+		long frame;
+		float x;
+		float z;
+		float heading;
+		float time;			// seconds played since the start
+		float cost;
+		int parent;			// -1 for the start
+		long parent_exit;	// frame of the parent's sequence left by the transition
+	};
+
+	const vector<Edge>& edgesFrom(int seq, long frame);
+	// Play node's sequence from its frame to at most last_frame and the time
+	// budget. Returns the first frame at the goal, or -1. closest and
+	// closest_frame are updated with the nearest approach that was seen.
+	long scanSegment(const Node& node, long last_frame, const Goal& goal,
+		float& closest, long& closest_frame) const;
+	float heuristic(float x, float z, const Goal& goal) const;
+	float transitionCost(int from_seq, long from_frame, int to_seq, long to_frame) const;
+	void buildPlan(const vector<Node>& nodes, int last, long last_frame, bool reached, Plan& plan) const;
+	bool search(const Start& start, const Goal& goal, const Limits& limits, const Plan* bound, Plan& plan);
+};
+
+#endif
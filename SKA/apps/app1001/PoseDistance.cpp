@@ -0,0 +1,240 @@
+//-----------------------------------------------------------------------------
+// app1001 - Builds with SKA Version 4.0
+//-----------------------------------------------------------------------------
+// PoseDistance.cpp
+//    Frame to frame pose distances between two motion sequences.
+//-----------------------------------------------------------------------------
+
+#include <Core/SystemConfiguration.h>
+#include <Core/Parallel.h>
+#include <Math/Float4.h>
+#include <cmath>
+#include "AppConfig.h"
+#include "PoseDistance.h"
+
+// Tile sizes: a column tile of b (TILE_COLS frames of every joint) stays in
+// cache while TILE_ROWS frames of a are compared against it.
+static const int TILE_ROWS = 16;
+static const int TILE_COLS = 64;
+// joints between checks of the culling threshold
+static const int CULL_CHECK_JOINTS = 4;
+
+void PackedPoses::pack(const PoseFeatures& features, int first_joint)
+{
+	num_frames = int(features.numFrames());
+	num_joints = features.numJoints() - first_joint;
+	if (num_joints < 0) num_joints = 0;
+	stride = (num_frames + 7) & ~3L;
+	data.assign(4*num_joints*stride, 0.0f);
+	for (int f=0; f<num_frames; f++)
+	{
+		for (int k=0; k<num_joints; k++)
+		{
+			const float* q = features.jointRotation(f, first_joint + k);
+			for (int c=0; c<4; c++) data[(4*k+c)*stride + f] = q[c];
+		}
+	}
+}
+
+// one row frame of a against four frames of b starting at j
+static inline Float4 distance4(const PackedPoses& a, int i, const PackedPoses& b, int j, Float4 limit)
+{
+	Float4 sum = f4zero();
+	for (int k=0; k<a.num_joints; k++)
+	{
+		Float4 dw = f4sub(f4set1(a.component(k,0)[i]), f4loadu(b.component(k,0)+j));
+		Float4 dx = f4sub(f4set1(a.component(k,1)[i]), f4loadu(b.component(k,1)+j));
+		Float4 dy = f4sub(f4set1(a.component(k,2)[i]), f4loadu(b.component(k,2)+j));
+		Float4 dz = f4sub(f4set1(a.component(k,3)[i]), f4loadu(b.component(k,3)+j));
+		Float4 m = f4mul(dw, dw);
+		m = f4madd(dx, dx, m);
+		m = f4madd(dy, dy, m);
+		m = f4madd(dz, dz, m);
+		sum = f4add(sum, f4sqrt(m));
+		// the sum only grows, so stop once all four lanes are over the limit
+		if (((k+1) % CULL_CHECK_JOINTS == 0) && (f4movemask(f4cmplt(sum, limit)) == 0)) break;
+	}
+	return sum;
+}
+
+void computePoseDistances(const PackedPoses& a, const PackedPoses& b,
+	int row_begin, int row_end, int col_begin, int col_end,
+	float max_distance, float* result, long result_stride, int max_threads)
+{
+	if (a.num_joints != b.num_joints)
+		throw AppException("computePoseDistances: sequences have different numbers of joints");
+	if ((row_end <= row_begin) || (col_end <= col_begin)) return;
+
+	int num_row_tiles = (row_end - row_begin + TILE_ROWS - 1)/TILE_ROWS;
+	parallelFor(0, num_row_tiles, [&](long tile)
+	{
+		int i0 = row_begin + int(tile)*TILE_ROWS;
+		int i1 = (i0 + TILE_ROWS < row_end) ? i0 + TILE_ROWS : row_end;
+		Float4 limit = f4set1(max_distance);
+		Float4 culled = f4set1(POSE_DISTANCE_CULLED);
+		float lanes[4];
+		for (int j0=col_begin; j0<col_end; j0+=TILE_COLS)
+		{
+			int j1 = (j0 + TILE_COLS < col_end) ? j0 + TILE_COLS : col_end;
+			for (int i=i0; i<i1; i++)
+			{
+				float* row = result + (i-row_begin)*result_stride - col_begin;
+				// the padding of b's arrays covers a partial last group
+				for (int j=j0; j<j1; j+=4)
+				{
+					Float4 d = distance4(a, i, b, j, limit);
+					d = f4select(f4cmplt(d, limit), d, culled);
+					if (j+4 <= j1) f4storeu(row+j, d);
+					else
+					{
+						f4storeu(lanes, d);
+						for (int k=0; k<j1-j; k++) row[j+k] = lanes[k];
+					}
+				}
+			}
+		}
+	}, 1, max_threads);
+}
+
+void PointClouds::pack(const float* positions, int _num_frames, int _num_points)
+{
+	num_frames = _num_frames;
+	num_points = _num_points;
+	padded = (num_points + 3) & ~3;
+	data.assign(3L*num_frames*padded, 0.0f);
+	double mean_x = 0.0, mean_z = 0.0;
+	long count = long(num_frames)*num_points;
+	for (long p=0; p<count; p++)
+	{
+		mean_x += positions[3*p];
+		mean_z += positions[3*p+2];
+	}
+	if (count > 0) { mean_x /= count; mean_z /= count; }
+
+	for (int f=0; f<num_frames; f++)
+	{
+		float* x = &data[(3L*f)*padded];
+		float* y = x + padded;
+		float* z = y + padded;
+		for (int k=0; k<num_points; k++)
+		{
+			const float* p = positions + 3*(long(f)*num_points + k);
+			x[k] = float(p[0] - mean_x);
+			y[k] = p[1];
+			z[k] = float(p[2] - mean_z);
+		}
+	}
+	computePrefixSums();
+}
+
+void PointClouds::computePrefixSums()
+{
+	prefix_x.assign(num_frames+1, 0.0);
+	prefix_z.assign(num_frames+1, 0.0);
+	prefix_sq.assign(num_frames+1, 0.0);
+	for (int f=0; f<num_frames; f++)
+	{
+		const float* x = &data[(3L*f)*padded];
+		const float* y = x + padded;
+		const float* z = y + padded;
+		double sx = 0.0, sz = 0.0, sq = 0.0;
+		for (int k=0; k<num_points; k++)
+		{
+			sx += x[k];
+			sz += z[k];
+			sq += double(x[k])*x[k] + double(y[k])*y[k] + double(z[k])*z[k];
+		}
+		prefix_x[f+1] = prefix_x[f] + sx;
+		prefix_z[f+1] = prefix_z[f] + sz;
+		prefix_sq[f+1] = prefix_sq[f] + sq;
+	}
+}
+
+// Sums over the points of frame i of a and frame j of b that depend on
+// both frames: x*x'+z*z', x*z'-x'*z and y*y'.
+static inline void crossTerms(const PointClouds& a, int i, const PointClouds& b, int j, double terms[3])
+{
+	const float* xa = &a.data[(3L*i)*a.padded];
+	const float* ya = xa + a.padded;
+	const float* za = ya + a.padded;
+	const float* xb = &b.data[(3L*j)*b.padded];
+	const float* yb = xb + b.padded;
+	const float* zb = yb + b.padded;
+	Float4 dot = f4zero(), cross = f4zero(), up = f4zero();
+	for (int k=0; k<a.padded; k+=4)
+	{
+		Float4 x1 = f4loadu(xa+k), z1 = f4loadu(za+k);
+		Float4 x2 = f4loadu(xb+k), z2 = f4loadu(zb+k);
+		dot = f4madd(x1, x2, f4madd(z1, z2, dot));
+		cross = f4sub(f4madd(x1, z2, cross), f4mul(x2, z1));
+		up = f4madd(f4loadu(ya+k), f4loadu(yb+k), up);
+	}
+	float lanes[3][4];
+	f4storeu(lanes[0], dot);
+	f4storeu(lanes[1], cross);
+	f4storeu(lanes[2], up);
+	for (int t=0; t<3; t++)
+		terms[t] = double(lanes[t][0]) + lanes[t][1] + lanes[t][2] + lanes[t][3];
+}
+
+// With n points in each window, sq the sum of squared lengths of both
+// windows, (X,Z) and (X',Z') the sums of the floor coordinates of each, and
+// the cross sums a = x*x'+z*z', c = x*z'-x'*z and u = y*y', the best
+// rotation by theta and floor translation leave
+//   sq - 2u - (X*X + Z*Z + X'*X' + Z'*Z')/n - 2*sqrt(ac*ac + bc*bc)
+// with ac = a - (X*X' + Z*Z')/n and bc = c - (X*Z' - X'*Z)/n, at
+// theta = atan2(bc, ac).
+void computeWindowedDistances(const PointClouds& a, const PointClouds& b, int window,
+	int row_begin, int row_end, int col_begin, int col_end,
+	float* result, long result_stride, int max_threads)
+{
+	if (a.num_points != b.num_points)
+		throw AppException("computeWindowedDistances: sequences have different numbers of points");
+	if (window < 1)
+		throw AppException("computeWindowedDistances: window must be at least one frame");
+	if ((row_end <= row_begin) || (col_end <= col_begin)) return;
+	if ((row_begin < 0) || (col_begin < 0) ||
+		(row_end + window - 1 > a.num_frames) || (col_end + window - 1 > b.num_frames))
+		throw AppException("computeWindowedDistances: windows run past the end of a sequence");
+
+	int height = row_end - row_begin;
+	int width = col_end - col_begin;
+	double n = double(window)*a.num_points;
+	// diagonal d starts at (row_begin + max(0, height-1-d), col_begin + max(0, d-height+1))
+	parallelFor(0, height + width - 1, [&](long d)
+	{
+		int i = row_begin + ((d < height) ? height - 1 - int(d) : 0);
+		int j = col_begin + ((d < height) ? 0 : int(d) - height + 1);
+		int length = min(row_end - i, col_end - j);
+
+		// cross terms of the frame pairs in the current window, as a ring
+		vector<double> ring(3*window);
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		for (int t=0; t<window; t++)
+		{
+			crossTerms(a, i+t, b, j+t, &ring[3*t]);
+			for (int s=0; s<3; s++) sum[s] += ring[3*t+s];
+		}
+		for (int step=0; step<length; step++, i++, j++)
+		{
+			if (step > 0)
+			{
+				// slide: drop frame pair (i-1, j-1), add (i+window-1, j+window-1)
+				double* slot = &ring[3*((step-1) % window)];
+				for (int s=0; s<3; s++) sum[s] -= slot[s];
+				crossTerms(a, i+window-1, b, j+window-1, slot);
+				for (int s=0; s<3; s++) sum[s] += slot[s];
+			}
+			double xa = a.prefix_x[i+window] - a.prefix_x[i];
+			double za = a.prefix_z[i+window] - a.prefix_z[i];
+			double xb = b.prefix_x[j+window] - b.prefix_x[j];
+			double zb = b.prefix_z[j+window] - b.prefix_z[j];
+			double sq = (a.prefix_sq[i+window] - a.prefix_sq[i]) + (b.prefix_sq[j+window] - b.prefix_sq[j]);
+			double ac = sum[0] - (xa*xb + za*zb)/n;
+			double bc = sum[1] - (xa*zb - xb*za)/n;
+			double residual = sq - 2.0*sum[2] - (xa*xa + za*za + xb*xb + zb*zb)/n
+				- 2.0*sqrt(ac*ac + bc*bc);
+			result[(i-row_begin)*result_stride + (j-col_begin)] = float(sqrt(max(residual, 0.0)/n));
+		}
+	}, 8, max_threads);
+}
@@ -0,0 +1,98 @@
+//-----------------------------------------------------------------------------
+// app1001 - Builds with SKA Version 4.0
+//-----------------------------------------------------------------------------
+// PoseDistance.h
+//    Frame to frame pose distances between two motion sequences, used by
+//    MotionGraph to find transitions. The distance between two poses is the
+//    sum over joints of the magnitude of the quaternion difference.
+//    Poses are packed one array per quaternion component (w, x, y, z of each
+//    joint), so four frames of one sequence are compared with a frame of
+//    the other in each SIMD operation. The matrix is computed in tiles that
+//    fit in cache, spread across threads.
+//    The windowed point cloud distance (Kovar, Gleicher and Pighin, Motion
+//    Graphs, SIGGRAPH 2002) compares the joint positions of a window of
+//    frames after each of the two frames, after the rotation about the
+//    vertical axis and the floor translation that align them best. Windows
+//    of neighbouring pairs on a diagonal of the matrix overlap, so their
+//    sums are updated as the window slides instead of being recomputed.
+//-----------------------------------------------------------------------------
+
+#ifndef POSEDISTANCE_DOT_H
+#define POSEDISTANCE_DOT_H
+#include <Core/SystemConfiguration.h>
+#include <vector>
+using namespace std;
+#include <Animation/PoseFeatures.h>
+
+// Value stored for frame pairs that were culled by the distance threshold.
+static const float POSE_DISTANCE_CULLED = 1.0e30f;
+
+struct PackedPoses
+{
+	int num_frames;
+	int num_joints;
+	// component c (0=w, 1=x, 2=y, 3=z) of joint k for frame f is at
+	// data[(4*k+c)*stride + f]. stride leaves room for a four frame read
+	// starting at any frame.
+	long stride;
+	vector<float> data;
+
+	PackedPoses() : num_frames(0), num_joints(0), stride(0) { }
+
+	// the joint rotations of features from first_joint on
+	void pack(const PoseFeatures& features, int first_joint=0);
+
+	const float* component(int joint, int c) const { return &data[(4*joint+c)*stride]; }
+
+	// the quaternions of frame f as one vector: w, x, y, z of each joint
+	void feature(int f, float* out) const
+	{
+		for (int k=0; k<4*num_joints; k++) out[k] = data[k*stride + f];
+	}
+};
+
+// Distances for frames [row_begin,row_end) of a against frames
+// [col_begin,col_end) of b. Entry (i,j) is stored at
+// result[(i-row_begin)*result_stride + (j-col_begin)].
+// Entries that reach max_distance are set to POSE_DISTANCE_CULLED, and
+// their computation stops as soon as the partial sum gets there.
+// Row tiles are spread across up to max_threads threads (0 = all).
+void computePoseDistances(const PackedPoses& a, const PackedPoses& b,
+	int row_begin, int row_end, int col_begin, int col_end,
+	float max_distance, float* result, long result_stride, int max_threads=0);
+
+// Joint positions of every frame, y up.
+struct PointClouds
+{
+	int num_frames;
+	int num_points;
+	// num_points rounded up to a multiple of 4
+	int padded;
+	// coordinate c (0=x, 1=y, 2=z) of point k in frame f is at
+	// data[(3*f+c)*padded + k]. Padding points are zero.
+	vector<float> data;
+	// sums over frames [0,f) of the per frame sums of x, of z and of
+	// x*x+y*y+z*z over all points
+	vector<double> prefix_x, prefix_z, prefix_sq;
+
+	PointClouds() : num_frames(0), num_points(0), padded(0) { }
+
+	// positions holds num_frames*num_points points (x, y, z), frame by
+	// frame. The clip's mean floor position is subtracted to keep values
+	// small; the distance does not depend on it.
+	void pack(const float* positions, int _num_frames, int _num_points);
+	// fill the prefix sums from data
+	void computePrefixSums();
+};
+
+// Windowed distances for frames [row_begin,row_end) of a against frames
+// [col_begin,col_end) of b, stored like computePoseDistances. Entry (i,j)
+// compares frames i to i+window-1 of a with frames j to j+window-1 of b,
+// so a and b need window-1 frames after row_end and col_end. The value is
+// the root mean square distance between corresponding points after the
+// best alignment, in the units of the positions.
+void computeWindowedDistances(const PointClouds& a, const PointClouds& b, int window,
+	int row_begin, int row_end, int col_begin, int col_end,
+	float* result, long result_stride, int max_threads=0);
+
+#endif